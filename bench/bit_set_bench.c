@@ -0,0 +1,110 @@
+// compare dense and sparse `BitSet` backends on the same inputs
+//
+// usage: bit_set_bench [iterations]
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bit_set.h"
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// xorshift, to generate the same inputs for both backends
+static uint64_t rand_state = 88172645463325252ull;
+static uint64_t next_rand() {
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 7;
+  rand_state ^= rand_state << 17;
+  return rand_state;
+}
+
+typedef struct {
+  unsigned length;
+  unsigned count;  // the number of set bits in each input
+} Input;
+
+// sets with the layout of reaching definitions: a few clustered bits in long sets
+static void fill(BitSet* s, unsigned count) {
+  unsigned base = next_rand() % length_BitSet(s);
+  for (unsigned i = 0; i < count; i++) {
+    unsigned idx = (base + next_rand() % 512) % length_BitSet(s);
+    set_BitSet(s, idx, true);
+  }
+}
+
+static double run(BitSetRepr repr, Input input, unsigned iterations, unsigned* checksum) {
+  rand_state = 88172645463325252ull;
+
+  enum { NUM_SETS = 64 };
+  BitSet* sets[NUM_SETS];
+  for (unsigned i = 0; i < NUM_SETS; i++) {
+    sets[i] = zero_BitSet_with(repr, input.length);
+    fill(sets[i], input.count);
+  }
+  BitSet* dst = zero_BitSet_with(repr, input.length);
+
+  double start = now();
+  for (unsigned it = 0; it < iterations; it++) {
+    for (unsigned i = 0; i < NUM_SETS; i++) {
+      BitSet* gen  = sets[i];
+      BitSet* in   = sets[(i + 1) % NUM_SETS];
+      BitSet* kill = sets[(i + 2) % NUM_SETS];
+
+      // the operations performed by `data_flow` and `propagation`
+      BitSet* join = copy_BitSet(in);
+      or_BitSet(join, sets[(i + 3) % NUM_SETS]);
+      transfer_BitSet(dst, gen, join, kill);
+      and_BitSet(join, kill);
+      *checksum += count_BitSet(dst) + count_BitSet(join);
+      if (count_BitSet(join) != 0) {
+        *checksum += mssb_BitSet(join);
+      }
+      *checksum += get_BitSet(dst, (it * NUM_SETS + i) % input.length);
+      // the live sets visited by `reg_alloc`
+      for (BitSetIterator bi = iter_BitSet(join); next_BitSet(&bi);) {
+        *checksum += bi.idx;
+      }
+      release_BitSet(join);
+    }
+  }
+  double elapsed = now() - start;
+
+  for (unsigned i = 0; i < NUM_SETS; i++) {
+    release_BitSet(sets[i]);
+  }
+  release_BitSet(dst);
+  return elapsed;
+}
+
+int main(int argc, char** argv) {
+  unsigned iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+  Input inputs[] = {
+      {256, 16},    {1024, 16},    {4096, 16},   {4096, 512},
+      {16384, 16},  {16384, 1024}, {65536, 16},  {65536, 4096},
+      {262144, 16}, {262144, 64},
+  };
+
+  printf("%10s %8s %12s %12s %8s\n", "length", "bits", "dense (ms)", "sparse (ms)", "ratio");
+  for (unsigned i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    unsigned dense_sum = 0, sparse_sum = 0;
+    double dense  = run(BS_DENSE, inputs[i], iterations, &dense_sum);
+    double sparse = run(BS_SPARSE, inputs[i], iterations, &sparse_sum);
+    if (dense_sum != sparse_sum) {
+      fprintf(stderr, "backends disagree on length %u\n", inputs[i].length);
+      return 1;
+    }
+
+    printf("%10u %8u %12.2f %12.2f %8.2f\n", inputs[i].length, inputs[i].count, dense * 1e3,
+           sparse * 1e3, dense / sparse);
+  }
+  return 0;
+}
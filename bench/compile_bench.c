@@ -0,0 +1,380 @@
+// compile time and memory of ccc on synthetic programs of growing size, to catch super-linear
+// behavior of phases
+//
+// usage: compile_bench CCC [steps] [CCC_OPTION...]
+// each program is generated at `steps` sizes, doubling from the base size of its shape
+// the exit status is 1 when any growth is flagged
+
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "error.h"
+
+// a phase is flagged when doubling the input multiplies its time or memory by more than this,
+// i.e. grows faster than n^1.5
+#define SUPERLINEAR_RATIO 2.83
+// measurements below these are too noisy to compare
+#define MIN_FLAGGED_MS 10.0
+#define MIN_FLAGGED_BYTES (1L << 20)
+
+#define MAX_PHASES 16
+#define MAX_PASSES 32
+
+static void gen_huge_function(FILE* p, unsigned n) {
+  fputs("int main() {\n  int a = 1;\n  int b = 2;\n  int c = 3;\n", p);
+  for (unsigned i = 0; i < n; i++) {
+    switch (i % 3) {
+      case 0:
+        fprintf(p, "  a = a + b * %u;\n", i);
+        break;
+      case 1:
+        fprintf(p, "  if (a > %u) b = b - c; else c = c + a;\n", i);
+        break;
+      case 2:
+        fprintf(p, "  int v%u = a ^ c;\n  c = c + v%u;\n", i, i);
+        break;
+    }
+  }
+  fputs("  return a + b + c;\n}\n", p);
+}
+
+// a single block, in which every use of a copy is checked for the definitions reaching it
+static void gen_straight_line(FILE* p, unsigned n) {
+  fputs("int main() {\n  int a = 3;\n  int b = 5;\n  int x = 1;\n", p);
+  for (unsigned i = 0; i < n; i++) {
+    fprintf(p, "  int v%u = a * %u + b;\n  x = x + v%u * (x - %u);\n", i, i, i, i);
+  }
+  fputs("  return x;\n}\n", p);
+}
+
+static void gen_many_functions(FILE* p, unsigned n) {
+  fputs("int f0(int x) { return x; }\n", p);
+  for (unsigned i = 1; i < n; i++) {
+    fprintf(p,
+            "int f%u(int x) {\n  int y = x * %u;\n  if (y > 100) return f%u(y - x);\n"
+            "  return y + f%u(x);\n}\n",
+            i, i, i - 1, i / 2);
+  }
+  fprintf(p, "int main() { return f%u(1); }\n", n - 1);
+}
+
+static void gen_deep_nesting(FILE* p, unsigned n) {
+  fputs("int main() {\n  int a = 0;\n", p);
+  for (unsigned i = 0; i < n; i++) {
+    if (i % 2 == 0) {
+      fprintf(p, "if (a < %u) {\n  a = a + %u;\n", i, i);
+    } else {
+      fprintf(p, "for (int i%u = 0; i%u < 2; i%u++) {\n  a = a + i%u;\n", i, i, i, i);
+    }
+  }
+  for (unsigned i = 0; i < n; i++) {
+    fputs("}\n", p);
+  }
+  fputs("  return a;\n}\n", p);
+}
+
+static void gen_long_expression(FILE* p, unsigned n) {
+  static const char* ops[] = {"+", "*", "-", "^", "&", "|"};
+  fputs("int main() {\n  int a = 3;\n  int b = 5;\n  return a", p);
+  for (unsigned i = 0; i < n; i++) {
+    fprintf(p, " %s %s", ops[i % 6], i % 2 ? "b" : "a");
+  }
+  fputs(";\n}\n", p);
+}
+
+static void gen_huge_switch(FILE* p, unsigned n) {
+  fputs("int f(int x) {\n  int y = 0;\n  switch (x) {\n", p);
+  for (unsigned i = 0; i < n; i++) {
+    if (i % 2 == 0) {
+      fprintf(p, "    case %u:\n      return x * %u;\n", i, i);
+    } else {
+      fprintf(p, "    case %u:\n      y = y + %u;\n      break;\n", i, i);
+    }
+  }
+  fputs("    default:\n      return 0;\n  }\n  return y;\n}\n", p);
+  fputs("int main() { return f(3); }\n", p);
+}
+
+static void gen_large_initializers(FILE* p, unsigned n) {
+  fprintf(p, "int data[%u] = {", n);
+  for (unsigned i = 0; i < n; i++) {
+    fprintf(p, "%s%u", i == 0 ? "" : ", ", i * 7);
+  }
+  fputs("};\n", p);
+
+  fprintf(p, "char* names[%u] = {", n / 8);
+  for (unsigned i = 0; i < n / 8; i++) {
+    fprintf(p, "%s\"name%u\"", i == 0 ? "" : ", ", i);
+  }
+  fputs("};\n", p);
+  fputs("int main() { return data[3]; }\n", p);
+}
+
+static const struct {
+  const char* name;
+  void (*generate)(FILE*, unsigned);
+  unsigned base;  // size of the smallest program
+} shapes[] = {
+    {"huge_function", gen_huge_function, 500},
+    {"straight_line", gen_straight_line, 150},
+    {"many_functions", gen_many_functions, 250},
+    {"deep_nesting", gen_deep_nesting, 50},
+    {"long_expression", gen_long_expression, 250},
+    {"huge_switch", gen_huge_switch, 250},
+    {"large_initializers", gen_large_initializers, 10000},
+};
+
+#define NUM_SHAPES (sizeof(shapes) / sizeof(shapes[0]))
+
+typedef struct {
+  char name[32];
+  double wall_ms;
+  long peak_heap;  // bytes
+} Phase;
+
+typedef struct {
+  Phase phases[MAX_PHASES];
+  unsigned num_phases;
+  Phase passes[MAX_PASSES];  // summed up over functions and iterations, with the largest heap
+  unsigned num_passes;
+  double wall_ms;  // of the whole process
+  long max_rss;    // bytes
+} Run;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Phase* find_phase(Phase* phases, unsigned count, const char* name) {
+  for (unsigned i = 0; i < count; i++) {
+    if (strcmp(phases[i].name, name) == 0) {
+      return &phases[i];
+    }
+  }
+  return NULL;
+}
+
+static void add_pass(Run* run, const Phase* p) {
+  Phase* sum = find_phase(run->passes, run->num_passes, p->name);
+  if (sum == NULL) {
+    if (run->num_passes == MAX_PASSES) {
+      error("too many passes");
+    }
+    run->passes[run->num_passes++] = *p;
+    return;
+  }
+  sum->wall_ms += p->wall_ms;
+  if (p->peak_heap > sum->peak_heap) {
+    sum->peak_heap = p->peak_heap;
+  }
+}
+
+// the output of `ccc --time-report=json`
+static void parse_report(Run* run, const char* report) {
+  const char* passes = strstr(report, "\"passes\"");
+  if (passes == NULL) {
+    error("unexpected time report: %.60s", report);
+  }
+
+  const char* cur = report;
+  while ((cur = strstr(cur, "{\"name\": \"")) != NULL && cur < passes) {
+    if (run->num_phases == MAX_PHASES) {
+      error("too many phases");
+    }
+    Phase* p = &run->phases[run->num_phases++];
+    if (sscanf(cur, "{\"name\": \"%31[^\"]\", \"wall_ms\": %lf, \"cpu_ms\": %*f, \"allocs\": %*u, "
+                    "\"peak_heap_bytes\": %ld}",
+               p->name, &p->wall_ms, &p->peak_heap) != 3) {
+      error("unexpected time report: %.60s", cur);
+    }
+    cur++;
+  }
+
+  cur = passes;
+  while ((cur = strstr(cur, "{\"name\": \"")) != NULL) {
+    Phase p;
+    if (sscanf(cur, "{\"name\": \"%31[^\"]\", \"function\": \"%*[^\"]\", \"iteration\": %*[^,], "
+                    "\"wall_ms\": %lf, \"cpu_ms\": %*f, \"allocs\": %*u, \"peak_heap_bytes\": %ld}",
+               p.name, &p.wall_ms, &p.peak_heap) != 3) {
+      error("unexpected time report: %.60s", cur);
+    }
+    add_pass(run, &p);
+    cur++;
+  }
+}
+
+static Run compile(const char* ccc, char** ccc_opts, const char* source) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    error("pipe failed");
+  }
+
+  double t0 = now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    unsigned argc = 0;
+    while (ccc_opts[argc] != NULL) {
+      argc++;
+    }
+    char** args = calloc(argc + 6, sizeof(char*));
+    args[0]     = (char*)ccc;
+    memcpy(args + 1, ccc_opts, sizeof(char*) * argc);
+    args[argc + 1] = "--time-report=json";
+    args[argc + 2] = "-o";
+    args[argc + 3] = "/dev/null";
+    args[argc + 4] = (char*)source;
+
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv(ccc, args);
+    _exit(127);
+  }
+  close(fds[1]);
+
+  size_t cap = 1 << 16, len = 0;
+  char* report = malloc(cap);
+  ssize_t n;
+  while ((n = read(fds[0], report + len, cap - len - 1)) > 0) {
+    len += n;
+    if (cap - len < 4096) {
+      cap *= 2;
+      report = realloc(report, cap);
+    }
+  }
+  report[len] = '\0';
+  close(fds[0]);
+
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  if (WIFSIGNALED(status)) {
+    error("%s killed by signal %d on %s", ccc, WTERMSIG(status), source);
+  }
+  if (WEXITSTATUS(status) != 0) {
+    error("%s failed on %s:\n%s", ccc, source, report);
+  }
+
+  Run run = {.wall_ms = (now() - t0) * 1e3, .max_rss = usage.ru_maxrss * 1024L};
+  parse_report(&run, report);
+  free(report);
+  return run;
+}
+
+static bool is_superlinear(double small, double large, double floor) {
+  return large >= floor && large > small * SUPERLINEAR_RATIO;
+}
+
+// print the phases in `bs` that grow super-linearly from the ones in `as`, returning how many
+static unsigned flag_phases(const char* kind,
+                            Phase* as,
+                            unsigned num_as,
+                            const Phase* bs,
+                            unsigned num_bs) {
+  unsigned flagged = 0;
+  for (unsigned i = 0; i < num_bs; i++) {
+    const Phase* b = &bs[i];
+    const Phase* a = find_phase(as, num_as, b->name);
+    if (a == NULL) {
+      continue;
+    }
+    if (is_superlinear(a->wall_ms, b->wall_ms, MIN_FLAGGED_MS)) {
+      printf("    ! %s %s time x%.1f\n", kind, b->name, b->wall_ms / a->wall_ms);
+      flagged++;
+    }
+    if (is_superlinear(a->peak_heap, b->peak_heap, MIN_FLAGGED_BYTES)) {
+      printf("    ! %s %s heap x%.1f\n", kind, b->name, (double)b->peak_heap / a->peak_heap);
+      flagged++;
+    }
+  }
+  return flagged;
+}
+
+static unsigned flag_growth(Run* prev, const Run* run) {
+  unsigned flagged = 0;
+  flagged += flag_phases("phase", prev->phases, prev->num_phases, run->phases, run->num_phases);
+  flagged += flag_phases("pass", prev->passes, prev->num_passes, run->passes, run->num_passes);
+  if (is_superlinear(prev->max_rss, run->max_rss, MIN_FLAGGED_BYTES)) {
+    printf("    ! rss x%.1f\n", (double)run->max_rss / prev->max_rss);
+    flagged++;
+  }
+  return flagged;
+}
+
+static void print_header(const Run* run) {
+  printf("  %8s %10s %9s", "size", "total(ms)", "rss(MiB)");
+  for (unsigned i = 0; i < run->num_phases; i++) {
+    // long phase names are cut to keep the table narrow
+    printf(" %9.9s", run->phases[i].name);
+  }
+  printf("\n");
+}
+
+static void print_run(unsigned size, const Run* run) {
+  printf("  %8u %10.1f %9.1f", size, run->wall_ms, run->max_rss / 1048576.0);
+  for (unsigned i = 0; i < run->num_phases; i++) {
+    printf(" %9.1f", run->phases[i].wall_ms);
+  }
+  printf("\n");
+}
+
+// the generated source, removed at exit as `error` exits on its own
+static char source[] = "/tmp/ccc-compile-bench-XXXXXX";
+
+static void remove_source() {
+  unlink(source);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    error("usage: compile_bench CCC [steps] [CCC_OPTION...]");
+  }
+  const char* ccc = argv[1];
+  unsigned steps  = argc > 2 ? atoi(argv[2]) : 4;
+  char** ccc_opts = argv + (argc > 2 ? 3 : 2);
+
+  int fd = mkstemp(source);
+  if (fd < 0) {
+    error("could not create a temporary file");
+  }
+  close(fd);
+  atexit(remove_source);
+
+  unsigned flagged = 0;
+  for (unsigned s = 0; s < NUM_SHAPES; s++) {
+    printf("%s\n", shapes[s].name);
+
+    Run prev = {0};
+    for (unsigned k = 0; k < steps; k++) {
+      unsigned size = shapes[s].base << k;
+      FILE* f       = fopen(source, "w");
+      shapes[s].generate(f, size);
+      fclose(f);
+
+      Run run = compile(ccc, ccc_opts, source);
+      if (k == 0) {
+        print_header(&run);
+      }
+      print_run(size, &run);
+      if (k != 0) {
+        flagged += flag_growth(&prev, &run);
+      }
+      prev = run;
+    }
+  }
+
+  printf("%u super-linear growth(s) flagged (more than x%.2f per doubling)\n", flagged,
+         SUPERLINEAR_RATIO);
+  return flagged != 0;
+}
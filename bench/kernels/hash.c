@@ -0,0 +1,68 @@
+// string hashing and an open addressing hash table
+
+void* calloc(long count, long size);
+
+// allocated in main, since ccc would emit every byte of global arrays, zeros included
+char* keys;  // 12 bytes each
+long* table_hashes;
+int* table_values;
+
+// FNV-1a, truncated to 31 bits
+long hash(char* s) {
+  long h = 2166136261;
+  for (int i = 0; s[i] != 0; i++) {
+    h = ((h ^ s[i]) * 16777619) & 2147483647;
+  }
+  return h;
+}
+
+void make_key(char* buf, int n) {
+  int len = 0;
+  buf[len++] = 107;  // 'k'
+  while (n > 0) {
+    buf[len++] = 97 + (n & 15);  // 'a' + a hex digit
+    n = n / 16;
+  }
+  buf[len] = 0;
+}
+
+// returns the slot of `h`, inserting it with `value` if absent
+int insert(long h, int value) {
+  int mask = 131071;
+  int i    = (int)(h & mask);
+  while (table_hashes[i] != 0) {
+    if (table_hashes[i] == h) {
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+  table_hashes[i] = h;
+  table_values[i] = value;
+  return i;
+}
+
+int main() {
+  int n        = 65536;
+  keys         = calloc(n, 12);
+  table_hashes = calloc(131072, 8);
+  table_values = calloc(131072, 4);
+  for (int i = 0; i < n; i++) {
+    make_key(keys + i * 12, i * 7 + 1);
+  }
+
+  long checksum = 0;
+  for (int round = 0; round < 40; round++) {
+    for (int i = 0; i < 131072; i++) {
+      table_hashes[i] = 0;
+    }
+    for (int i = 0; i < n; i++) {
+      int slot = insert(hash(keys + i * 12) + 1, i);
+      checksum = (checksum + table_values[slot]) & 16777215;
+    }
+    for (int i = n - 1; i >= 0; i = i - 3) {
+      int slot = insert(hash(keys + i * 12) + 1, -1);
+      checksum = (checksum * 31 + slot) & 16777215;
+    }
+  }
+  return (int)(checksum & 127);
+}
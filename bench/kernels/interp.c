@@ -0,0 +1,119 @@
+// a switch-dispatched stack machine running a counting loop
+
+enum {
+  OP_PUSH,
+  OP_LOAD,
+  OP_STORE,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_AND,
+  OP_XOR,
+  OP_LT,
+  OP_JUMP,
+  OP_JUMP_IF_ZERO,
+  OP_HALT,
+};
+
+int code[64];
+int stack[64];
+int vars[8];
+
+int emit(int pc, int op, int arg) {
+  code[pc]     = op;
+  code[pc + 1] = arg;
+  return pc + 2;
+}
+
+// for (i = 0; i < n; i++) { acc = ((acc * 31 + i) & 0xffffff) ^ 12345; }
+void assemble(int n) {
+  int pc = 0;
+  pc     = emit(pc, OP_PUSH, 0);
+  pc     = emit(pc, OP_STORE, 0);  // i
+  pc     = emit(pc, OP_PUSH, 0);
+  pc     = emit(pc, OP_STORE, 1);  // acc
+  int loop = pc;
+  pc       = emit(pc, OP_LOAD, 0);
+  pc       = emit(pc, OP_PUSH, n);
+  pc       = emit(pc, OP_LT, 0);
+  int exit = pc;
+  pc       = emit(pc, OP_JUMP_IF_ZERO, 0);
+  pc       = emit(pc, OP_LOAD, 1);
+  pc       = emit(pc, OP_PUSH, 31);
+  pc       = emit(pc, OP_MUL, 0);
+  pc       = emit(pc, OP_LOAD, 0);
+  pc       = emit(pc, OP_ADD, 0);
+  pc       = emit(pc, OP_PUSH, 16777215);
+  pc       = emit(pc, OP_AND, 0);
+  pc       = emit(pc, OP_PUSH, 12345);
+  pc       = emit(pc, OP_XOR, 0);
+  pc       = emit(pc, OP_STORE, 1);
+  pc       = emit(pc, OP_LOAD, 0);
+  pc       = emit(pc, OP_PUSH, 1);
+  pc       = emit(pc, OP_ADD, 0);
+  pc       = emit(pc, OP_STORE, 0);
+  pc       = emit(pc, OP_JUMP, loop);
+  code[exit + 1] = pc;
+  emit(pc, OP_HALT, 0);
+}
+
+int run() {
+  int pc = 0;
+  int sp = 0;
+  for (;;) {
+    int op  = code[pc];
+    int arg = code[pc + 1];
+    pc      = pc + 2;
+    switch (op) {
+      case OP_PUSH:
+        stack[sp++] = arg;
+        break;
+      case OP_LOAD:
+        stack[sp++] = vars[arg];
+        break;
+      case OP_STORE:
+        vars[arg] = stack[--sp];
+        break;
+      case OP_ADD:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] + stack[sp];
+        break;
+      case OP_SUB:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] - stack[sp];
+        break;
+      case OP_MUL:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] * stack[sp];
+        break;
+      case OP_AND:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] & stack[sp];
+        break;
+      case OP_XOR:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] ^ stack[sp];
+        break;
+      case OP_LT:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] < stack[sp];
+        break;
+      case OP_JUMP:
+        pc = arg;
+        break;
+      case OP_JUMP_IF_ZERO:
+        if (stack[--sp] == 0) {
+          pc = arg;
+        }
+        break;
+      case OP_HALT:
+        return vars[1];
+    }
+  }
+}
+
+int main() {
+  assemble(3000000);
+  int acc = run();
+  return (acc ^ acc / 65536) & 127;
+}
@@ -0,0 +1,48 @@
+// dense integer matrix multiplication and transposition
+
+int a[192][192];
+int b[192][192];
+int c[192][192];
+
+void multiply(int n) {
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      int sum = 0;
+      for (int k = 0; k < n; k++) {
+        sum = sum + a[i][k] * b[k][j];
+      }
+      c[i][j] = (sum & 4095) + 1;
+    }
+  }
+}
+
+void transpose_into_a(int n) {
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      a[j][i] = c[i][j];
+    }
+  }
+}
+
+int main() {
+  int n = 192;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      a[i][j] = (i * 3 + j) & 15;
+      b[i][j] = ((i + j * 5) & 15) | 1;
+    }
+  }
+
+  for (int round = 0; round < 10; round++) {
+    multiply(n);
+    transpose_into_a(n);
+  }
+
+  int checksum = 0;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      checksum = (checksum * 31 + c[i][j]) & 16777215;
+    }
+  }
+  return (checksum ^ checksum / 65536) & 127;
+}
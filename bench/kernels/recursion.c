@@ -0,0 +1,37 @@
+// deeply recursive calls with little work per call
+
+int fib(int n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+
+int ackermann(int m, int n) {
+  if (m == 0) {
+    return n + 1;
+  }
+  if (n == 0) {
+    return ackermann(m - 1, 1);
+  }
+  return ackermann(m - 1, ackermann(m, n - 1));
+}
+
+int moves;
+
+void hanoi(int n, int from, int to, int via) {
+  if (n == 0) {
+    return;
+  }
+  hanoi(n - 1, from, via, to);
+  moves = (moves + from * 3 + to) & 16777215;
+  hanoi(n - 1, via, to, from);
+}
+
+int main() {
+  int checksum = fib(30);
+  checksum     = checksum ^ ackermann(2, 2000) * 7;
+  hanoi(20, 1, 3, 2);
+  checksum = (checksum + moves) & 16777215;
+  return (checksum ^ checksum / 65536) & 127;
+}
@@ -0,0 +1,76 @@
+// quicksort and insertion sort of pseudo-random integers
+
+void* calloc(long count, long size);
+
+int* data;  // allocated in main, as in hash.c
+long seed;
+
+// a linear congruential generator, kept positive
+int next_random() {
+  seed = (seed * 1103515245 + 12345) & 2147483647;
+  return (int)(seed / 256);
+}
+
+void insertion_sort(int* a, int lo, int hi) {
+  for (int i = lo + 1; i <= hi; i++) {
+    int v = a[i];
+    int j = i - 1;
+    while (j >= lo && a[j] > v) {
+      a[j + 1] = a[j];
+      j--;
+    }
+    a[j + 1] = v;
+  }
+}
+
+void quick_sort(int* a, int lo, int hi) {
+  while (hi - lo > 16) {
+    int pivot = a[lo + (hi - lo) / 2];
+    int i     = lo;
+    int j     = hi;
+    while (i <= j) {
+      while (a[i] < pivot) {
+        i++;
+      }
+      while (a[j] > pivot) {
+        j--;
+      }
+      if (i <= j) {
+        int t = a[i];
+        a[i]  = a[j];
+        a[j]  = t;
+        i++;
+        j--;
+      }
+    }
+    // recurse into the smaller half to bound the depth
+    if (j - lo < hi - i) {
+      quick_sort(a, lo, j);
+      lo = i;
+    } else {
+      quick_sort(a, i, hi);
+      hi = j;
+    }
+  }
+  insertion_sort(a, lo, hi);
+}
+
+int main() {
+  int n        = 200000;
+  int checksum = 0;
+  data         = calloc(n, 4);
+  seed         = 42;
+  for (int round = 0; round < 8; round++) {
+    for (int i = 0; i < n; i++) {
+      data[i] = next_random();
+    }
+    quick_sort(data, 0, n - 1);
+    for (int i = 1; i < n; i++) {
+      if (data[i - 1] > data[i]) {
+        return 255;
+      }
+    }
+    checksum = checksum ^ data[n / 2] ^ data[n / 4];
+  }
+  return checksum & 127;
+}
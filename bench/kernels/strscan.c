@@ -0,0 +1,90 @@
+// scanning text for words, lines and substrings
+
+void* calloc(long count, long size);
+
+char* text;  // allocated in main, as in hash.c
+
+int fill_text(int size) {
+  long seed = 7;
+  int len   = 0;
+  while (len < size - 16) {
+    seed         = (seed * 1103515245 + 12345) & 2147483647;
+    int r        = (int)(seed / 256);
+    int word_len = 1 + (r & 7);
+    for (int i = 0; i < word_len; i++) {
+      text[len++] = 97 + ((r / 8 + i * 5) & 15);  // 'a' and following letters
+    }
+    if ((r & 63) == 0) {
+      text[len++] = 10;
+    } else {
+      text[len++] = 32;
+    }
+  }
+  text[len] = 0;
+  return len;
+}
+
+int string_length(char* s) {
+  int n = 0;
+  while (s[n] != 0) {
+    n++;
+  }
+  return n;
+}
+
+int count_words(char* s) {
+  int words   = 0;
+  int in_word = 0;
+  for (int i = 0; s[i] != 0; i++) {
+    int is_space = s[i] == 32 || s[i] == 10;
+    if (!is_space && !in_word) {
+      words++;
+    }
+    in_word = !is_space;
+  }
+  return words;
+}
+
+int count_vowels(char* s) {
+  int n = 0;
+  for (int i = 0; s[i] != 0; i++) {
+    char c = s[i];
+    if (c == 97 || c == 101 || c == 105 || c == 111 || c == 117) {
+      n++;
+    }
+  }
+  return n;
+}
+
+// naive search, returning the number of occurrences of `pat`
+int count_matches(char* s, int len, char* pat) {
+  int plen    = string_length(pat);
+  int matches = 0;
+  for (int i = 0; i + plen <= len; i++) {
+    int j = 0;
+    while (j < plen && s[i + j] == pat[j]) {
+      j++;
+    }
+    if (j == plen) {
+      matches++;
+    }
+  }
+  return matches;
+}
+
+int main() {
+  text         = calloc(1048576, 1);
+  int len      = fill_text(1048576);
+  int checksum = 0;
+  for (int round = 0; round < 6; round++) {
+    // keep rounds from being folded into one
+    text[round * 4099] = 98 + round;
+    checksum = checksum + string_length(text);
+    checksum = checksum + count_words(text) * 3;
+    checksum = checksum + count_vowels(text) * 5;
+    checksum = checksum + count_matches(text, len, "fk") * 7;
+    checksum = checksum + count_matches(text, len, "bgl") * 11;
+    checksum = checksum & 16777215;
+  }
+  return (checksum ^ checksum / 65536) & 127;
+}
@@ -0,0 +1,119 @@
+// lexer throughput on large inputs of several shapes
+//
+// usage: lexer_bench [rounds] [FILE]
+// FILE, if given, is repeated up to the input size and measured as well
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "error.h"
+#include "lexer.h"
+
+#define INPUT_SIZE (16u << 20)
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// `unit` repeated until the result reaches `INPUT_SIZE` bytes
+static char* repeat(const char* unit, size_t unit_len) {
+  size_t count = INPUT_SIZE / unit_len + 1;
+  char* buf    = malloc(unit_len * count + 1);
+  for (size_t i = 0; i < count; i++) {
+    memcpy(buf + unit_len * i, unit, unit_len);
+  }
+  buf[unit_len * count] = '\0';
+  return buf;
+}
+
+static char* read_unit(const char* path, size_t* len) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    error("could not open \"%s\"", path);
+  }
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char* buf = malloc(*len + 1);
+  fread(buf, 1, *len, f);
+  fclose(f);
+  buf[*len] = '\0';
+  return buf;
+}
+
+static void bench(const char* name, const char* input, unsigned rounds) {
+  size_t size     = strlen(input);
+  unsigned long n = 0;
+
+  double t0 = now();
+  for (unsigned k = 0; k < rounds; k++) {
+    Lexer* l = new_Lexer(input);
+    while (next_token(l).kind != TK_END) {
+      n++;
+    }
+    release_Lexer(l);
+  }
+  double t = (now() - t0) / rounds;
+
+  printf("%-10s %10.1f %12.1f %12.1f\n", name, size / t / 1e6, n / rounds / t / 1e6, t * 1e3);
+}
+
+static const char code[] =
+    "static int compute_checksum(const char* buffer, int length) {\n"
+    "  int checksum = 0; // running sum\n"
+    "  for (int i = 0; i < length; i++) {\n"
+    "    checksum = (checksum << 5) ^ (checksum >> 27) ^ buffer[i];\n"
+    "  }\n"
+    "  if (checksum != 0 && length >= 16) { return checksum & 2147483647; }\n"
+    "  return checksum;\n"
+    "}\n\n";
+
+static const char comments[] =
+    "/*\n"
+    " * Block comments as found in file and function headers, which the lexer has to\n"
+    " * skip without producing tokens. They are usually several lines long.\n"
+    " */\n"
+    "int x; // a trailing line comment that runs for a while before the newline\n";
+
+static const char idents[] =
+    "translation_unit_external_declaration = declaration_specifier_list + "
+    "struct_declarator_with_bit_width * initializer_list_designator_count;\n";
+
+static const char strings[] =
+    "puts(\"a string literal of moderate length, as used for diagnostics and formats\");\n";
+
+#define UNIT(s) {#s, s, sizeof(s) - 1}
+
+static const struct {
+  const char* name;
+  const char* text;
+  size_t length;
+} units[] = {UNIT(code), UNIT(comments), UNIT(idents), UNIT(strings)};
+
+int main(int argc, char** argv) {
+  unsigned rounds = argc > 1 ? atoi(argv[1]) : 5;
+
+  printf("%-10s %10s %12s %12s\n", "input", "MB/s", "Mtokens/s", "time (ms)");
+
+  for (unsigned i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+    char* input = repeat(units[i].text, units[i].length);
+    bench(units[i].name, input, rounds);
+    free(input);
+  }
+
+  if (argc > 2) {
+    size_t len;
+    char* unit  = read_unit(argv[2], &len);
+    char* input = repeat(unit, len);
+    bench("file", input, rounds);
+    free(input);
+    free(unit);
+  }
+  return 0;
+}
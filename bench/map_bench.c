@@ -0,0 +1,117 @@
+// compare `DEFINE_MAP` with the former chained implementation
+//
+// usage: map_bench [rounds]
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chained_map.h"
+#include "error.h"
+#include "intern.h"
+#include "map.h"
+
+static unsigned copy_unsigned(unsigned u) {
+  return u;
+}
+static void release_unsigned(unsigned u) {}
+
+DECLARE_MAP(unsigned, OpenMap)
+DEFINE_MAP(copy_unsigned, release_unsigned, unsigned, OpenMap)
+
+DECLARE_CHAINED_MAP(unsigned, ChainedMap)
+DEFINE_CHAINED_MAP(copy_unsigned, release_unsigned, unsigned, ChainedMap)
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// identifiers shaped like the ones in generated code, interned as the lexer does
+static const char** make_keys(unsigned n, const char* prefix) {
+  const char** keys = malloc(sizeof(char*) * n);
+  for (unsigned i = 0; i < n; i++) {
+    char buf[32];
+    snprintf(buf, 32, "%s%u_%x", prefix, i, i * 2654435761u);
+    keys[i] = intern(buf);
+  }
+  return keys;
+}
+
+typedef struct {
+  double insert;
+  double hit;
+  double miss;
+  double scope;
+  unsigned found;  // the number of keys found in lookups of missing keys
+} Result;
+
+// same operations on both maps: the insertion, lookups, and per-scope copies done by `sema`
+#define BENCH(Name, n, rounds, keys, missing, r)                                                   \
+  do {                                                                                             \
+    double t0 = now();                                                                             \
+    Name* m   = NULL;                                                                              \
+    for (unsigned k = 0; k < rounds; k++) {                                                        \
+      m = new_##Name(64);                                                                          \
+      for (unsigned i = 0; i < n; i++) {                                                           \
+        insert_##Name(m, keys[i], i);                                                              \
+      }                                                                                            \
+      if (k + 1 != rounds) {                                                                       \
+        release_##Name(m);                                                                         \
+      }                                                                                            \
+    }                                                                                              \
+    double t1 = now();                                                                             \
+    for (unsigned k = 0; k < rounds; k++) {                                                        \
+      for (unsigned i = 0; i < n; i++) {                                                           \
+        unsigned v;                                                                                \
+        if (!lookup_##Name(m, keys[i], &v) || v != i) {                                            \
+          error("broken map");                                                                     \
+        }                                                                                          \
+      }                                                                                            \
+    }                                                                                              \
+    double t2 = now();                                                                             \
+    for (unsigned k = 0; k < rounds; k++) {                                                        \
+      for (unsigned i = 0; i < n; i++) {                                                           \
+        r.found += lookup_##Name(m, missing[i], NULL);                                             \
+      }                                                                                            \
+    }                                                                                              \
+    double t3 = now();                                                                             \
+    for (unsigned k = 0; k < 16; k++) {                                                            \
+      Name* copy = shallow_copy_##Name(m);                                                         \
+      insert_##Name(copy, keys[k % n], k);                                                         \
+      release_##Name(copy);                                                                        \
+    }                                                                                              \
+    double t4 = now();                                                                             \
+    r.insert = (t1 - t0) / rounds;                                                                 \
+    r.hit    = (t2 - t1) / rounds;                                                                 \
+    r.miss   = (t3 - t2) / rounds;                                                                 \
+    r.scope  = (t4 - t3) / 16;                                                                     \
+  } while (0)
+
+int main(int argc, char** argv) {
+  unsigned rounds = argc > 1 ? atoi(argv[1]) : 20;
+
+  unsigned sizes[] = {16, 256, 4096, 65536};
+
+  printf("%8s %-8s %12s %12s %12s %12s %8s\n", "keys", "map", "insert (us)", "hit (us)",
+         "miss (us)", "copy (us)", "aliased");
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    unsigned n       = sizes[s];
+    const char** keys    = make_keys(n, "v");
+    const char** missing = make_keys(n, "w");
+    unsigned r_count     = n > 4096 ? 1 : rounds;
+
+    Result open = {0}, chained = {0};
+    BENCH(OpenMap, n, r_count, keys, missing, open);
+    BENCH(ChainedMap, n, r_count, keys, missing, chained);
+
+    printf("%8u %-8s %12.1f %12.1f %12.1f %12.1f %8u\n", n, "open", open.insert * 1e6,
+           open.hit * 1e6, open.miss * 1e6, open.scope * 1e6, open.found);
+    printf("%8u %-8s %12.1f %12.1f %12.1f %12.1f %8u\n", n, "chained", chained.insert * 1e6,
+           chained.hit * 1e6, chained.miss * 1e6, chained.scope * 1e6, chained.found);
+  }
+  return 0;
+}
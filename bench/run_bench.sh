@@ -0,0 +1,126 @@
+#!/bin/bash
+# runtime of the code generated by ccc and gcc, on compute-heavy kernels
+#
+# usage: run_bench.sh CCC [KERNEL.c...]
+# kernels default to bench/kernels/*.c, and return a checksum as their exit status, which has to
+# agree among compilers (the first of gcc levels is taken as the reference)
+# the exit status is 1 if any kernel fails to build or returns a different checksum
+# CCC_LEVELS, GCC_LEVELS and RUNS override the -O levels compared and the number of runs; the best
+# run is reported
+
+set -u
+
+readonly BENCH_DIR="$(dirname "$BASH_SOURCE")"
+readonly CCC="$1"
+shift
+
+readonly CCC_LEVELS="${CCC_LEVELS:-1 3 fix}"
+readonly GCC_LEVELS="${GCC_LEVELS:-0 1}"
+readonly RUNS="${RUNS:-3}"
+
+if [ $# -eq 0 ]; then
+    set -- "$BENCH_DIR"/kernels/*.c
+fi
+
+readonly TMP_DIR="$(mktemp -d)"
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+failed=0
+
+if command -v perf > /dev/null && perf stat -e instructions true > /dev/null 2>&1; then
+    readonly HAS_PERF=1
+else
+    readonly HAS_PERF=0
+    echo "perf is not available; instruction counts are not measured"
+fi
+
+# build `$TMP_DIR/$name` from the kernel `$3` with `$1` (ccc or gcc) at -O`$2`
+function build() {
+    local compiler="$1"
+    local level="$2"
+    local source="$3"
+    local out="$TMP_DIR/$compiler-$level"
+
+    if [ "$compiler" = "ccc" ]; then
+        "$CCC" -O"$level" -o "$out.s" "$source" 2> /dev/null &&
+          gcc -c -o "$out.o" "$out.s" 2> /dev/null
+    else
+        gcc -O"$level" -w -c -o "$out.o" "$source" 2> /dev/null
+    fi &&
+      gcc -o "$out" "$out.o" 2> /dev/null
+}
+
+function now_ns() {
+    date +%s%N
+}
+
+# the size of the text section of the kernel alone, without the C runtime
+function text_size() {
+    size "$1" | awk 'NR == 2 { print $1 }'
+}
+
+function instructions() {
+    if [ "$HAS_PERF" = 0 ]; then
+        echo "-"
+        return
+    fi
+    perf stat -x, -e instructions -- "$1" 2>&1 > /dev/null | awk -F, '/instructions/ { print $1 }'
+}
+
+printf "%-12s %-10s %10s %8s %14s %9s  %s\n" \
+  "kernel" "compiler" "time(ms)" "/gcc-O1" "instructions" "text(B)" "result"
+
+for source in "$@"; do
+    kernel="$(basename "$source" .c)"
+    expected=""
+    reference_ms=""
+
+    for config in $(printf "gcc:%s " $GCC_LEVELS) $(printf "ccc:%s " $CCC_LEVELS); do
+        compiler="${config%%:*}"
+        level="${config#*:}"
+        exe="$TMP_DIR/$compiler-$level"
+        name="$compiler -O$level"
+
+        if ! build "$compiler" "$level" "$source"; then
+            printf "%-12s %-10s %10s %8s %14s %9s  %s\n" "$kernel" "$name" "-" "-" "-" "-" \
+              "build failed"
+            failed=1
+            continue
+        fi
+
+        best=""
+        for ((i = 0; i < RUNS; i++)); do
+            start="$(now_ns)"
+            "$exe"
+            actual="$?"
+            elapsed=$(( $(now_ns) - start ))
+            if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+                best="$elapsed"
+            fi
+        done
+        ms="$(awk -v ns="$best" 'BEGIN { printf "%.1f", ns / 1e6 }')"
+
+        if [ -z "$expected" ]; then
+            expected="$actual"
+        fi
+        if [ "$actual" = "$expected" ]; then
+            result="ok"
+        else
+            result="wrong result $actual (expected $expected)"
+            failed=1
+        fi
+
+        if [ "$name" = "gcc -O1" ]; then
+            reference_ms="$ms"
+        fi
+        ratio="-"
+        if [ -n "$reference_ms" ]; then
+            ratio="$(awk -v a="$ms" -v b="$reference_ms" 'BEGIN { printf "%.2fx", a / b }')"
+        fi
+
+        printf "%-12s %-10s %10s %8s %14s %9s  %s\n" "$kernel" "$name" "$ms" "$ratio" \
+          "$(instructions "$exe")" "$(text_size "$exe.o")" "$result"
+    done
+done
+
+exit "$failed"
@@ -0,0 +1,123 @@
+// peak memory of ccc with and without --stream, on programs of many small functions
+//
+// usage: stream_bench CCC [steps] [CCC_OPTION...]
+// the program is generated at `steps` sizes, doubling from 500 functions, and compiled with -O1
+// unless options are given
+// the exit status is 1 when --stream takes more memory than compiling the whole translation unit at
+// once
+
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "error.h"
+
+#define BASE_FUNCTIONS 500
+// differences of peak memory below this are noise
+#define MIN_FLAGGED_BYTES (1L << 20)
+
+static void gen_loop_functions(FILE* p, unsigned n) {
+  for (unsigned i = 0; i < n; i++) {
+    fprintf(p, "int f%u(int n) {\n  int s = 0;\n", i);
+    fprintf(p, "  for (int i = 0; i < n; i++) {\n    s = s + i * %u;\n  }\n  return s;\n}\n", i);
+  }
+  fputs("int main() { return f1(3); }\n", p);
+}
+
+typedef struct {
+  double wall_ms;
+  long max_rss;  // bytes
+} Run;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Run compile(const char* ccc, char** ccc_opts, const char* stream, const char* source) {
+  double t0 = now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    unsigned argc = 0;
+    while (ccc_opts[argc] != NULL) {
+      argc++;
+    }
+    char** args = calloc(argc + 6, sizeof(char*));
+    unsigned i  = 0;
+    args[i++]   = (char*)ccc;
+    memcpy(args + i, ccc_opts, sizeof(char*) * argc);
+    i += argc;
+    if (stream != NULL) {
+      args[i++] = (char*)stream;
+    }
+    args[i++] = "-o";
+    args[i++] = "/dev/null";
+    args[i++] = (char*)source;
+    execv(ccc, args);
+    _exit(127);
+  }
+
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  if (WIFSIGNALED(status)) {
+    error("%s killed by signal %d on %s", ccc, WTERMSIG(status), source);
+  }
+  if (WEXITSTATUS(status) != 0) {
+    error("%s failed on %s", ccc, source);
+  }
+
+  return (Run){.wall_ms = (now() - t0) * 1e3, .max_rss = usage.ru_maxrss * 1024L};
+}
+
+// the generated source, removed at exit as `error` exits on its own
+static char source[] = "/tmp/ccc-stream-bench-XXXXXX";
+
+static void remove_source() {
+  unlink(source);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    error("usage: stream_bench CCC [steps] [CCC_OPTION...]");
+  }
+  const char* ccc      = argv[1];
+  unsigned steps       = argc > 2 ? atoi(argv[2]) : 4;
+  char* default_opts[] = {"-O1", NULL};
+  char** ccc_opts      = argc > 3 ? argv + 3 : default_opts;
+
+  int fd = mkstemp(source);
+  if (fd < 0) {
+    error("could not create a temporary file");
+  }
+  close(fd);
+  atexit(remove_source);
+
+  printf("%10s %12s %12s %12s %12s\n", "functions", "whole(ms)", "whole(MiB)", "stream(ms)",
+         "stream(MiB)");
+  unsigned worse = 0;
+  for (unsigned k = 0; k < steps; k++) {
+    unsigned size = BASE_FUNCTIONS << k;
+    FILE* f       = fopen(source, "w");
+    gen_loop_functions(f, size);
+    fclose(f);
+
+    Run whole     = compile(ccc, ccc_opts, NULL, source);
+    Run stream    = compile(ccc, ccc_opts, "--stream", source);
+    bool is_worse = stream.max_rss > whole.max_rss + MIN_FLAGGED_BYTES;
+    printf("%10u %12.1f %12.1f %12.1f %12.1f%s\n", size, whole.wall_ms, whole.max_rss / 1048576.0,
+           stream.wall_ms, stream.max_rss / 1048576.0, is_worse ? " !" : "");
+    worse += is_worse;
+  }
+
+  return worse != 0;
+}
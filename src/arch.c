@@ -1,4 +1,5 @@
 #include "arch.h"
+#include "mem_stats.h"
 
 // clang-format off
 const char* regs8[]      = {"dil", "sil", "dl",  "cl",  "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b", "al",  "bl"};
@@ -23,6 +24,15 @@ unsigned nth_arg_id(unsigned n) {
   return n;
 }
 
+bool is_division(IRInst* inst) {
+  if (inst->kind != IR_BIN && inst->kind != IR_BIN_IMM) {
+    return false;
+  }
+  return inst->binary_op == ARITH_DIV || inst->binary_op == ARITH_REM;
+}
+
+DEFINE_TAGGED_ALLOCATOR(passes, MEM_PASSES)
+
 typedef struct {
   unsigned global_inst_count;
   unsigned inst_count;
@@ -31,7 +41,7 @@ typedef struct {
 } Env;
 
 static Env* init_Env(unsigned global_inst_count, Function* f) {
-  Env* env               = calloc(1, sizeof(Env));
+  Env* env               = alloc_passes(sizeof(Env));
   env->global_inst_count = global_inst_count;
   env->inst_count        = f->inst_count;
   env->reg_count         = f->reg_count;
@@ -44,7 +54,7 @@ static void finish_Env(Env* env, unsigned* inst_count, Function* f) {
   f->inst_count      = env->inst_count;
   f->reg_count       = env->reg_count;
   f->used_fixed_regs = env->used_fixed_regs;
-  free(env);
+  free_passes(env);
 }
 
 static Reg* new_fixed_reg(Env* env, unsigned id, DataSize size) {
@@ -90,6 +100,22 @@ static IRInst* new_zext(Env* env, Reg* rd, Reg* ra) {
   return inst;
 }
 
+// `idiv` takes no immediate, so a constant divisor is put in a register
+static void divisor_to_reg(Env* env, IRInstList* list, IRInstListIterator* it) {
+  IRInst* inst = data_IRInstListIterator(it);
+  if (inst->kind != IR_BIN_IMM) {
+    return;
+  }
+
+  Reg* rhs   = new_virtual_Reg(get_RegVec(inst->ras, 0)->size, env->reg_count++);
+  IRInst* i0 = new_imm(env, rhs, inst->imm);
+
+  inst->kind = IR_BIN;
+  push_RegVec(inst->ras, rhs);
+
+  insert_IRInstListIterator(list, it, i0);
+}
+
 static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
   if (is_nil_IRInstListIterator(it)) {
     return;
@@ -103,10 +129,15 @@ static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
       Reg* lhs = get_RegVec(inst->ras, 0);
       switch (inst->binary_op) {
         case BINOP_DIV: {
+          divisor_to_reg(env, list, it);
           Reg* rax   = rax_fixed_reg(env, lhs->size);
           IRInst* i1 = new_move(env, rax, lhs);
           IRInst* i3 = new_move(env, rd, rax);
+          release_Reg(rd);
+          release_Reg(lhs);
 
+          // the remainder is left in rdx, which the allocator keeps free around the division
+          set_BitSet(env->used_fixed_regs, rdx_reg_id, true);
           rax->sticky = true;
           inst->rd    = copy_Reg(rax);
           set_RegVec(inst->ras, 0, rax);
@@ -116,10 +147,13 @@ static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
           break;
         }
         case BINOP_REM: {
+          divisor_to_reg(env, list, it);
           Reg* rax   = rax_fixed_reg(env, lhs->size);
           Reg* rdx   = rdx_fixed_reg(env, rd->size);
           IRInst* i1 = new_move(env, rax, lhs);
           IRInst* i3 = new_move(env, rd, rdx);
+          release_Reg(rd);
+          release_Reg(lhs);
 
           rdx->sticky = true;
           rax->sticky = true;
@@ -139,6 +173,7 @@ static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
               Reg* rcx1 = rcx_fixed_reg(env, rhs->size);
               i1        = new_move(env, rcx1, rhs);
               release_Reg(rcx1);
+              release_Reg(rhs);
               break;
             }
             case IR_BIN_IMM: {
@@ -152,6 +187,7 @@ static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
           }
           Reg* rcx2  = rcx_fixed_reg(env, SIZE_BYTE);
           IRInst* i2 = new_move(env, rd, lhs);
+          release_Reg(lhs);
 
           rd->sticky   = true;
           rcx2->sticky = true;
@@ -179,6 +215,7 @@ static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
       Reg* rd    = inst->rd;
       Reg* opr   = get_RegVec(inst->ras, 0);
       IRInst* i1 = new_move(env, rd, opr);
+      release_Reg(opr);
 
       rd->sticky = true;
       set_RegVec(inst->ras, 0, copy_Reg(rd));
@@ -220,6 +257,7 @@ static void walk_insts(Env* env, IRInstList* list, IRInstListIterator* it) {
       }
       if (rd != NULL) {
         insert_IRInstListIterator(list, next_IRInstListIterator(it), new_move(env, rd, ret));
+        release_Reg(rd);
       }
       release_Reg(ret);
       break;
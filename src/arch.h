@@ -12,6 +12,10 @@ extern const unsigned rdx_reg_id;
 extern const unsigned rcx_reg_id;
 unsigned nth_arg_id(unsigned);
 
+// whether `inst` is lowered into `cqo` (or `cdq`) and `idiv`, which overwrite rax and rdx before
+// the divisor is read
+bool is_division(IRInst*);
+
 extern const char* regs8[];
 extern const char* regs16[];
 extern const char* regs32[];
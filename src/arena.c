@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+static const size_t chunk_size = 64 * 1024;
+static const size_t alignment  = alignof(max_align_t);
+
+typedef struct Chunk Chunk;
+
+struct Chunk {
+  Chunk* next;
+  size_t size;
+  size_t used;
+  alignas(max_align_t) char data[];
+};
+
+struct Arena {
+  const char* name;
+  MemTag tag;
+  Chunk* chunks;  // the current one first
+
+  void* last;  // the last allocation, which can be resized in place
+
+  unsigned long allocations;
+  size_t used;      // bytes handed out
+  size_t reserved;  // bytes of chunks, which is the peak as nothing is freed before the teardown
+};
+
+Arena* new_Arena(const char* name, MemTag tag) {
+  Arena* a = alloc_tagged(tag, sizeof(Arena));
+  a->name  = name;
+  a->tag   = tag;
+  return a;
+}
+
+static size_t align_up(size_t size) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// an empty allocation still takes a slot, so that it is never resized over the next one
+static size_t slot_size(size_t size) {
+  return size == 0 ? alignment : align_up(size);
+}
+
+static Chunk* new_chunk(Arena* a, size_t size) {
+  Chunk* c = alloc_tagged(a->tag, sizeof(Chunk) + size);
+  c->size  = size;
+  a->reserved += size;
+  return c;
+}
+
+void* alloc_Arena(Arena* a, size_t size) {
+  assert(a != NULL);
+
+  size = slot_size(size);
+  a->allocations++;
+  a->used += size;
+
+  Chunk* c = a->chunks;
+  if (c == NULL || c->size - c->used < size) {
+    if (size > chunk_size / 4) {
+      // large allocations get their own chunk, so that the current one is kept
+      Chunk* big = new_chunk(a, size);
+      big->used  = size;
+      if (c == NULL) {
+        a->chunks = big;
+      } else {
+        big->next = c->next;
+        c->next   = big;
+      }
+      a->last = NULL;
+      return big->data;
+    }
+
+    c         = new_chunk(a, chunk_size);
+    c->next   = a->chunks;
+    a->chunks = c;
+  }
+
+  void* p = c->data + c->used;
+  c->used += size;
+  a->last = p;
+  return p;
+}
+
+void* realloc_Arena(Arena* a, void* p, size_t old_size, size_t new_size) {
+  if (p == NULL) {
+    return alloc_Arena(a, new_size);
+  }
+
+  old_size           = slot_size(old_size);
+  size_t new_aligned = slot_size(new_size);
+
+  // grow or shrink the last allocation in place
+  Chunk* c = a->chunks;
+  if (p == a->last && c->used - old_size + new_aligned <= c->size) {
+    if (new_aligned < old_size) {
+      // the reclaimed tail is handed out again by `alloc_Arena`, which has to return zeros
+      memset((char*)p + new_aligned, 0, old_size - new_aligned);
+    }
+    c->used = c->used - old_size + new_aligned;
+    a->used = a->used - old_size + new_aligned;
+    return p;
+  }
+
+  if (new_size <= old_size) {
+    return p;
+  }
+
+  void* new = alloc_Arena(a, new_size);
+  memcpy(new, p, old_size);
+  return new;
+}
+
+void release_Arena(Arena* a) {
+  if (a == NULL) {
+    return;
+  }
+
+  Chunk* c = a->chunks;
+  while (c != NULL) {
+    Chunk* next = c->next;
+    free_tagged(a->tag, c);
+    c = next;
+  }
+  free_tagged(a->tag, a);
+}
+
+void print_Arena(FILE* p, const Arena* a) {
+  fprintf(p, "arena %-8s %10lu allocs %12zu bytes used %12zu bytes peak\n", a->name, a->allocations,
+          a->used, a->reserved);
+}
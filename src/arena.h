@@ -0,0 +1,30 @@
+#ifndef CCC_ARENA_H
+#define CCC_ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "mem_stats.h"
+
+// region allocator: memory is bump-allocated from large chunks and freed all at once
+typedef struct Arena Arena;
+
+// chunks are counted as `tag` (see mem_stats.h)
+Arena* new_Arena(const char* name, MemTag tag);
+void* alloc_Arena(Arena*, size_t size);  // zero-initialized
+void* realloc_Arena(Arena*, void*, size_t old_size, size_t new_size);
+void release_Arena(Arena*);
+
+// the number of allocations, the bytes handed out and the peak footprint
+void print_Arena(FILE*, const Arena*);
+
+// define the allocator `A` (see `DEFINE_*_WITH` in list.h, vector.h and map.h) backed by `arena`
+// individual frees are no-ops
+#define DEFINE_ARENA_ALLOCATOR(A, arena)                                                           \
+  static inline void* alloc_##A(size_t size) { return alloc_Arena(arena, size); }                  \
+  static inline void* realloc_##A(void* p, size_t old_size, size_t new_size) {                     \
+    return realloc_Arena(arena, p, old_size, new_size);                                            \
+  }                                                                                                \
+  static inline void free_##A(void* p) {}
+
+#endif
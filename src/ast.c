@@ -1,284 +1,68 @@
 #include "ast.h"
 #include "util.h"
 
-// release functions
+Arena* ast_arena;
 
-void release_expr(Expr* e);
+DEFINE_ARENA_ALLOCATOR(ast, ast_arena)
 
-static void release_Enumerator(Enumerator* e) {
-  if (e == NULL) {
-    return;
-  }
-
-  free(e->name);
-  release_expr(e->value);
-  free(e);
-}
-
-DEFINE_LIST(release_Enumerator, Enumerator*, EnumeratorList)
-
-static void release_EnumSpecifier(EnumSpecifier* es) {
-  if (es == NULL) {
-    return;
-  }
-
-  free(es->tag);
-  release_EnumeratorList(es->enums);
-  free(es);
-}
-
-static void release_DirectDeclarator(DirectDeclarator* d) {
-  if (d == NULL) {
-    return;
-  }
-
-  free(d->name);
-  release_DirectDeclarator(d->decl);
-  release_expr(d->length);
-  free(d);
-}
-
-static void release_Declarator(Declarator* d) {
-  if (d == NULL) {
-    return;
-  }
-
-  release_DirectDeclarator(d->direct);
-  free(d);
-}
-
-DEFINE_LIST(release_Declarator, Declarator*, DeclaratorList)
-
-static void release_StructSpecifier(StructSpecifier* s);
-
-static void release_DeclarationSpecifiers(DeclarationSpecifiers* spec) {
-  if (spec == NULL) {
-    return;
-  }
-
-  release_StructSpecifier(spec->struct_);
-  release_EnumSpecifier(spec->enum_);
-  free(spec);
-}
-
-static void release_StructDeclaration(StructDeclaration* sd) {
-  if (sd == NULL) {
-    return;
-  }
-
-  release_DeclarationSpecifiers(sd->spec);
-  release_DeclaratorList(sd->declarators);
-  free(sd);
-}
-
-DEFINE_LIST(release_StructDeclaration, StructDeclaration*, StructDeclarationList)
-
-static void release_StructSpecifier(StructSpecifier* s) {
-  if (s == NULL) {
-    return;
-  }
-
-  free(s->tag);
-  release_StructDeclarationList(s->declarations);
-  free(s);
-}
-
-static void release_Initializer(Initializer* init) {
-  if (init == NULL) {
-    return;
-  }
-
-  release_expr(init->expr);
-  release_InitializerList(init->list);
-  free(init);
-}
-
-DEFINE_LIST(release_Initializer, Initializer*, InitializerList)
-
-static void release_InitDeclarator(InitDeclarator* d) {
-  if (d == NULL) {
-    return;
-  }
-
-  release_Declarator(d->declarator);
-  release_Initializer(d->initializer);
-  release_Type(d->type);
-  free(d);
-}
-
-DEFINE_LIST(release_InitDeclarator, InitDeclarator*, InitDeclaratorList)
+DEFINE_LIST_WITH(ast, release_dummy, Enumerator*, EnumeratorList)
+DEFINE_LIST_WITH(ast, release_dummy, Declarator*, DeclaratorList)
+DEFINE_LIST_WITH(ast, release_dummy, StructDeclaration*, StructDeclarationList)
+DEFINE_LIST_WITH(ast, release_dummy, Initializer*, InitializerList)
+DEFINE_LIST_WITH(ast, release_dummy, InitDeclarator*, InitDeclaratorList)
+DEFINE_VECTOR_WITH(ast, release_dummy, Expr*, ExprVec)
+DEFINE_VECTOR_WITH(ast, release_dummy, Statement*, StmtVec)
+DEFINE_LIST_WITH(ast, release_dummy, BlockItem*, BlockItemList)
+DEFINE_LIST_WITH(ast, release_dummy, ParameterDecl*, ParamList)
+DEFINE_LIST_WITH(ast, release_dummy, ExternalDecl*, TranslationUnit)
 
-static void release_declaration(Declaration* d) {
-  if (d == NULL) {
-    return;
-  }
-
-  release_DeclarationSpecifiers(d->spec);
-  release_InitDeclaratorList(d->declarators);
-  free(d);
-}
-
-static void release_TypeName(TypeName* t) {
-  if (t == NULL) {
-    return;
-  }
-
-  release_DeclarationSpecifiers(t->spec);
-  release_Declarator(t->declarator);
-  release_Type(t->type);
-  free(t);
-}
-
-void release_expr(Expr* e) {
-  if (e == NULL) {
-    return;
-  }
-
-  release_expr(e->lhs);
-  release_expr(e->rhs);
-  release_expr(e->expr);
-  free(e->var);
-  free(e->string);
-  release_ExprVec(e->args);
-  release_TypeName(e->cast_to);
-  release_Type(e->cast_type);
-  release_Type(e->type);
-  release_expr(e->cond);
-  release_expr(e->then_);
-  release_expr(e->else_);
-  release_TypeName(e->sizeof_);
-
-  free(e);
-}
-
-DEFINE_VECTOR(release_expr, Expr*, ExprVec)
-
-static void release_statement(Statement* stmt) {
-  if (stmt == NULL) {
-    return;
-  }
-
-  release_expr(stmt->expr);
-  release_statement(stmt->body);
-  release_statement(stmt->then_);
-  release_statement(stmt->else_);
-  release_expr(stmt->init);
-  release_expr(stmt->before);
-  release_expr(stmt->after);
-  free(stmt->label_name);
-  release_BlockItemList(stmt->items);
-  // TODO: shallow release
-  /* release_StmtVec(stmt->cases); */
-  /* release_statement(stmt->default_); */
-  free(stmt);
-}
-
-DEFINE_VECTOR(release_statement, Statement*, StmtVec)
-
-static void release_BlockItem(BlockItem* item) {
-  if (item == NULL) {
-    return;
-  }
-
-  release_statement(item->stmt);
-  release_declaration(item->decl);
-  free(item);
+static void release_unsigned(unsigned i) {}
+static unsigned copy_unsigned(unsigned i) {
+  return i;
 }
+DEFINE_MAP_WITH(ast, copy_unsigned, release_unsigned, unsigned, UIMap)
 
-DEFINE_LIST(release_BlockItem, BlockItem*, BlockItemList)
-
-Enumerator* new_Enumerator(char* name, Expr* value) {
-  Enumerator* e = calloc(1, sizeof(Enumerator));
+Enumerator* new_Enumerator(const char* name, Expr* value) {
+  Enumerator* e = alloc_ast(sizeof(Enumerator));
   e->name       = name;
   e->value      = value;
   return e;
 }
 
-EnumSpecifier* new_EnumSpecifier(EnumSpecKind kind, char* tag) {
-  EnumSpecifier* s = calloc(1, sizeof(EnumSpecifier));
+EnumSpecifier* new_EnumSpecifier(EnumSpecKind kind, const char* tag) {
+  EnumSpecifier* s = alloc_ast(sizeof(EnumSpecifier));
   s->kind          = kind;
   s->tag           = tag;
   return s;
 }
 
 DeclarationSpecifiers* new_DeclarationSpecifiers(DeclarationSpecKind kind) {
-  DeclarationSpecifiers* spec = calloc(1, sizeof(DeclarationSpecifiers));
+  DeclarationSpecifiers* spec = alloc_ast(sizeof(DeclarationSpecifiers));
   spec->kind                  = kind;
   return spec;
 }
 
 StructDeclaration* new_StructDeclaration(DeclarationSpecifiers* spec, DeclaratorList* declarators) {
-  StructDeclaration* d = calloc(1, sizeof(StructDeclaration));
+  StructDeclaration* d = alloc_ast(sizeof(StructDeclaration));
   d->spec              = spec;
   d->declarators       = declarators;
   return d;
 }
 
-StructSpecifier* new_StructSpecifier(StructSpecKind kind, char* tag) {
-  StructSpecifier* s = calloc(1, sizeof(StructSpecifier));
+StructSpecifier* new_StructSpecifier(StructSpecKind kind, const char* tag) {
+  StructSpecifier* s = alloc_ast(sizeof(StructSpecifier));
   s->kind            = kind;
   s->tag             = tag;
   return s;
 }
 
 ParameterDecl* new_ParameterDecl(DeclarationSpecifiers* spec, Declarator* decl) {
-  ParameterDecl* d = calloc(1, sizeof(ParameterDecl));
+  ParameterDecl* d = alloc_ast(sizeof(ParameterDecl));
   d->spec          = spec;
   d->decl          = decl;
   return d;
 }
 
-static void release_ParameterDecl(ParameterDecl* d) {
-  if (d == NULL) {
-    return;
-  }
-
-  release_DeclarationSpecifiers(d->spec);
-  release_Declarator(d->decl);
-  free(d);
-}
-
-DEFINE_LIST(release_ParameterDecl, ParameterDecl*, ParamList)
-static void release_unsigned(unsigned i) {}
-static unsigned copy_unsigned(unsigned i) {
-  return i;
-}
-DEFINE_MAP(copy_unsigned, release_unsigned, unsigned, UIMap)
-
-static void release_FunctionDef(FunctionDef* def) {
-  if (def == NULL) {
-    return;
-  }
-  release_DeclarationSpecifiers(def->spec);
-  release_Declarator(def->decl);
-  release_ParamList(def->params);
-  release_BlockItemList(def->items);
-  release_Type(def->type);
-  release_UIMap(def->named_labels);
-  free(def);
-}
-static void release_FunctionDecl(FunctionDecl* decl) {
-  if (decl == NULL) {
-    return;
-  }
-  release_DeclarationSpecifiers(decl->spec);
-  release_Declarator(decl->decl);
-  release_ParamList(decl->params);
-  release_Type(decl->type);
-  free(decl);
-}
-static void release_ExternalDecl(ExternalDecl* edecl) {
-  release_FunctionDef(edecl->func);
-  release_FunctionDecl(edecl->func_decl);
-  free(edecl);
-}
-
-DEFINE_LIST(release_ExternalDecl, ExternalDecl*, TranslationUnit)
-
-void release_AST(AST* t) {
-  release_TranslationUnit(t);
-}
-
 // printer functions
 static void print_expr(FILE* p, Expr* expr);
 
@@ -753,7 +537,7 @@ void print_AST(FILE* p, AST* ast) {
 
 // constructors
 Expr* new_node(ExprKind kind, Expr* lhs, Expr* rhs) {
-  Expr* node = calloc(1, sizeof(Expr));
+  Expr* node = alloc_ast(sizeof(Expr));
   node->kind = kind;
   node->lhs  = lhs;
   node->rhs  = rhs;
@@ -768,14 +552,14 @@ Expr* new_node_num(int num) {
 
 Expr* new_node_string(const char* s, size_t len) {
   Expr* node    = new_node(ND_STRING, NULL, NULL);
-  node->string  = strdup(s);
+  node->string  = s;
   node->str_len = len;
   return node;
 }
 
 Expr* new_node_var(const char* ident) {
   Expr* node = new_node(ND_VAR, NULL, NULL);
-  node->var  = strdup(ident);
+  node->var  = ident;
   return node;
 }
 
@@ -854,7 +638,7 @@ Expr* new_node_sizeof_expr(Expr* e) {
 Expr* new_node_member(Expr* e, const char* s) {
   Expr* node   = new_node(ND_MEMBER, NULL, NULL);
   node->expr   = e;
-  node->member = strdup(s);
+  node->member = s;
   return node;
 }
 
@@ -884,15 +668,6 @@ Expr* copy_node(Expr* e) {
   if (e->else_ != NULL) {
     node->else_ = copy_node(e->else_);
   }
-  if (e->var != NULL) {
-    node->var = strdup(e->var);
-  }
-  if (e->string != NULL) {
-    node->string = strdup(e->string);
-  }
-  if (e->member != NULL) {
-    node->member = strdup(e->member);
-  }
   if (e->type != NULL) {
     node->type = copy_Type(e->type);
   }
@@ -906,13 +681,13 @@ Expr* copy_node(Expr* e) {
 }
 
 DirectDeclarator* new_DirectDeclarator(DirectDeclKind kind) {
-  DirectDeclarator* d = calloc(1, sizeof(DirectDeclarator));
+  DirectDeclarator* d = alloc_ast(sizeof(DirectDeclarator));
   d->kind             = kind;
   return d;
 }
 
 Declarator* new_Declarator(DirectDeclarator* direct, unsigned num_ptrs) {
-  Declarator* d = calloc(1, sizeof(Declarator));
+  Declarator* d = alloc_ast(sizeof(Declarator));
   d->direct     = direct;
   d->num_ptrs   = num_ptrs;
   return d;
@@ -927,13 +702,13 @@ bool is_abstract_declarator(Declarator* d) {
 }
 
 Initializer* new_Initializer(InitializerKind kind) {
-  Initializer* init = calloc(1, sizeof(Initializer));
+  Initializer* init = alloc_ast(sizeof(Initializer));
   init->kind        = kind;
   return init;
 }
 
 InitDeclarator* new_InitDeclarator(Declarator* d, Initializer* init) {
-  InitDeclarator* decl = calloc(1, sizeof(InitDeclarator));
+  InitDeclarator* decl = alloc_ast(sizeof(InitDeclarator));
   decl->declarator     = d;
   decl->initializer    = init;
   return decl;
@@ -941,7 +716,7 @@ InitDeclarator* new_InitDeclarator(Declarator* d, Initializer* init) {
 
 Declaration* new_declaration(DeclarationSpecifiers* spec, InitDeclaratorList* s) {
   // TODO: check that all declarator in `s` is not an abstract declarator
-  Declaration* d = calloc(1, sizeof(Declaration));
+  Declaration* d = alloc_ast(sizeof(Declaration));
   d->spec        = spec;
   d->declarators = s;
   return d;
@@ -949,21 +724,21 @@ Declaration* new_declaration(DeclarationSpecifiers* spec, InitDeclaratorList* s)
 
 TypeName* new_TypeName(DeclarationSpecifiers* spec, Declarator* s) {
   assert(is_abstract_declarator(s));
-  TypeName* d   = calloc(1, sizeof(TypeName));
+  TypeName* d   = alloc_ast(sizeof(TypeName));
   d->spec       = spec;
   d->declarator = s;
   return d;
 }
 
 Statement* new_statement(StmtKind kind, Expr* expr) {
-  Statement* s = calloc(1, sizeof(Statement));
+  Statement* s = alloc_ast(sizeof(Statement));
   s->kind      = kind;
   s->expr      = expr;
   return s;
 }
 
 BlockItem* new_block_item(BlockItemKind kind, Statement* stmt, Declaration* decl) {
-  BlockItem* item = calloc(1, sizeof(BlockItem));
+  BlockItem* item = alloc_ast(sizeof(BlockItem));
   item->kind      = kind;
   item->stmt      = stmt;
   item->decl      = decl;
@@ -971,15 +746,15 @@ BlockItem* new_block_item(BlockItemKind kind, Statement* stmt, Declaration* decl
 }
 
 FunctionDef* new_function_def() {
-  return calloc(1, sizeof(FunctionDef));
+  return alloc_ast(sizeof(FunctionDef));
 }
 
 FunctionDecl* new_function_decl() {
-  return calloc(1, sizeof(FunctionDecl));
+  return alloc_ast(sizeof(FunctionDecl));
 }
 
 ExternalDecl* new_external_decl(ExtDeclKind kind) {
-  ExternalDecl* edecl = calloc(1, sizeof(ExternalDecl));
+  ExternalDecl* edecl = alloc_ast(sizeof(ExternalDecl));
   edecl->kind         = kind;
   return edecl;
 }
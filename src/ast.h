@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 
+#include "arena.h"
 #include "list.h"
 #include "map.h"
 #include "ops.h"
@@ -12,11 +13,11 @@
 typedef struct Expr Expr;
 
 typedef struct {
-  char* name;
-  Expr* value;  // nullable
+  const char* name;  // interned
+  Expr* value;       // nullable
 } Enumerator;
 
-Enumerator* new_Enumerator(char* name, Expr* value);
+Enumerator* new_Enumerator(const char* name, Expr* value);
 
 DECLARE_LIST(Enumerator*, EnumeratorList)
 
@@ -28,11 +29,11 @@ typedef enum {
 typedef struct {
   EnumSpecKind kind;
 
-  char* tag;              // owned, nullable in SS_DECL
+  const char* tag;        // interned, nullable in SS_DECL
   EnumeratorList* enums;  // for ES_DECL, owned
 } EnumSpecifier;
 
-EnumSpecifier* new_EnumSpecifier(EnumSpecKind, char* tag);
+EnumSpecifier* new_EnumSpecifier(EnumSpecKind, const char* tag);
 
 typedef struct DeclarationSpecifiers DeclarationSpecifiers;
 typedef struct Declarator Declarator;
@@ -56,11 +57,11 @@ typedef enum {
 typedef struct {
   StructSpecKind kind;
 
-  char* tag;                            // owned, nullable in SS_DECL
+  const char* tag;                      // interned, nullable in SS_DECL
   StructDeclarationList* declarations;  // for SS_DECL, owned
 } StructSpecifier;
 
-StructSpecifier* new_StructSpecifier(StructSpecKind, char*);
+StructSpecifier* new_StructSpecifier(StructSpecKind, const char*);
 
 // use bit flags to express the combination of names
 // this idea is from `cdecl.c` by Rui Ueyama
@@ -91,7 +92,7 @@ struct DeclarationSpecifiers {
   EnumSpecifier* enum_;      // for DS_ENUM, owned
 
   bool is_typedef;
-  char* typedef_name;
+  const char* typedef_name;  // interned
   bool is_extern;
   bool is_static;
   bool is_const;
@@ -109,9 +110,9 @@ typedef struct DirectDeclarator DirectDeclarator;
 
 struct DirectDeclarator {
   DirectDeclKind kind;
-  char* name_ref;  // not owned, NULL if this is abstract declarator
+  const char* name_ref;  // interned, NULL if this is abstract declarator
 
-  char* name;  // for DE_DIRECT, owned
+  const char* name;  // for DE_DIRECT, interned
 
   DirectDeclarator* decl;  // for DE_ARRAY, owned
   Expr* length;            // for DE_ARRAY, owned, NULL if omitted
@@ -211,14 +212,14 @@ struct Expr {
 
   TypeName* sizeof_;  // for ND_SIZEOF_TYPE, owned
 
-  BinaryOp binop;  // for ND_BINOP, ND_COMPOUND_ASSIGN
-  UnaryOp unaop;   // for ND_UNAOP
-  char* var;       // for ND_VAR, owned
-  int num;         // for ND_NUM
-  char* string;    // for ND_STRING, owned
-  size_t str_len;  // for ND_STRING
-  ExprVec* args;   // for ND_CALL, owned
-  char* member;    // for ND_MEMBER, owned
+  BinaryOp binop;      // for ND_BINOP, ND_COMPOUND_ASSIGN
+  UnaryOp unaop;       // for ND_UNAOP
+  const char* var;     // for ND_VAR, interned
+  int num;             // for ND_NUM
+  const char* string;  // for ND_STRING, interned
+  size_t str_len;      // for ND_STRING
+  ExprVec* args;       // for ND_CALL, owned
+  const char* member;  // for ND_MEMBER, interned
 
   Expr* cond;   // for ND_COND, owned
   Expr* then_;  // for ND_COND, owned
@@ -248,7 +249,6 @@ Expr* new_node_sizeof_expr(Expr*);
 Expr* new_node_member(Expr*, const char*);
 Expr* copy_node(Expr*);
 Expr* shallow_copy_node(Expr*);
-void release_expr(Expr*);
 
 typedef struct Statement Statement;
 
@@ -304,8 +304,8 @@ struct Statement {
 
   BlockItemList* items;  // for ST_COMPOUND
 
-  // for ST_LABEL and ST_GOTO, owned
-  char* label_name;
+  // for ST_LABEL and ST_GOTO, interned
+  const char* label_name;
 
   // will filled in `sema`
   unsigned label_id;    // for ST_LABEL, ST_CASE, ST_DEFAULT
@@ -377,8 +377,10 @@ DECLARE_LIST(ExternalDecl*, TranslationUnit)
 
 typedef TranslationUnit AST;
 
-void print_AST(FILE*, AST*);
+// every node and container of the AST is allocated in `ast_arena`, which is set up by the caller
+// of `parse` and torn down at once after the IR is generated
+extern Arena* ast_arena;
 
-void release_AST(AST*);
+void print_AST(FILE*, AST*);
 
 #endif
@@ -0,0 +1,176 @@
+#include <stdlib.h>
+
+#include "arch.h"
+#include "backend.h"
+#include "mem_stats.h"
+#include "parallel.h"
+#include "reg_alloc.h"
+
+typedef struct {
+  unsigned size;   // the number of instructions
+  unsigned index;  // of the function in the translation unit
+  IR* ir;
+} FunctionTask;
+
+typedef struct {
+  FunctionTask* tasks;  // largest function first
+  const BackendOptions* opts;
+} BackendJob;
+
+static TraceEvent pass_event(const char* name, Function* f, int iteration, Measure m) {
+  unsigned insts = 0;
+  for (IRInstListIterator* it = front_IRInstList(f->instructions); !is_nil_IRInstListIterator(it);
+       it                     = next_IRInstListIterator(it)) {
+    insts++;
+  }
+  unsigned blocks = 0;
+  for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
+       it                 = next_BBListIterator(it)) {
+    blocks++;
+  }
+
+  TraceEvent e = {
+      .name         = name,
+      .category     = "pass",
+      .start        = m.start,
+      .duration     = m.wall,
+      .function     = f->name,
+      .iteration    = iteration,
+      .num_counters = 3,
+      .counters     = {{"instructions", insts}, {"blocks", blocks}, {"registers", f->reg_count}},
+  };
+  return e;
+}
+
+// where the passes of a function are run, for `observe_pass`
+typedef struct {
+  const BackendJob* job;
+  const FunctionTask* task;
+  int iteration;
+} PassContext;
+
+static void observe_pass(void* data, const char* name, Measure m) {
+  PassContext* ctx           = data;
+  const BackendOptions* opts = ctx->job->opts;
+  Function* f                = head_FunctionList(ctx->task->ir->functions);
+  if (opts->report != NULL) {
+    add_pass_TimeReport(opts->report, name, f->name, ctx->task->index, ctx->iteration, m);
+  }
+  if (opts->trace != NULL) {
+    add_Trace(opts->trace, pass_event(name, f, ctx->iteration, m));
+  }
+}
+
+static bool allocate_registers(IR* ir) {
+  reg_alloc(RA_LINEAR, num_regs, ir);
+  return true;
+}
+
+static bool color_registers(IR* ir) {
+  reg_alloc(RA_COLOR, num_regs, ir);
+  return true;
+}
+
+static const Pass reg_allocator = {"reg_alloc", allocate_registers, ANALYSIS_LIVE, 0};
+static const Pass reg_colorer   = {"reg_color", color_registers, ANALYSIS_LIVE, 0};
+
+// a span enclosing passes of a function, measured by `t`
+static void end_function_span(const BackendJob* job,
+                              const FunctionTask* task,
+                              const char* name,
+                              int iteration,
+                              Timer* t) {
+  if (job->opts->trace == NULL) {
+    return;
+  }
+  Measure m    = stop_Timer(t);
+  TraceEvent e = {
+      .name      = name,
+      .category  = "function",
+      .start     = m.start,
+      .duration  = m.wall,
+      .function  = head_FunctionList(task->ir->functions)->name,
+      .iteration = iteration,
+  };
+  add_Trace(job->opts->trace, e);
+}
+
+// the mid-end and register allocation of a single function
+static void compile_function(unsigned idx, void* data) {
+  BackendJob* job            = data;
+  const BackendOptions* opts = job->opts;
+  FunctionTask* task         = &job->tasks[idx];
+  Timer whole                = start_Timer(true);
+
+  PassContext ctx = {.job = job, .task = task};
+  bool observed   = opts->report != NULL || opts->trace != NULL;
+  PassManager* pm = new_PassManager(task->ir, opts->pipeline, observed ? observe_pass : NULL, &ctx);
+
+  for (unsigned i = 0; i < opts->iterations; i++) {
+    Timer t       = start_Timer(true);
+    ctx.iteration = i;
+    bool dirty    = run_pipeline(pm);
+    end_function_span(job, task, "iteration", i, &t);
+
+    if (!dirty) {
+      // every pass would be skipped in the next iteration
+      break;
+    }
+  }
+
+  if (opts->allocate) {
+    ctx.iteration = -1;
+    run_pass(pm, opts->regalloc == RA_COLOR ? &reg_colorer : &reg_allocator);
+  }
+  release_PassManager(pm);
+  end_function_span(job, task, head_FunctionList(task->ir->functions)->name, -1, &whole);
+}
+
+static int compare_task_size(const void* a, const void* b) {
+  unsigned sa = ((const FunctionTask*)a)->size;
+  unsigned sb = ((const FunctionTask*)b)->size;
+  return (sa < sb) - (sa > sb);
+}
+
+void compile_functions(IR* ir, const BackendOptions* opts) {
+  unsigned count = length_FunctionList(ir->functions);
+  IR** parts     = calloc(count, sizeof(IR*));
+  BackendJob job = {.tasks = calloc(count, sizeof(FunctionTask)), .opts = opts};
+
+  unsigned i = 0;
+  for (FunctionList* l = ir->functions; !is_nil_FunctionList(l); l = tail_FunctionList(l), i++) {
+    Function* f  = head_FunctionList(l);
+    parts[i]     = function_IR_part(ir, f);
+    job.tasks[i] = (FunctionTask){.size = f->inst_count, .index = i, .ir = parts[i]};
+  }
+  // start from large functions so that no long one is left to run alone at the end
+  qsort(job.tasks, count, sizeof(FunctionTask), compare_task_size);
+
+  parallel_for(opts->jobs, count, compile_function, &job);
+
+  join_IR_parts(ir, parts);
+  free(parts);
+  free(job.tasks);
+}
+
+void end_phase(TimeReport* report, Trace* trace, const char* name, Timer* t) {
+  end_mem_phase(name);
+  if (report == NULL && trace == NULL) {
+    return;
+  }
+
+  Measure m = stop_Timer(t);
+  if (report != NULL) {
+    add_phase_TimeReport(report, name, m);
+  }
+  if (trace != NULL) {
+    TraceEvent e = {
+        .name      = name,
+        .category  = "phase",
+        .start     = m.start,
+        .duration  = m.wall,
+        .iteration = -1,
+    };
+    add_Trace(trace, e);
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef CCC_BACKEND_H
+#define CCC_BACKEND_H
+
+#include <stdbool.h>
+
+#include "ir.h"
+#include "pass_manager.h"
+#include "reg_alloc.h"
+#include "time_report.h"
+#include "trace.h"
+
+typedef struct {
+  unsigned iterations;  // of the optimization pipeline, at most
+  const Pipeline* pipeline;
+  bool allocate;        // run the register allocation after the pipeline
+  RegAllocKind regalloc;
+  unsigned jobs;
+  TimeReport* report;   // nullable
+  Trace* trace;         // nullable
+} BackendOptions;
+
+// optimize and allocate registers of each function in `ir`
+// functions are compiled independently on `jobs` threads; the result does not depend on `jobs`
+void compile_functions(IR* ir, const BackendOptions*);
+
+// record a phase of the whole translation unit measured by `t`, if `report` or `trace` is given
+// the phase is also closed in the memory report (see mem_stats.h)
+void end_phase(TimeReport* report, Trace* trace, const char* name, Timer* t);
+
+#endif
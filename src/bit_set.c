@@ -1,105 +1,552 @@
 #include "bit_set.h"
 #include "error.h"
-#include "vector.h"
+#include "mem_stats.h"
 
+#include <assert.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
-DECLARE_VECTOR(uint64_t, U64Vec)
-static void release_u64(uint64_t l) {}
-DEFINE_VECTOR(release_u64, uint64_t, U64Vec)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CCC_BIT_SET_X86
+#include <immintrin.h>
+#endif
 
+// a set is either dense (`data` holds all words) or sparse (`data` holds only non-zero words, and
+// `index` holds their word indices in ascending order)
 struct BitSet {
-  U64Vec* data;
+  BitSetRepr repr;  // current representation, BS_DENSE or BS_SPARSE
+  bool is_fixed;    // true if `repr` is never switched automatically
   unsigned length;
+
+  uint64_t* data;
+  unsigned* index;    // NULL if dense
+  unsigned size;      // the number of words in `data`
+  unsigned capacity;  // allocated words in `data` (and `index`)
 };
 
 const size_t block_size = sizeof(uint64_t) * 8;
 
-static BitSet* init_BitSet() {
-  return calloc(1, sizeof(BitSet));
+// sets at least this long start sparse (see `make bench-bitset` for the crossover)
+static const unsigned sparse_min_length = 8192;
+
+// a sparse set is made dense when more than 1/`sparse_max_ratio` of its words are non-zero
+static const unsigned sparse_max_ratio = 8;
+
+static unsigned words_of(unsigned length) {
+  return (length + block_size - 1) / block_size;
 }
 
-BitSet* new_BitSet(unsigned length) {
-  BitSet* s     = init_BitSet();
-  unsigned size = (length + block_size - 1) / block_size;
-  s->data       = new_U64Vec(size);
-  resize_U64Vec(s->data, size);
+static BitSet* init_BitSet(BitSetRepr repr, unsigned length) {
+  BitSet* s   = alloc_tagged(MEM_BITSETS, sizeof(BitSet));
+  s->is_fixed = repr != BS_AUTO;
+  if (repr == BS_AUTO) {
+    repr = length >= sparse_min_length ? BS_SPARSE : BS_DENSE;
+  }
+  s->repr   = repr;
   s->length = length;
   return s;
 }
 
-BitSet* zero_BitSet(unsigned length) {
-  BitSet* s = new_BitSet(length);
-  clear_BitSet(s);
+BitSet* zero_BitSet_with(BitSetRepr repr, unsigned length) {
+  BitSet* s = init_BitSet(repr, length);
+  if (s->repr == BS_DENSE) {
+    s->size     = words_of(length);
+    s->capacity = s->size;
+    s->data     = alloc_tagged(MEM_BITSETS, sizeof(uint64_t) * s->size);
+  }
+  return s;
+}
+
+BitSet* new_BitSet(unsigned length) {
+  BitSet* s = init_BitSet(BS_AUTO, length);
+  if (s->repr == BS_DENSE) {
+    s->size     = words_of(length);
+    s->capacity = s->size;
+    s->data     = realloc_tagged(MEM_BITSETS, NULL, sizeof(uint64_t) * s->size);
+  }
   return s;
 }
 
+BitSet* zero_BitSet(unsigned length) {
+  return zero_BitSet_with(BS_AUTO, length);
+}
+
 unsigned length_BitSet(const BitSet* s) {
   return s->length;
 }
 
-void or_BitSet(BitSet* s1, const BitSet* s2) {
-  assert(s1->length == s2->length);
-  for (unsigned i = 0; i < length_U64Vec(s1->data); i++) {
-    uint64_t d1 = get_U64Vec(s1->data, i);
-    uint64_t d2 = get_U64Vec(s2->data, i);
-    set_U64Vec(s1->data, i, d1 | d2);
+BitSetRepr repr_BitSet(const BitSet* s) {
+  return s->repr;
+}
+
+static void make_dense(BitSet* s) {
+  assert(s->repr == BS_SPARSE);
+
+  unsigned size  = words_of(s->length);
+  uint64_t* data = alloc_tagged(MEM_BITSETS, sizeof(uint64_t) * size);
+  for (unsigned i = 0; i < s->size; i++) {
+    data[s->index[i]] = s->data[i];
   }
+
+  free_tagged(MEM_BITSETS, s->data);
+  free_tagged(MEM_BITSETS, s->index);
+  s->repr     = BS_DENSE;
+  s->data     = data;
+  s->index    = NULL;
+  s->size     = size;
+  s->capacity = size;
 }
 
-void and_BitSet(BitSet* s1, const BitSet* s2) {
+static void adjust_repr(BitSet* s) {
+  if (s->is_fixed || s->repr == BS_DENSE) {
+    return;
+  }
+
+  if (s->size * sparse_max_ratio > words_of(s->length)) {
+    make_dense(s);
+  }
+}
+
+static void reserve_sparse(BitSet* s, unsigned capacity) {
+  if (s->capacity >= capacity) {
+    return;
+  }
+
+  unsigned c = s->capacity == 0 ? 4 : s->capacity;
+  while (c < capacity) {
+    c *= 2;
+  }
+  s->data     = realloc_tagged(MEM_BITSETS, s->data, sizeof(uint64_t) * c);
+  s->index    = realloc_tagged(MEM_BITSETS, s->index, sizeof(unsigned) * c);
+  s->capacity = c;
+}
+
+// position of the first entry whose word index is not less than `idx`
+static unsigned lower_bound(const BitSet* s, unsigned idx) {
+  unsigned lo = 0, hi = s->size;
+  while (lo < hi) {
+    unsigned mid = lo + (hi - lo) / 2;
+    if (s->index[mid] < idx) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// the word at `idx` regardless of the representation
+static uint64_t word_at(const BitSet* s, unsigned idx) {
+  if (s->repr == BS_DENSE) {
+    return s->data[idx];
+  }
+
+  unsigned pos = lower_bound(s, idx);
+  return pos < s->size && s->index[pos] == idx ? s->data[pos] : 0;
+}
+
+// iterates non-zero words of a set in ascending order regardless of the representation
+typedef struct {
+  const BitSet* s;
+  unsigned pos;
+
+  bool valid;
+  unsigned idx;
+  uint64_t word;
+} WordCursor;
+
+static void advance_cursor(WordCursor* c) {
+  const BitSet* s = c->s;
+  if (s->repr == BS_SPARSE) {
+    c->valid = c->pos < s->size;
+    if (c->valid) {
+      c->idx  = s->index[c->pos];
+      c->word = s->data[c->pos];
+      c->pos++;
+    }
+    return;
+  }
+
+  while (c->pos < s->size && s->data[c->pos] == 0) {
+    c->pos++;
+  }
+  c->valid = c->pos < s->size;
+  if (c->valid) {
+    c->idx  = c->pos;
+    c->word = s->data[c->pos];
+    c->pos++;
+  }
+}
+
+static WordCursor init_cursor(const BitSet* s) {
+  WordCursor c = {.s = s};
+  advance_cursor(&c);
+  return c;
+}
+
+typedef enum {
+  WORD_OR,
+  WORD_AND,
+  WORD_DIFF,
+} WordOp;
+
+static uint64_t apply_op(WordOp op, uint64_t a, uint64_t b) {
+  switch (op) {
+    case WORD_OR:
+      return a | b;
+    case WORD_AND:
+      return a & b;
+    case WORD_DIFF:
+      return a & ~b;
+    default:
+      CCC_UNREACHABLE;
+  }
+}
+
+// s1 = s1 `op` s2, where s1 is sparse
+static void merge_sparse(BitSet* s1, const BitSet* s2, WordOp op) {
+  assert(s1->repr == BS_SPARSE);
+
+  BitSet result = {.repr = BS_SPARSE};
+  reserve_sparse(&result, s1->size);
+
+  WordCursor c1 = init_cursor(s1);
+  WordCursor c2 = init_cursor(s2);
+  while (c1.valid || c2.valid) {
+    unsigned idx;
+    uint64_t w1 = 0, w2 = 0;
+    if (c1.valid && (!c2.valid || c1.idx <= c2.idx)) {
+      idx = c1.idx;
+      w1  = c1.word;
+    } else {
+      idx = c2.idx;
+    }
+    if (c2.valid && c2.idx == idx) {
+      w2 = c2.word;
+      advance_cursor(&c2);
+    }
+    if (c1.valid && c1.idx == idx) {
+      advance_cursor(&c1);
+    } else if (op != WORD_OR) {
+      // nothing is left to keep when the word is missing from s1
+      continue;
+    }
+
+    uint64_t w = apply_op(op, w1, w2);
+    if (w == 0) {
+      continue;
+    }
+    reserve_sparse(&result, result.size + 1);
+    result.data[result.size]  = w;
+    result.index[result.size] = idx;
+    result.size++;
+  }
+
+  free_tagged(MEM_BITSETS, s1->data);
+  free_tagged(MEM_BITSETS, s1->index);
+  s1->data     = result.data;
+  s1->index    = result.index;
+  s1->size     = result.size;
+  s1->capacity = result.capacity;
+
+  adjust_repr(s1);
+}
+
+// s1 = s1 `op` s2, where s1 is dense
+static void merge_dense(BitSet* s1, const BitSet* s2, WordOp op) {
+  assert(s1->repr == BS_DENSE);
+
+  uint64_t* d1 = s1->data;
+  if (s2->repr == BS_DENSE) {
+    const uint64_t* d2 = s2->data;
+    switch (op) {
+      case WORD_OR:
+        for (unsigned i = 0; i < s1->size; i++) {
+          d1[i] |= d2[i];
+        }
+        return;
+      case WORD_AND:
+        for (unsigned i = 0; i < s1->size; i++) {
+          d1[i] &= d2[i];
+        }
+        return;
+      case WORD_DIFF:
+        for (unsigned i = 0; i < s1->size; i++) {
+          d1[i] &= ~d2[i];
+        }
+        return;
+      default:
+        CCC_UNREACHABLE;
+    }
+  }
+
+  if (op == WORD_AND) {
+    // words missing from s2 are cleared
+    unsigned next = 0;
+    for (unsigned j = 0; j < s2->size; j++) {
+      unsigned idx = s2->index[j];
+      memset(d1 + next, 0, sizeof(uint64_t) * (idx - next));
+      d1[idx] &= s2->data[j];
+      next = idx + 1;
+    }
+    memset(d1 + next, 0, sizeof(uint64_t) * (s1->size - next));
+    return;
+  }
+
+  for (unsigned j = 0; j < s2->size; j++) {
+    unsigned idx = s2->index[j];
+    d1[idx]      = apply_op(op, d1[idx], s2->data[j]);
+  }
+}
+
+static void merge(BitSet* s1, const BitSet* s2, WordOp op) {
   assert(s1->length == s2->length);
-  for (unsigned i = 0; i < length_U64Vec(s1->data); i++) {
-    uint64_t d1 = get_U64Vec(s1->data, i);
-    uint64_t d2 = get_U64Vec(s2->data, i);
-    set_U64Vec(s1->data, i, d1 & d2);
+  if (s1->repr == BS_DENSE) {
+    merge_dense(s1, s2, op);
+  } else {
+    merge_sparse(s1, s2, op);
   }
 }
 
+void or_BitSet(BitSet* s1, const BitSet* s2) {
+  merge(s1, s2, WORD_OR);
+}
+
+void and_BitSet(BitSet* s1, const BitSet* s2) {
+  merge(s1, s2, WORD_AND);
+}
+
 void diff_BitSet(BitSet* s1, const BitSet* s2) {
-  assert(s1->length == s2->length);
-  for (unsigned i = 0; i < length_U64Vec(s1->data); i++) {
-    uint64_t d1 = get_U64Vec(s1->data, i);
-    uint64_t d2 = get_U64Vec(s2->data, i);
-    set_U64Vec(s1->data, i, d1 & (~d2));
+  merge(s1, s2, WORD_DIFF);
+}
+
+// kernels of `transfer_BitSet`, each processes `size` words and returns true if `dst` is changed
+typedef bool (*TransferKernel)(uint64_t* dst,
+                               const uint64_t* gen,
+                               const uint64_t* in,
+                               const uint64_t* kill,
+                               unsigned size);
+
+static bool transfer_words(uint64_t* dst,
+                           const uint64_t* gen,
+                           const uint64_t* in,
+                           const uint64_t* kill,
+                           unsigned size) {
+  uint64_t changed = 0;
+  for (unsigned i = 0; i < size; i++) {
+    uint64_t d = gen[i] | (in[i] & ~kill[i]);
+    changed |= d ^ dst[i];
+    dst[i] = d;
+  }
+  return changed != 0;
+}
+
+#ifdef CCC_BIT_SET_X86
+__attribute__((target("sse2"))) static bool transfer_words_sse2(uint64_t* dst,
+                                                                const uint64_t* gen,
+                                                                const uint64_t* in,
+                                                                const uint64_t* kill,
+                                                                unsigned size) {
+  __m128i changed = _mm_setzero_si128();
+  unsigned i      = 0;
+  for (; i + 2 <= size; i += 2) {
+    __m128i g = _mm_loadu_si128((const __m128i*)(gen + i));
+    __m128i n = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i k = _mm_loadu_si128((const __m128i*)(kill + i));
+    __m128i o = _mm_loadu_si128((const __m128i*)(dst + i));
+    __m128i d = _mm_or_si128(g, _mm_andnot_si128(k, n));
+    changed   = _mm_or_si128(changed, _mm_xor_si128(d, o));
+    _mm_storeu_si128((__m128i*)(dst + i), d);
+  }
+  bool tail = transfer_words(dst + i, gen + i, in + i, kill + i, size - i);
+  return tail || _mm_movemask_epi8(_mm_cmpeq_epi8(changed, _mm_setzero_si128())) != 0xFFFF;
+}
+
+__attribute__((target("avx2"))) static bool transfer_words_avx2(uint64_t* dst,
+                                                                const uint64_t* gen,
+                                                                const uint64_t* in,
+                                                                const uint64_t* kill,
+                                                                unsigned size) {
+  __m256i changed = _mm256_setzero_si256();
+  unsigned i      = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256i g = _mm256_loadu_si256((const __m256i*)(gen + i));
+    __m256i n = _mm256_loadu_si256((const __m256i*)(in + i));
+    __m256i k = _mm256_loadu_si256((const __m256i*)(kill + i));
+    __m256i o = _mm256_loadu_si256((const __m256i*)(dst + i));
+    __m256i d = _mm256_or_si256(g, _mm256_andnot_si256(k, n));
+    changed   = _mm256_or_si256(changed, _mm256_xor_si256(d, o));
+    _mm256_storeu_si256((__m256i*)(dst + i), d);
+  }
+  bool tail = transfer_words(dst + i, gen + i, in + i, kill + i, size - i);
+  return tail || !_mm256_testz_si256(changed, changed);
+}
+#endif
+
+static TransferKernel select_transfer_kernel() {
+#ifdef CCC_BIT_SET_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return transfer_words_avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return transfer_words_sse2;
+  }
+#endif
+  return transfer_words;
+}
+
+bool transfer_BitSet(BitSet* dst, const BitSet* gen, const BitSet* in, const BitSet* kill) {
+  assert(dst->length == gen->length);
+  assert(dst->length == in->length);
+  assert(dst->length == kill->length);
+
+  if (dst->repr == BS_DENSE && gen->repr == BS_DENSE && in->repr == BS_DENSE &&
+      kill->repr == BS_DENSE) {
+    // may be selected concurrently by several threads, which all store the same kernel
+    static _Atomic(TransferKernel) kernel = NULL;
+    if (kernel == NULL) {
+      kernel = select_transfer_kernel();
+    }
+    return kernel(dst->data, gen->data, in->data, kill->data, dst->size);
+  }
+
+  BitSet* s = copy_BitSet(in);
+  diff_BitSet(s, kill);
+  or_BitSet(s, gen);
+  bool changed = !equal_to_BitSet(dst, s);
+  if (changed) {
+    copy_to_BitSet(dst, s);
   }
+  release_BitSet(s);
+  return changed;
 }
 
 bool get_BitSet(const BitSet* s, unsigned idx) {
-  uint64_t data = get_U64Vec(s->data, idx / block_size);
+  assert(idx < s->length);
+  uint64_t data = word_at(s, idx / block_size);
   unsigned pos  = idx % block_size;
   return (data >> pos) & UINT64_C(1);
 }
 
+static void set_sparse(BitSet* s, unsigned idx, bool b) {
+  unsigned word_idx = idx / block_size;
+  uint64_t mask     = UINT64_C(1) << (idx % block_size);
+
+  // bits are often set in ascending order
+  bool is_append = s->size != 0 && s->index[s->size - 1] < word_idx;
+  unsigned pos   = is_append ? s->size : lower_bound(s, word_idx);
+  bool found     = pos < s->size && s->index[pos] == word_idx;
+
+  if (b) {
+    if (found) {
+      s->data[pos] |= mask;
+      return;
+    }
+    reserve_sparse(s, s->size + 1);
+    memmove(s->data + pos + 1, s->data + pos, sizeof(uint64_t) * (s->size - pos));
+    memmove(s->index + pos + 1, s->index + pos, sizeof(unsigned) * (s->size - pos));
+    s->data[pos]  = mask;
+    s->index[pos] = word_idx;
+    s->size++;
+    adjust_repr(s);
+    return;
+  }
+
+  if (!found) {
+    return;
+  }
+  s->data[pos] &= ~mask;
+  if (s->data[pos] == 0) {
+    memmove(s->data + pos, s->data + pos + 1, sizeof(uint64_t) * (s->size - pos - 1));
+    memmove(s->index + pos, s->index + pos + 1, sizeof(unsigned) * (s->size - pos - 1));
+    s->size--;
+  }
+}
+
 void set_BitSet(BitSet* s, unsigned idx, bool b) {
-  uint64_t data = get_U64Vec(s->data, idx / block_size);
-  unsigned pos  = idx % block_size;
+  assert(idx < s->length);
+  if (s->repr == BS_SPARSE) {
+    set_sparse(s, idx, b);
+    return;
+  }
+
+  uint64_t* data = &s->data[idx / block_size];
+  unsigned pos   = idx % block_size;
   if (b) {
-    data |= UINT64_C(1) << pos;
+    *data |= UINT64_C(1) << pos;
   } else {
-    data &= ~(UINT64_C(1) << pos);
+    *data &= ~(UINT64_C(1) << pos);
   }
-  set_U64Vec(s->data, idx / block_size, data);
 }
 
 void clear_BitSet(BitSet* s) {
-  for (unsigned i = 0; i < length_U64Vec(s->data); i++) {
-    set_U64Vec(s->data, i, 0);
+  if (s->repr == BS_SPARSE) {
+    s->size = 0;
+    return;
   }
+
+  memset(s->data, 0, sizeof(uint64_t) * s->size);
 }
 
 BitSet* copy_BitSet(const BitSet* s) {
-  BitSet* new = init_BitSet();
-  new->length = s->length;
-  new->data   = copy_U64Vec(s->data);
+  BitSet* new   = alloc_tagged(MEM_BITSETS, sizeof(BitSet));
+  new->repr     = s->repr;
+  new->is_fixed = s->is_fixed;
+  new->length   = s->length;
+  new->size     = s->size;
+  new->capacity = s->size;
+  new->data     = realloc_tagged(MEM_BITSETS, NULL, sizeof(uint64_t) * s->size);
+  memcpy(new->data, s->data, sizeof(uint64_t) * s->size);
+  if (s->repr == BS_SPARSE) {
+    new->index = realloc_tagged(MEM_BITSETS, NULL, sizeof(unsigned) * s->size);
+    memcpy(new->index, s->index, sizeof(unsigned) * s->size);
+  }
   return new;
 }
 
 void copy_to_BitSet(BitSet* s1, const BitSet* s2) {
   assert(s1->length == s2->length);
-  for (unsigned i = 0; i < length_U64Vec(s1->data); i++) {
-    uint64_t d = get_U64Vec(s2->data, i);
-    set_U64Vec(s1->data, i, d);
+
+  if (s1->repr == BS_DENSE && s2->repr == BS_DENSE) {
+    memcpy(s1->data, s2->data, sizeof(uint64_t) * s1->size);
+    return;
+  }
+
+  if (s1->is_fixed && s1->repr == BS_DENSE) {
+    // scatter the words of sparse `s2`
+    memset(s1->data, 0, sizeof(uint64_t) * s1->size);
+    for (unsigned i = 0; i < s2->size; i++) {
+      s1->data[s2->index[i]] = s2->data[i];
+    }
+    return;
+  }
+  if (s1->is_fixed && s2->repr == BS_DENSE) {
+    // gather the non-zero words of dense `s2`
+    s1->size = 0;
+    for (unsigned i = 0; i < s2->size; i++) {
+      if (s2->data[i] != 0) {
+        reserve_sparse(s1, s1->size + 1);
+        s1->data[s1->size]  = s2->data[i];
+        s1->index[s1->size] = i;
+        s1->size++;
+      }
+    }
+    return;
+  }
+
+  // take over the representation of `s2`
+  free_tagged(MEM_BITSETS, s1->index);
+  s1->index    = NULL;
+  s1->repr     = s2->repr;
+  s1->size     = s2->size;
+  s1->capacity = s2->size;
+  s1->data     = realloc_tagged(MEM_BITSETS, s1->data, sizeof(uint64_t) * s2->size);
+  memcpy(s1->data, s2->data, sizeof(uint64_t) * s2->size);
+  if (s2->repr == BS_SPARSE) {
+    s1->index = realloc_tagged(MEM_BITSETS, NULL, sizeof(unsigned) * s2->size);
+    memcpy(s1->index, s2->index, sizeof(unsigned) * s2->size);
   }
 }
 
@@ -108,56 +555,123 @@ bool equal_to_BitSet(const BitSet* s1, const BitSet* s2) {
     return false;
   }
 
-  for (unsigned i = 0; i < length_U64Vec(s1->data); i++) {
-    uint64_t d1 = get_U64Vec(s1->data, i);
-    uint64_t d2 = get_U64Vec(s2->data, i);
-    if (d1 != d2) {
+  if (s1->repr == BS_DENSE && s2->repr == BS_DENSE) {
+    return memcmp(s1->data, s2->data, sizeof(uint64_t) * s1->size) == 0;
+  }
+
+  // sparse sets never hold zero words, so non-zero words must match one by one
+  WordCursor c1 = init_cursor(s1);
+  WordCursor c2 = init_cursor(s2);
+  while (c1.valid && c2.valid) {
+    if (c1.idx != c2.idx || c1.word != c2.word) {
       return false;
     }
+    advance_cursor(&c1);
+    advance_cursor(&c2);
   }
+  return c1.valid == c2.valid;
+}
 
-  return true;
+bool intersects_BitSet(const BitSet* s1, const BitSet* s2) {
+  assert(s1->length == s2->length);
+  for (WordCursor c = init_cursor(s2); c.valid; advance_cursor(&c)) {
+    if ((word_at(s1, c.idx) & c.word) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static unsigned popcount(uint64_t d) {
+#ifdef __GNUC__
+  return __builtin_popcountll(d);
+#else
+  unsigned res = 0;
+  for (; d != 0; d &= d - 1) {
+    res++;
+  }
+  return res;
+#endif
+}
+
+// index of the most significant set bit in non-zero `d`
+static unsigned msb(uint64_t d) {
+  assert(d != 0);
+#ifdef __GNUC__
+  return block_size - 1 - __builtin_clzll(d);
+#else
+  unsigned res = 0;
+  while (d >>= 1) {
+    res++;
+  }
+  return res;
+#endif
 }
 
 unsigned count_BitSet(const BitSet* s) {
   unsigned res = 0;
-  for (unsigned i = 0; i < length_U64Vec(s->data); i++) {
-    uint64_t d = get_U64Vec(s->data, i);
-    // TODO: faster count
-    for (; d != 0; d &= d - 1) {
-      res++;
-    }
+  for (unsigned i = 0; i < s->size; i++) {
+    res += popcount(s->data[i]);
   }
   return res;
 }
 
 // most significant set bit
 unsigned mssb_BitSet(const BitSet* s) {
-  assert(count_BitSet(s) != 0);
-  for (unsigned j = length_U64Vec(s->data); j > 0; j--) {
+  for (unsigned j = s->size; j > 0; j--) {
     unsigned i = j - 1;
-    uint64_t d = get_U64Vec(s->data, i);
-    if (d == 0) {
-      continue;
+    uint64_t d = s->data[i];
+    if (d != 0) {
+      unsigned idx = s->repr == BS_SPARSE ? s->index[i] : i;
+      return msb(d) + idx * block_size;
     }
+  }
+  CCC_UNREACHABLE;
+}
 
-    // TODO: faster count
-    unsigned mssb = 0;
-    while (d) {
-      d >>= 1;
-      mssb++;
-    }
+// index of the least significant set bit in non-zero `d`
+static unsigned lsb(uint64_t d) {
+  assert(d != 0);
+#ifdef __GNUC__
+  return __builtin_ctzll(d);
+#else
+  unsigned res = 0;
+  while ((d & 1) == 0) {
+    d >>= 1;
+    res++;
+  }
+  return res;
+#endif
+}
+
+BitSetIterator iter_BitSet(const BitSet* s) {
+  return (BitSetIterator){.set = s};
+}
 
-    return mssb - 1 + i * block_size;
+bool next_BitSet(BitSetIterator* it) {
+  if (it->word == 0) {
+    WordCursor c = {.s = it->set, .pos = it->pos};
+    advance_cursor(&c);
+    if (!c.valid) {
+      return false;
+    }
+    it->pos  = c.pos;
+    it->base = c.idx * block_size;
+    it->word = c.word;
   }
-  CCC_UNREACHABLE;
+
+  it->idx = it->base + lsb(it->word);
+  it->word &= it->word - 1;
+  return true;
 }
 
 void print_BitSet(FILE* p, const BitSet* s) {
   fputs("{", p);
-  for (unsigned i = 0; i < s->length; i++) {
-    if (get_BitSet(s, i)) {
-      fprintf(p, "%d, ", i);
+  for (WordCursor c = init_cursor(s); c.valid; advance_cursor(&c)) {
+    for (unsigned i = 0; i < block_size; i++) {
+      if ((c.word >> i) & UINT64_C(1)) {
+        fprintf(p, "%d, ", (int)(c.idx * block_size + i));
+      }
     }
   }
   fputs("}", p);
@@ -168,6 +682,7 @@ void release_BitSet(BitSet* s) {
     return;
   }
 
-  release_U64Vec(s->data);
-  free(s);
+  free_tagged(MEM_BITSETS, s->data);
+  free_tagged(MEM_BITSETS, s->index);
+  free_tagged(MEM_BITSETS, s);
 }
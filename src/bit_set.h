@@ -2,18 +2,30 @@
 #define CCC_BIT_SET_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef struct BitSet BitSet;
 
+typedef enum {
+  BS_AUTO,  // chosen by length and density, and switched as the set fills up
+  BS_DENSE,
+  BS_SPARSE,  // only non-zero words are stored
+} BitSetRepr;
+
 BitSet* new_BitSet(unsigned length);   // uninitialized
 BitSet* zero_BitSet(unsigned length);  // initialized
+BitSet* zero_BitSet_with(BitSetRepr, unsigned length);
 unsigned length_BitSet(const BitSet*);
+BitSetRepr repr_BitSet(const BitSet*);  // BS_DENSE or BS_SPARSE
 
 void or_BitSet(BitSet*, const BitSet*);
 void and_BitSet(BitSet*, const BitSet*);
 void diff_BitSet(BitSet*, const BitSet*);
 
+// dst = gen | (in - kill), returns true if `dst` is changed
+bool transfer_BitSet(BitSet* dst, const BitSet* gen, const BitSet* in, const BitSet* kill);
+
 bool get_BitSet(const BitSet*, unsigned);
 void set_BitSet(BitSet*, unsigned, bool);
 
@@ -21,9 +33,24 @@ void clear_BitSet(BitSet*);
 BitSet* copy_BitSet(const BitSet*);
 void copy_to_BitSet(BitSet*, const BitSet*);
 bool equal_to_BitSet(const BitSet*, const BitSet*);
+// whether any bit is set in both, visiting only the words of the second one
+bool intersects_BitSet(const BitSet*, const BitSet*);
 unsigned count_BitSet(const BitSet*);
 unsigned mssb_BitSet(const BitSet*);
 
+// visits set bits in ascending order, skipping zero words; the set must not change meanwhile
+//   for (BitSetIterator it = iter_BitSet(s); next_BitSet(&it);) { ... it.idx ... }
+typedef struct {
+  const BitSet* set;
+  unsigned pos;   // the next word to load
+  unsigned base;  // the first bit of `word`
+  uint64_t word;  // bits not visited yet
+  unsigned idx;   // the current bit
+} BitSetIterator;
+
+BitSetIterator iter_BitSet(const BitSet*);
+bool next_BitSet(BitSetIterator*);  // false when no bits are left
+
 void print_BitSet(FILE*, const BitSet*);
 void release_BitSet(BitSet*);
 
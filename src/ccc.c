@@ -4,26 +4,29 @@
 #include <string.h>
 
 #include "arch.h"
+#include "backend.h"
 #include "codegen.h"
 #include "const_fold_tree.h"
-#include "data_flow.h"
-#include "dead_code_elim.h"
 #include "error.h"
+#include "intern.h"
 #include "ir.h"
+#include "ir_text.h"
 #include "lexer.h"
-#include "mem2reg.h"
-#include "merge.h"
+#include "mem_stats.h"
 #include "parser.h"
-#include "peephole.h"
-#include "propagation.h"
 #include "reg_alloc.h"
-#include "reorder.h"
+#include "pass_manager.h"
 #include "sema.h"
+#include "time_report.h"
+#include "trace.h"
+#include "util.h"
 
 static char doc[] = "ccc: c compiler";
 
 static char args_doc[] =
-    "[--emit-tokens FILE] [--emit-ast FILE] [--emit-ir1 FILE] [--emit-ir2 FILE] [-On] -o FILE "
+    "[--emit-tokens FILE] [--emit-ast FILE] [--emit-ir1 FILE] [--emit-ir2 FILE] [--save-ir FILE] "
+    "[-On|-Ofix] [--passes PASS,...] [--regalloc ALLOCATOR] [-j N] [--stream] [--arena-report] "
+    "[--mem-report] [--regalloc-report] [--time-report[=FORMAT]] [--trace-out FILE] -o FILE "
     "SOURCE";
 
 static struct argp_option options[] = {
@@ -33,10 +36,32 @@ static struct argp_option options[] = {
     {"emit-ir1", 'c', "FILE", 0, "Dump the initial IR to the file"},
     {"emit-ir2", 'i', "FILE", 0, "Dump the target-specific IR to the file"},
     {"emit-ir3", 'f', "FILE", 0, "Dump the final IR to the file"},
-    {"optimize", 'O', "INTEGER", 0, "Number of optimization iterations"},
+    {"save-ir", 'I', "FILE", 0, "Save the target-specific IR to the file, to be read by ccc-opt"},
+    {"optimize", 'O', "INTEGER", 0,
+     "Maximum number of optimization iterations, or 'fix' to iterate until nothing changes"},
+    {"passes", 'p', "PASS,...", 0,
+     "Passes of the optimization pipeline (default: peephole,mem2reg,propagation,dead_code_elim,"
+     "remove_dead_blocks,merge_blocks,reorder_blocks)"},
+    {"regalloc", 'A', "ALLOCATOR", 0,
+     "Register allocator, 'linear' (default) for linear scan or 'color' for graph coloring with "
+     "move coalescing"},
+    {"jobs", 'j', "N", 0, "Optimize and allocate registers of N functions in parallel"},
+    {"stream", 'S', 0, 0,
+     "Parse, analyze, compile and output one function at a time (-j has no effect)"},
+    {"arena-report", 'R', 0, 0, "Print allocation statistics of each arena to stderr"},
+    {"mem-report", 'M', 0, 0,
+     "Print live bytes, peak bytes and allocations of each subsystem and phase to stderr"},
+    {"regalloc-report", 'G', 0, 0,
+     "Print the number of spills, reloads and rematerializations inserted in allocation to stderr"},
+    {"time-report", 'T', "FORMAT", OPTION_ARG_OPTIONAL,
+     "Print time and memory spent in each phase and pass to stderr, as text (default) or json"},
+    {"trace-out", 'P', "FILE", 0, "Write the timeline of phases and passes in trace event format"},
     {"output", 'o', "FILE", 0, "Output to FILE"},
     {0}};
 
+// the safety cap of `-Ofix`, for passes that keep changing a function
+#define FIXPOINT_ITERATIONS 16
+
 typedef struct {
   char* emit_tokens;
   char* emit_ast1;
@@ -44,8 +69,21 @@ typedef struct {
   char* emit_ir1;
   char* emit_ir2;
   char* emit_ir3;
+  char* save_ir;
+
+  unsigned iterations;  // of the optimization pipeline, at most
+  Pipeline* pipeline;
+  RegAllocKind regalloc;
+  unsigned jobs;
+  bool stream;
+  bool arena_report;
+  bool regalloc_report;
+
+  TimeReport* time_report;  // NULL unless requested
+  bool time_report_json;
 
-  unsigned optimize;
+  char* trace_out;
+  Trace* trace;  // NULL unless requested
 
   char* output;
   char* source;
@@ -73,11 +111,64 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
     case 'i':
       opts->emit_ir2 = arg;
       break;
+    case 'I':
+      opts->save_ir = arg;
+      break;
     case 'o':
       opts->output = arg;
       break;
     case 'O':
-      opts->optimize = atoi(arg);
+      if (strcmp(arg, "fix") == 0) {
+        opts->iterations = FIXPOINT_ITERATIONS;
+      } else {
+        opts->iterations = atoi(arg) + 1;
+      }
+      break;
+    case 'p': {
+      char* unknown;
+      release_Pipeline(opts->pipeline);
+      opts->pipeline = parse_pipeline(arg, &unknown);
+      if (opts->pipeline == NULL) {
+        argp_error(state, "unknown pass: %s", unknown);
+      }
+      break;
+    }
+    case 'A':
+      if (strcmp(arg, "linear") == 0) {
+        opts->regalloc = RA_LINEAR;
+      } else if (strcmp(arg, "color") == 0) {
+        opts->regalloc = RA_COLOR;
+      } else {
+        argp_error(state, "unknown register allocator: %s", arg);
+      }
+      break;
+    case 'j':
+      opts->jobs = atoi(arg);
+      break;
+    case 'S':
+      opts->stream = true;
+      break;
+    case 'R':
+      opts->arena_report = true;
+      break;
+    case 'G':
+      opts->regalloc_report = true;
+      break;
+    case 'M':
+      // usually started already in `main`
+      start_mem_stats();
+      break;
+    case 'T':
+      if (arg != NULL && strcmp(arg, "json") == 0) {
+        opts->time_report_json = true;
+      } else if (arg != NULL && strcmp(arg, "text") != 0) {
+        argp_error(state, "unknown report format: %s", arg);
+      }
+      opts->time_report = new_TimeReport();
+      break;
+    case 'P':
+      opts->trace_out = arg;
+      opts->trace     = new_Trace();
       break;
 
     case ARGP_KEY_ARG:
@@ -91,6 +182,10 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
         argp_usage(state);
       } else if (opts->output == NULL) {
         argp_usage(state);
+      } else if (opts->stream && (opts->emit_ast1 != NULL || opts->emit_ast2 != NULL ||
+                                  opts->emit_ir1 != NULL || opts->emit_ir2 != NULL ||
+                                  opts->emit_ir3 != NULL || opts->save_ir != NULL)) {
+        argp_error(state, "--stream cannot be combined with dumps of the AST or the IR");
       }
       break;
     default:
@@ -101,120 +196,227 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
 
 static struct argp argp = {options, parse_opt, args_doc, doc};
 
-static bool is_hyphen(const char* path) {
-  return path[0] == '-' && path[1] == '\0';
-}
-
-static FILE* open_file(const char* path, const char* mode) {
-  if (mode[0] == 'w' && is_hyphen(path)) {
-    return stdout;
-  }
-  FILE* f = fopen(path, mode);
-  if (f == NULL) {
-    error("could not open \"%s\": %s", path, strerror(errno));
-  }
-  return f;
-}
-
-static void close_file(FILE* f) {
-  if (f == stdout) {
-    return;
+// free all objects in `arena` at once
+static void teardown_arena(const Options* opts, Arena* arena) {
+  if (opts->arena_report) {
+    print_Arena(stderr, arena);
   }
-  fclose(f);
+  release_Arena(arena);
 }
 
-static char* read_file(const char* path) {
-  FILE* f = open_file(path, "rb");
-  fseek(f, 0, SEEK_END);
-  size_t size = ftell(f);
-  fseek(f, 0, SEEK_SET);
-
-  char* buf = malloc(size + 1);
-  fread(buf, 1, size, f);
-  fclose(f);
-
-  buf[size] = 0;
-
-  return buf;
+static BackendOptions backend_options(const Options* opts) {
+  return (BackendOptions){
+      .iterations = opts->iterations,
+      .pipeline   = opts->pipeline,
+      .allocate   = true,
+      .regalloc   = opts->regalloc,
+      .jobs       = opts->jobs,
+      .report     = opts->time_report,
+      .trace      = opts->trace,
+  };
 }
 
-int main(int argc, char** argv) {
-  Options opts = {0};
-  argp_parse(&argp, argc, argv, 0, 0, &opts);
-
-  char* input = read_file(opts.source);
-
-  TokenList* tokens = tokenize(input);
-  free(input);
-  if (opts.emit_tokens != NULL) {
-    FILE* f = open_file(opts.emit_tokens, "w");
-    print_TokenList(f, tokens);
-    close_file(f);
-  }
-
-  AST* tree = parse(tokens);
-  release_TokenList(tokens);
-  if (opts.emit_ast1 != NULL) {
-    FILE* f = open_file(opts.emit_ast1, "w");
-    print_AST(f, tree);
-    close_file(f);
-  }
-
+// analyze the whole translation unit, generate its IR, then run each phase on all of it
+static void compile_whole(const Options* opts, AST* tree) {
+  Timer t = start_Timer(false);
   sema(tree);
-  if (opts.emit_ast2 != NULL) {
-    FILE* f = open_file(opts.emit_ast2, "w");
+  end_phase(opts->time_report, opts->trace, "sema", &t);
+  if (opts->emit_ast2 != NULL) {
+    FILE* f = open_file(opts->emit_ast2, "w");
     print_AST(f, tree);
     close_file(f);
   }
 
+  t = start_Timer(false);
   const_fold_tree(tree);
+  end_phase(opts->time_report, opts->trace, "const_fold_tree", &t);
 
   // TODO: reduce the number of semantic analysis
+  t = start_Timer(false);
   sema(tree);
+  end_phase(opts->time_report, opts->trace, "sema2", &t);
+
+  t      = start_Timer(false);
   IR* ir = generate_IR(tree);
-  release_AST(tree);
-  if (opts.emit_ir1 != NULL) {
-    FILE* f = open_file(opts.emit_ir1, "w");
+  end_phase(opts->time_report, opts->trace, "generate_IR", &t);
+  teardown_arena(opts, ast_arena);
+  teardown_arena(opts, type_arena);
+  if (opts->emit_ir1 != NULL) {
+    FILE* f = open_file(opts->emit_ir1, "w");
     print_IR(f, ir);
     close_file(f);
   }
 
+  t = start_Timer(false);
   arch(ir);
-  if (opts.emit_ir2 != NULL) {
-    FILE* f = open_file(opts.emit_ir2, "w");
+  end_phase(opts->time_report, opts->trace, "arch", &t);
+  if (opts->emit_ir2 != NULL) {
+    FILE* f = open_file(opts->emit_ir2, "w");
     print_IR(f, ir);
     close_file(f);
   }
-
-  for (unsigned i = 0; i < opts.optimize + 1; i++) {
-    peephole(ir);
-    mem2reg(ir);
-
-    reach_data_flow(ir);
-    propagation(ir);
-
-    live_data_flow(ir);
-    dead_code_elim(ir);
-
-    remove_dead_blocks(ir);
-    merge_blocks(ir);
-    reorder_blocks(ir);
+  if (opts->save_ir != NULL) {
+    FILE* f = open_file(opts->save_ir, "w");
+    write_IR(f, ir);
+    close_file(f);
   }
 
-  live_data_flow(ir);
-  reg_alloc(num_regs, ir);
+  BackendOptions backend = backend_options(opts);
+  t                      = start_Timer(false);
+  compile_functions(ir, &backend);
+  end_phase(opts->time_report, opts->trace, "functions", &t);
 
-  if (opts.emit_ir3 != NULL) {
-    FILE* f = open_file(opts.emit_ir3, "w");
+  if (opts->emit_ir3 != NULL) {
+    FILE* f = open_file(opts->emit_ir3, "w");
     print_IR(f, ir);
     close_file(f);
   }
 
-  FILE* f = open_file(opts.output, "w");
+  t       = start_Timer(false);
+  FILE* f = open_file(opts->output, "w");
   codegen(f, ir);
   close_file(f);
+  end_phase(opts->time_report, opts->trace, "codegen", &t);
 
   release_IR(ir);
+}
+
+typedef struct {
+  const BackendOptions* backend;
+  FILE* output;
+} Stream;
+
+static void compile_part(IR* part, void* data) {
+  Stream* s = data;
+  arch(part);
+  compile_functions(part, s->backend);
+  codegen_text(s->output, part);
+}
+
+// the steps of `compile_whole` from `sema` to IR generation, on `d` alone
+// types made for the body of a function definition are allocated in an arena of its own, which is
+// freed once its code is output
+static void stream_external_decl(Sema* first, Sema* second, IRGen* gen, ExternalDecl* d) {
+  if (d->kind != EX_FUNC) {
+    sema_external_decl(first, d);
+    const_fold_external_decl(d);
+    sema_external_decl(second, d);
+    generate_IR_decl(gen, d);
+    return;
+  }
+
+  // the signature is needed by the functions after
+  sema_external_decl(first, d);
+  sema_external_decl(second, d);
+
+  Arena* types = type_arena;
+  type_arena   = new_Arena("types", MEM_TYPES);
+  sema_function_body(first, d->func);
+  const_fold_external_decl(d);
+  sema_function_body(second, d->func);
+  generate_IR_decl(gen, d);
+  release_Arena(type_arena);
+  type_arena = types;
+}
+
+// parse, analyze, compile and output each external declaration in turn, so that only one function
+// is alive at a time; globals are output at the end
+static void compile_streaming(const Options* opts, const char* input) {
+  BackendOptions backend = backend_options(opts);
+  FILE* f                = open_file(opts->output, "w");
+  start_codegen(f);
+
+  // the phases of a function are interleaved with the others; passes are reported as usual
+  Stream s     = {.backend = &backend, .output = f};
+  Timer t      = start_Timer(false);
+  Sema* first  = new_Sema();
+  Sema* second = new_Sema();
+  IRGen* gen   = new_IRGen(compile_part, &s);
+  Parser* p    = new_Parser(input);
+  // nothing refers to the nodes of a declaration once its IR is generated
+  ast_arena = new_Arena("ast", MEM_AST);
+  ExternalDecl* d;
+  while ((d = parse_external_decl(p)) != NULL) {
+    stream_external_decl(first, second, gen, d);
+    release_Arena(ast_arena);
+    ast_arena = new_Arena("ast", MEM_AST);
+  }
+  release_Arena(ast_arena);
+  release_Parser(p);
+  IR* globals = finish_IRGen(gen);
+  release_Sema(first);
+  release_Sema(second);
+  end_phase(opts->time_report, opts->trace, "stream", &t);
+  teardown_arena(opts, type_arena);
+
+  t = start_Timer(false);
+  codegen_data(f, globals);
+  close_file(f);
+  end_phase(opts->time_report, opts->trace, "codegen", &t);
+
+  release_IR(globals);
+}
+
+int main(int argc, char** argv) {
+  start_mem_stats_if_requested(argc, argv);
+
+  Options opts = {.iterations = 1, .pipeline = default_pipeline(), .jobs = 1};
+  argp_parse(&argp, argc, argv, 0, 0, &opts);
+
+  char* input = read_file(opts.source);
+
+  Timer t;
+  if (opts.emit_tokens != NULL) {
+    // the parser lexes on demand; lex the whole input separately just for the dump
+    t                = start_Timer(false);
+    TokenVec* tokens = tokenize(input);
+    end_phase(opts.time_report, opts.trace, "tokenize", &t);
+    FILE* f = open_file(opts.emit_tokens, "w");
+    print_TokenVec(f, tokens);
+    close_file(f);
+    release_TokenVec(tokens);
+  }
+
+  type_arena = new_Arena("types", MEM_TYPES);
+  if (opts.stream) {
+    compile_streaming(&opts, input);
+    free(input);
+  } else {
+    ast_arena = new_Arena("ast", MEM_AST);
+    t         = start_Timer(false);
+    AST* tree = parse(input);
+    end_phase(opts.time_report, opts.trace, "parse", &t);
+    free(input);
+    if (opts.emit_ast1 != NULL) {
+      FILE* f = open_file(opts.emit_ast1, "w");
+      print_AST(f, tree);
+      close_file(f);
+    }
+    compile_whole(&opts, tree);
+  }
+
+  if (opts.regalloc_report) {
+    print_reg_alloc_stats(stderr);
+  }
+  if (opts.time_report != NULL) {
+    if (opts.time_report_json) {
+      print_json_TimeReport(stderr, opts.time_report);
+    } else {
+      print_TimeReport(stderr, opts.time_report);
+    }
+    release_TimeReport(opts.time_report);
+  }
+  if (opts.trace != NULL) {
+    FILE* f = open_file(opts.trace_out, "w");
+    print_Trace(f, opts.trace);
+    close_file(f);
+    release_Trace(opts.trace);
+  }
+  release_Pipeline(opts.pipeline);
+  release_interned_strings();
+
+  // what is still live here is leaked
+  print_mem_report(stderr);
 
   return 0;
 }
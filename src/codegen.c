@@ -22,7 +22,7 @@ static const char* size_spec(DataSize s) {
   }
 }
 
-static void emit_label(FILE* p, char* fmt, ...) {
+static void emit_label(FILE* p, const char* fmt, ...) {
   va_list ap;
   va_start(ap, fmt);
   vfprintf(p, fmt, ap);
@@ -137,12 +137,8 @@ static void codegen_insts(FILE* p,
                           Function* f,
                           BasicBlock* bb,
                           BBListIterator* next_it,
-                          IRInstRangeIterator* it) {
-  if (is_nil_IRInstRangeIterator(it)) {
-    return;
-  }
-
-  IRInst* h = data_IRInstRangeIterator(it);
+                          IRInstListIterator* it) {
+  IRInst* h = data_IRInstListIterator(it);
   switch (h->kind) {
     case IR_IMM:
       emit(p, "mov %s, %d", reg_of(h->rd), h->imm);
@@ -251,7 +247,9 @@ static void codegen_insts(FILE* p,
       CCC_UNREACHABLE;
   }
 
-  codegen_insts(p, f, bb, next_it, next_IRInstRangeIterator(it));
+  if (it != bb->instructions->to) {
+    codegen_insts(p, f, bb, next_it, next_IRInstListIterator(it));
+  }
 }
 
 static void codegen_br_cmp(FILE* p, BBListIterator* next_bb_it, IRInst* inst) {
@@ -342,6 +340,23 @@ static void codegen_cmp(FILE* p, IRInst* inst) {
   }
 }
 
+// sign-extend rax into rdx, as the dividend of `idiv`
+static void emit_sign_extend_rax(FILE* p, DataSize size) {
+  switch (size) {
+    case SIZE_QWORD:
+      emit(p, "cqo");
+      return;
+    case SIZE_DWORD:
+      emit(p, "cdq");
+      return;
+    case SIZE_WORD:
+      emit(p, "cwd");
+      return;
+    default:
+      CCC_UNREACHABLE;
+  }
+}
+
 static void codegen_una(FILE* p, IRInst* inst) {
   Reg* rd  = inst->rd;
   Reg* opr = get_RegVec(inst->ras, 0);
@@ -366,20 +381,18 @@ static void codegen_bin(FILE* p, IRInst* inst) {
   Reg* rd  = inst->rd;
   Reg* lhs = get_RegVec(inst->ras, 0);
 
-  char* rhs_s = NULL;
-  Reg* rhs    = NULL;
+  char rhs_s[16];
+  Reg* rhs = NULL;
   switch (inst->kind) {
     case IR_BIN: {
-      rhs   = get_RegVec(inst->ras, 1);
-      rhs_s = strdup(reg_of(rhs));
+      rhs = get_RegVec(inst->ras, 1);
+      snprintf(rhs_s, sizeof(rhs_s), "%s", reg_of(rhs));
       // A = B op A instruction can't be emitted
       assert(rd->real != rhs->real);
       break;
     }
     case IR_BIN_IMM: {
-      // TODO: allocate an accurate amount of memory
-      rhs_s = malloc(32);
-      sprintf(rhs_s, "%d", inst->imm);
+      snprintf(rhs_s, sizeof(rhs_s), "%d", inst->imm);
       break;
     }
     default:
@@ -405,13 +418,13 @@ static void codegen_bin(FILE* p, IRInst* inst) {
     case ARITH_DIV:
       assert(lhs->real == rax_reg_id);
       assert(rd->real == rax_reg_id);
-      emit(p, "cqo");
+      emit_sign_extend_rax(p, lhs->size);
       emit(p, "idiv %s", rhs_s);
       return;
     case ARITH_REM:
       assert(lhs->real == rax_reg_id);
       assert(rd->real == rdx_reg_id);
-      emit(p, "cqo");
+      emit_sign_extend_rax(p, lhs->size);
       emit(p, "idiv %s", rhs_s);
       return;
     case ARITH_SHIFT_RIGHT:
@@ -435,8 +448,6 @@ static void codegen_bin(FILE* p, IRInst* inst) {
     default:
       CCC_UNREACHABLE;
   }
-
-  free(rhs_s);
 }
 
 static void codegen_blocks(FILE* p, Function* f, BBListIterator* it) {
@@ -447,7 +458,7 @@ static void codegen_blocks(FILE* p, Function* f, BBListIterator* it) {
   BasicBlock* b        = data_BBListIterator(it);
   BBListIterator* next = next_BBListIterator(it);
 
-  codegen_insts(p, f, b, next, front_IRInstRange(b->instructions));
+  codegen_insts(p, f, b, next, b->instructions->from);
 
   codegen_blocks(p, f, next);
 }
@@ -521,10 +532,22 @@ static void codegen_globals(FILE* p, GlobalVarVec* vs) {
   }
 }
 
-void codegen(FILE* p, IR* ir) {
+void start_codegen(FILE* p) {
   emit(p, ".intel_syntax noprefix");
+}
+
+void codegen_data(FILE* p, IR* ir) {
   emit(p, ".data");
   codegen_globals(p, ir->globals);
+}
+
+void codegen_text(FILE* p, IR* ir) {
   emit(p, ".text");
   codegen_functions(p, ir->functions);
 }
+
+void codegen(FILE* p, IR* ir) {
+  start_codegen(p);
+  codegen_data(p, ir);
+  codegen_text(p, ir);
+}
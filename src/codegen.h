@@ -7,4 +7,9 @@
 // generate x86_64 code and output it
 void codegen(FILE*, IR*);
 
+// the same in pieces: `start_codegen` once, then globals and functions of any number of IRs
+void start_codegen(FILE*);
+void codegen_data(FILE*, IR*);
+void codegen_text(FILE*, IR*);
+
 #endif
@@ -128,22 +128,25 @@ void const_fold_items(BlockItemList* items) {
   }
 }
 
+void const_fold_external_decl(ExternalDecl* d) {
+  switch (d->kind) {
+    case EX_FUNC:
+      const_fold_items(d->func->items);
+      break;
+    case EX_FUNC_DECL:
+      break;
+    case EX_DECL:
+      const_fold_decl(d->decl);
+      break;
+    default:
+      CCC_UNREACHABLE;
+  }
+}
+
 void const_fold_tree(AST* ast) {
   TranslationUnit* l = ast;
   while (!is_nil_TranslationUnit(l)) {
-    ExternalDecl* d = head_TranslationUnit(l);
-    switch (d->kind) {
-      case EX_FUNC:
-        const_fold_items(d->func->items);
-        break;
-      case EX_FUNC_DECL:
-        break;
-      case EX_DECL:
-        const_fold_decl(d->decl);
-        break;
-      default:
-        CCC_UNREACHABLE;
-    }
+    const_fold_external_decl(head_TranslationUnit(l));
     l = tail_TranslationUnit(l);
   }
 }
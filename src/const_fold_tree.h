@@ -4,6 +4,7 @@
 #include "ast.h"
 
 void const_fold_tree(AST*);
+void const_fold_external_decl(ExternalDecl*);
 
 bool get_constant(Expr*, long*);
 void const_fold_expr(Expr*);
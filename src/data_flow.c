@@ -1,12 +1,13 @@
 #include "data_flow.h"
+#include "error.h"
 
 static void collect_defs(Function*);
 static void compute_local_live_sets(Function*);
 static void compute_local_reach_sets(Function*);
 static void compute_global_live_sets(Function*);
 static void compute_global_reach_sets(Function*);
-static void compute_inst_live_sets(Function*);
-static void compute_inst_reach_sets(Function*);
+static void compute_reg_defs(Function*);
+static void prepare_set(BitSet**, unsigned);
 
 void live_data_flow(IR* ir) {
   FunctionList* l = ir->functions;
@@ -19,9 +20,6 @@ void live_data_flow(IR* ir) {
     // compute `live_out` and `live_in` in `BasicBlock`
     compute_global_live_sets(f);
 
-    // compute `live_out` and `live_in` in `IRInst`
-    compute_inst_live_sets(f);
-
     l = tail_FunctionList(l);
   }
 }
@@ -40,8 +38,8 @@ void reach_data_flow(IR* ir) {
     // compute `reach_out` and `reach_in` in `BasicBlock`
     compute_global_reach_sets(f);
 
-    // compute `reach_out` and `reach_in` in `IRInst`
-    compute_inst_reach_sets(f);
+    // compute `definitions` in `Reg`
+    compute_reg_defs(f);
 
     l = tail_FunctionList(l);
   }
@@ -61,13 +59,13 @@ static void collect_defs(Function* f) {
     }
   }
 
+  release_BSVec(f->definitions);
   f->definitions = defs;
 }
 
 static void iter_insts_forward(BasicBlock* b, IRInstRange* insts) {
-  for (IRInstRangeIterator* it = front_IRInstRange(insts); !is_nil_IRInstRangeIterator(it);
-       it                      = next_IRInstRangeIterator(it)) {
-    IRInst* inst = data_IRInstRangeIterator(it);
+  for (IRInstListIterator* it = insts->from;; it = next_IRInstListIterator(it)) {
+    IRInst* inst = data_IRInstListIterator(it);
 
     for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
       Reg* ra = get_RegVec(inst->ras, i);
@@ -81,27 +79,32 @@ static void iter_insts_forward(BasicBlock* b, IRInstRange* insts) {
     if (inst->rd != NULL) {
       set_BitSet(b->live_kill, inst->rd->virtual, true);
     }
+
+    if (it == insts->to) {
+      break;
+    }
   }
 }
 
 static void iter_insts_backward(BSVec* defs, BasicBlock* b, IRInstRange* insts) {
-  for (IRInstRangeIterator* it = back_IRInstRange(insts); !is_nil_IRInstRangeIterator(it);
-       it                      = prev_IRInstRangeIterator(it)) {
-    IRInst* inst = data_IRInstRangeIterator(it);
+  for (IRInstListIterator* it = insts->to;; it = prev_IRInstListIterator(it)) {
+    IRInst* inst = data_IRInstListIterator(it);
     unsigned id  = inst->local_id;
 
-    if (inst->rd == NULL) {
-      continue;
-    }
+    if (inst->rd != NULL) {
+      if (!get_BitSet(b->reach_kill, id)) {
+        set_BitSet(b->reach_gen, id, true);
+      }
 
-    if (!get_BitSet(b->reach_kill, id)) {
-      set_BitSet(b->reach_gen, id, true);
+      BitSet* kill = copy_BitSet(get_BSVec(defs, inst->rd->virtual));
+      set_BitSet(kill, id, false);
+      or_BitSet(b->reach_kill, kill);
+      release_BitSet(kill);
     }
 
-    BitSet* kill = copy_BitSet(get_BSVec(defs, inst->rd->virtual));
-    set_BitSet(kill, id, false);
-    or_BitSet(b->reach_kill, kill);
-    release_BitSet(kill);
+    if (it == insts->from) {
+      break;
+    }
   }
 }
 
@@ -110,8 +113,8 @@ static void compute_local_live_sets(Function* ir) {
        it                 = next_BBListIterator(it)) {
     BasicBlock* b = data_BBListIterator(it);
 
-    b->live_gen  = zero_BitSet(ir->reg_count);
-    b->live_kill = zero_BitSet(ir->reg_count);
+    prepare_set(&b->live_gen, ir->reg_count);
+    prepare_set(&b->live_kill, ir->reg_count);
 
     iter_insts_forward(b, b->instructions);
   }
@@ -122,214 +125,263 @@ static void compute_local_reach_sets(Function* ir) {
        it                 = next_BBListIterator(it)) {
     BasicBlock* b = data_BBListIterator(it);
 
-    b->reach_gen  = zero_BitSet(ir->inst_count);
-    b->reach_kill = zero_BitSet(ir->inst_count);
+    prepare_set(&b->reach_gen, ir->inst_count);
+    prepare_set(&b->reach_kill, ir->inst_count);
 
     iter_insts_backward(ir->definitions, b, b->instructions);
   }
 }
 
-// TODO: Organize these similar iteration algorithms
-static void iter_succs(BasicBlock* b, BBRefListIterator* l) {
-  if (is_nil_BBRefListIterator(l)) {
-    return;
-  }
-
-  BasicBlock* sux = data_BBRefListIterator(l);
-  if (sux->live_in != NULL) {
-    or_BitSet(b->live_out, sux->live_in);
-  }
-
-  iter_succs(b, next_BBRefListIterator(l));
+static BitSet** live_in_of(BasicBlock* b) {
+  return &b->live_in;
 }
 
-static void compute_global_live_sets(Function* ir) {
-  // temporary vector to detect changes in `live_in`
-  BSVec* lasts = new_BSVec(ir->bb_count);
-  for (unsigned i = 0; i < ir->bb_count; i++) {
-    push_BSVec(lasts, zero_BitSet(ir->reg_count));
-  }
-
-  for (BBListIterator* it = front_BBList(ir->blocks); !is_nil_BBListIterator(it);
-       it                 = next_BBListIterator(it)) {
-    BasicBlock* b = data_BBListIterator(it);
-    if (b->live_in != NULL) {
-      release_BitSet(b->live_in);
-    }
-    b->live_in = zero_BitSet(ir->reg_count);
-  }
-
-  bool changed;
-  bool is_first_loop = true;  // TODO: Improve the control flow
-  do {
-    // first two loops are performed unconditionally
-    changed       = is_first_loop;
-    is_first_loop = false;
-
-    // reverse order
-    for (BBListIterator* it = back_BBList(ir->blocks); !is_nil_BBListIterator(it);
-         it                 = prev_BBListIterator(it)) {
-      BasicBlock* b = data_BBListIterator(it);
-
-      if (b->live_out != NULL) {
-        release_BitSet(b->live_out);
-      }
-      b->live_out = zero_BitSet(ir->reg_count);
+static BitSet** live_out_of(BasicBlock* b) {
+  return &b->live_out;
+}
 
-      iter_succs(b, front_BBRefList(b->succs));
+static BitSet* live_gen_of(BasicBlock* b) {
+  return b->live_gen;
+}
 
-      copy_to_BitSet(b->live_in, b->live_out);
-      diff_BitSet(b->live_in, b->live_kill);
-      or_BitSet(b->live_in, b->live_gen);
+static BitSet* live_kill_of(BasicBlock* b) {
+  return b->live_kill;
+}
 
-      BitSet* last = get_BSVec(lasts, b->local_id);
-      changed      = changed || !equal_to_BitSet(b->live_in, last);
-      copy_to_BitSet(last, b->live_in);
-    }
-  } while (changed);
+static void compute_global_live_sets(Function* ir) {
+  DataFlowProblem p = {
+      .direction = DF_BACKWARD,
+      .join      = live_out_of,
+      .transfer  = live_in_of,
+      .gen       = live_gen_of,
+      .kill      = live_kill_of,
+  };
+  solve_data_flow(ir, &p, ir->reg_count);
+}
 
-  release_BSVec(lasts);
+static BitSet** reach_in_of(BasicBlock* b) {
+  return &b->reach_in;
 }
 
-static void compute_inst_live_sets(Function* ir) {
-  for (BBListIterator* it1 = front_BBList(ir->blocks); !is_nil_BBListIterator(it1);
-       it1                 = next_BBListIterator(it1)) {
-    BasicBlock* b = data_BBListIterator(it1);
+static BitSet** reach_out_of(BasicBlock* b) {
+  return &b->reach_out;
+}
 
-    BitSet* live = copy_BitSet(b->live_out);
-    for (IRInstRangeIterator* it2              = back_IRInstRange(b->instructions);
-         !is_nil_IRInstRangeIterator(it2); it2 = prev_IRInstRangeIterator(it2)) {
-      IRInst* inst = data_IRInstRangeIterator(it2);
+static BitSet* reach_gen_of(BasicBlock* b) {
+  return b->reach_gen;
+}
 
-      if (inst->live_out != NULL) {
-        release_BitSet(inst->live_out);
-      }
-      inst->live_out = copy_BitSet(live);
+static BitSet* reach_kill_of(BasicBlock* b) {
+  return b->reach_kill;
+}
 
-      if (inst->rd != NULL) {
-        set_BitSet(live, inst->rd->virtual, false);
-      }
-      for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
-        Reg* ra = get_RegVec(inst->ras, i);
-        set_BitSet(live, ra->virtual, true);
-      }
+static void compute_global_reach_sets(Function* ir) {
+  DataFlowProblem p = {
+      .direction = DF_FORWARD,
+      .join      = reach_in_of,
+      .transfer  = reach_out_of,
+      .gen       = reach_gen_of,
+      .kill      = reach_kill_of,
+  };
+  solve_data_flow(ir, &p, ir->inst_count);
+}
 
-      if (inst->live_in != NULL) {
-        release_BitSet(inst->live_in);
-      }
-      inst->live_in = copy_BitSet(live);
-    }
-    assert(equal_to_BitSet(b->live_in, live));
+// reuse `*s` if it already has `length`, otherwise (re)allocate it
+static void prepare_set(BitSet** s, unsigned length) {
+  if (*s != NULL && length_BitSet(*s) == length) {
+    clear_BitSet(*s);
+    return;
   }
+
+  release_BitSet(*s);
+  *s = zero_BitSet(length);
 }
 
-static void iter_preds(BasicBlock* b, BBRefListIterator* l) {
-  if (is_nil_BBRefListIterator(l)) {
+static void postorder(BBRefVec* order, BitSet* visited, BasicBlock* b) {
+  if (get_BitSet(visited, b->local_id)) {
     return;
   }
+  set_BitSet(visited, b->local_id, true);
 
-  BasicBlock* pre = data_BBRefListIterator(l);
-  if (pre->reach_out != NULL) {
-    or_BitSet(b->reach_in, pre->reach_out);
+  for (BBRefListIterator* it = front_BBRefList(b->succs); !is_nil_BBRefListIterator(it);
+       it                    = next_BBRefListIterator(it)) {
+    postorder(order, visited, data_BBRefListIterator(it));
   }
 
-  iter_preds(b, next_BBRefListIterator(l));
+  push_BBRefVec(order, b);
 }
 
-static void compute_global_reach_sets(Function* ir) {
-  // temporary vector to detect changes in `reach_out`
-  BSVec* lasts = new_BSVec(ir->bb_count);
-  for (unsigned i = 0; i < ir->bb_count; i++) {
-    push_BSVec(lasts, zero_BitSet(ir->inst_count));
-  }
+// blocks ordered so that most of `join` inputs are computed before each block
+static BBRefVec* flow_order(Function* f, DataFlowDirection direction) {
+  BBRefVec* order = new_BBRefVec(f->bb_count);
+  BitSet* visited = zero_BitSet(f->bb_count);
 
-  for (BBListIterator* it = front_BBList(ir->blocks); !is_nil_BBListIterator(it);
+  postorder(order, visited, f->entry);
+
+  // unreachable blocks are not removed yet
+  for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
        it                 = next_BBListIterator(it)) {
-    BasicBlock* b = data_BBListIterator(it);
-    if (b->reach_out != NULL) {
-      release_BitSet(b->reach_out);
+    postorder(order, visited, data_BBListIterator(it));
+  }
+  release_BitSet(visited);
+
+  if (direction == DF_FORWARD) {
+    unsigned n = length_BBRefVec(order);
+    for (unsigned i = 0; i < n / 2; i++) {
+      BasicBlock* tmp = get_BBRefVec(order, i);
+      set_BBRefVec(order, i, get_BBRefVec(order, n - i - 1));
+      set_BBRefVec(order, n - i - 1, tmp);
     }
-    b->reach_out = zero_BitSet(ir->inst_count);
   }
 
-  bool changed;
-  bool is_first_loop = true;  // TODO: Improve the control flow
-  do {
-    // first two loops are performed unconditionally
-    changed       = is_first_loop;
-    is_first_loop = false;
-
-    // straight order
-    for (BBListIterator* it = front_BBList(ir->blocks); !is_nil_BBListIterator(it);
-         it                 = next_BBListIterator(it)) {
-      BasicBlock* b = data_BBListIterator(it);
-
-      if (b->reach_in != NULL) {
-        release_BitSet(b->reach_in);
-      }
-      b->reach_in = zero_BitSet(ir->inst_count);
+  return order;
+}
 
-      iter_preds(b, front_BBRefList(b->preds));
+void solve_data_flow(Function* f, const DataFlowProblem* p, unsigned length) {
+  BBRefVec* order = flow_order(f, p->direction);
+  unsigned n      = length_BBRefVec(order);
 
-      copy_to_BitSet(b->reach_out, b->reach_in);
-      diff_BitSet(b->reach_out, b->reach_kill);
-      or_BitSet(b->reach_out, b->reach_gen);
+  // `local_id` -> index in `order`
+  UIVec* position = new_UIVec(f->bb_count);
+  resize_UIVec(position, f->bb_count);
+  for (unsigned i = 0; i < n; i++) {
+    BasicBlock* b = get_BBRefVec(order, i);
+    set_UIVec(position, b->local_id, i);
 
-      BitSet* last = get_BSVec(lasts, b->local_id);
-      changed      = changed || !equal_to_BitSet(b->reach_out, last);
-      copy_to_BitSet(last, b->reach_out);
-    }
-  } while (changed);
+    prepare_set(p->join(b), length);
+    prepare_set(p->transfer(b), length);
+  }
 
-  release_BSVec(lasts);
-}
+  // all blocks are visited at least once
+  BitSet* pending = zero_BitSet(n);
+  for (unsigned i = 0; i < n; i++) {
+    set_BitSet(pending, i, true);
+  }
+  unsigned pending_count = n;
 
-static void compute_reg_defs(Function* f, IRInst* inst) {
-  for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
-    Reg* r = get_RegVec(inst->ras, i);
+  while (pending_count != 0) {
+    for (unsigned i = 0; i < n; i++) {
+      if (!get_BitSet(pending, i)) {
+        continue;
+      }
+      set_BitSet(pending, i, false);
+      pending_count--;
+
+      BasicBlock* b      = get_BBRefVec(order, i);
+      BBRefList* inputs  = p->direction == DF_FORWARD ? b->preds : b->succs;
+      BBRefList* outputs = p->direction == DF_FORWARD ? b->succs : b->preds;
+
+      BitSet* join = *p->join(b);
+      clear_BitSet(join);
+      for (BBRefListIterator* it = front_BBRefList(inputs); !is_nil_BBRefListIterator(it);
+           it                    = next_BBRefListIterator(it)) {
+        or_BitSet(join, *p->transfer(data_BBRefListIterator(it)));
+      }
 
-    BitSet* defs = copy_BitSet(get_BSVec(f->definitions, r->virtual));
-    and_BitSet(defs, inst->reach_in);
+      if (!transfer_BitSet(*p->transfer(b), p->gen(b), join, p->kill(b))) {
+        continue;
+      }
 
-    if (r->definitions != NULL) {
-      release_BitSet(r->definitions);
+      // only the blocks reading `transfer` of `b` need to be revisited
+      for (BBRefListIterator* it = front_BBRefList(outputs); !is_nil_BBRefListIterator(it);
+           it                    = next_BBRefListIterator(it)) {
+        unsigned j = get_UIVec(position, data_BBRefListIterator(it)->local_id);
+        if (!get_BitSet(pending, j)) {
+          set_BitSet(pending, j, true);
+          pending_count++;
+        }
+      }
     }
-    r->definitions = defs;
   }
+
+  release_BitSet(pending);
+  release_UIVec(position);
+  release_BBRefVec(order);
 }
 
-static void compute_inst_reach_sets(Function* ir) {
-  for (BBListIterator* it1 = front_BBList(ir->blocks); !is_nil_BBListIterator(it1);
+static void compute_reg_defs(Function* f) {
+  for (BBListIterator* it1 = front_BBList(f->blocks); !is_nil_BBListIterator(it1);
        it1                 = next_BBListIterator(it1)) {
     BasicBlock* b = data_BBListIterator(it1);
 
     BitSet* reach = copy_BitSet(b->reach_in);
-    for (IRInstRangeIterator* it2              = front_IRInstRange(b->instructions);
-         !is_nil_IRInstRangeIterator(it2); it2 = next_IRInstRangeIterator(it2)) {
-      IRInst* inst = data_IRInstRangeIterator(it2);
+    for (IRInstListIterator* it2 = b->instructions->from;; it2 = next_IRInstListIterator(it2)) {
+      IRInst* inst = data_IRInstListIterator(it2);
 
-      if (inst->reach_in != NULL) {
-        release_BitSet(inst->reach_in);
-      }
-      inst->reach_in = copy_BitSet(reach);
+      for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
+        Reg* r = get_RegVec(inst->ras, i);
 
-      compute_reg_defs(ir, inst);
+        BitSet* defs = copy_BitSet(get_BSVec(f->definitions, r->virtual));
+        and_BitSet(defs, reach);
 
-      if (inst->rd == NULL) {
-        continue;
+        release_BitSet(r->definitions);
+        r->definitions = defs;
       }
-      unsigned id  = inst->local_id;
-      BitSet* defs = copy_BitSet(get_BSVec(ir->definitions, inst->rd->virtual));
-      set_BitSet(defs, id, false);
-      diff_BitSet(reach, defs);
-      set_BitSet(reach, id, true);
-      release_BitSet(defs);
-
-      if (inst->reach_out != NULL) {
-        release_BitSet(inst->reach_out);
+
+      step_reach_forward(f, reach, inst);
+
+      if (it2 == b->instructions->to) {
+        break;
       }
-      inst->reach_out = copy_BitSet(reach);
     }
     assert(equal_to_BitSet(b->reach_out, reach));
+    release_BitSet(reach);
+  }
+}
+
+void step_live_backward(BitSet* live, IRInst* inst) {
+  if (inst->rd != NULL) {
+    set_BitSet(live, inst->rd->virtual, false);
+  }
+  for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
+    Reg* ra = get_RegVec(inst->ras, i);
+    set_BitSet(live, ra->virtual, true);
+  }
+}
+
+void step_reach_forward(Function* f, BitSet* reach, IRInst* inst) {
+  if (inst->rd == NULL) {
+    return;
+  }
+
+  // instructions and registers created after the analysis are not tracked
+  if (inst->local_id >= length_BitSet(reach) ||
+      inst->rd->virtual >= length_BSVec(f->definitions)) {
+    return;
+  }
+
+  diff_BitSet(reach, get_BSVec(f->definitions, inst->rd->virtual));
+  set_BitSet(reach, inst->local_id, true);
+}
+
+// the scans step list iterators, since range iterators are allocated at each step
+
+BitSet* live_out_at(BasicBlock* b, IRInst* inst) {
+  BitSet* live = copy_BitSet(b->live_out);
+  for (IRInstListIterator* it = b->instructions->to;; it = prev_IRInstListIterator(it)) {
+    IRInst* i = data_IRInstListIterator(it);
+    if (i == inst) {
+      return live;
+    }
+    step_live_backward(live, i);
+    if (it == b->instructions->from) {
+      break;
+    }
+  }
+  CCC_UNREACHABLE;
+}
+
+BitSet* reach_in_at(Function* f, BasicBlock* b, IRInst* inst) {
+  BitSet* reach = copy_BitSet(b->reach_in);
+  for (IRInstListIterator* it = b->instructions->from;; it = next_IRInstListIterator(it)) {
+    IRInst* i = data_IRInstListIterator(it);
+    if (i == inst) {
+      return reach;
+    }
+    step_reach_forward(f, reach, i);
+    if (it == b->instructions->to) {
+      break;
+    }
   }
+  CCC_UNREACHABLE;
 }
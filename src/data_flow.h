@@ -3,7 +3,45 @@
 
 #include "ir.h"
 
+// compute block-level sets in `BasicBlock`
 void live_data_flow(IR*);
 void reach_data_flow(IR*);
 
+// sets at each instruction are not stored, but derived from the block-level sets on demand
+
+// update `live` from the live-out set of `inst` to its live-in set
+void step_live_backward(BitSet* live, IRInst* inst);
+// update `reach` from the reach-in set of `inst` to its reach-out set
+void step_reach_forward(Function*, BitSet* reach, IRInst* inst);
+
+// live-out set of `inst` in `b`, computed by a backward scan from the end of `b`
+// passes visiting every instruction keep a running set with the `step_*` functions instead
+BitSet* live_out_at(BasicBlock* b, IRInst* inst);
+// reach-in set of `inst` in `b`, computed by a forward scan from the beginning of `b`
+BitSet* reach_in_at(Function*, BasicBlock* b, IRInst* inst);
+
+typedef enum {
+  DF_FORWARD,
+  DF_BACKWARD,
+} DataFlowDirection;
+
+// a bit-vector data flow problem on `BasicBlock`s, joined by union
+//
+//   join(b)     = union of transfer(n) for n in preds(b) (succs(b) if backward)
+//   transfer(b) = gen(b) | (join(b) - kill(b))
+//
+// e.g. `join` is `live_out` and `transfer` is `live_in` in liveness analysis
+typedef struct {
+  DataFlowDirection direction;
+
+  BitSet** (*join)(BasicBlock*);      // updated in place, allocated if needed
+  BitSet** (*transfer)(BasicBlock*);  // ditto
+  BitSet* (*gen)(BasicBlock*);
+  BitSet* (*kill)(BasicBlock*);
+} DataFlowProblem;
+
+// solve `p` on `f` with a worklist visiting blocks in reverse postorder (postorder if backward)
+// `length` is the length of each set
+void solve_data_flow(Function* f, const DataFlowProblem* p, unsigned length);
+
 #endif
@@ -1,38 +1,52 @@
 #include "dead_code_elim.h"
+#include "data_flow.h"
 
-static void perform_dce(IRInstList* list, IRInstListIterator* it) {
-  IRInst* inst = data_IRInstListIterator(it);
-  if (inst->rd == NULL) {
-    return;
-  }
+// scan `b` backward with its live set, and remove definitions that are never used
+static bool dead_code_elim_block(Function* f, BasicBlock* b) {
+  BitSet* live = copy_BitSet(b->live_out);
+  bool changed  = false;
 
-  if (get_BitSet(inst->live_out, inst->rd->virtual)) {
-    return;
-  }
+  IRInstListIterator* it = b->instructions->to;
+  while (it != prev_IRInstListIterator(b->instructions->from)) {
+    IRInst* inst = data_IRInstListIterator(it);
+    it           = prev_IRInstListIterator(it);
+
+    if (inst->rd != NULL && !get_BitSet(live, inst->rd->virtual)) {
+      if (inst->kind != IR_CALL) {
+        // operands of the removed instruction are not live anymore
+        remove_by_idx_IRInstListIterator(f->instructions, inst->local_id);
+        changed = true;
+        continue;
+      }
+
+      release_Reg(inst->rd);
+      inst->rd = NULL;
+      changed  = true;
+    }
 
-  if (inst->kind == IR_CALL) {
-    release_Reg(inst->rd);
-    inst->rd = NULL;
-    return;
+    step_live_backward(live, inst);
   }
 
-  remove_IRInstListIterator(list, it);
+  release_BitSet(live);
+  return changed;
 }
 
-static void dead_code_elim_function(Function* f) {
-  IRInstListIterator* it = front_IRInstList(f->instructions);
-  while (!is_nil_IRInstListIterator(it)) {
-    IRInstListIterator* next = next_IRInstListIterator(it);
-    perform_dce(f->instructions, it);
-    it = next;
+static bool dead_code_elim_function(Function* f) {
+  bool changed = false;
+  for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
+       it                 = next_BBListIterator(it)) {
+    changed |= dead_code_elim_block(f, data_BBListIterator(it));
   }
+  return changed;
 }
 
-void dead_code_elim(IR* ir) {
+bool dead_code_elim(IR* ir) {
+  bool changed    = false;
   FunctionList* l = ir->functions;
   while (!is_nil_FunctionList(l)) {
     Function* f = head_FunctionList(l);
-    dead_code_elim_function(f);
+    changed |= dead_code_elim_function(f);
     l = tail_FunctionList(l);
   }
+  return changed;
 }
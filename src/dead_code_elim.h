@@ -3,6 +3,7 @@
 
 #include "ir.h"
 
-void dead_code_elim(IR*);
+// returns whether any function has been changed
+bool dead_code_elim(IR*);
 
 #endif
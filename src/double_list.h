@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include "error.h"
+#include "util.h"
 
 // a doubly linked list
 #define DECLARE_DLIST(T, Name)                                                                     \
@@ -32,9 +33,13 @@
   Name##Iterator* find_##Name(Name* list, T value);                                                \
   void erase_one_##Name(Name* list, T value);                                                      \
   Name* shallow_copy_##Name(const Name* list);                                                     \
+  void shallow_release_##Name(Name* list);                                                         \
   void release_##Name(Name* list);
 
-#define DEFINE_DLIST(release_data, T, Name)                                                        \
+#define DEFINE_DLIST(release_data, T, Name) DEFINE_DLIST_WITH(heap, release_data, T, Name)
+
+// nodes are allocated with `alloc_##A` and freed with `free_##A` (see util.h and arena.h)
+#define DEFINE_DLIST_WITH(A, release_data, T, Name)                                                \
   struct Name##Iterator {                                                                          \
     bool is_nil;                                                                                   \
     T data;                                                                                        \
@@ -46,7 +51,7 @@
     Name##Iterator* last;                                                                          \
   };                                                                                               \
   Name##Iterator* new_##Name##Iterator(Name##Iterator* prev, Name##Iterator* next) {               \
-    Name##Iterator* l = malloc(sizeof(Name##Iterator));                                            \
+    Name##Iterator* l = alloc_##A(sizeof(Name##Iterator));                                         \
     l->is_nil         = false;                                                                     \
     l->prev           = prev;                                                                      \
     l->next           = next;                                                                      \
@@ -56,10 +61,10 @@
     if (!it->is_nil) {                                                                             \
       release_data(it->data);                                                                      \
     }                                                                                              \
-    free(it);                                                                                      \
+    free_##A(it);                                                                                  \
   }                                                                                                \
   Name* new_##Name() {                                                                             \
-    Name* l         = malloc(sizeof(Name));                                                        \
+    Name* l         = alloc_##A(sizeof(Name));                                                     \
     l->init         = new_##Name##Iterator(NULL, NULL);                                            \
     l->init->is_nil = true;                                                                        \
     l->last         = new_##Name##Iterator(NULL, NULL);                                            \
@@ -195,6 +200,16 @@
     }                                                                                              \
     return new;                                                                                    \
   }                                                                                                \
+  /* frees the nodes without releasing the elements */                                             \
+  void shallow_release_##Name(Name* list) {                                                        \
+    Name##Iterator* it = list->init;                                                               \
+    while (it != NULL) {                                                                           \
+      Name##Iterator* next = it->next;                                                             \
+      free_##A(it);                                                                                \
+      it = next;                                                                                   \
+    }                                                                                              \
+    free_##A(list);                                                                                \
+  }                                                                                                \
   void release_##Name(Name* list) {                                                                \
     Name##Iterator* it = front_##Name(list);                                                       \
     while (!is_nil_##Name##Iterator(it)) {                                                         \
@@ -204,6 +219,7 @@
     }                                                                                              \
     release_##Name##Iterator(list->init);                                                          \
     release_##Name##Iterator(list->last);                                                          \
+    free_##A(list);                                                                                \
   }
 
 #endif
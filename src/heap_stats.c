@@ -0,0 +1,100 @@
+#include <stdlib.h>
+
+#include "heap_stats.h"
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer) ||                         \
+    __has_feature(thread_sanitizer)
+#define CCC_SANITIZED
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define CCC_SANITIZED
+#endif
+
+#if defined(__GLIBC__) && !defined(CCC_SANITIZED)
+#define CCC_HEAP_STATS
+#endif
+
+static _Thread_local HeapStats stats;
+
+#ifdef CCC_HEAP_STATS
+#include <malloc.h>
+
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+extern void __libc_free(void*);
+
+static void count_alloc(void* p) {
+  if (p == NULL) {
+    return;
+  }
+  stats.allocs++;
+  stats.in_use += malloc_usable_size(p);
+  if (stats.in_use > stats.peak) {
+    stats.peak = stats.in_use;
+  }
+}
+
+static void count_free(void* p) {
+  if (p != NULL) {
+    stats.in_use -= malloc_usable_size(p);
+  }
+}
+
+void* malloc(size_t size) {
+  void* p = __libc_malloc(size);
+  count_alloc(p);
+  return p;
+}
+
+void* calloc(size_t n, size_t size) {
+  void* p = __libc_calloc(n, size);
+  count_alloc(p);
+  return p;
+}
+
+void* realloc(void* old, size_t size) {
+  count_free(old);
+  void* p = __libc_realloc(old, size);
+  if (p == NULL && size != 0) {
+    // `old` is left as is
+    stats.in_use += malloc_usable_size(old);
+    return NULL;
+  }
+  count_alloc(p);
+  return p;
+}
+
+void free(void* p) {
+  count_free(p);
+  __libc_free(p);
+}
+#endif
+
+bool heap_stats_available() {
+#ifdef CCC_HEAP_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+HeapStats* thread_heap_stats() {
+  return &stats;
+}
+
+HeapPeak start_heap_peak() {
+  HeapPeak m = {.base = stats.in_use, .outer_peak = stats.peak};
+  stats.peak = stats.in_use;
+  return m;
+}
+
+long end_heap_peak(HeapPeak m) {
+  long peak = stats.peak - m.base;
+  if (m.outer_peak > stats.peak) {
+    stats.peak = m.outer_peak;
+  }
+  return peak;
+}
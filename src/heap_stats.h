@@ -0,0 +1,27 @@
+#ifndef CCC_HEAP_STATS_H
+#define CCC_HEAP_STATS_H
+
+#include <stdbool.h>
+
+// counters of heap allocations made by the calling thread
+// collected by wrapping malloc and friends, which is done only with glibc and without sanitizers
+typedef struct {
+  unsigned long allocs;
+  long in_use;  // bytes; may drift when blocks are freed by another thread than the allocating one
+  long peak;    // the maximum of `in_use` (see `start_heap_peak`)
+} HeapStats;
+
+bool heap_stats_available();
+HeapStats* thread_heap_stats();
+
+// a measurement of the peak usage of the calling thread, which can be nested
+typedef struct {
+  long base;        // `in_use` at the start
+  long outer_peak;  // `peak` of the enclosing measurement
+} HeapPeak;
+
+HeapPeak start_heap_peak();
+// the peak usage since `start_heap_peak`, relative to the usage back then
+long end_heap_peak(HeapPeak);
+
+#endif
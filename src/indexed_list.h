@@ -32,19 +32,24 @@
   void push_front_with_idx_##Name(Name* list, unsigned idx, T value);                              \
   void push_back_with_idx_##Name(Name* list, unsigned idx, T value);                               \
   Name* shallow_copy_##Name(const Name* list);                                                     \
+  void shallow_release_##Name(Name* list);                                                         \
   void release_##Name(Name* list);
 
 #define DEFINE_INDEXED_LIST(release_data, T, Name)                                                 \
+  DEFINE_INDEXED_LIST_WITH(heap, release_data, T, Name)
+
+// allocated with `alloc_##A` and freed with `free_##A` (see util.h and arena.h)
+#define DEFINE_INDEXED_LIST_WITH(A, release_data, T, Name)                                         \
   DECLARE_DLIST(T, Name##List)                                                                     \
-  DEFINE_DLIST(release_data, T, Name##List)                                                        \
+  DEFINE_DLIST_WITH(A, release_data, T, Name##List)                                                \
   DECLARE_VECTOR(Name##ListIterator*, Name##IterRefVec)                                            \
-  DEFINE_VECTOR(release_dummy, Name##ListIterator*, Name##IterRefVec)                              \
+  DEFINE_VECTOR_WITH(A, release_dummy, Name##ListIterator*, Name##IterRefVec)                      \
   struct Name {                                                                                    \
     Name##List* list;                                                                              \
     Name##IterRefVec* iterators;                                                                   \
   };                                                                                               \
   Name* new_##Name(unsigned size) {                                                                \
-    Name* l      = malloc(sizeof(Name));                                                           \
+    Name* l      = alloc_##A(sizeof(Name));                                                        \
     l->list      = new_##Name##List();                                                             \
     l->iterators = new_##Name##IterRefVec(size);                                                   \
     resize_##Name##IterRefVec(l->iterators, size);                                                 \
@@ -123,15 +128,20 @@
   T head_##Name(Name* list) { return head_##Name##List(list->list); }                              \
   T last_##Name(Name* list) { return last_##Name##List(list->list); }                              \
   Name* shallow_copy_##Name(const Name* list) {                                                    \
-    Name* l      = malloc(sizeof(Name));                                                           \
+    Name* l      = alloc_##A(sizeof(Name));                                                        \
     l->list      = shallow_copy_##Name##List(list->list);                                          \
     l->iterators = /*shallow_*/ copy_##Name##IterRefVec(list->iterators);                          \
     return l;                                                                                      \
   }                                                                                                \
+  void shallow_release_##Name(Name* list) {                                                        \
+    shallow_release_##Name##List(list->list);                                                      \
+    release_##Name##IterRefVec(list->iterators);                                                   \
+    free_##A(list);                                                                                \
+  }                                                                                                \
   void release_##Name(Name* list) {                                                                \
     release_##Name##List(list->list);                                                              \
     release_##Name##IterRefVec(list->iterators);                                                   \
-    free(list);                                                                                    \
+    free_##A(list);                                                                                \
   }
 
 #define DECLARE_SELF_INDEXED_LIST(T, Name)                                                         \
@@ -142,7 +152,10 @@
   void push_back_##Name(Name* list, T value);
 
 #define DEFINE_SELF_INDEXED_LIST(get_idx, release_data, T, Name)                                   \
-  DEFINE_INDEXED_LIST(release_data, T, Name)                                                       \
+  DEFINE_SELF_INDEXED_LIST_WITH(heap, get_idx, release_data, T, Name)
+
+#define DEFINE_SELF_INDEXED_LIST_WITH(A, get_idx, release_data, T, Name)                           \
+  DEFINE_INDEXED_LIST_WITH(A, release_data, T, Name)                                               \
   Name##Iterator* remove_##Name##Iterator(Name* list, Name##Iterator* iter) {                      \
     T v = data_##Name##Iterator(iter);                                                             \
     return remove_with_idx_##Name##Iterator(list, get_idx(v), iter);                               \
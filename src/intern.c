@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "mem_stats.h"
+
+typedef struct {
+  unsigned hash;
+  size_t length;
+  char data[];
+} Interned;
+
+// open addressing, power of two capacity
+static Interned** table;
+static unsigned capacity;
+static unsigned count;
+
+static unsigned hash_n(const char* s, size_t length) {
+  unsigned hash = 0;
+  for (size_t i = 0; i < length; i++) {
+    hash = s[i] + (hash << 6) + (hash << 16) - hash;
+  }
+  return hash;
+}
+
+static Interned* header_of(const char* s) {
+  return (Interned*)(s - offsetof(Interned, data));
+}
+
+static void grow() {
+  unsigned old_capacity = capacity;
+  Interned** old_table  = table;
+
+  capacity = old_capacity == 0 ? 1024 : old_capacity * 2;
+  table    = alloc_tagged(MEM_STRINGS, sizeof(Interned*) * capacity);
+  for (unsigned i = 0; i < old_capacity; i++) {
+    Interned* e = old_table[i];
+    if (e == NULL) {
+      continue;
+    }
+    unsigned idx = e->hash & (capacity - 1);
+    while (table[idx] != NULL) {
+      idx = (idx + 1) & (capacity - 1);
+    }
+    table[idx] = e;
+  }
+  free_tagged(MEM_STRINGS, old_table);
+}
+
+const char* intern_n(const char* s, size_t length) {
+  if ((count + 1) * 4 > capacity * 3) {
+    grow();
+  }
+
+  unsigned hash = hash_n(s, length);
+  unsigned idx  = hash & (capacity - 1);
+  Interned* e;
+  while ((e = table[idx]) != NULL) {
+    if (e->hash == hash && e->length == length && memcmp(e->data, s, length) == 0) {
+      return e->data;
+    }
+    idx = (idx + 1) & (capacity - 1);
+  }
+
+  e         = alloc_tagged(MEM_STRINGS, sizeof(Interned) + length + 1);
+  e->hash   = hash;
+  e->length = length;
+  memcpy(e->data, s, length);
+  e->data[length] = '\0';
+
+  table[idx] = e;
+  count++;
+  return e->data;
+}
+
+const char* intern(const char* s) {
+  return intern_n(s, strlen(s));
+}
+
+unsigned hash_interned(const char* s) {
+  return header_of(s)->hash;
+}
+
+size_t length_interned(const char* s) {
+  return header_of(s)->length;
+}
+
+void release_interned_strings() {
+  for (unsigned i = 0; i < capacity; i++) {
+    free_tagged(MEM_STRINGS, table[i]);
+  }
+  free_tagged(MEM_STRINGS, table);
+  table    = NULL;
+  capacity = 0;
+  count    = 0;
+}
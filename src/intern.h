@@ -0,0 +1,17 @@
+#ifndef CCC_INTERN_H
+#define CCC_INTERN_H
+
+#include <stddef.h>
+
+// each distinct spelling is stored once, so interned strings are compared by pointer
+// and carry their hash; they live until `release_interned_strings`
+const char* intern(const char*);
+const char* intern_n(const char*, size_t length);
+
+// of interned strings only
+unsigned hash_interned(const char*);
+size_t length_interned(const char*);
+
+void release_interned_strings();
+
+#endif
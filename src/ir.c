@@ -1,11 +1,17 @@
 #include "ir.h"
 #include "const_fold_tree.h"
 #include "error.h"
+#include "intern.h"
 #include "map.h"
+#include "mem_stats.h"
 #include "parser.h"
+#include "scoped_map.h"
+
+DEFINE_TAGGED_ALLOCATOR(ir, MEM_IR)
+DEFINE_TAGGED_ALLOCATOR(regs, MEM_REGS)
 
 Reg* new_Reg(RegKind kind, DataSize size) {
-  Reg* r  = calloc(1, sizeof(Reg));
+  Reg* r  = alloc_regs(sizeof(Reg));
   r->kind = kind;
   r->size = size;
   return r;
@@ -40,7 +46,7 @@ Reg* copy_Reg(Reg* r) {
 }
 
 IRInst* new_inst(unsigned local, unsigned global, IRInstKind kind) {
-  IRInst* i    = calloc(1, sizeof(IRInst));
+  IRInst* i    = alloc_ir(sizeof(IRInst));
   i->kind      = kind;
   i->local_id  = local;
   i->global_id = global;
@@ -55,26 +61,28 @@ void release_Reg(Reg* r) {
   }
 
   release_BitSet(r->definitions);
-  free(r);
+  free_regs(r);
 }
 
 void release_inst(IRInst* i) {
   release_RegVec(i->ras);
   release_Reg(i->rd);
-  release_BitSet(i->live_in);
-  release_BitSet(i->live_out);
-  release_BitSet(i->reach_in);
-  release_BitSet(i->reach_out);
-  free(i->global_name);
-  free(i);
+  free_ir(i);
 }
 
 static unsigned get_local_id(IRInst* inst) {
   return inst->local_id;
 }
-DEFINE_SELF_INDEXED_LIST(get_local_id, release_inst, IRInst*, IRInstList)
-DEFINE_RANGE(IRInst*, IRInstList, IRInstRange)
-DEFINE_VECTOR(release_Reg, Reg*, RegVec)
+DEFINE_SELF_INDEXED_LIST_WITH(ir, get_local_id, release_inst, IRInst*, IRInstList)
+DEFINE_RANGE_WITH(ir, IRInst*, IRInstList, IRInstRange)
+DEFINE_VECTOR_WITH(regs, release_Reg, Reg*, RegVec)
+
+void truncate_ras(IRInst* i, unsigned length) {
+  for (unsigned k = length; k < length_RegVec(i->ras); k++) {
+    release_Reg(get_RegVec(i->ras, k));
+  }
+  resize_RegVec(i->ras, length);
+}
 
 void release_BasicBlock(BasicBlock* bb) {
   if (bb == NULL) {
@@ -94,37 +102,41 @@ void release_BasicBlock(BasicBlock* bb) {
 
   release_BitSet(bb->should_preserve);
 
-  free(bb);
+  release_BBRefList(bb->succs);
+  release_BBRefList(bb->preds);
+  free_ir(bb);
 }
 
 DECLARE_MAP(BasicBlock*, BBMap)
-DEFINE_DLIST(release_BasicBlock, BasicBlock*, BBList)
+DEFINE_DLIST_WITH(ir, release_BasicBlock, BasicBlock*, BBList)
 static void release_ref(void* p) {}
-DEFINE_DLIST(release_ref, BasicBlock*, BBRefList)
+DEFINE_DLIST_WITH(ir, release_ref, BasicBlock*, BBRefList)
 DEFINE_VECTOR(release_BasicBlock, BasicBlock*, BBVec)
+DEFINE_VECTOR(release_ref, BasicBlock*, BBRefVec)
 DEFINE_VECTOR(release_BitSet, BitSet*, BSVec)
 
 static void release_Function(Function* f) {
-  free(f->name);
   release_BBList(f->blocks);
   release_IRInstList(f->instructions);
   release_RegIntervals(f->intervals);
   release_BitSet(f->used_fixed_regs);
+  release_BitSet(f->used_regs);
   release_BSVec(f->definitions);
-  free(f);
+  release_UIVec(f->vars);
+  free_ir(f);
 }
 
 DEFINE_LIST(release_Function, Function*, FunctionList)
 
-static GlobalVar* new_GlobalVar(char* name, GlobalInitializer* init) {
-  GlobalVar* v = calloc(1, sizeof(GlobalVar));
+static GlobalVar* new_GlobalVar(const char* name, GlobalInitializer* init) {
+  GlobalVar* v = alloc_ir(sizeof(GlobalVar));
   v->name      = name;
   v->init      = init;
   return v;
 }
 
 static GlobalExpr* new_GlobalExpr(GlobalExprKind kind) {
-  GlobalExpr* expr = calloc(1, sizeof(GlobalExpr));
+  GlobalExpr* expr = alloc_ir(sizeof(GlobalExpr));
   expr->kind       = kind;
   return expr;
 }
@@ -134,9 +146,7 @@ static void release_GlobalExpr(GlobalExpr* expr) {
     return;
   }
 
-  free(expr->lhs);
-  free(expr->string);
-  free(expr);
+  free_ir(expr);
 }
 
 DEFINE_LIST(release_GlobalExpr, GlobalExpr*, GlobalInitializer)
@@ -146,39 +156,47 @@ static void release_GlobalVar(GlobalVar* v) {
     return;
   }
 
-  free(v->name);
-  free(v);
+  free_ir(v);
 }
 
 DEFINE_VECTOR(release_GlobalVar, GlobalVar*, GlobalVarVec)
 
-typedef struct {
+struct IRGen {
   unsigned bb_count;
   unsigned inst_count;
   GlobalVarVec* globals;
-} GlobalEnv;
+
+  FunctionSink sink;  // NULL unless streaming
+  void* sink_data;
+};
+
+typedef IRGen GlobalEnv;
 
 static GlobalEnv* init_GlobalEnv() {
-  GlobalEnv* env = calloc(1, sizeof(GlobalEnv));
+  GlobalEnv* env = alloc_ir(sizeof(GlobalEnv));
   env->globals   = new_GlobalVarVec(16);
   return env;
 }
 
 static void release_GlobalEnv(GlobalEnv* env) {
-  free(env);
+  free_ir(env);
 }
 
 static void add_normal_gvar(GlobalEnv* env, const char* name, GlobalInitializer* init) {
-  GlobalVar* gv = new_GlobalVar(strdup(name), init);
+  GlobalVar* gv = new_GlobalVar(name, init);
   push_GlobalVarVec(env->globals, gv);
 }
 
 static void add_string_gvar(GlobalEnv* env, const char* name, const char* str) {
   GlobalExpr* expr = new_GlobalExpr(GE_STRING);
-  expr->string     = strdup(str);
+  expr->string     = str;
   add_normal_gvar(env, name, single_GlobalInitializer(expr));
 }
 
+static void release_unsigned(unsigned u) {}
+DECLARE_SCOPED_MAP(unsigned, ScopedUIMap)
+DEFINE_SCOPED_MAP(release_unsigned, unsigned, ScopedUIMap)
+
 typedef struct {
   unsigned reg_count;
   unsigned stack_count;
@@ -187,9 +205,10 @@ typedef struct {
 
   unsigned call_count;
 
-  UIMap* vars;
+  ScopedUIMap* vars;
+  UIVec* var_offsets;
   BBList* blocks;
-  BBVec* labels;
+  BBRefVec* labels;
   UIMap* named_labels;
 
   BasicBlock* entry;
@@ -212,7 +231,7 @@ static BasicBlock* new_bb(Env* env) {
   unsigned local_id  = env->bb_count++;
   unsigned global_id = env->global_env->bb_count++;
 
-  BasicBlock* bb   = calloc(1, sizeof(BasicBlock));
+  BasicBlock* bb   = alloc_ir(sizeof(BasicBlock));
   bb->local_id     = local_id;
   bb->global_id    = global_id;
   bb->instructions = new_unchecked_IRInstRange(NULL, NULL);
@@ -225,17 +244,18 @@ static BasicBlock* new_bb(Env* env) {
 }
 
 static Env* new_env(GlobalEnv* genv, FunctionDef* f) {
-  Env* env        = calloc(1, sizeof(Env));
-  env->global_env = genv;
-  env->vars       = new_UIMap(32);
-  env->blocks     = new_BBList();
+  Env* env         = alloc_ir(sizeof(Env));
+  env->global_env  = genv;
+  env->vars        = new_ScopedUIMap(32);
+  env->var_offsets = new_UIVec(8);
+  env->blocks      = new_BBList();
 
   env->exit = new_bb(env);
 
   env->named_labels = f->named_labels;
-  env->labels       = new_BBVec(f->label_count);
+  env->labels       = new_BBRefVec(f->label_count);
   for (unsigned i = 0; i < f->label_count; i++) {
-    push_BBVec(env->labels, new_bb(env));
+    push_BBRefVec(env->labels, new_bb(env));
   }
 
   env->instructions = new_IRInstList(64);
@@ -264,7 +284,7 @@ static void start_bb(Env* env, BasicBlock* bb) {
 }
 
 static BasicBlock* get_label(Env* env, unsigned id) {
-  return get_BBVec(env->labels, id);
+  return get_BBRefVec(env->labels, id);
 }
 
 static BasicBlock* get_named_label(Env* env, const char* name) {
@@ -280,19 +300,20 @@ static Reg* new_reg(Env* env, DataSize size) {
   return new_virtual_Reg(size, env->reg_count++);
 }
 
-static unsigned new_var(Env* env, char* name, unsigned size) {
-  if (lookup_UIMap(env->vars, name, NULL)) {
+static unsigned new_var(Env* env, const char* name, unsigned size) {
+  if (lookup_local_ScopedUIMap(env->vars, name, NULL)) {
     error("redeclaration of \"%s\"", name);
   }
 
   env->stack_count += size;
   unsigned i = env->stack_count;
-  insert_UIMap(env->vars, name, i);
+  insert_ScopedUIMap(env->vars, name, i);
+  push_UIVec(env->var_offsets, i);
   return i;
 }
 
-static bool get_var(Env* env, char* name, unsigned* dest) {
-  return lookup_UIMap(env->vars, name, dest);
+static bool get_var(Env* env, const char* name, unsigned* dest) {
+  return lookup_ScopedUIMap(env->vars, name, dest);
 }
 
 static Reg* new_binop(Env* env, BinaryOp op, Reg* lhs, Reg* rhs) {
@@ -440,11 +461,13 @@ static Reg* nth_arg(Env* env, unsigned nth, DataSize size) {
   return r;
 }
 
-static void new_move(Env* env, Reg* d, Reg* s) {
+// returns the copy of `d` owned by the move
+static Reg* new_move(Env* env, Reg* d, Reg* s) {
   IRInst* i = new_inst_(env, IR_MOV);
   push_RegVec(i->ras, copy_Reg(s));
   i->rd = copy_Reg(d);
   add_inst(env, i);
+  return i->rd;
 }
 
 static void new_jump(Env* env, BasicBlock* jump, BasicBlock* next);
@@ -564,26 +587,24 @@ static Reg* new_global(Env* env, const char* name, GlobalNameKind kind) {
   Reg* r            = new_reg(env, SIZE_QWORD);  // TODO: hardcoded pointer size
   IRInst* inst      = new_inst_(env, IR_GLOBAL_ADDR);
   inst->rd          = r;
-  inst->global_name = strdup(name);
+  inst->global_name = name;
   inst->global_kind = kind;
   add_inst(env, inst);
   return r;
 }
 
-static char* new_named_string(GlobalEnv* env, const char* str) {
+static const char* new_named_string(GlobalEnv* env, const char* str) {
   unsigned i = length_GlobalVarVec(env->globals);
   // TODO: allocate accurate length of string
-  char name[10];
-  sprintf(name, "_s_%d", i);
+  char buf[10];
+  sprintf(buf, "_s_%d", i);
+  const char* name = intern(buf);
   add_string_gvar(env, name, str);
-  return strdup(name);
+  return name;
 }
 
 static Reg* new_string(Env* env, const char* str) {
-  char* name = new_named_string(env->global_env, str);
-  Reg* r     = new_global(env, name, GN_DATA);
-  free(name);
-  return r;
+  return new_global(env, new_named_string(env->global_env, str), GN_DATA);
 }
 
 static Reg* gen_expr(Env* env, Expr* node);
@@ -774,12 +795,11 @@ Reg* gen_expr(Env* env, Expr* node) {
 
       // else
       Reg* else_ = gen_expr(env, node->else_);
-      new_move(env, r, else_);
+      Reg* rd    = new_move(env, r, else_);
       new_jump(env, next_bb, next_bb);
+      release_Reg(r);
 
-      // TODO: `r` is leaked
-
-      return r;
+      return rd;
     }
     case ND_SIZEOF_TYPE:
     case ND_SIZEOF_EXPR:
@@ -803,18 +823,12 @@ BasicBlock* set_continue(Env* env, BasicBlock* continue_) {
 
 void gen_block_item_list(Env* env, BlockItemList* ast);
 
-static UIMap* start_scope(Env* env) {
-  UIMap* save = env->vars;
-  UIMap* inst = shallow_copy_UIMap(env->vars);
-
-  env->vars = inst;
-
-  return save;
+static void start_scope(Env* env) {
+  start_scope_ScopedUIMap(env->vars);
 }
 
-static void end_scope(Env* env, UIMap* save) {
-  release_UIMap(env->vars);
-  env->vars = save;
+static void end_scope(Env* env) {
+  end_scope_ScopedUIMap(env->vars);
 }
 
 static void gen_decl(Env* env, Declaration* decl);
@@ -898,7 +912,7 @@ static void gen_stmt(Env* env, Statement* stmt) {
       BasicBlock* old_break    = set_break(env, next_bb);
       BasicBlock* old_continue = set_continue(env, cont_bb);
 
-      UIMap* save = start_scope(env);
+      start_scope(env);
       if (stmt->init_decl != NULL) {
         gen_decl(env, stmt->init_decl);
       } else if (stmt->init != NULL) {
@@ -913,7 +927,7 @@ static void gen_stmt(Env* env, Statement* stmt) {
       if (stmt->after != NULL) {
         gen_expr(env, stmt->after);
       }
-      end_scope(env, save);
+      end_scope(env);
       new_jump(env, for_bb, next_bb);
 
       set_break(env, old_break);
@@ -941,9 +955,9 @@ static void gen_stmt(Env* env, Statement* stmt) {
     }
     case ST_COMPOUND: {
       // compound statement is a block
-      UIMap* save = start_scope(env);
+      start_scope(env);
       gen_block_item_list(env, stmt->items);
-      end_scope(env, save);
+      end_scope(env);
       break;
     }
     case ST_LABEL:
@@ -999,7 +1013,7 @@ static GlobalExpr* translate_initializer_lhs(GlobalEnv* env, Expr* expr) {
   switch (expr->kind) {
     case ND_VAR: {
       GlobalExpr* e = new_GlobalExpr(GE_NAME);
-      e->name       = strdup(expr->var);
+      e->name       = expr->var;
       return e;
     }
     case ND_STRING: {
@@ -1016,7 +1030,7 @@ static GlobalExpr* translate_initializer_expr(GlobalEnv* env, Expr* expr) {
   switch (expr->kind) {
     case ND_STRING: {
       GlobalExpr* e = new_GlobalExpr(GE_STRING);
-      e->string     = strdup(expr->string);
+      e->string     = expr->string;
       return e;
     }
     case ND_ADDR:
@@ -1183,14 +1197,11 @@ static void gen_params(Env* env, FunctionDef* f, unsigned nth, ParamList* l) {
     return;
   }
 
-  char* name    = head_ParamList(l)->decl->direct->name_ref;
-  Type* ty      = get_TypeVec(f->type->params, nth);
-  unsigned size = sizeof_ty(ty);
-  new_var(env, name, size);
-
-  unsigned addr;
-  get_var(env, name, &addr);
-  Reg* addr_reg = new_stack_addr(env, addr);
+  const char* name = head_ParamList(l)->decl->direct->name_ref;
+  Type* ty         = get_TypeVec(f->type->params, nth);
+  unsigned size    = sizeof_ty(ty);
+  unsigned addr    = new_var(env, name, size);
+  Reg* addr_reg    = new_stack_addr(env, addr);
 
   Reg* rhs = nth_arg(env, nth, to_data_size(size));
   new_store(env, addr_reg, rhs, to_data_size(size));
@@ -1213,52 +1224,80 @@ static Function* gen_function(GlobalEnv* genv, FunctionDef* ast) {
   new_exit_ret(env);
   env->cur->instructions->to = back_IRInstList(env->instructions);
 
-  Function* ir     = calloc(1, sizeof(Function));
-  ir->name         = strdup(ast->decl->direct->name_ref);
+  Function* ir     = alloc_ir(sizeof(Function));
+  ir->name         = ast->decl->direct->name_ref;
   ir->entry        = env->entry;
   ir->exit         = env->cur;
   ir->bb_count     = env->bb_count;
   ir->reg_count    = env->reg_count;
   ir->stack_count  = env->stack_count;
+  ir->vars         = env->var_offsets;
   ir->inst_count   = env->inst_count;
   ir->call_count   = env->call_count;
   ir->blocks       = env->blocks;
   ir->instructions = env->instructions;
 
   // TODO: shallow release of containers
-  free(env);
+  release_ScopedUIMap(env->vars);
+  release_BBRefVec(env->labels);
+  free_ir(env);
   return ir;
 }
 
-static FunctionList* gen_TranslationUnit(GlobalEnv* genv, FunctionList* acc, TranslationUnit* l) {
-  if (is_nil_TranslationUnit(l)) {
-    return acc;
-  }
+// hand `f` over to the sink and release it
+static void sink_function(GlobalEnv* genv, Function* f) {
+  IR* part         = alloc_ir(sizeof(IR));
+  part->functions  = single_FunctionList(f);
+  part->inst_count = genv->inst_count;
+  part->bb_count   = genv->bb_count;
+  part->globals    = NULL;
 
-  ExternalDecl* d       = head_TranslationUnit(l);
-  TranslationUnit* tail = tail_TranslationUnit(l);
+  genv->sink(part, genv->sink_data);
+
+  // ids allocated by passes stay unique among functions
+  genv->inst_count = part->inst_count;
+  genv->bb_count   = part->bb_count;
+  release_IR(part);
+}
+
+// the function defined by `d`, unless it is not a function definition or is handed to the sink
+static Function* gen_external_decl(GlobalEnv* genv, ExternalDecl* d) {
   switch (d->kind) {
     case EX_FUNC: {
       Function* f = gen_function(genv, d->func);
-      return gen_TranslationUnit(genv, cons_FunctionList(f, acc), tail);
+      if (genv->sink != NULL) {
+        sink_function(genv, f);
+        return NULL;
+      }
+      return f;
     }
     case EX_FUNC_DECL:
-      return gen_TranslationUnit(genv, acc, tail);
+      return NULL;
     case EX_DECL:
       if (!d->decl->spec->is_typedef) {
         gen_init_decl_list(NULL, genv, d->decl->spec, d->decl->declarators);
       }
-      return gen_TranslationUnit(genv, acc, tail);
+      return NULL;
     default:
       CCC_UNREACHABLE;
   }
 }
 
-IR* generate_IR(AST* ast) {
-  GlobalEnv* genv = init_GlobalEnv();
+static FunctionList* gen_TranslationUnit(GlobalEnv* genv, FunctionList* acc, TranslationUnit* l) {
+  if (is_nil_TranslationUnit(l)) {
+    return acc;
+  }
 
-  IR* ir         = calloc(1, sizeof(IR));
-  ir->functions  = gen_TranslationUnit(genv, nil_FunctionList(), ast);
+  Function* f = gen_external_decl(genv, head_TranslationUnit(l));
+  if (f != NULL) {
+    acc = cons_FunctionList(f, acc);
+  }
+  return gen_TranslationUnit(genv, acc, tail_TranslationUnit(l));
+}
+
+static IR* finish_GlobalEnv(GlobalEnv* genv, FunctionList* functions) {
+  IR* ir         = alloc_ir(sizeof(IR));
+  ir->functions  = functions;
   ir->inst_count = genv->inst_count;
   ir->bb_count   = genv->bb_count;
   ir->globals    = genv->globals;
@@ -1268,9 +1307,82 @@ IR* generate_IR(AST* ast) {
   return ir;
 }
 
+IR* generate_IR(AST* ast) {
+  GlobalEnv* genv = init_GlobalEnv();
+  return finish_GlobalEnv(genv, gen_TranslationUnit(genv, nil_FunctionList(), ast));
+}
+
+IRGen* new_IRGen(FunctionSink sink, void* data) {
+  GlobalEnv* genv = init_GlobalEnv();
+  genv->sink      = sink;
+  genv->sink_data = data;
+  return genv;
+}
+
+void generate_IR_decl(IRGen* gen, ExternalDecl* d) {
+  gen_external_decl(gen, d);
+}
+
+IR* finish_IRGen(IRGen* gen) {
+  return finish_GlobalEnv(gen, nil_FunctionList());
+}
+
 void release_IR(IR* ir) {
   release_FunctionList(ir->functions);
   release_GlobalVarVec(ir->globals);
+  free_ir(ir);
+}
+
+IR* function_IR_part(const IR* ir, Function* f) {
+  IR* part         = alloc_ir(sizeof(IR));
+  part->functions  = single_FunctionList(f);
+  part->inst_count = ir->inst_count;
+  part->bb_count   = ir->bb_count;
+  part->globals    = NULL;
+  return part;
+}
+
+static void release_IR_part(IR* part) {
+  // `Function` is owned by the original `IR`
+  free_heap(part->functions->tail);
+  free_heap(part->functions);
+  free_ir(part);
+}
+
+void join_IR_parts(IR* ir, IR** parts) {
+  // ids up to `ir->inst_count` are shared by all parts; the ones allocated after are shifted
+  // the same goes for blocks
+  unsigned base      = ir->inst_count;
+  unsigned offset    = 0;
+  unsigned bb_base   = ir->bb_count;
+  unsigned bb_offset = 0;
+  unsigned i         = 0;
+  for (FunctionList* l = ir->functions; !is_nil_FunctionList(l); l = tail_FunctionList(l), i++) {
+    IR* part    = parts[i];
+    Function* f = head_FunctionList(l);
+    assert(head_FunctionList(part->functions) == f);
+
+    for (IRInstListIterator* it = front_IRInstList(f->instructions);
+         !is_nil_IRInstListIterator(it); it = next_IRInstListIterator(it)) {
+      IRInst* inst = data_IRInstListIterator(it);
+      if (inst->global_id >= base) {
+        inst->global_id += offset;
+      }
+    }
+    for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
+         it                 = next_BBListIterator(it)) {
+      BasicBlock* b = data_BBListIterator(it);
+      if (b->global_id >= bb_base) {
+        b->global_id += bb_offset;
+      }
+    }
+    offset += part->inst_count - base;
+    bb_offset += part->bb_count - bb_base;
+
+    release_IR_part(part);
+  }
+  ir->inst_count = base + offset;
+  ir->bb_count   = bb_base + bb_offset;
 }
 
 void connect_BasicBlock(BasicBlock* from, BasicBlock* to) {
@@ -1283,6 +1395,50 @@ void disconnect_BasicBlock(BasicBlock* from, BasicBlock* to) {
   erase_one_BBRefList(to->preds, from);
 }
 
+static BasicBlock* retarget(BasicBlock* target, BasicBlock* from, BasicBlock* to) {
+  return target == from ? to : target;
+}
+
+BasicBlock* split_edge(Function* f,
+                       unsigned* global_inst_count,
+                       unsigned* global_bb_count,
+                       BasicBlock* from,
+                       BasicBlock* to) {
+  BasicBlock* bb = alloc_ir(sizeof(BasicBlock));
+  bb->local_id   = f->bb_count++;
+  bb->global_id  = (*global_bb_count)++;
+  bb->succs      = new_BBRefList();
+  bb->preds      = new_BBRefList();
+
+  IRInst* label = new_inst(f->inst_count++, (*global_inst_count)++, IR_LABEL);
+  label->label  = bb;
+  IRInst* jump  = new_inst(f->inst_count++, (*global_inst_count)++, IR_JUMP);
+  jump->jump    = to;
+  push_back_IRInstList(f->instructions, label);
+  IRInstListIterator* label_it = back_IRInstList(f->instructions);
+  push_back_IRInstList(f->instructions, jump);
+  bb->instructions = new_IRInstRange(label_it, back_IRInstList(f->instructions));
+  push_back_BBList(f->blocks, bb);
+
+  // `from` may branch to `to` on both sides
+  IRInst* last = last_IRInstRange(from->instructions);
+  last->jump   = retarget(last->jump, to, bb);
+  last->then_  = retarget(last->then_, to, bb);
+  last->else_  = retarget(last->else_, to, bb);
+
+  unsigned edges = 0;
+  for (BBRefListIterator* it = front_BBRefList(from->succs); !is_nil_BBRefListIterator(it);
+       it                    = next_BBRefListIterator(it)) {
+    edges += data_BBRefListIterator(it) == to;
+  }
+  for (unsigned i = 0; i < edges; i++) {
+    disconnect_BasicBlock(from, to);
+  }
+  connect_BasicBlock(from, bb);
+  connect_BasicBlock(bb, to);
+  return bb;
+}
+
 void detach_BasicBlock(Function* f, BasicBlock* b) {
   // detach a block from IR and release it safely.
   // - check entry/exit
@@ -1462,21 +1618,21 @@ static void print_inst(FILE* p, IRInst* i) {
 }
 
 // NOTE: printers below are to print CFG in dot language
-static unsigned print_graph_insts(FILE* p, IRInstRangeIterator* it) {
-  IRInst* i1             = data_IRInstRangeIterator(it);
-  IRInstRangeIterator* t = next_IRInstRangeIterator(it);
+static unsigned print_graph_insts(FILE* p, IRInstRange* r, IRInstListIterator* it) {
+  IRInst* i1 = data_IRInstListIterator(it);
 
   fprintf(p, "inst_%d [shape=record,fontname=monospace,label=\"%d|", i1->global_id, i1->local_id);
   print_inst(p, i1);
   fputs("\"];\n", p);
 
-  if (is_nil_IRInstRangeIterator(t)) {
+  if (it == r->to) {
     return i1->global_id;
   }
 
-  IRInst* i2 = data_IRInstRangeIterator(t);
+  IRInstListIterator* t = next_IRInstListIterator(it);
+  IRInst* i2            = data_IRInstListIterator(t);
   fprintf(p, "inst_%d -> inst_%d;\n", i1->global_id, i2->global_id);
-  return print_graph_insts(p, t);
+  return print_graph_insts(p, r, t);
 }
 
 static void print_graph_bb(FILE* p, BasicBlock* bb);
@@ -1517,7 +1673,7 @@ static void print_graph_bb(FILE* p, BasicBlock* bb) {
 
   fprintf(p, "\";\n");
 
-  unsigned last_id = print_graph_insts(p, front_IRInstRange(bb->instructions));
+  unsigned last_id = print_graph_insts(p, bb->instructions, bb->instructions->from);
 
   fputs("}\n", p);
   print_graph_succs(p, last_id, front_BBRefList(bb->succs));
@@ -1548,13 +1704,29 @@ void print_IR(FILE* p, IR* ir) {
   // TODO: print `ir->globals`
 }
 
+static void release_LiveRange(LiveRange r) {}
+DEFINE_VECTOR_WITH(regs, release_LiveRange, LiveRange, LiveRanges)
+
 static void release_Interval(Interval* iv) {
-  free(iv);
+  if (iv == NULL) {
+    return;
+  }
+  release_LiveRanges(iv->ranges);
+  release_UIVec(iv->uses);
+  release_Interval(iv->next);
+  free_regs(iv);
 }
-DEFINE_VECTOR(release_Interval, Interval*, RegIntervals)
+DEFINE_VECTOR_WITH(regs, release_Interval, Interval*, RegIntervals)
 
 static void print_Interval(FILE* p, Interval* iv) {
-  fprintf(p, "[%d, %d]", iv->from, iv->to);
+  for (unsigned i = 0; i < length_LiveRanges(iv->ranges); i++) {
+    LiveRange r = get_LiveRanges(iv->ranges, i);
+    fprintf(p, "%s[%d, %d)", i == 0 ? "" : " ", r.from, r.to);
+  }
+  if (iv->next != NULL) {
+    fprintf(p, " | ");
+    print_Interval(p, iv->next);
+  }
 }
 
 void print_Intervals(FILE* p, RegIntervals* v) {
@@ -90,7 +90,7 @@ struct IRInst {
   unsigned argument_idx;   // for IR_ARG
   DataSize data_size;      // for IR_{LOAD, STORE, STACK_LOAD, STACK_STORE}
 
-  char* global_name;           // for IR_GLOBAL, owned
+  const char* global_name;     // for IR_GLOBAL, interned
   GlobalNameKind global_kind;  // for IR_GLOBAL
 
   BasicBlock* label;  // for IR_LABEL, not owned
@@ -104,16 +104,12 @@ struct IRInst {
 
   Reg* rd;      // destination register (null if unused)
   RegVec* ras;  // argument registers (won't be null)
-
-  // will filled in `data_flow`
-  BitSet* live_in;    // owned, NULL before analysis
-  BitSet* live_out;   // owned, ditto
-  BitSet* reach_in;   // owned, ditto
-  BitSet* reach_out;  // owned, ditto
 };
 
 IRInst* new_inst(unsigned local_id, unsigned global_id, IRInstKind);
 void release_inst(IRInst*);
+// release the argument registers of the instruction from the `length`-th on
+void truncate_ras(IRInst*, unsigned length);
 
 DECLARE_DLIST(BasicBlock*, BBList)
 DECLARE_DLIST(BasicBlock*, BBRefList)
@@ -155,6 +151,12 @@ typedef struct Function Function;
 void detach_BasicBlock(Function*, BasicBlock*);
 void connect_BasicBlock(BasicBlock* from, BasicBlock* to);
 void disconnect_BasicBlock(BasicBlock* from, BasicBlock* to);
+// insert an empty block on the edge, placed at the end of `f`; ids are taken from the counters
+BasicBlock* split_edge(Function* f,
+                       unsigned* global_inst_count,
+                       unsigned* global_bb_count,
+                       BasicBlock* from,
+                       BasicBlock* to);
 void release_BasicBlock(BasicBlock*);
 
 typedef enum {
@@ -163,25 +165,45 @@ typedef enum {
   IV_FIXED,
 } IntervalKind;
 
+// positions number instructions in the order of blocks, two for each:
+// operands of the k-th instruction are read at 2k, and its result is written at 2k + 1
 typedef struct {
+  unsigned from;
+  unsigned to;  // exclusive
+} LiveRange;
+
+DECLARE_VECTOR(LiveRange, LiveRanges)
+
+typedef struct Interval Interval;
+
+struct Interval {
   IntervalKind kind;
+  unsigned virtual;
 
-  // -1 for undefined
+  // bounds of `ranges`, -1 for undefined
   // TODO: stop using -1 to indicate undefined value
   unsigned from;
-  unsigned to;
+  unsigned to;  // exclusive
+
+  LiveRanges* ranges;  // owned, ascending and disjoint; gaps between them are lifetime holes
+  UIVec* uses;         // owned, positions where the register is read or written, ascending
 
   unsigned fixed_real;  // for IV_FIXED
-} Interval;
+
+  // will filled in `reg_alloc`
+  unsigned real;   // -1 -> on the stack
+  Interval* next;  // owned, the rest split off from this, NULL if not split
+};
 
 DECLARE_VECTOR(Interval*, RegIntervals)
 void print_Intervals(FILE*, RegIntervals*);
 
 DECLARE_VECTOR(BasicBlock*, BBVec)
+DECLARE_VECTOR(BasicBlock*, BBRefVec)
 DECLARE_VECTOR(BitSet*, BSVec)
 
 struct Function {
-  char* name;  // owned
+  const char* name;  // interned
 
   BBList* blocks;            // owned
   IRInstList* instructions;  // owned
@@ -191,6 +213,10 @@ struct Function {
   unsigned stack_count;
   unsigned inst_count;
 
+  // `stack_idx` of local variables in the order of allocation
+  // each variable takes the bytes after the previous one, until `reg_alloc` lays out the frame
+  UIVec* vars;  // owned
+
   BasicBlock* entry;  // not owned
   BasicBlock* exit;   // not owend
 
@@ -202,7 +228,7 @@ struct Function {
   // will filled in `data_flow`
   BSVec* definitions;  // owned, virtual -> inst local id
 
-  // will filled in `liveness`
+  // will filled in `reg_alloc`
   RegIntervals* intervals;  // owned
 
   // will filled in `reg_alloc`
@@ -223,21 +249,21 @@ typedef enum {
 typedef struct {
   GlobalExprKind kind;
 
-  char* lhs;  // for GE_ADD, GE_SUB, owned
-  long rhs;   // ditto
+  const char* lhs;  // for GE_ADD, GE_SUB, interned
+  long rhs;         // ditto
 
-  char* name;  // for GE_NAME, owned
+  const char* name;  // for GE_NAME, interned
 
   long num;       // for GE_NUM
   DataSize size;  // for GE_NUM
 
-  char* string;  // for GE_STRING
+  const char* string;  // for GE_STRING, interned
 } GlobalExpr;
 
 DECLARE_LIST(GlobalExpr*, GlobalInitializer)
 
 typedef struct {
-  char* name;  // owned
+  const char* name;  // interned
   GlobalInitializer* init;
 } GlobalVar;
 
@@ -254,9 +280,30 @@ typedef struct {
 // build IR from ast
 IR* generate_IR(AST* ast);
 
+// called with each function in an IR of its own, on which passes can run as on `function_IR_part`
+typedef void (*FunctionSink)(IR* part, void* data);
+
+// builds IR one external declaration at a time, handing each function to `sink` as soon as it is
+// built and releasing it once `sink` returns
+typedef struct IRGen IRGen;
+
+IRGen* new_IRGen(FunctionSink sink, void* data);
+void generate_IR_decl(IRGen*, ExternalDecl*);
+// an IR without functions, whose globals (including string literals) are complete
+IR* finish_IRGen(IRGen*);
+
 // free the memory space used in IR
 void release_IR(IR*);
 
+// an IR holding `f` of `ir` alone, on which passes can run independently of other functions
+// global ids allocated in it may collide with the ones in other parts until `join_IR_parts`
+IR* function_IR_part(const IR* ir, Function* f);
+
+// make global ids allocated in `parts` unique again and release the parts, which have been made
+// by `function_IR_part` from each function of `ir` in order
+// the ids only depend on the order of `parts`, not on the order they have been processed in
+void join_IR_parts(IR* ir, IR** parts);
+
 // print for debugging purpose
 void print_IR(FILE*, IR*);
 
@@ -0,0 +1,843 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "error.h"
+#include "intern.h"
+#include "ir_text.h"
+#include "mem_stats.h"
+
+static const char* kind_names[] = {
+    [IR_BIN] = "BIN",
+    [IR_UNA] = "UNA",
+    [IR_IMM] = "IMM",
+    [IR_CMP] = "CMP",
+    [IR_ARG] = "ARG",
+    [IR_RET] = "RET",
+    [IR_STACK_ADDR] = "STACK_ADDR",
+    [IR_STACK_STORE] = "STACK_STORE",
+    [IR_STACK_LOAD] = "STACK_LOAD",
+    [IR_STORE] = "STORE",
+    [IR_LOAD] = "LOAD",
+    [IR_MOV] = "MOV",
+    [IR_BR] = "BR",
+    [IR_JUMP] = "JUMP",
+    [IR_LABEL] = "LABEL",
+    [IR_CALL] = "CALL",
+    [IR_SEXT] = "SEXT",
+    [IR_ZEXT] = "ZEXT",
+    [IR_TRUNC] = "TRUNC",
+    [IR_GLOBAL_ADDR] = "GLOBAL_ADDR",
+    [IR_BIN_IMM] = "BIN_IMM",
+    [IR_CMP_IMM] = "CMP_IMM",
+    [IR_BR_CMP] = "BR_CMP",
+    [IR_BR_CMP_IMM] = "BR_CMP_IMM",
+};
+
+#define NUM_KINDS (sizeof(kind_names) / sizeof(kind_names[0]))
+
+static void write_reg(FILE* p, Reg* r) {
+  if (r == NULL) {
+    fputs("_", p);
+    return;
+  }
+
+  switch (r->kind) {
+    case REG_VIRT:
+      fputc('v', p);
+      break;
+    case REG_REAL:
+      fputc('r', p);
+      break;
+    case REG_FIXED:
+      fputc('f', p);
+      break;
+    default:
+      CCC_UNREACHABLE;
+  }
+  fprintf(p, "%u", r->virtual);
+  if (r->real != 0) {
+    fprintf(p, ":%u", r->real);
+  }
+  fprintf(p, ".%d", r->size);
+  if (r->sticky) {
+    fputc('!', p);
+  }
+}
+
+static void write_inst(FILE* p, IRInst* inst) {
+  fprintf(p, "  %u %u %s", inst->local_id, inst->global_id, kind_names[inst->kind]);
+
+  if (inst->binary_op != 0) {
+    fprintf(p, " op=%d", inst->binary_op);
+  }
+  if (inst->unary_op != 0) {
+    fprintf(p, " una=%d", inst->unary_op);
+  }
+  if (inst->predicate_op != 0) {
+    fprintf(p, " pred=%d", inst->predicate_op);
+  }
+  if (inst->imm != 0) {
+    fprintf(p, " imm=%d", inst->imm);
+  }
+  if (inst->stack_idx != 0) {
+    fprintf(p, " stack=%u", inst->stack_idx);
+  }
+  if (inst->argument_idx != 0) {
+    fprintf(p, " arg=%u", inst->argument_idx);
+  }
+  if (inst->data_size != 0) {
+    fprintf(p, " size=%d", inst->data_size);
+  }
+  if (inst->global_name != NULL) {
+    fprintf(p, " global=%s", inst->global_name);
+  }
+  if (inst->global_kind != 0) {
+    fprintf(p, " gkind=%d", inst->global_kind);
+  }
+  if (inst->label != NULL) {
+    fprintf(p, " label=%u", inst->label->local_id);
+  }
+  if (inst->jump != NULL) {
+    fprintf(p, " jump=%u", inst->jump->local_id);
+  }
+  if (inst->then_ != NULL) {
+    fprintf(p, " then=%u", inst->then_->local_id);
+  }
+  if (inst->else_ != NULL) {
+    fprintf(p, " else=%u", inst->else_->local_id);
+  }
+  if (inst->is_vararg) {
+    fputs(" vararg=1", p);
+  }
+  if (inst->rd != NULL) {
+    fputs(" rd=", p);
+    write_reg(p, inst->rd);
+  }
+  if (length_RegVec(inst->ras) != 0) {
+    fputs(" ras=", p);
+    for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
+      if (i != 0) {
+        fputc(',', p);
+      }
+      write_reg(p, get_RegVec(inst->ras, i));
+    }
+  }
+  fputc('\n', p);
+}
+
+static void write_block_refs(FILE* p, const char* name, BBRefList* l) {
+  fprintf(p, " %s", name);
+  for (BBRefListIterator* it = front_BBRefList(l); !is_nil_BBRefListIterator(it);
+       it                    = next_BBRefListIterator(it)) {
+    fprintf(p, " %u", data_BBRefListIterator(it)->local_id);
+  }
+}
+
+static void write_block(FILE* p, BasicBlock* bb) {
+  fprintf(p, "  block %u %u", bb->local_id, bb->global_id);
+
+  IRInstRange* r = bb->instructions;
+  if (r->from == NULL) {
+    fputs(" -", p);
+  } else {
+    fprintf(p, " %u", data_IRInstListIterator(r->from)->local_id);
+  }
+  if (r->to == NULL) {
+    fputs(" -", p);
+  } else {
+    fprintf(p, " %u", data_IRInstListIterator(r->to)->local_id);
+  }
+
+  if (bb->is_call_bb) {
+    fputs(" call", p);
+  }
+  write_block_refs(p, "succs", bb->succs);
+  write_block_refs(p, "preds", bb->preds);
+  fputc('\n', p);
+}
+
+static void write_Function(FILE* p, Function* f) {
+  fprintf(p, "function %s %u %u %u %u %u %u %u %u\n", f->name, f->bb_count, f->reg_count,
+          f->stack_count, f->inst_count, f->call_count, f->entry->local_id, f->exit->local_id,
+          capacity_IRInstList(f->instructions));
+
+  if (f->used_fixed_regs != NULL) {
+    fprintf(p, "  fixed_regs %u", length_BitSet(f->used_fixed_regs));
+    for (unsigned i = 0; i < length_BitSet(f->used_fixed_regs); i++) {
+      if (get_BitSet(f->used_fixed_regs, i)) {
+        fprintf(p, " %u", i);
+      }
+    }
+    fputc('\n', p);
+  }
+
+  fputs("  vars", p);
+  for (unsigned i = 0; i < length_UIVec(f->vars); i++) {
+    fprintf(p, " %u", get_UIVec(f->vars, i));
+  }
+  fputc('\n', p);
+
+  for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
+       it                 = next_BBListIterator(it)) {
+    write_block(p, data_BBListIterator(it));
+  }
+  for (IRInstListIterator* it = front_IRInstList(f->instructions); !is_nil_IRInstListIterator(it);
+       it                     = next_IRInstListIterator(it)) {
+    write_inst(p, data_IRInstListIterator(it));
+  }
+  fputs("end\n", p);
+}
+
+static void write_string(FILE* p, const char* s) {
+  fputc('"', p);
+  size_t len = length_interned(s);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\' || !isprint(c)) {
+      fprintf(p, "\\x%02x", c);
+    } else {
+      fputc(c, p);
+    }
+  }
+  fputc('"', p);
+}
+
+static void write_GlobalExpr(FILE* p, GlobalExpr* e) {
+  switch (e->kind) {
+    case GE_ADD:
+      fprintf(p, "  add %s %ld\n", e->lhs, e->rhs);
+      return;
+    case GE_SUB:
+      fprintf(p, "  sub %s %ld\n", e->lhs, e->rhs);
+      return;
+    case GE_NAME:
+      fprintf(p, "  name %s\n", e->name);
+      return;
+    case GE_NUM:
+      fprintf(p, "  num %d %ld\n", e->size, e->num);
+      return;
+    case GE_STRING:
+      fputs("  string ", p);
+      write_string(p, e->string);
+      fputc('\n', p);
+      return;
+    default:
+      CCC_UNREACHABLE;
+  }
+}
+
+void write_IR(FILE* p, IR* ir) {
+  fprintf(p, "ccc-ir %u %u\n", ir->inst_count, ir->bb_count);
+
+  for (unsigned i = 0; i < length_GlobalVarVec(ir->globals); i++) {
+    GlobalVar* v = get_GlobalVarVec(ir->globals, i);
+    fprintf(p, "global %s\n", v->name);
+    for (GlobalInitializer* l = v->init; !is_nil_GlobalInitializer(l);
+         l                    = tail_GlobalInitializer(l)) {
+      write_GlobalExpr(p, head_GlobalInitializer(l));
+    }
+  }
+
+  for (FunctionList* l = ir->functions; !is_nil_FunctionList(l); l = tail_FunctionList(l)) {
+    write_Function(p, head_FunctionList(l));
+  }
+}
+
+typedef struct {
+  const char* cur;
+  unsigned line;
+  unsigned inst_count;   // of the header
+  unsigned bb_count;     // of the header
+  unsigned reg_count;    // of the function being read
+  unsigned stack_count;  // of the function being read
+  unsigned* reg_uses;    // of the function being read, by virtual register (see `read_reg`)
+} Reader;
+
+static void skip_spaces(Reader* r) {
+  while (*r->cur == ' ') {
+    r->cur++;
+  }
+}
+
+static bool at_eol(Reader* r) {
+  skip_spaces(r);
+  return *r->cur == '\n' || *r->cur == '\0';
+}
+
+static void end_line(Reader* r) {
+  if (!at_eol(r)) {
+    error("IR line %u: unexpected \"%c\"", r->line, *r->cur);
+  }
+  if (*r->cur == '\n') {
+    r->cur++;
+    r->line++;
+  }
+}
+
+static bool is_word_end(char c) {
+  return c == ' ' || c == '\n' || c == '\0' || c == '=' || c == ',';
+}
+
+static size_t word_length(Reader* r) {
+  skip_spaces(r);
+  size_t len = 0;
+  while (!is_word_end(r->cur[len])) {
+    len++;
+  }
+  return len;
+}
+
+// consume `word` if it comes next
+static bool accept(Reader* r, const char* word) {
+  size_t len = word_length(r);
+  if (len != strlen(word) || strncmp(r->cur, word, len) != 0) {
+    return false;
+  }
+  r->cur += len;
+  return true;
+}
+
+static void expect(Reader* r, const char* word) {
+  if (!accept(r, word)) {
+    error("IR line %u: expected \"%s\"", r->line, word);
+  }
+}
+
+static void expect_char(Reader* r, char c) {
+  if (*r->cur != c) {
+    error("IR line %u: expected \"%c\"", r->line, c);
+  }
+  r->cur++;
+}
+
+static long read_long(Reader* r) {
+  skip_spaces(r);
+  char* end;
+  long n = strtol(r->cur, &end, 10);
+  if (end == r->cur) {
+    error("IR line %u: expected a number", r->line);
+  }
+  r->cur = end;
+  return n;
+}
+
+static unsigned read_unsigned(Reader* r) {
+  long n = read_long(r);
+  if (n < 0) {
+    error("IR line %u: unexpected negative number", r->line);
+  }
+  return n;
+}
+
+static const char* read_name(Reader* r) {
+  size_t len = word_length(r);
+  if (len == 0) {
+    error("IR line %u: expected a name", r->line);
+  }
+  const char* s = intern_n(r->cur, len);
+  r->cur += len;
+  return s;
+}
+
+static const char* read_string(Reader* r) {
+  skip_spaces(r);
+  expect_char(r, '"');
+
+  size_t cap = 16, len = 0;
+  char* buf  = malloc(cap);
+  while (*r->cur != '"') {
+    if (*r->cur == '\n' || *r->cur == '\0') {
+      error("IR line %u: unterminated string", r->line);
+    }
+
+    char c;
+    if (*r->cur == '\\') {
+      if (r->cur[1] != 'x' || !isxdigit(r->cur[2]) || !isxdigit(r->cur[3])) {
+        error("IR line %u: invalid escape in string", r->line);
+      }
+      char hex[3] = {r->cur[2], r->cur[3], '\0'};
+      c           = strtol(hex, NULL, 16);
+      r->cur += 4;
+    } else {
+      c = *r->cur++;
+    }
+
+    if (len == cap) {
+      cap *= 2;
+      buf = realloc(buf, cap);
+    }
+    buf[len++] = c;
+  }
+  r->cur++;
+
+  const char* s = intern_n(buf, len);
+  free(buf);
+  return s;
+}
+
+static Reg* read_reg(Reader* r) {
+  skip_spaces(r);
+  if (*r->cur == '_') {
+    r->cur++;
+    return NULL;
+  }
+
+  RegKind kind;
+  switch (*r->cur) {
+    case 'v':
+      kind = REG_VIRT;
+      break;
+    case 'r':
+      kind = REG_REAL;
+      break;
+    case 'f':
+      kind = REG_FIXED;
+      break;
+    default:
+      error("IR line %u: expected a register", r->line);
+  }
+  r->cur++;
+
+  unsigned virtual = read_unsigned(r);
+  unsigned real    = 0;
+  if (*r->cur == ':') {
+    r->cur++;
+    real = read_unsigned(r);
+  }
+  expect_char(r, '.');
+  DataSize size = read_unsigned(r);
+
+  if (virtual >= r->reg_count) {
+    error("IR line %u: unknown register %u", r->line, virtual);
+  }
+  if (kind != REG_VIRT && real >= num_regs) {
+    error("IR line %u: unknown real register %u", r->line, real);
+  }
+  if (kind != REG_REAL) {
+    // 0 if not seen yet, 1 if virtual, or 2 plus the real register it is fixed to
+    unsigned use = kind == REG_VIRT ? 1 : 2 + real;
+    if (r->reg_uses[virtual] == 0) {
+      r->reg_uses[virtual] = use;
+    } else if (r->reg_uses[virtual] != use) {
+      error("IR line %u: register %u is used as another kind or real register", r->line, virtual);
+    }
+  }
+  if (size != SIZE_BYTE && size != SIZE_WORD && size != SIZE_DWORD && size != SIZE_QWORD) {
+    error("IR line %u: invalid register size %u", r->line, size);
+  }
+
+  Reg* reg     = new_Reg(kind, size);
+  reg->virtual = virtual;
+  reg->real    = real;
+  if (*r->cur == '!') {
+    r->cur++;
+    reg->sticky = true;
+  }
+  return reg;
+}
+
+// blocks of the function being read, by local id
+typedef struct {
+  BasicBlock** blocks;
+  unsigned count;
+} BlockTable;
+
+static BasicBlock* lookup_block(Reader* r, BlockTable* t, unsigned id) {
+  if (id >= t->count || t->blocks[id] == NULL) {
+    error("IR line %u: unknown block %u", r->line, id);
+  }
+  return t->blocks[id];
+}
+
+static IRInstKind read_kind(Reader* r) {
+  for (unsigned k = 0; k < NUM_KINDS; k++) {
+    if (accept(r, kind_names[k])) {
+      return k;
+    }
+  }
+  error("IR line %u: unknown instruction kind", r->line);
+}
+
+static IRInst* read_inst(Reader* r, BlockTable* t) {
+  unsigned local  = read_unsigned(r);
+  unsigned global = read_unsigned(r);
+  if (global >= r->inst_count) {
+    error("IR line %u: global instruction id %u out of range", r->line, global);
+  }
+  IRInst* inst = new_inst(local, global, read_kind(r));
+
+  while (!at_eol(r)) {
+    if (accept(r, "ras")) {
+      expect_char(r, '=');
+      push_RegVec(inst->ras, read_reg(r));
+      while (*r->cur == ',') {
+        r->cur++;
+        push_RegVec(inst->ras, read_reg(r));
+      }
+      continue;
+    }
+
+    const char* key = read_name(r);
+    expect_char(r, '=');
+    if (key == intern("op")) {
+      inst->binary_op = read_long(r);
+    } else if (key == intern("una")) {
+      inst->unary_op = read_long(r);
+    } else if (key == intern("pred")) {
+      inst->predicate_op = read_long(r);
+    } else if (key == intern("imm")) {
+      inst->imm = read_long(r);
+    } else if (key == intern("stack")) {
+      inst->stack_idx = read_unsigned(r);
+      if (inst->stack_idx > r->stack_count) {
+        error("IR line %u: stack index %u out of range", r->line, inst->stack_idx);
+      }
+    } else if (key == intern("arg")) {
+      inst->argument_idx = read_unsigned(r);
+    } else if (key == intern("size")) {
+      inst->data_size = read_unsigned(r);
+    } else if (key == intern("global")) {
+      inst->global_name = read_name(r);
+    } else if (key == intern("gkind")) {
+      inst->global_kind = read_long(r);
+    } else if (key == intern("label")) {
+      inst->label = lookup_block(r, t, read_unsigned(r));
+    } else if (key == intern("jump")) {
+      inst->jump = lookup_block(r, t, read_unsigned(r));
+    } else if (key == intern("then")) {
+      inst->then_ = lookup_block(r, t, read_unsigned(r));
+    } else if (key == intern("else")) {
+      inst->else_ = lookup_block(r, t, read_unsigned(r));
+    } else if (key == intern("vararg")) {
+      inst->is_vararg = read_long(r) != 0;
+    } else if (key == intern("rd")) {
+      inst->rd = read_reg(r);
+    } else {
+      error("IR line %u: unknown field \"%s\"", r->line, key);
+    }
+  }
+
+  // binary operations are in the two-address form of x86 except for the remainder in rdx (see
+  // arch.c)
+  if (inst->kind == IR_BIN || inst->kind == IR_BIN_IMM) {
+    unsigned arity = inst->kind == IR_BIN ? 2 : 1;
+    if (inst->rd == NULL || length_RegVec(inst->ras) != arity ||
+        (inst->binary_op != ARITH_REM && inst->rd->virtual != get_RegVec(inst->ras, 0)->virtual) ||
+        (arity == 2 && inst->rd->virtual == get_RegVec(inst->ras, 1)->virtual)) {
+      error("IR line %u: binary operation not in the two-address form", r->line);
+    }
+  }
+  end_line(r);
+  return inst;
+}
+
+// the local id of the first or the last instruction of a block, -1 if it has none yet
+static unsigned read_range_end(Reader* r) {
+  if (accept(r, "-")) {
+    return -1;
+  }
+  return read_unsigned(r);
+}
+
+static IRInstListIterator* range_end(Reader* r, Function* f, unsigned id) {
+  if (id == (unsigned)-1) {
+    return NULL;
+  }
+  if (id >= capacity_IRInstList(f->instructions) ||
+      get_iterator_IRInstList(f->instructions, id) == NULL) {
+    error("IR line %u: unknown instruction %u in function %s", r->line, id, f->name);
+  }
+  return get_iterator_IRInstList(f->instructions, id);
+}
+
+// each block starts with its label and the ranges of blocks tile the instructions, which are read
+// from `line` on
+static void check_ranges(Function* f, unsigned* firsts, unsigned* lasts, unsigned line) {
+  BasicBlock* cur = NULL;  // the block of `prev`
+  IRInst* prev    = NULL;
+  unsigned count  = 0;
+  for (IRInstListIterator* it = front_IRInstList(f->instructions); !is_nil_IRInstListIterator(it);
+       it = next_IRInstListIterator(it), line++) {
+    IRInst* inst = data_IRInstListIterator(it);
+    if (inst->kind != IR_LABEL) {
+      if (cur == NULL) {
+        error("IR line %u: instruction out of any block in function %s", line, f->name);
+      }
+      prev = inst;
+      continue;
+    }
+
+    if (inst->label == NULL || firsts[inst->label->local_id] != inst->local_id) {
+      error("IR line %u: label does not start its block in function %s", line, f->name);
+    }
+    if (cur != NULL && lasts[cur->local_id] != prev->local_id) {
+      error("IR line %u: block %u does not end before this label in function %s", line,
+            cur->local_id, f->name);
+    }
+    cur  = inst->label;
+    prev = inst;
+    count++;
+  }
+  if (cur != NULL && lasts[cur->local_id] != prev->local_id) {
+    error("IR line %u: block %u does not end at the last instruction in function %s", line - 1,
+          cur->local_id, f->name);
+  }
+  if (count != f->bb_count) {
+    error("IR line %u: %u of %u blocks have instructions in function %s", line, count, f->bb_count,
+          f->name);
+  }
+}
+
+static unsigned count_refs(BBRefList* l, BasicBlock* bb) {
+  unsigned count = 0;
+  for (BBRefListIterator* it = front_BBRefList(l); !is_nil_BBRefListIterator(it);
+       it                    = next_BBRefListIterator(it)) {
+    count += data_BBRefListIterator(it) == bb;
+  }
+  return count;
+}
+
+static bool is_succ(BasicBlock* bb, BasicBlock* target) {
+  return target == NULL || count_refs(bb->succs, target) != 0;
+}
+
+// an edge is listed as many times in the successors of its source as in the predecessors of its
+// destination, and branches only go to successors
+static void check_edges(Function* f, unsigned line) {
+  for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
+       it                 = next_BBListIterator(it), line++) {
+    BasicBlock* bb = data_BBListIterator(it);
+    for (IRInstListIterator* i = bb->instructions->from;; i = next_IRInstListIterator(i)) {
+      IRInst* inst = data_IRInstListIterator(i);
+      if (!is_succ(bb, inst->jump) || !is_succ(bb, inst->then_) || !is_succ(bb, inst->else_)) {
+        error("IR line %u: instruction %u branches out of the successors of block %u", line,
+              inst->local_id, bb->local_id);
+      }
+      if (i == bb->instructions->to) {
+        break;
+      }
+    }
+    for (BBRefListIterator* s = front_BBRefList(bb->succs); !is_nil_BBRefListIterator(s);
+         s                    = next_BBRefListIterator(s)) {
+      BasicBlock* succ = data_BBRefListIterator(s);
+      if (count_refs(bb->succs, succ) != count_refs(succ->preds, bb)) {
+        error("IR line %u: successor %u does not list block %u as a predecessor", line,
+              succ->local_id, bb->local_id);
+      }
+    }
+    for (BBRefListIterator* p = front_BBRefList(bb->preds); !is_nil_BBRefListIterator(p);
+         p                    = next_BBRefListIterator(p)) {
+      BasicBlock* pred = data_BBRefListIterator(p);
+      if (count_refs(bb->preds, pred) != count_refs(pred->succs, bb)) {
+        error("IR line %u: predecessor %u does not list block %u as a successor", line,
+              pred->local_id, bb->local_id);
+      }
+    }
+  }
+}
+
+static Function* read_Function(Reader* r) {
+  Function* f    = alloc_tagged(MEM_IR, sizeof(Function));
+  f->name        = read_name(r);
+  f->bb_count    = read_unsigned(r);
+  f->reg_count   = read_unsigned(r);
+  r->reg_count   = f->reg_count;
+  f->stack_count = read_unsigned(r);
+  r->stack_count = f->stack_count;
+  f->inst_count  = read_unsigned(r);
+  f->call_count  = read_unsigned(r);
+  unsigned entry = read_unsigned(r);
+  unsigned exit  = read_unsigned(r);
+  f->blocks       = new_BBList();
+  f->instructions = new_IRInstList(read_unsigned(r));
+  end_line(r);
+
+  if (accept(r, "fixed_regs")) {
+    unsigned length = read_unsigned(r);
+    if (length != num_regs) {
+      error("IR line %u: %u fixed registers instead of %u", r->line, length, num_regs);
+    }
+    f->used_fixed_regs = zero_BitSet(length);
+    while (!at_eol(r)) {
+      unsigned i = read_unsigned(r);
+      if (i >= length_BitSet(f->used_fixed_regs)) {
+        error("IR line %u: fixed register %u out of range", r->line, i);
+      }
+      set_BitSet(f->used_fixed_regs, i, true);
+    }
+    end_line(r);
+  }
+
+  expect(r, "vars");
+  f->vars = new_UIVec(8);
+  while (!at_eol(r)) {
+    unsigned end = read_unsigned(r);
+    if (end > f->stack_count) {
+      error("IR line %u: variable at %u out of the stack", r->line, end);
+    }
+    push_UIVec(f->vars, end);
+  }
+  end_line(r);
+
+  BlockTable t = {.blocks = alloc_tagged(MEM_IR, f->bb_count * sizeof(BasicBlock*)),
+                  .count  = f->bb_count};
+
+  // edges and ranges refer to blocks and instructions that are read later
+  const char** edges  = alloc_tagged(MEM_IR, f->bb_count * sizeof(char*));
+  unsigned* firsts    = alloc_tagged(MEM_IR, f->bb_count * sizeof(unsigned));
+  unsigned* lasts     = alloc_tagged(MEM_IR, f->bb_count * sizeof(unsigned));
+  unsigned first_line = r->line;
+
+  while (accept(r, "block")) {
+    unsigned id = read_unsigned(r);
+    if (id >= f->bb_count || t.blocks[id] != NULL) {
+      error("IR line %u: invalid block id %u", r->line, id);
+    }
+
+    BasicBlock* bb = alloc_tagged(MEM_IR, sizeof(BasicBlock));
+    bb->local_id   = id;
+    bb->global_id  = read_unsigned(r);
+    if (bb->global_id >= r->bb_count) {
+      error("IR line %u: global block id %u out of range", r->line, bb->global_id);
+    }
+    bb->succs      = new_BBRefList();
+    bb->preds      = new_BBRefList();
+    firsts[id]     = read_range_end(r);
+    lasts[id]      = read_range_end(r);
+    bb->is_call_bb = accept(r, "call");
+    edges[id]      = r->cur;
+    t.blocks[id]   = bb;
+    push_back_BBList(f->blocks, bb);
+
+    while (!at_eol(r)) {
+      r->cur++;
+    }
+    end_line(r);
+  }
+  for (unsigned id = 0; id < f->bb_count; id++) {
+    if (t.blocks[id] == NULL) {
+      error("IR line %u: block %u is not defined in function %s", r->line, id, f->name);
+    }
+  }
+
+  unsigned inst_line = r->line;
+  r->reg_uses        = alloc_tagged(MEM_IR, f->reg_count * sizeof(unsigned));
+  while (!accept(r, "end")) {
+    IRInst* inst = read_inst(r, &t);
+    if (inst->local_id >= f->inst_count) {
+      error("IR line %u: instruction id %u out of range", r->line - 1, inst->local_id);
+    }
+    if (inst->local_id < capacity_IRInstList(f->instructions) &&
+        get_iterator_IRInstList(f->instructions, inst->local_id) != NULL) {
+      error("IR line %u: duplicate instruction %u", r->line - 1, inst->local_id);
+    }
+    push_back_with_idx_IRInstList(f->instructions, inst->local_id, inst);
+  }
+  end_line(r);
+  unsigned next_line = r->line;
+  free_tagged(MEM_IR, r->reg_uses);
+  r->reg_uses = NULL;
+
+  check_ranges(f, firsts, lasts, inst_line);
+
+  // resolve the references of blocks, going back to their lines
+  Reader back = {.line = first_line};
+  for (BBListIterator* it = front_BBList(f->blocks); !is_nil_BBListIterator(it);
+       it                 = next_BBListIterator(it), back.line++) {
+    BasicBlock* bb = data_BBListIterator(it);
+    back.cur       = edges[bb->local_id];
+
+    expect(&back, "succs");
+    while (!accept(&back, "preds")) {
+      push_back_BBRefList(bb->succs, lookup_block(&back, &t, read_unsigned(&back)));
+    }
+    while (!at_eol(&back)) {
+      push_back_BBRefList(bb->preds, lookup_block(&back, &t, read_unsigned(&back)));
+    }
+
+    bb->instructions = new_unchecked_IRInstRange(range_end(&back, f, firsts[bb->local_id]),
+                                                 range_end(&back, f, lasts[bb->local_id]));
+  }
+  check_edges(f, first_line);
+
+  f->entry = lookup_block(r, &t, entry);
+  f->exit  = lookup_block(r, &t, exit);
+  r->line  = next_line;
+
+  free_tagged(MEM_IR, t.blocks);
+  free_tagged(MEM_IR, edges);
+  free_tagged(MEM_IR, firsts);
+  free_tagged(MEM_IR, lasts);
+  return f;
+}
+
+static GlobalExpr* read_GlobalExpr(Reader* r) {
+  GlobalExpr* e = alloc_tagged(MEM_IR, sizeof(GlobalExpr));
+  if (accept(r, "add")) {
+    e->kind = GE_ADD;
+    e->lhs  = read_name(r);
+    e->rhs  = read_long(r);
+  } else if (accept(r, "sub")) {
+    e->kind = GE_SUB;
+    e->lhs  = read_name(r);
+    e->rhs  = read_long(r);
+  } else if (accept(r, "name")) {
+    e->kind = GE_NAME;
+    e->name = read_name(r);
+  } else if (accept(r, "num")) {
+    e->kind = GE_NUM;
+    e->size = read_unsigned(r);
+    e->num  = read_long(r);
+  } else if (accept(r, "string")) {
+    e->kind   = GE_STRING;
+    e->string = read_string(r);
+  } else {
+    free_tagged(MEM_IR, e);
+    return NULL;
+  }
+  end_line(r);
+  return e;
+}
+
+static GlobalVar* read_GlobalVar(Reader* r) {
+  GlobalVar* v = alloc_tagged(MEM_IR, sizeof(GlobalVar));
+  v->name      = read_name(r);
+  v->init      = nil_GlobalInitializer();
+  end_line(r);
+
+  GlobalInitializer* last = v->init;
+  GlobalExpr* e;
+  while ((e = read_GlobalExpr(r)) != NULL) {
+    last = tail_GlobalInitializer(append_GlobalInitializer(last, single_GlobalInitializer(e)));
+  }
+  return v;
+}
+
+IR* read_IR(const char* text) {
+  Reader r = {.cur = text, .line = 1};
+
+  IR* ir = alloc_tagged(MEM_IR, sizeof(IR));
+  expect(&r, "ccc-ir");
+  ir->inst_count = read_unsigned(&r);
+  ir->bb_count   = read_unsigned(&r);
+  r.inst_count   = ir->inst_count;
+  r.bb_count     = ir->bb_count;
+  ir->functions  = nil_FunctionList();
+  ir->globals    = new_GlobalVarVec(16);
+  end_line(&r);
+
+  FunctionList* last = ir->functions;
+  while (*r.cur != '\0') {
+    if (accept(&r, "global")) {
+      push_GlobalVarVec(ir->globals, read_GlobalVar(&r));
+    } else if (accept(&r, "function")) {
+      Function* f = read_Function(&r);
+      last        = tail_FunctionList(append_FunctionList(last, single_FunctionList(f)));
+    } else {
+      error("IR line %u: expected \"global\" or \"function\"", r.line);
+    }
+  }
+  return ir;
+}
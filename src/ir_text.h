@@ -0,0 +1,31 @@
+#ifndef CCC_IR_TEXT_H
+#define CCC_IR_TEXT_H
+
+#include <stdio.h>
+
+#include "ir.h"
+
+// a line-based textual form of `IR`, to save IR between `arch` and the passes and run the passes
+// on it alone (see tools/ccc_opt.c)
+//
+//   ccc-ir <inst_count> <bb_count>
+//   global <name>
+//     num <size> <value> | name <name> | add <name> <offset> | sub <name> <offset> | string "..."
+//   function <name> <bb_count> <reg_count> <stack_count> <inst_count> <call_count> <entry> <exit>
+//            <capacity of instructions>
+//     fixed_regs <length> <index>...
+//     vars <stack_idx>...
+//     block <local_id> <global_id> <first inst|-> <last inst|-> [call] succs <id>... preds <id>...
+//     <local_id> <global_id> <KIND> [key=value]...
+//   end
+//
+// blocks and instructions are listed in the order of `blocks` and `instructions` of `Function`
+// fields of instructions are omitted when zero, and registers are written as
+// `<v|r|f><virtual>[:<real>].<size>[!]` (`!` for sticky ones) or `_` for NULL
+// results of analyses are not saved; passes compute them again
+void write_IR(FILE*, IR*);
+
+// the inverse of `write_IR`; exits with an error on malformed input
+IR* read_IR(const char* text);
+
+#endif
@@ -1,38 +1,54 @@
 #include <ctype.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "error.h"
+#include "intern.h"
 #include "lexer.h"
-#include "list.h"
-#include "util.h"
+#include "mem_stats.h"
+#include "vector.h"
 
-static void release_Token(Token* t) {
-  if (t == NULL) {
-    return;
-  }
+DEFINE_TAGGED_ALLOCATOR(tokens, MEM_TOKENS)
+
+static void release_Token(Token t) {}
+DEFINE_VECTOR_WITH(tokens, release_Token, Token, TokenVec)
 
-  free(t->ident);
-  free(t->string);
-  free(t);
+struct Lexer {
+  const char* input;
+  const char* end;  // the terminating NUL of `input`
+  const char* pos;  // the next character to be lexed
+};
+
+Lexer* new_Lexer(const char* input) {
+  Lexer* l = alloc_tokens(sizeof(Lexer));
+  l->input = input;
+  l->end   = input + strlen(input);
+  l->pos   = input;
+  return l;
 }
-DEFINE_LIST(release_Token, Token*, TokenList)
 
-Token* new_Token(TokenKind kind) {
-  Token* t = calloc(1, sizeof(Token));
-  t->kind  = kind;
-  return t;
+void release_Lexer(Lexer* l) {
+  free_tokens(l);
 }
 
-static TokenList* add_token(TokenKind kind, TokenList* cur) {
-  return snoc_TokenList(new_Token(kind), cur);
+// a token of `kind` spanning [start, end), after which lexing resumes
+static Token emit(Lexer* l, const char* start, const char* end, TokenKind kind) {
+  l->pos  = end;
+  Token t = {.kind = kind, .offset = start - l->input};
+  return t;
 }
 
-// will seek `strp` to the end of number
-static TokenList* add_number(char** strp, TokenList* cur) {
-  TokenList* t    = add_token(TK_NUMBER, cur);
-  t->head->number = strtol(*strp, strp, 10);
+static Token lex_number(Lexer* l, const char* start) {
+  char* end = NULL;
+  long n    = strtol(start, &end, 10);
+  Token t   = emit(l, start, end, TK_NUMBER);
+  t.number  = n;
   return t;
 }
 
@@ -40,108 +56,185 @@ static bool is_ident_char(char c) {
   return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || (c == '_');
 }
 
-// will seek `strp` to the end of ident
-static TokenList* add_ident(char** strp, TokenList* cur) {
-  char* init = *strp;
-  while (is_ident_char(**strp)) {
-    (*strp)++;
+static bool is_space_char(char c) {
+  return c == ' ' || ('\t' <= c && c <= '\r');
+}
+
+// the scanners below return the first position in [p, end) that stops the scan, or `end`
+// 16 bytes are classified at a time where SSE2 is available, and the rest one by one
+
+#ifdef __SSE2__
+// mask of the bytes in `v` within ['lo', 'hi'] (both are ASCII, so the signed compare is fine)
+static __m128i in_range(__m128i v, char lo, char hi) {
+  __m128i ge_lo = _mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1));
+  __m128i le_hi = _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1));
+  return _mm_and_si128(ge_lo, le_hi);
+}
+
+// index of the first unset bit in the low 16 bits of `mask`, or 16
+static unsigned first_unset(int mask) {
+  unsigned inv = ~(unsigned)mask & 0xffff;
+  return inv == 0 ? 16 : __builtin_ctz(inv);
+}
+#endif
+
+static const char* skip_ident_chars(const char* p, const char* end) {
+#ifdef __SSE2__
+  for (; end - p >= 16; p += 16) {
+    __m128i v     = _mm_loadu_si128((const __m128i*)p);
+    __m128i lower = in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i digit = in_range(v, '0', '9');
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    int mask      = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(lower, digit), under));
+    unsigned n    = first_unset(mask);
+    if (n != 16) {
+      return p + n;
+    }
+  }
+#endif
+  while (p != end && is_ident_char(*p)) {
+    p++;
   }
+  return p;
+}
 
-#define IS_SAME(sv, sc) (memcmp(sv, sc, sizeof(sc) - 1) == 0)
-  if (IS_SAME(init, "return")) {
-    return add_token(TK_RETURN, cur);
-  } else if (IS_SAME(init, "if")) {
-    return add_token(TK_IF, cur);
-  } else if (IS_SAME(init, "else")) {
-    return add_token(TK_ELSE, cur);
-  } else if (IS_SAME(init, "while")) {
-    return add_token(TK_WHILE, cur);
-  } else if (IS_SAME(init, "for")) {
-    return add_token(TK_FOR, cur);
-  } else if (IS_SAME(init, "do")) {
-    return add_token(TK_DO, cur);
-  } else if (IS_SAME(init, "break")) {
-    return add_token(TK_BREAK, cur);
-  } else if (IS_SAME(init, "continue")) {
-    return add_token(TK_CONTINUE, cur);
-  } else if (IS_SAME(init, "int")) {
-    return add_token(TK_INT, cur);
-  } else if (IS_SAME(init, "char")) {
-    return add_token(TK_CHAR, cur);
-  } else if (IS_SAME(init, "long")) {
-    return add_token(TK_LONG, cur);
-  } else if (IS_SAME(init, "short")) {
-    return add_token(TK_SHORT, cur);
-  } else if (IS_SAME(init, "void")) {
-    return add_token(TK_VOID, cur);
-  } else if (IS_SAME(init, "signed")) {
-    return add_token(TK_SIGNED, cur);
-  } else if (IS_SAME(init, "unsigned")) {
-    return add_token(TK_UNSIGNED, cur);
-  } else if (IS_SAME(init, "_Bool")) {
-    return add_token(TK_BOOL, cur);
-  } else if (IS_SAME(init, "sizeof")) {
-    return add_token(TK_SIZEOF, cur);
-  } else if (IS_SAME(init, "switch")) {
-    return add_token(TK_SWITCH, cur);
-  } else if (IS_SAME(init, "goto")) {
-    return add_token(TK_GOTO, cur);
-  } else if (IS_SAME(init, "case")) {
-    return add_token(TK_CASE, cur);
-  } else if (IS_SAME(init, "default")) {
-    return add_token(TK_DEFAULT, cur);
-  } else if (IS_SAME(init, "struct")) {
-    return add_token(TK_STRUCT, cur);
-  } else if (IS_SAME(init, "enum")) {
-    return add_token(TK_ENUM, cur);
-  } else if (IS_SAME(init, "typedef")) {
-    return add_token(TK_TYPEDEF, cur);
-  } else if (IS_SAME(init, "const")) {
-    return add_token(TK_CONST, cur);
-  } else if (IS_SAME(init, "extern")) {
-    return add_token(TK_EXTERN, cur);
-  } else if (IS_SAME(init, "static")) {
-    return add_token(TK_STATIC, cur);
+static const char* skip_spaces(const char* p, const char* end) {
+#ifdef __SSE2__
+  for (; end - p >= 16; p += 16) {
+    __m128i v     = _mm_loadu_si128((const __m128i*)p);
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    __m128i ctrl  = in_range(v, '\t', '\r');
+    unsigned n    = first_unset(_mm_movemask_epi8(_mm_or_si128(space, ctrl)));
+    if (n != 16) {
+      return p + n;
+    }
   }
-#undef IS_SAME
+#endif
+  while (p != end && is_space_char(*p)) {
+    p++;
+  }
+  return p;
+}
 
-  TokenList* t   = add_token(TK_IDENT, cur);
-  t->head->ident = strndup(init, *strp - init);
-  return t;
+// the first occurrence of `c`
+static const char* find_char(const char* p, const char* end, char c) {
+#ifdef __SSE2__
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    int mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (p != end && *p != c) {
+    p++;
+  }
+  return p;
+}
+
+typedef struct {
+  const char* name;
+  unsigned length;
+  TokenKind kind;
+} Keyword;
+
+#define KEYWORD(s, k) {s, sizeof(s) - 1, k}
+
+#define KEYWORD_TABLE_SIZE 64
+
+// collision-free for the keywords below; the multipliers were found by a search over small
+// integers, which has to be redone (along with the indices of `keywords`) to add a keyword
+static unsigned keyword_hash(const char* s, unsigned length) {
+  return ((unsigned char)s[0] * 6 + (unsigned char)s[length - 1] * 3 + length * 7) %
+         KEYWORD_TABLE_SIZE;
 }
 
-static void end_tokens(TokenList* cur) {
-  add_token(TK_END, cur);
+// perfect hash table of the keywords, indexed by `keyword_hash`
+static const Keyword keywords[KEYWORD_TABLE_SIZE] = {
+    [1]  = KEYWORD("enum", TK_ENUM),
+    [4]  = KEYWORD("char", TK_CHAR),
+    [5]  = KEYWORD("static", TK_STATIC),
+    [8]  = KEYWORD("signed", TK_SIGNED),
+    [12] = KEYWORD("void", TK_VOID),
+    [14] = KEYWORD("sizeof", TK_SIZEOF),
+    [15] = KEYWORD("for", TK_FOR),
+    [17] = KEYWORD("const", TK_CONST),
+    [18] = KEYWORD("extern", TK_EXTERN),
+    [19] = KEYWORD("goto", TK_GOTO),
+    [20] = KEYWORD("switch", TK_SWITCH),
+    [25] = KEYWORD("long", TK_LONG),
+    [27] = KEYWORD("typedef", TK_TYPEDEF),
+    [28] = KEYWORD("while", TK_WHILE),
+    [29] = KEYWORD("case", TK_CASE),
+    [32] = KEYWORD("return", TK_RETURN),
+    [33] = KEYWORD("_Bool", TK_BOOL),
+    [34] = KEYWORD("unsigned", TK_UNSIGNED),
+    [37] = KEYWORD("default", TK_DEFAULT),
+    [39] = KEYWORD("int", TK_INT),
+    [41] = KEYWORD("else", TK_ELSE),
+    [48] = KEYWORD("break", TK_BREAK),
+    [49] = KEYWORD("short", TK_SHORT),
+    [51] = KEYWORD("do", TK_DO),
+    [54] = KEYWORD("if", TK_IF),
+    [56] = KEYWORD("struct", TK_STRUCT),
+    [57] = KEYWORD("continue", TK_CONTINUE),
+};
+
+static TokenKind keyword_kind(const char* s, unsigned length) {
+  const Keyword* k = &keywords[keyword_hash(s, length)];
+  if (k->name != NULL && k->length == length && memcmp(k->name, s, length) == 0) {
+    return k->kind;
+  }
+  return TK_IDENT;
 }
 
-TokenList* tokenize(char* p) {
-  TokenList* init = nil_TokenList();
-  TokenList* cur  = init;
+static Token lex_ident(Lexer* l, const char* start) {
+  const char* end = skip_ident_chars(start, l->end);
 
-  while (*p) {
-    if (isspace(*p)) {
-      // skip spaces
-      p++;
+  Token t = emit(l, start, end, keyword_kind(start, end - start));
+  if (t.kind == TK_IDENT) {
+    t.ident = intern_n(start, end - start);
+  }
+  return t;
+}
+
+Token next_token(Lexer* l) {
+  const char* p   = l->pos;
+  const char* end = l->end;
+
+  while (p != end) {
+    if (is_space_char(*p)) {
+      p = skip_spaces(p, end);
       continue;
     }
 
-    if (memcmp(p, "//", 2) == 0) {
-      p += 2;
+    if (p[0] == '/' && p[1] == '/') {
       // newline is also consumed
-      while (*(p++) != '\n')
-        ;
+      p = find_char(p + 2, end, '\n');
+      if (p != end) {
+        p++;
+      }
       continue;
     }
 
-    if (memcmp(p, "/*", 2) == 0) {
+    if (p[0] == '/' && p[1] == '*') {
       p += 2;
-      while (memcmp(p, "*/", 2) != 0) {
+      for (;;) {
+        p = find_char(p, end, '*');
+        if (p == end) {
+          error("unterminated comment");
+        }
+        if (p[1] == '/') {
+          break;
+        }
         p++;
       }
       p += 2;
       continue;
     }
 
+    const char* start = p;
     switch (*p) {
       case '.':
         p++;
@@ -150,266 +243,181 @@ TokenList* tokenize(char* p) {
             p++;
             switch (*p) {
               case '.':
-                p++;
-                cur = add_token(TK_ELIPSIS, cur);
-                continue;
+                return emit(l, start, p + 1, TK_ELIPSIS);
               default:
-                cur = add_token(TK_DOT, cur);
-                continue;
+                return emit(l, start, p, TK_DOT);
             }
           default:
-            cur = add_token(TK_DOT, cur);
-            continue;
+            return emit(l, start, p, TK_DOT);
         }
       case '+':
         p++;
         switch (*p) {
           case '+':
-            cur = add_token(TK_DOUBLE_PLUS, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_DOUBLE_PLUS);
           case '=':
-            cur = add_token(TK_PLUS_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_PLUS_EQUAL);
           default:
-            cur = add_token(TK_PLUS, cur);
-            continue;
+            return emit(l, start, p, TK_PLUS);
         }
       case '-':
         p++;
         switch (*p) {
           case '-':
-            cur = add_token(TK_DOUBLE_MINUS, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_DOUBLE_MINUS);
           case '>':
-            cur = add_token(TK_ARROW, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_ARROW);
           case '=':
-            cur = add_token(TK_MINUS_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_MINUS_EQUAL);
           default:
-            cur = add_token(TK_MINUS, cur);
-            continue;
+            return emit(l, start, p, TK_MINUS);
         }
       case '*':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_STAR_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_STAR_EQUAL);
           default:
-            cur = add_token(TK_STAR, cur);
-            continue;
+            return emit(l, start, p, TK_STAR);
         }
       case '/':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_SLASH_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_SLASH_EQUAL);
           default:
-            cur = add_token(TK_SLASH, cur);
-            continue;
+            return emit(l, start, p, TK_SLASH);
         }
       case '~':
-        cur = add_token(TK_TILDE, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_TILDE);
       case '(':
-        cur = add_token(TK_LPAREN, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_LPAREN);
       case ')':
-        cur = add_token(TK_RPAREN, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_RPAREN);
       case '{':
-        cur = add_token(TK_LBRACE, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_LBRACE);
       case '}':
-        cur = add_token(TK_RBRACE, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_RBRACE);
       case '[':
-        cur = add_token(TK_LBRACKET, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_LBRACKET);
       case ']':
-        cur = add_token(TK_RBRACKET, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_RBRACKET);
       case ';':
-        cur = add_token(TK_SEMICOLON, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_SEMICOLON);
       case ',':
-        cur = add_token(TK_COMMA, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_COMMA);
       case '"':
-        p++;
-        char* init = p;
-        while (*p != '"')
-          p++;
-        cur               = add_token(TK_STRING, cur);
-        cur->head->string = strndup(init, p - init);
-        cur->head->length = p - init;
-        p++;
-        continue;
+        p = find_char(p + 1, end, '"');
+        if (p == end) {
+          error("unterminated string literal");
+        }
+        Token t  = emit(l, start, p + 1, TK_STRING);
+        t.string = intern_n(start + 1, p - start - 1);
+        return t;
       case '^':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_HAT_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_HAT_EQUAL);
           default:
-            cur = add_token(TK_HAT, cur);
-            continue;
+            return emit(l, start, p, TK_HAT);
         }
       case '%':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_PERCENT_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_PERCENT_EQUAL);
           default:
-            cur = add_token(TK_PERCENT, cur);
-            continue;
+            return emit(l, start, p, TK_PERCENT);
         }
       case '&':
         p++;
         switch (*p) {
           case '&':
-            cur = add_token(TK_DOUBLE_AND, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_DOUBLE_AND);
           case '=':
-            cur = add_token(TK_AND_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_AND_EQUAL);
           default:
-            cur = add_token(TK_AND, cur);
-            continue;
+            return emit(l, start, p, TK_AND);
         }
       case '|':
         p++;
         switch (*p) {
           case '|':
-            cur = add_token(TK_DOUBLE_VERTICAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_DOUBLE_VERTICAL);
           case '=':
-            cur = add_token(TK_VERTICAL_EQUAL, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_VERTICAL_EQUAL);
           default:
-            cur = add_token(TK_VERTICAL, cur);
-            continue;
+            return emit(l, start, p, TK_VERTICAL);
         }
       case ':':
-        cur = add_token(TK_COLON, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_COLON);
       case '?':
-        cur = add_token(TK_QUESTION, cur);
-        p++;
-        continue;
+        return emit(l, start, p + 1, TK_QUESTION);
       case '=':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_EQ, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_EQ);
           default:
-            cur = add_token(TK_EQUAL, cur);
-            continue;
+            return emit(l, start, p, TK_EQUAL);
         }
       case '!':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_NE, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_NE);
           default:
-            cur = add_token(TK_EXCL, cur);
-            continue;
+            return emit(l, start, p, TK_EXCL);
         }
       case '>':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_GE, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_GE);
           case '>':
             p++;
             switch (*p) {
               case '=':
-                cur = add_token(TK_RIGHT_EQUAL, cur);
-                p++;
-                continue;
+                return emit(l, start, p + 1, TK_RIGHT_EQUAL);
               default:
-                cur = add_token(TK_RIGHT, cur);
-                continue;
+                return emit(l, start, p, TK_RIGHT);
             }
           default:
-            cur = add_token(TK_GT, cur);
-            continue;
+            return emit(l, start, p, TK_GT);
         }
       case '<':
         p++;
         switch (*p) {
           case '=':
-            cur = add_token(TK_LE, cur);
-            p++;
-            continue;
+            return emit(l, start, p + 1, TK_LE);
           case '<':
             p++;
             switch (*p) {
               case '=':
-                cur = add_token(TK_LEFT_EQUAL, cur);
-                p++;
-                continue;
+                return emit(l, start, p + 1, TK_LEFT_EQUAL);
               default:
-                cur = add_token(TK_LEFT, cur);
-                continue;
+                return emit(l, start, p, TK_LEFT);
             }
           default:
-            cur = add_token(TK_LT, cur);
-            continue;
+            return emit(l, start, p, TK_LT);
         }
       default:
         if (isdigit(*p)) {
-          // call of `add_number` updates p
-          cur = add_number(&p, cur);
-          continue;
+          return lex_number(l, start);
         } else if (is_ident_char(*p)) {
-          // call of `add_ident` updates p
-          cur = add_ident(&p, cur);
-          continue;
+          return lex_ident(l, start);
         }
     }
 
     error("Unexpected charcter: %c", *p);
   }
 
-  end_tokens(cur);
-  return init;
+  return emit(l, p, p, TK_END);
 }
 
-static void print_Token(FILE* p, Token* t) {
-  switch (t->kind) {
+void print_Token(FILE* p, Token t) {
+  switch (t.kind) {
     case TK_PLUS:
       fprintf(p, "(+)");
       break;
@@ -630,20 +638,32 @@ static void print_Token(FILE* p, Token* t) {
       fprintf(p, "(...)");
       break;
     case TK_NUMBER:
-      fprintf(p, "num(%d)", t->number);
+      fprintf(p, "num(%d)", t.number);
       break;
     case TK_STRING:
-      fprintf(p, "str(%s,%ld)", t->string, t->length);
+      fprintf(p, "str(%s,%ld)", t.string, length_interned(t.string));
       break;
     case TK_END:
       fprintf(p, "end");
       return;
     case TK_IDENT:
-      fprintf(p, "ident(%s)", t->ident);
+      fprintf(p, "ident(%s)", t.ident);
       return;
     default:
       CCC_UNREACHABLE;
   }
 }
 
-DEFINE_LIST_PRINTER(print_Token, ", ", "\n", TokenList)
+DEFINE_VECTOR_PRINTER(print_Token, ", ", "\n", TokenVec)
+
+TokenVec* tokenize(const char* input) {
+  Lexer* l    = new_Lexer(input);
+  TokenVec* v = new_TokenVec(64);
+  Token t;
+  do {
+    t = next_token(l);
+    push_TokenVec(v, t);
+  } while (t.kind != TK_END);
+  release_Lexer(l);
+  return v;
+}
@@ -2,7 +2,8 @@
 #define CCC_TOKEN_H
 
 #include <stdio.h>
-#include "list.h"
+
+#include "vector.h"
 
 typedef enum {
   TK_PLUS,
@@ -84,20 +85,32 @@ typedef enum {
   TK_END,     // end of tokens
 } TokenKind;
 
+// tokens are small values stored contiguously, not individually allocated
 typedef struct {
   TokenKind kind;
-  char* ident;    // for TK_IDENT, owned
-  char* string;   // for TK_STRING, owned
-  size_t length;  // for TK_STRING
-  int number;     // for TK_NUMBER
+  unsigned offset;  // in the source
+
+  union {
+    const char* ident;   // for TK_IDENT, interned
+    const char* string;  // for TK_STRING, interned (use `length_interned` for its length)
+    int number;          // for TK_NUMBER
+  };
 } Token;
 
-Token* new_Token(TokenKind);
+void print_Token(FILE*, Token);
+
+DECLARE_VECTOR(Token, TokenVec)
+DECLARE_VECTOR_PRINTER(TokenVec)
+
+// pull-based lexer: `input` is lexed on demand, one token per `next_token` call
+typedef struct Lexer Lexer;
 
-DECLARE_LIST(Token*, TokenList)
-DECLARE_LIST_PRINTER(TokenList)
+Lexer* new_Lexer(const char* input);
+// TK_END is returned at the end of `input`, and on every call after that
+Token next_token(Lexer*);
+void release_Lexer(Lexer*);
 
-// divide `input` into a linked list of `Token`s.
-TokenList* tokenize(char* input);
+// lex the whole `input` at once, the last element being TK_END
+TokenVec* tokenize(const char* input);
 
 #endif
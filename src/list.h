@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include "error.h"
+#include "util.h"
 
 // a simple linked list
 #define DECLARE_LIST(T, Name)                                                                      \
@@ -26,13 +27,16 @@
   Name* copy_##Name(const Name* list);                                                             \
   void release_##Name(Name* list);
 
-#define DEFINE_LIST(release_data, T, Name)                                                         \
+#define DEFINE_LIST(release_data, T, Name) DEFINE_LIST_WITH(heap, release_data, T, Name)
+
+// cells are allocated with `alloc_##A` and freed with `free_##A` (see util.h and arena.h)
+#define DEFINE_LIST_WITH(A, release_data, T, Name)                                                 \
   struct Name {                                                                                    \
     bool is_nil;                                                                                   \
     T head;                                                                                        \
     Name* tail;                                                                                    \
   };                                                                                               \
-  Name* init_##Name() { return calloc(1, sizeof(Name)); }                                          \
+  Name* init_##Name() { return alloc_##A(sizeof(Name)); }                                          \
   Name* nil_##Name() {                                                                             \
     Name* l   = init_##Name();                                                                     \
     l->is_nil = true;                                                                              \
@@ -113,7 +117,7 @@
       release_data(list->head);                                                                    \
       release_##Name(list->tail);                                                                  \
     }                                                                                              \
-    free(list);                                                                                    \
+    free_##A(list);                                                                                \
   }
 
 #define DECLARE_LIST_PRINTER(Name) void print_##Name(FILE* f, Name* l);
@@ -1,13 +1,16 @@
 #ifndef CCC_MAP_H
 #define CCC_MAP_H
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-#include "list.h"
+#include "error.h"
+#include "intern.h"
+#include "mem_stats.h"
 #include "util.h"
-#include "vector.h"
 
-// hash table from string to `T`
+// hash table from interned string (see intern.h) to `T`
 #define DECLARE_MAP(T, Name)                                                                       \
   typedef struct Name Name;                                                                        \
   Name* new_##Name(unsigned size);                                                                 \
@@ -17,82 +20,98 @@
   T get_##Name(Name*, const char* k);                                                              \
   bool lookup_##Name(Name*, const char* k, T* out);                                                \
   void remove_##Name(Name*, const char* k);                                                        \
+  unsigned length_##Name(const Name*);                                                             \
   void release_##Name(Name*);
 
-#define DEFINE_MAP(copy_T, release_T, T, Name)                                                     \
+// open addressing with linear probing; keys are compared by pointer and hashed once on interning
+// an existing value is replaced on `insert` without being released, as it may be shared with a
+// shallow copy
+#define DEFINE_MAP(copy_T, release_T, T, Name) DEFINE_MAP_WITH(maps, copy_T, release_T, T, Name)
+
+// the default allocator of maps, which are counted apart from other containers
+DEFINE_TAGGED_ALLOCATOR(maps, MEM_MAPS)
+
+// allocated with `alloc_##A` and `free_##A` (see util.h and arena.h)
+#define DEFINE_MAP_WITH(A, copy_T, release_T, T, Name)                                             \
   typedef struct {                                                                                 \
     unsigned hash;                                                                                 \
-    char* key;                                                                                     \
+    const char* key; /* NULL if the slot is empty */                                               \
     T value;                                                                                       \
   } Name##Entry;                                                                                   \
-  static void release_##Name##Entry(Name##Entry* e) {                                              \
-    if (e == NULL) {                                                                               \
-      return;                                                                                      \
-    }                                                                                              \
-    free(e->key);                                                                                  \
-    release_T(e->value);                                                                           \
-    free(e);                                                                                       \
-  }                                                                                                \
-  DECLARE_LIST(Name##Entry*, Name##Entries)                                                        \
-  DECLARE_VECTOR(Name##Entries*, Name##Table)                                                      \
-  DEFINE_LIST(release_##Name##Entry, Name##Entry*, Name##Entries)                                  \
-  DEFINE_VECTOR(release_##Name##Entries, Name##Entries*, Name##Table)                              \
   struct Name {                                                                                    \
-    Name##Table* table;                                                                            \
+    Name##Entry* entries;                                                                          \
+    unsigned capacity; /* power of two */                                                          \
+    unsigned count;                                                                                \
   };                                                                                               \
-  Name* new_##Name(unsigned size) {                                                                \
-    Name* m  = calloc(1, sizeof(Name));                                                            \
-    m->table = new_##Name##Table(size);                                                            \
-    for (unsigned i = 0; i < size; i++) {                                                          \
-      push_##Name##Table(m->table, nil_##Name##Entries());                                         \
-    }                                                                                              \
+  static Name* init_##Name(unsigned capacity) {                                                    \
+    Name* m     = alloc_##A(sizeof(Name));                                                         \
+    m->entries  = alloc_##A(sizeof(Name##Entry) * capacity);                                       \
+    m->capacity = capacity;                                                                        \
     return m;                                                                                      \
   }                                                                                                \
-  static Name##Entry* new_##Name##Entry() { return calloc(1, sizeof(Name##Entry)); }               \
-  static Name##Entry* copy_##Name##Entry(Name##Entry* e, bool copy_value) {                        \
-    Name##Entry* new = new_##Name##Entry();                                                        \
-    new->hash        = e->hash;                                                                    \
-    new->key         = strdup(e->key);                                                             \
-    if (copy_value) {                                                                              \
-      new->value = copy_T(e->value);                                                               \
-    } else {                                                                                       \
-      new->value = e->value;                                                                       \
-    }                                                                                              \
-    return new;                                                                                    \
-  }                                                                                                \
-  static Name##Entries* copy_entries_##Name(const Name##Entries* list, bool copy_value) {          \
-    if (list->is_nil) {                                                                            \
-      return nil_##Name##Entries();                                                                \
+  Name* new_##Name(unsigned size) {                                                                \
+    unsigned capacity = 8;                                                                         \
+    while (capacity < size) {                                                                      \
+      capacity *= 2;                                                                               \
     }                                                                                              \
-    Name##Entry* e = copy_##Name##Entry(list->head, copy_value);                                   \
-    return cons_##Name##Entries(e, copy_entries_##Name(list->tail, copy_value));                   \
+    return init_##Name(capacity);                                                                  \
   }                                                                                                \
   static Name* copy_impl_##Name(const Name* m, bool is_deep) {                                     \
-    Name* copy    = calloc(1, sizeof(Name));                                                       \
-    unsigned size = length_##Name##Table(m->table);                                                \
-    copy->table   = new_##Name##Table(size);                                                       \
-    for (unsigned i = 0; i < size; i++) {                                                          \
-      Name##Entries* l = get_##Name##Table(m->table, i);                                           \
-      push_##Name##Table(copy->table, copy_entries_##Name(l, is_deep));                            \
+    Name* copy  = init_##Name(m->capacity);                                                        \
+    copy->count = m->count;                                                                        \
+    for (unsigned i = 0; i < m->capacity; i++) {                                                   \
+      Name##Entry* e = &m->entries[i];                                                             \
+      if (e->key == NULL) {                                                                        \
+        continue;                                                                                  \
+      }                                                                                            \
+      Name##Entry* new = &copy->entries[i];                                                        \
+      new->hash        = e->hash;                                                                  \
+      new->key         = e->key;                                                                   \
+      new->value       = is_deep ? copy_T(e->value) : e->value;                                    \
     }                                                                                              \
     return copy;                                                                                   \
   }                                                                                                \
   Name* shallow_copy_##Name(const Name* m) { return copy_impl_##Name(m, false); }                  \
   Name* copy_##Name(const Name* m) { return copy_impl_##Name(m, true); }                           \
-  static Name##Entry* make_entry_##Name(const char* k, T v) {                                      \
-    unsigned hash  = hash_string(k);                                                               \
-    Name##Entry* e = new_##Name##Entry();                                                          \
-    e->hash        = hash;                                                                         \
-    e->value       = v;                                                                            \
-    e->key         = strdup(k);                                                                    \
-    return e;                                                                                      \
+  /* the slot holding `k`, or the empty slot where `k` would be inserted */                        \
+  static Name##Entry* find_slot_##Name(const Name* m, const char* k, unsigned hash) {              \
+    unsigned mask = m->capacity - 1;                                                               \
+    for (unsigned i = hash & mask;; i = (i + 1) & mask) {                                          \
+      Name##Entry* e = &m->entries[i];                                                             \
+      if (e->key == NULL || e->key == k) {                                                         \
+        return e;                                                                                  \
+      }                                                                                            \
+    }                                                                                              \
+  }                                                                                                \
+  /* rehash into `capacity` slots, which must hold all entries */                                  \
+  static void resize_##Name(Name* m, unsigned capacity) {                                          \
+    Name##Entry* old  = m->entries;                                                                \
+    unsigned old_size = m->capacity;                                                               \
+    m->capacity       = capacity;                                                                  \
+    m->entries        = alloc_##A(sizeof(Name##Entry) * m->capacity);                              \
+    for (unsigned i = 0; i < old_size; i++) {                                                      \
+      if (old[i].key != NULL) {                                                                    \
+        *find_slot_##Name(m, old[i].key, old[i].hash) = old[i];                                    \
+      }                                                                                            \
+    }                                                                                              \
+    free_##A(old);                                                                                 \
   }                                                                                                \
   void insert_##Name(Name* m, const char* k, T v) {                                                \
-    Name##Entry* e         = make_entry_##Name(k, v);                                              \
-    unsigned idx           = e->hash % length_##Name##Table(m->table);                             \
-    Name##Entries* es      = get_##Name##Table(m->table, idx);                                     \
-    Name##Entries* chained = cons_##Name##Entries(e, es);                                          \
-    set_##Name##Table(m->table, idx, chained);                                                     \
+    unsigned hash  = hash_interned(k);                                                             \
+    Name##Entry* e = find_slot_##Name(m, k, hash);                                                 \
+    if (e->key != NULL) {                                                                          \
+      e->value = v;                                                                                \
+      return;                                                                                      \
+    }                                                                                              \
+    /* keep the load factor under 3/4 */                                                           \
+    if ((m->count + 1) * 4 > m->capacity * 3) {                                                    \
+      resize_##Name(m, m->capacity * 2);                                                           \
+      e = find_slot_##Name(m, k, hash);                                                            \
+    }                                                                                              \
+    e->hash  = hash;                                                                               \
+    e->key   = k;                                                                                  \
+    e->value = v;                                                                                  \
+    m->count++;                                                                                    \
   }                                                                                                \
   T get_##Name(Name* m, const char* k) {                                                           \
     T out;                                                                                         \
@@ -101,76 +120,73 @@
     }                                                                                              \
     error("key \"%s\" not found", k);                                                              \
   }                                                                                                \
-  static bool search_##Name(Name##Entries* es, unsigned hash, T* out) {                            \
-    if (is_nil_##Name##Entries(es)) {                                                              \
+  bool lookup_##Name(Name* m, const char* k, T* out) {                                             \
+    Name##Entry* e = find_slot_##Name(m, k, hash_interned(k));                                     \
+    if (e->key == NULL) {                                                                          \
       return false;                                                                                \
     }                                                                                              \
-    Name##Entry* e = head_##Name##Entries(es);                                                     \
-    if (e->hash == hash) {                                                                         \
-      if (out != NULL) {                                                                           \
-        *out = e->value;                                                                           \
-      }                                                                                            \
-      return true;                                                                                 \
+    if (out != NULL) {                                                                             \
+      *out = e->value;                                                                             \
     }                                                                                              \
-    Name##Entries* t = tail_##Name##Entries(es);                                                   \
-    return search_##Name(t, hash, out);                                                            \
+    return true;                                                                                   \
   }                                                                                                \
-  bool lookup_##Name(Name* m, const char* k, T* out) {                                             \
-    unsigned hash     = hash_string(k);                                                            \
-    unsigned idx      = hash % length_##Name##Table(m->table);                                     \
-    Name##Entries* es = get_##Name##Table(m->table, idx);                                          \
-    return search_##Name(es, hash, out);                                                           \
-  }                                                                                                \
-  static void search_remove_##Name(Name##Entries* es, unsigned hash) {                             \
-    if (is_nil_##Name##Entries(es)) {                                                              \
+  void remove_##Name(Name* m, const char* k) {                                                     \
+    Name##Entry* e = find_slot_##Name(m, k, hash_interned(k));                                     \
+    if (e->key == NULL) {                                                                          \
       return;                                                                                      \
     }                                                                                              \
-    Name##Entry* e   = head_##Name##Entries(es);                                                   \
-    Name##Entries* t = tail_##Name##Entries(es);                                                   \
-    if (e->hash == hash) {                                                                         \
-      *es = *t;                                                                                    \
-      return;                                                                                      \
+    e->key = NULL;                                                                                 \
+    m->count--;                                                                                    \
+    /* shift back following entries so that probing never stops at the hole */                     \
+    unsigned mask = m->capacity - 1;                                                               \
+    unsigned hole = e - m->entries;                                                                \
+    for (unsigned i = (hole + 1) & mask; m->entries[i].key != NULL; i = (i + 1) & mask) {          \
+      unsigned home = m->entries[i].hash & mask;                                                   \
+      if (((i - home) & mask) >= ((i - hole) & mask)) {                                            \
+        m->entries[hole]  = m->entries[i];                                                         \
+        m->entries[i].key = NULL;                                                                  \
+        hole              = i;                                                                     \
+      }                                                                                            \
+    }                                                                                              \
+    /* halve the table once the load factor drops under 1/8 */                                     \
+    if (m->capacity > 8 && m->count * 8 < m->capacity) {                                           \
+      resize_##Name(m, m->capacity / 2);                                                           \
     }                                                                                              \
-    search_remove_##Name(t, hash);                                                                 \
-  }                                                                                                \
-  void remove_##Name(Name* m, const char* k) {                                                     \
-    unsigned hash     = hash_string(k);                                                            \
-    unsigned idx      = hash % length_##Name##Table(m->table);                                     \
-    Name##Entries* es = get_##Name##Table(m->table, idx);                                          \
-    search_remove_##Name(es, hash);                                                                \
   }                                                                                                \
+  unsigned length_##Name(const Name* m) { return m->count; }                                       \
   void release_##Name(Name* m) {                                                                   \
     if (m == NULL) {                                                                               \
       return;                                                                                      \
     }                                                                                              \
-    release_##Name##Table(m->table);                                                               \
+    for (unsigned i = 0; i < m->capacity; i++) {                                                   \
+      if (m->entries[i].key != NULL) {                                                             \
+        release_T(m->entries[i].value);                                                            \
+      }                                                                                            \
+    }                                                                                              \
+    free_##A(m->entries);                                                                          \
+    free_##A(m);                                                                                   \
   }
 
 #define DECLARE_MAP_PRINTER(Name) void print_##Name(FILE*, Name*);
 
 #define DEFINE_MAP_PRINTER(print_T, begin, sep, sep_kv, end, Name)                                 \
-  static void print_entries_##Name(FILE* p, Name##Entries* es) {                                   \
-    if (is_nil_##Name##Entries(es)) {                                                              \
-      return;                                                                                      \
-    }                                                                                              \
-    Name##Entry* e = head_##Name##Entries(es);                                                     \
-    fputs(e->key, p);                                                                              \
-    fputs(sep_kv, p);                                                                              \
-    print_T(p, e->value);                                                                          \
-    Name##Entries* t = tail_##Name##Entries(es);                                                   \
-    if (!is_nil_##Name##Entries(t)) {                                                              \
-      fputs(sep, p);                                                                               \
-    }                                                                                              \
-    print_entries_##Name(p, t);                                                                    \
-  }                                                                                                \
   void print_##Name(FILE* p, Name* m) {                                                            \
     fputs(begin, p);                                                                               \
-    for (unsigned i = 0; i < length_##Name##Table(m->table); i++) {                                \
-      print_entries_##Name(p, get_##Name##Table(m->table, i));                                     \
+    bool is_first = true;                                                                          \
+    for (unsigned i = 0; i < m->capacity; i++) {                                                   \
+      Name##Entry* e = &m->entries[i];                                                             \
+      if (e->key == NULL) {                                                                        \
+        continue;                                                                                  \
+      }                                                                                            \
+      if (!is_first) {                                                                             \
+        fputs(sep, p);                                                                             \
+      }                                                                                            \
+      is_first = false;                                                                            \
+      fputs(e->key, p);                                                                            \
+      fputs(sep_kv, p);                                                                            \
+      print_T(p, e->value);                                                                        \
     }                                                                                              \
     fputs(end, p);                                                                                 \
   }
 
-unsigned hash_string(const char*);
-
 #endif
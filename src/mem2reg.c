@@ -1,7 +1,10 @@
 #include "mem2reg.h"
 #include "bit_set.h"
+#include "mem_stats.h"
 #include "vector.h"
 
+DEFINE_TAGGED_ALLOCATOR(passes, MEM_PASSES)
+
 typedef struct {
   IR* ir;
   Function* function;
@@ -23,7 +26,8 @@ static void collect_uses(Env*, Function*);
 static void apply_conversion(Env*, Function*);
 static void compute_replaceable(Env*);
 
-void mem2reg(IR* ir) {
+bool mem2reg(IR* ir) {
+  bool changed    = false;
   FunctionList* l = ir->functions;
   while (!is_nil_FunctionList(l)) {
     Function* f = head_FunctionList(l);
@@ -31,18 +35,23 @@ void mem2reg(IR* ir) {
     Env* env = init_Env(f, ir);
     collect_uses(env, f);
     compute_replaceable(env);
-    apply_conversion(env, f);
+    // each replaceable register is defined by a stack address, which is removed
+    if (count_BitSet(env->replaceable) != 0) {
+      apply_conversion(env, f);
+      changed = true;
+    }
     finish_Env(env);
 
     l = tail_FunctionList(l);
   }
+  return changed;
 }
 
 static Env* init_Env(Function* f, IR* ir) {
   unsigned reg_count   = f->reg_count;
   unsigned stack_count = f->stack_count + 1;
 
-  Env* env        = malloc(sizeof(Env));
+  Env* env        = alloc_passes(sizeof(Env));
   env->function   = f;
   env->ir         = ir;
   env->candidates = zero_BitSet(reg_count);
@@ -66,7 +75,7 @@ static void finish_Env(Env* env) {
   release_BitSet(env->replaceable);
   release_UIVec(env->replaced_regs);
   release_UIVec(env->assoc_areas);
-  free(env);
+  free_passes(env);
 }
 
 static void set_reg(BitSet* s, Reg* r) {
@@ -181,10 +190,11 @@ static bool is_replaceable(Env* env, Reg* r) {
   return get_BitSet(env->replaceable, r->virtual);
 }
 
+// takes `rd` and `ra`
 static IRInst* new_move(Env* env, Reg* rd, Reg* ra) {
   IRInst* inst = new_inst(env->function->inst_count++, env->ir->inst_count++, IR_MOV);
-  inst->rd     = copy_Reg(rd);
-  push_RegVec(inst->ras, copy_Reg(ra));
+  inst->rd     = rd;
+  push_RegVec(inst->ras, ra);
   return inst;
 }
 
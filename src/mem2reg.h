@@ -3,6 +3,7 @@
 
 #include "ir.h"
 
-void mem2reg(IR*);
+// returns whether any function has been changed
+bool mem2reg(IR*);
 
 #endif
@@ -0,0 +1,177 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_stats.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#define usable_size(p) malloc_usable_size(p)
+#else
+#define usable_size(p) ((size_t)0)
+#endif
+
+static const char* tag_names[NUM_MEM_TAGS] = {
+    [MEM_TOKENS] = "tokens",   [MEM_AST] = "ast",   [MEM_TYPES] = "types",
+    [MEM_STRINGS] = "strings", [MEM_IR] = "ir",     [MEM_REGS] = "regs",
+    [MEM_BITSETS] = "bitsets", [MEM_MAPS] = "maps", [MEM_PASSES] = "passes",
+    [MEM_CONTAINERS] = "containers",
+};
+
+typedef struct {
+  atomic_ulong allocs;
+  atomic_long live;        // bytes
+  atomic_long peak;        // since `start_mem_stats`
+  atomic_long phase_peak;  // since the end of the previous phase
+} Counter;
+
+// the last one sums up all tags
+#define NUM_COUNTERS (NUM_MEM_TAGS + 1)
+
+static Counter counters[NUM_COUNTERS];
+static atomic_bool enabled;
+
+typedef struct {
+  const char* name;
+  unsigned long allocs[NUM_COUNTERS];  // since `start_mem_stats`
+  long live[NUM_COUNTERS];
+  long peak[NUM_COUNTERS];
+} Phase;
+
+// phases are closed by the main thread only
+static Phase* phases;
+static unsigned num_phases;
+static unsigned phase_capacity;
+
+void start_mem_stats() {
+  atomic_store(&enabled, true);
+}
+
+bool mem_stats_enabled() {
+  return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+void start_mem_stats_if_requested(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--mem-report") == 0) {
+      start_mem_stats();
+    }
+  }
+}
+
+static void raise_to(atomic_long* peak, long value) {
+  long old = atomic_load_explicit(peak, memory_order_relaxed);
+  while (value > old && !atomic_compare_exchange_weak_explicit(peak, &old, value,
+                                                               memory_order_relaxed,
+                                                               memory_order_relaxed)) {
+  }
+}
+
+static void add_bytes(Counter* c, long bytes) {
+  long live = atomic_fetch_add_explicit(&c->live, bytes, memory_order_relaxed) + bytes;
+  if (bytes > 0) {
+    raise_to(&c->peak, live);
+    raise_to(&c->phase_peak, live);
+  }
+}
+
+static void count(MemTag tag, long bytes, bool is_alloc) {
+  Counter* cs[] = {&counters[tag], &counters[NUM_MEM_TAGS]};
+  for (unsigned i = 0; i < 2; i++) {
+    if (is_alloc) {
+      atomic_fetch_add_explicit(&cs[i]->allocs, 1, memory_order_relaxed);
+    }
+    add_bytes(cs[i], bytes);
+  }
+}
+
+void* alloc_tagged(MemTag tag, size_t size) {
+  void* p = calloc(1, size);
+  if (p != NULL && mem_stats_enabled()) {
+    count(tag, usable_size(p), true);
+  }
+  return p;
+}
+
+void* realloc_tagged(MemTag tag, void* p, size_t size) {
+  if (!mem_stats_enabled()) {
+    return realloc(p, size);
+  }
+
+  long old_size = p == NULL ? 0 : usable_size(p);
+  void* new     = realloc(p, size);
+  if (new == NULL && size != 0) {
+    // `p` is left as is
+    return NULL;
+  }
+  long new_size = new == NULL ? 0 : usable_size(new);
+  count(tag, new_size - old_size, p == NULL);
+  return new;
+}
+
+void free_tagged(MemTag tag, void* p) {
+  if (p != NULL && mem_stats_enabled()) {
+    count(tag, -(long)usable_size(p), false);
+  }
+  free(p);
+}
+
+void end_mem_phase(const char* name) {
+  if (!mem_stats_enabled()) {
+    return;
+  }
+
+  if (num_phases == phase_capacity) {
+    phase_capacity = phase_capacity == 0 ? 16 : phase_capacity * 2;
+    phases         = realloc(phases, sizeof(Phase) * phase_capacity);
+  }
+
+  Phase* p = &phases[num_phases++];
+  p->name  = name;
+  for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+    Counter* c   = &counters[i];
+    p->allocs[i] = atomic_load(&c->allocs);
+    p->live[i]   = atomic_load(&c->live);
+    p->peak[i]   = atomic_exchange(&c->phase_peak, p->live[i]);
+  }
+}
+
+static const char* counter_name(unsigned i) {
+  return i == NUM_MEM_TAGS ? "total" : tag_names[i];
+}
+
+static void print_header(FILE* f, const char* title) {
+  fprintf(f, "%-16s %12s %14s %14s\n", title, "allocs", "live(B)", "peak(B)");
+}
+
+static void print_row(FILE* f, unsigned i, unsigned long allocs, long live, long peak) {
+  fprintf(f, "  %-14s %12lu %14ld %14ld\n", counter_name(i), allocs, live, peak);
+}
+
+void print_mem_report(FILE* f) {
+  if (!mem_stats_enabled()) {
+    return;
+  }
+#ifndef __GLIBC__
+  fprintf(f, "block sizes are not available; only allocations are counted\n");
+#endif
+
+  print_header(f, "memory by tag");
+  for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+    Counter* c = &counters[i];
+    print_row(f, i, atomic_load(&c->allocs), atomic_load(&c->live), atomic_load(&c->peak));
+  }
+
+  // per phase: allocations made in it, the usage at its end and the peak within it
+  for (unsigned k = 0; k < num_phases; k++) {
+    Phase* p = &phases[k];
+    print_header(f, p->name);
+    for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+      unsigned long allocs = p->allocs[i] - (k == 0 ? 0 : phases[k - 1].allocs[i]);
+      if (allocs == 0 && p->live[i] == 0 && i != NUM_MEM_TAGS) {
+        continue;
+      }
+      print_row(f, i, allocs, p->live[i], p->peak[i]);
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef CCC_MEM_STATS_H
+#define CCC_MEM_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// the subsystem an allocation is attributed to
+typedef enum {
+  MEM_TOKENS,
+  MEM_AST,
+  MEM_TYPES,
+  MEM_STRINGS,  // interned
+  MEM_IR,       // instructions, blocks and functions
+  MEM_REGS,
+  MEM_BITSETS,
+  MEM_MAPS,
+  MEM_PASSES,      // per-function state of passes and the register allocator
+  MEM_CONTAINERS,  // lists and vectors not attributed to any of the above
+} MemTag;
+
+#define NUM_MEM_TAGS (MEM_CONTAINERS + 1)
+
+// allocations are counted by tag once this is called, from any thread
+// blocks allocated before have to outlive the report, or `live` would be off by their sizes
+// bytes are the usable sizes of blocks, which are known only with glibc
+void start_mem_stats();
+bool mem_stats_enabled();
+// start if `--mem-report` is given, before anything is allocated to parse options
+void start_mem_stats_if_requested(int argc, char** argv);
+
+void* alloc_tagged(MemTag, size_t size);  // zero-initialized
+void* realloc_tagged(MemTag, void*, size_t size);  // uninitialized if given NULL
+void free_tagged(MemTag, void*);
+
+// define the allocator `A` (see `DEFINE_*_WITH` in list.h, vector.h and map.h) attributed to `tag`
+#define DEFINE_TAGGED_ALLOCATOR(A, tag)                                                            \
+  static inline void* alloc_##A(size_t size) { return alloc_tagged(tag, size); }                   \
+  static inline void* realloc_##A(void* p, size_t old_size, size_t new_size) {                     \
+    return realloc_tagged(tag, p, new_size);                                                       \
+  }                                                                                                \
+  static inline void free_##A(void* p) { free_tagged(tag, p); }
+
+// close a phase, which has begun at the end of the previous one (or at `start_mem_stats`)
+// does nothing unless started
+void end_mem_phase(const char* name);
+
+// live bytes, peak bytes and allocation counts by tag, overall and in each phase
+void print_mem_report(FILE*);
+
+#endif
@@ -50,23 +50,26 @@ static void merge_two(Function* f, BasicBlock* from, BasicBlock* to) {
       BBRefList* succs       = shallow_copy_BBRefList(to->succs);
       detach_BasicBlock(f, to);
       reconnect_blocks(from, succs);
+      release_BBRefList(succs);
       break;
     default:
       CCC_UNREACHABLE;
   }
 }
 
-void merge_blocks_search(BitSet* visited, Function* f, BasicBlock* b1) {
+// returns whether any blocks have been merged
+bool merge_blocks_search(BitSet* visited, Function* f, BasicBlock* b1) {
   if (get_BitSet(visited, b1->local_id)) {
-    return;
+    return false;
   }
   set_BitSet(visited, b1->local_id, true);
 
+  bool changed           = false;
   BBRefListIterator* it = front_BBRefList(b1->preds);
   while (!is_nil_BBRefListIterator(it)) {
     BasicBlock* b2 = data_BBRefListIterator(it);
     it             = next_BBRefListIterator(it);
-    merge_blocks_search(visited, f, b2);
+    changed |= merge_blocks_search(visited, f, b2);
   }
 
   if (!b1->is_call_bb && is_single_BBRefList(b1->preds)) {
@@ -77,19 +80,23 @@ void merge_blocks_search(BitSet* visited, Function* f, BasicBlock* b1) {
       }
 
       merge_two(f, t, b1);
+      return true;
     }
   }
+  return changed;
 }
 
-void merge_blocks(IR* ir) {
+bool merge_blocks(IR* ir) {
+  bool changed    = false;
   FunctionList* l = ir->functions;
   while (!is_nil_FunctionList(l)) {
     Function* f = head_FunctionList(l);
 
     BitSet* visited = zero_BitSet(f->bb_count);
-    merge_blocks_search(visited, f, f->exit);
+    changed |= merge_blocks_search(visited, f, f->exit);
     release_BitSet(visited);
 
     l = tail_FunctionList(l);
   }
+  return changed;
 }
@@ -3,6 +3,7 @@
 
 #include "ir.h"
 
-void merge_blocks(IR*);
+// returns whether any function has been changed
+bool merge_blocks(IR*);
 
 #endif
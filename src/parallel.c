@@ -0,0 +1,50 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "error.h"
+#include "parallel.h"
+
+typedef struct {
+  atomic_uint next;  // the next task to be claimed
+  unsigned count;
+  void (*task)(unsigned, void*);
+  void* data;
+} Work;
+
+static void* worker(void* arg) {
+  Work* w = arg;
+  for (;;) {
+    unsigned i = atomic_fetch_add(&w->next, 1);
+    if (i >= w->count) {
+      return NULL;
+    }
+    w->task(i, w->data);
+  }
+}
+
+void parallel_for(unsigned num_threads, unsigned count, void (*task)(unsigned, void*), void* data) {
+  Work w = {.count = count, .task = task, .data = data};
+  atomic_init(&w.next, 0);
+
+  if (num_threads > count) {
+    num_threads = count;
+  }
+  if (num_threads <= 1) {
+    worker(&w);
+    return;
+  }
+
+  unsigned num_spawned = num_threads - 1;
+  pthread_t* threads   = calloc(num_spawned, sizeof(pthread_t));
+  for (unsigned i = 0; i < num_spawned; i++) {
+    if (pthread_create(&threads[i], NULL, worker, &w) != 0) {
+      error("could not create a thread");
+    }
+  }
+  worker(&w);
+  for (unsigned i = 0; i < num_spawned; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+}
@@ -0,0 +1,9 @@
+#ifndef CCC_PARALLEL_H
+#define CCC_PARALLEL_H
+
+// call `task(i, data)` for each `i` in [0, count) on `num_threads` threads, the caller included
+// tasks are claimed one by one from a shared counter, so a thread that runs out of work takes the
+// next pending task instead of waiting on a fixed share
+void parallel_for(unsigned num_threads, unsigned count, void (*task)(unsigned, void*), void* data);
+
+#endif
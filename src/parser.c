@@ -4,9 +4,10 @@
 #include <string.h>
 
 #include "error.h"
-#include "map.h"
+#include "intern.h"
 #include "ops.h"
 #include "parser.h"
+#include "scoped_map.h"
 #include "util.h"
 
 typedef enum {
@@ -14,22 +15,28 @@ typedef enum {
   NAME_VARIABLE,
 } NameKind;
 
-DECLARE_MAP(NameKind, NameMap)
 static void release_NameKind(NameKind k) {}
-static NameKind copy_NameKind(NameKind k) {
-  return k;
-}
-DEFINE_MAP(copy_NameKind, release_NameKind, NameKind, NameMap)
+DECLARE_SCOPED_MAP(NameKind, NameMap)
+DEFINE_SCOPED_MAP(release_NameKind, NameKind, NameMap)
+
+// tokens are pulled from `lexer` into `window` as the parser looks ahead
+// `window` holds the tokens from `base` on, which are kept for backtracking until `drop_tokens`
+struct Parser {
+  Lexer* lexer;
+  TokenVec* window;
+  unsigned base;  // index of the first token in `window`
+  unsigned cur;   // index of the current token
 
-typedef struct {
-  TokenList* cur;
   NameMap* names;
-} Env;
+};
+
+typedef Parser Env;
 
-static Env* init_Env(TokenList* t) {
-  Env* env   = calloc(1, sizeof(Env));
-  env->cur   = t;
-  env->names = new_NameMap(64);
+static Env* init_Env(const char* input) {
+  Env* env    = calloc(1, sizeof(Env));
+  env->lexer  = new_Lexer(input);
+  env->window = new_TokenVec(64);
+  env->names  = new_NameMap(64);
   return env;
 }
 
@@ -37,7 +44,17 @@ static void add_name(Env* env, const char* name, NameKind kind) {
   insert_NameMap(env->names, name, kind);
 }
 
+static void start_scope(Env* env) {
+  start_scope_NameMap(env->names);
+}
+
+static void end_scope(Env* env) {
+  end_scope_NameMap(env->names);
+}
+
 static void release_Env(Env* env) {
+  release_Lexer(env->lexer);
+  release_TokenVec(env->window);
   release_NameMap(env->names);
   free(env);
 }
@@ -50,26 +67,47 @@ static bool is_typedef_name(Env* env, const char* name) {
   return k == NAME_TYPEDEF;
 }
 
+// the `n`-th token from the current one
+static Token peek(Env* env, unsigned n) {
+  unsigned idx = env->cur + n - env->base;
+  while (length_TokenVec(env->window) <= idx) {
+    push_TokenVec(env->window, next_token(env->lexer));
+  }
+  return get_TokenVec(env->window, idx);
+}
+
+// forget the tokens before the current one
+// no position saved for backtracking may be restored after this
+static void drop_tokens(Env* env) {
+  unsigned consumed = env->cur - env->base;
+  unsigned len      = length_TokenVec(env->window);
+  for (unsigned i = consumed; i < len; i++) {
+    set_TokenVec(env->window, i - consumed, get_TokenVec(env->window, i));
+  }
+  resize_TokenVec(env->window, len - consumed);
+  env->base = env->cur;
+}
+
 static void consume(Env* env) {
-  env->cur = tail_TokenList(env->cur);
+  env->cur++;
 }
 
-static Token* consuming(Env* env) {
-  TokenList* p = env->cur;
+static Token consuming(Env* env) {
+  Token t = peek(env, 0);
   consume(env);
-  return head_TokenList(p);
+  return t;
 }
 
-static Token* expect(Env* env, TokenKind k) {
-  Token* r = consuming(env);
-  if (r->kind != k) {
+static Token expect(Env* env, TokenKind k) {
+  Token r = consuming(env);
+  if (r.kind != k) {
     error("unexpected token");
   }
   return r;
 }
 
 static TokenKind head_of(Env* env) {
-  return head_TokenList(env->cur)->kind;
+  return peek(env, 0).kind;
 }
 
 // if head_of(env) == k, consume it and return true.
@@ -93,7 +131,7 @@ static DirectDeclarator* try_direct_declarator(Env* env, bool is_abstract) {
 
   DirectDeclarator* base = new_DirectDeclarator(is_abstract ? DE_DIRECT_ABSTRACT : DE_DIRECT);
   if (!is_abstract) {
-    base->name     = strdup(expect(env, TK_IDENT)->ident);
+    base->name     = expect(env, TK_IDENT).ident;
     base->name_ref = base->name;
   }
 
@@ -122,7 +160,7 @@ static DirectDeclarator* try_direct_declarator(Env* env, bool is_abstract) {
 }
 
 static Declarator* try_declarator(Env* env, bool is_abstract) {
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
 
   unsigned num_ptrs = 0;
   while (head_of(env) == TK_STAR) {
@@ -165,7 +203,7 @@ static DeclaratorList* declarator_list(Env* env) {
 static Expr* conditional(Env* env);
 
 static Enumerator* enumerator(Env* env) {
-  char* name  = strdup(expect(env, TK_IDENT)->ident);
+  const char* name  = expect(env, TK_IDENT).ident;
   Expr* value = NULL;
   if (head_of(env) == TK_EQUAL) {
     consume(env);
@@ -191,9 +229,9 @@ static EnumeratorList* enumerator_list(Env* env) {
 static EnumSpecifier* enum_specifier(Env* env) {
   expect(env, TK_ENUM);
 
-  char* tag = NULL;
+  const char* tag = NULL;
   if (head_of(env) == TK_IDENT) {
-    tag = strdup(expect(env, TK_IDENT)->ident);
+    tag = expect(env, TK_IDENT).ident;
   }
 
   if (head_of(env) == TK_LBRACE) {
@@ -236,9 +274,9 @@ static StructDeclarationList* struct_declaration_list(Env* env) {
 static StructSpecifier* struct_specifier(Env* env) {
   expect(env, TK_STRUCT);
 
-  char* tag = NULL;
+  const char* tag = NULL;
   if (head_of(env) == TK_IDENT) {
-    tag = strdup(expect(env, TK_IDENT)->ident);
+    tag = expect(env, TK_IDENT).ident;
   }
 
   if (head_of(env) == TK_LBRACE) {
@@ -266,9 +304,9 @@ static DeclarationSpecifiers* try_declaration_specifiers(Env* env) {
   bool is_const            = false;
   bool is_static           = false;
   bool is_extern           = false;
-  char* typedef_name       = NULL;
+  const char* typedef_name = NULL;
 
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
 
   for (;;) {
     switch (head_of(env)) {
@@ -333,7 +371,7 @@ static DeclarationSpecifiers* try_declaration_specifiers(Env* env) {
         enum_ = enum_specifier(env);
         break;
       case TK_IDENT: {
-        char* ident = head_TokenList(env->cur)->ident;
+        const char* ident = peek(env, 0).ident;
         if (is_typedef_name(env, ident)) {
           if (typedef_name != NULL) {
             error("too many typedef names in declaration specifiers");
@@ -365,7 +403,7 @@ static DeclarationSpecifiers* try_declaration_specifiers(Env* env) {
         } else {
           assert(typedef_name != NULL);
           s               = new_DeclarationSpecifiers(DS_TYPEDEF_NAME);
-          s->typedef_name = strdup(typedef_name);
+          s->typedef_name = typedef_name;
         }
         s->is_typedef = is_typedef;
         s->is_const   = is_const;
@@ -379,7 +417,8 @@ static DeclarationSpecifiers* try_declaration_specifiers(Env* env) {
 static DeclarationSpecifiers* declaration_specifiers(Env* env) {
   DeclarationSpecifiers* s = try_declaration_specifiers(env);
   if (s == NULL) {
-    print_TokenList(stderr, env->cur);
+    print_Token(stderr, peek(env, 0));
+    fputc('\n', stderr);
     error("could not parse declaration specifiers.");
   }
   return s;
@@ -429,7 +468,7 @@ static Initializer* initializer(Env* env) {
 }
 
 static InitializerList* try_initializer_list(Env* env) {
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
 
   InitializerList* cur  = nil_InitializerList();
   InitializerList* list = cur;
@@ -471,7 +510,7 @@ static InitDeclarator* try_init_declarator(Env* env, bool is_typedef) {
 }
 
 static InitDeclaratorList* try_init_declarator_list(Env* env, bool is_typedef) {
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
 
   InitDeclaratorList* cur  = nil_InitDeclaratorList();
   InitDeclaratorList* list = cur;
@@ -514,7 +553,7 @@ static Declaration* try_declaration(Env* env) {
 
   Declaration* d = new_declaration(s, dor);
 
-  if (consuming(env)->kind != TK_SEMICOLON) {
+  if (consuming(env).kind != TK_SEMICOLON) {
     return NULL;
   }
 
@@ -533,12 +572,12 @@ static Expr* term(Env* env) {
     }
   } else {
     if (head_of(env) == TK_NUMBER) {
-      return new_node_num(consuming(env)->number);
+      return new_node_num(consuming(env).number);
     } else if (head_of(env) == TK_IDENT) {
-      return new_node_var(consuming(env)->ident);
+      return new_node_var(consuming(env).ident);
     } else if (head_of(env) == TK_STRING) {
-      Token* tk = consuming(env);
-      return new_node_string(tk->string, tk->length);
+      const char* s = consuming(env).string;
+      return new_node_string(s, length_interned(s));
     } else {
       error("unexpected token.");
     }
@@ -586,12 +625,12 @@ static Expr* postfix(Env* env) {
         break;
       case TK_DOT:
         consume(env);
-        node = new_node_member(node, expect(env, TK_IDENT)->ident);
+        node = new_node_member(node, expect(env, TK_IDENT).ident);
         break;
       case TK_ARROW:
         consume(env);
         // `e->ident` is converted to `(e*)->ident`
-        node = new_node_member(new_node_deref(node), expect(env, TK_IDENT)->ident);
+        node = new_node_member(new_node_deref(node), expect(env, TK_IDENT).ident);
         break;
       case TK_DOUBLE_PLUS: {
         consume(env);
@@ -645,7 +684,7 @@ static Expr* unary(Env* env) {
     case TK_SIZEOF:
       consume(env);
       if (head_of(env) == TK_LPAREN) {
-        TokenList* save = env->cur;
+        unsigned save = env->cur;
         consume(env);
         TypeName* ty = try_type_name(env);
         if (ty != NULL) {
@@ -665,7 +704,7 @@ static Expr* cast(Env* env) {
     return unary(env);
   }
 
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
   consume(env);
 
   TypeName* ty = try_type_name(env);
@@ -999,6 +1038,7 @@ static Statement* statement(Env* env) {
     case TK_FOR: {
       consume(env);
       expect(env, TK_LPAREN);
+      start_scope(env);
 
       Expr* init             = NULL;
       Declaration* init_decl = NULL;
@@ -1030,6 +1070,7 @@ static Statement* statement(Env* env) {
 
       expect(env, TK_RPAREN);
       Statement* body = statement(env);
+      end_scope(env);
 
       Statement* s = new_statement(ST_FOR, NULL);
       s->init_decl = init_decl;
@@ -1051,9 +1092,11 @@ static Statement* statement(Env* env) {
     }
     case TK_LBRACE: {
       consume(env);
+      start_scope(env);
       Statement* s = new_statement(ST_COMPOUND, NULL);
       s->items     = block_item_list(env);
       expect(env, TK_RBRACE);
+      end_scope(env);
       return s;
     }
     case TK_SEMICOLON: {
@@ -1086,17 +1129,17 @@ static Statement* statement(Env* env) {
     }
     case TK_GOTO: {
       consume(env);
-      char* name    = expect(env, TK_IDENT)->ident;
+      const char* name    = expect(env, TK_IDENT).ident;
       Statement* s  = new_statement(ST_GOTO, NULL);
-      s->label_name = strdup(name);
+      s->label_name = name;
       return s;
     }
     case TK_IDENT: {
-      if (head_TokenList(tail_TokenList(env->cur))->kind == TK_COLON) {
-        char* name = expect(env, TK_IDENT)->ident;
+      if (peek(env, 1).kind == TK_COLON) {
+        const char* name = expect(env, TK_IDENT).ident;
         expect(env, TK_COLON);
         Statement* s  = new_statement(ST_LABEL, NULL);
-        s->label_name = strdup(name);
+        s->label_name = name;
         s->body       = statement(env);
         return s;
       }
@@ -1111,7 +1154,7 @@ static Statement* statement(Env* env) {
 }
 
 static BlockItem* block_item(Env* env) {
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
   Declaration* d  = try_declaration(env);
   if (d) {
     return new_block_item(BI_DECL, NULL, d);
@@ -1157,7 +1200,7 @@ static ParamList* parameter_list(Env* env) {
 static ExternalDecl* external_declaration(Env* env) {
   DeclarationSpecifiers* spec = declaration_specifiers(env);
 
-  TokenList* save = env->cur;
+  unsigned save = env->cur;
   Declarator* d   = try_declarator(env, false);
   if (d == NULL) {
     expect(env, TK_SEMICOLON);
@@ -1195,7 +1238,9 @@ static ExternalDecl* external_declaration(Env* env) {
     def->decl        = d;
     def->params      = params;
     def->is_vararg   = is_vararg;
-    def->items       = block_item_list(env);
+    start_scope(env);
+    def->items = block_item_list(env);
+    end_scope(env);
     expect(env, TK_RBRACE);
 
     ExternalDecl* edecl = new_external_decl(EX_FUNC);
@@ -1216,19 +1261,38 @@ static ExternalDecl* external_declaration(Env* env) {
   }
 }
 
+ExternalDecl* parse_external_decl(Parser* p) {
+  if (head_of(p) == TK_END) {
+    return NULL;
+  }
+  ExternalDecl* d = external_declaration(p);
+  // no backtracking across external declarations
+  drop_tokens(p);
+  return d;
+}
+
 static TranslationUnit* translation_unit(Env* env) {
   TranslationUnit* cur  = nil_TranslationUnit();
   TranslationUnit* list = cur;
 
-  while (head_of(env) != TK_END) {
-    cur = snoc_TranslationUnit(external_declaration(env), cur);
+  ExternalDecl* d;
+  while ((d = parse_external_decl(env)) != NULL) {
+    cur = snoc_TranslationUnit(d, cur);
   }
   return list;
 }
 
-// parse tokens into AST
-AST* parse(TokenList* t) {
-  Env* env              = init_Env(t);
+Parser* new_Parser(const char* input) {
+  return init_Env(input);
+}
+
+void release_Parser(Parser* p) {
+  release_Env(p);
+}
+
+// parse source into AST
+AST* parse(const char* input) {
+  Env* env              = init_Env(input);
   TranslationUnit* unit = translation_unit(env);
   release_Env(env);
   return unit;
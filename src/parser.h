@@ -6,7 +6,16 @@
 #include "ast.h"
 #include "lexer.h"
 
-// parse a list of tokens into AST.
-AST* parse(TokenList* tokens);
+// parse `input` into AST, lexing it on demand
+AST* parse(const char* input);
+
+// the state of `parse` between external declarations, to parse them one at a time
+typedef struct Parser Parser;
+
+// `input` is lexed on demand, so it has to outlive the parser
+Parser* new_Parser(const char* input);
+// the next external declaration, or NULL at the end of the input
+ExternalDecl* parse_external_decl(Parser*);
+void release_Parser(Parser*);
 
 #endif
@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include "data_flow.h"
+#include "dead_code_elim.h"
+#include "mem2reg.h"
+#include "mem_stats.h"
+#include "merge.h"
+#include "pass_manager.h"
+#include "peephole.h"
+#include "propagation.h"
+#include "reorder.h"
+#include "util.h"
+
+DEFINE_TAGGED_ALLOCATOR(passes, MEM_PASSES)
+
+static void release_pass_ref(const Pass* p) {}
+
+DEFINE_VECTOR(release_pass_ref, const Pass*, Pipeline)
+
+typedef struct {
+  Analysis kind;
+  const char* name;
+  void (*compute)(IR*);
+} AnalysisInfo;
+
+// in the order of computation when a pass requires several
+static const AnalysisInfo analyses[] = {
+    {ANALYSIS_REACH, "reach_data_flow", reach_data_flow},
+    {ANALYSIS_LIVE, "live_data_flow", live_data_flow},
+};
+
+// liveness only depends on successors and is kept by removing unreachable blocks, and by
+// renumbering instructions and blocks
+static const Pass passes[] = {
+    {"peephole", peephole, 0, 0},
+    {"mem2reg", mem2reg, 0, 0},
+    {"propagation", propagation, ANALYSIS_REACH, 0},
+    {"dead_code_elim", dead_code_elim, ANALYSIS_LIVE, 0},
+    {"remove_dead_blocks", remove_dead_blocks, 0, ANALYSIS_LIVE},
+    {"merge_blocks", merge_blocks, 0, 0},
+    {"reorder_blocks", reorder_blocks, 0, ANALYSIS_LIVE},
+};
+
+#define NUM_ANALYSES (sizeof(analyses) / sizeof(analyses[0]))
+#define NUM_PASSES (sizeof(passes) / sizeof(passes[0]))
+
+Pipeline* default_pipeline() {
+  Pipeline* v = new_Pipeline(NUM_PASSES);
+  for (unsigned i = 0; i < NUM_PASSES; i++) {
+    push_Pipeline(v, &passes[i]);
+  }
+  return v;
+}
+
+static const Pass* find_pass(const char* name, size_t len) {
+  for (unsigned i = 0; i < NUM_PASSES; i++) {
+    if (strlen(passes[i].name) == len && strncmp(passes[i].name, name, len) == 0) {
+      return &passes[i];
+    }
+  }
+  return NULL;
+}
+
+Pipeline* parse_pipeline(const char* names, char** unknown) {
+  Pipeline* v = new_Pipeline(NUM_PASSES);
+  if (*names == '\0') {
+    return v;
+  }
+
+  for (;;) {
+    const char* end = strchr(names, ',');
+    size_t len      = end == NULL ? strlen(names) : (size_t)(end - names);
+
+    const Pass* p = find_pass(names, len);
+    if (p == NULL) {
+      *unknown = strndup(names, len);
+      release_Pipeline(v);
+      return NULL;
+    }
+    push_Pipeline(v, p);
+
+    if (end == NULL) {
+      return v;
+    }
+    names = end + 1;
+  }
+}
+
+struct PassManager {
+  IR* ir;
+  const Pipeline* pipeline;
+
+  unsigned valid;       // analyses up to date
+  unsigned generation;  // the number of runs that changed the function
+  UIVec* clean_at;      // pipeline index -> the generation the pass left unchanged, or -1
+
+  PassObserver observer;  // nullable
+  void* data;
+};
+
+PassManager* new_PassManager(IR* ir, const Pipeline* pipeline, PassObserver observer, void* data) {
+  PassManager* pm = alloc_passes(sizeof(PassManager));
+  pm->ir          = ir;
+  pm->pipeline    = pipeline;
+  pm->observer    = observer;
+  pm->data        = data;
+
+  unsigned length = length_Pipeline(pipeline);
+  pm->clean_at    = new_UIVec(length);
+  resize_UIVec(pm->clean_at, length);
+  fill_UIVec(pm->clean_at, -1);
+  return pm;
+}
+
+static void compute_analyses(PassManager* pm, unsigned required) {
+  for (unsigned i = 0; i < NUM_ANALYSES; i++) {
+    const AnalysisInfo* a = &analyses[i];
+    if (!(required & a->kind) || (pm->valid & a->kind)) {
+      continue;
+    }
+
+    if (pm->observer == NULL) {
+      a->compute(pm->ir);
+    } else {
+      Timer t = start_Timer(true);
+      a->compute(pm->ir);
+      pm->observer(pm->data, a->name, stop_Timer(&t));
+    }
+    pm->valid |= a->kind;
+  }
+}
+
+bool run_pass(PassManager* pm, const Pass* pass) {
+  compute_analyses(pm, pass->requires);
+
+  bool changed;
+  if (pm->observer == NULL) {
+    changed = pass->run(pm->ir);
+  } else {
+    Timer t = start_Timer(true);
+    changed = pass->run(pm->ir);
+    pm->observer(pm->data, pass->name, stop_Timer(&t));
+  }
+
+  if (changed) {
+    pm->valid &= pass->preserves;
+    pm->generation++;
+  }
+  return changed;
+}
+
+bool run_pipeline(PassManager* pm) {
+  bool dirty = false;
+  for (unsigned i = 0; i < length_Pipeline(pm->pipeline); i++) {
+    // a pass run on the very same function again would not change it either
+    if (get_UIVec(pm->clean_at, i) == pm->generation) {
+      continue;
+    }
+
+    if (run_pass(pm, get_Pipeline(pm->pipeline, i))) {
+      dirty = true;
+    } else {
+      set_UIVec(pm->clean_at, i, pm->generation);
+    }
+  }
+  return dirty;
+}
+
+void release_PassManager(PassManager* pm) {
+  release_UIVec(pm->clean_at);
+  free_passes(pm);
+}
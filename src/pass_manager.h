@@ -0,0 +1,50 @@
+#ifndef CCC_PASS_MANAGER_H
+#define CCC_PASS_MANAGER_H
+
+#include <stdbool.h>
+
+#include "ir.h"
+#include "time_report.h"
+#include "vector.h"
+
+// analyses cached per function, as a set of bits
+typedef enum {
+  ANALYSIS_REACH = 1 << 0,  // reach_data_flow
+  ANALYSIS_LIVE  = 1 << 1,  // live_data_flow
+} Analysis;
+
+typedef struct {
+  const char* name;
+  bool (*run)(IR*);    // returns whether the function has been changed
+  unsigned requires;   // analyses computed before `run`, if not cached
+  unsigned preserves;  // analyses left valid even if the function has been changed
+} Pass;
+
+DECLARE_VECTOR(const Pass*, Pipeline)
+
+// the optimization pipeline used unless configured
+Pipeline* default_pipeline();
+
+// `names` is a comma-separated list of passes
+// NULL is returned and `*unknown` is set to the offending name (to be freed) on an unknown one
+Pipeline* parse_pipeline(const char* names, char** unknown);
+
+// called with the measurement of every pass and analysis run
+typedef void (*PassObserver)(void* data, const char* name, Measure);
+
+// runs passes on a single function, keeping analyses and cleanness of passes across runs
+typedef struct PassManager PassManager;
+
+// `ir` holds a single function; `observer` may be NULL
+PassManager* new_PassManager(IR* ir, const Pipeline* pipeline, PassObserver, void* data);
+
+// run every pass of the pipeline once, skipping ones that are known to change nothing
+// returns whether the function has been changed
+bool run_pipeline(PassManager*);
+
+// run `pass` outside of the pipeline
+bool run_pass(PassManager*, const Pass*);
+
+void release_PassManager(PassManager*);
+
+#endif
@@ -23,7 +23,8 @@ static bool try_log2(unsigned long in, unsigned long* out) {
   return true;
 }
 
-static void modify_inst(IRInstList* list, IRInstListIterator* it) {
+// returns whether `inst` was modified
+static bool modify_inst(IRInstList* list, IRInstListIterator* it) {
   IRInst* inst = data_IRInstListIterator(it);
   switch (inst->kind) {
     case IR_BIN_IMM:
@@ -32,85 +33,88 @@ static void modify_inst(IRInstList* list, IRInstListIterator* it) {
         case ARITH_SUB:
           if (inst->imm == 0) {
             disable_inst(list, it, inst);
+            return true;
           }
-          break;
+          return false;
         case ARITH_MUL:
           switch (inst->imm) {
             case 1:
               disable_inst(list, it, inst);
-              break;
+              return true;
             case 0:
               inst->kind = IR_IMM;
-              resize_RegVec(inst->ras, 0);
-              break;
+              truncate_ras(inst, 0);
+              return true;
             default: {
               unsigned long c;
               if (try_log2(inst->imm, &c)) {
                 inst->binary_op = ARITH_SHIFT_LEFT;
                 inst->imm       = c;
+                return true;
               }
-              break;
+              return false;
             }
           }
-          break;
         case ARITH_DIV:
           switch (inst->imm) {
             case 1:
               disable_inst(list, it, inst);
-              break;
+              return true;
             case 0:
-              break;
+              return false;
             default: {
               unsigned long c;
               if (try_log2(inst->imm, &c)) {
                 inst->binary_op = ARITH_SHIFT_RIGHT;
                 inst->imm       = c;
+                return true;
               }
-              break;
+              return false;
             }
           }
-          break;
         default:
-          break;
+          return false;
       }
-      break;
     case IR_BR_CMP_IMM:
       if (inst->imm != 0) {
-        break;
+        return false;
       }
       switch (inst->predicate_op) {
         case CMP_NE:
           inst->kind = IR_BR;
-          break;
+          return true;
         case CMP_EQ:
           inst->kind      = IR_BR;
           BasicBlock* tmp = inst->then_;
           inst->then_     = inst->else_;
           inst->else_     = tmp;
-          break;
+          return true;
         default:
-          break;
+          return false;
       }
-      break;
     default:
-      break;
+      return false;
   }
 }
 
-static void peephole_function(Function* ir) {
+static bool peephole_function(Function* ir) {
+  bool changed           = false;
   IRInstListIterator* it = front_IRInstList(ir->instructions);
   while (!is_nil_IRInstListIterator(it)) {
     IRInstListIterator* next = next_IRInstListIterator(it);
-    modify_inst(ir->instructions, it);
+    changed |= modify_inst(ir->instructions, it);
     it = next;
   }
+  return changed;
 }
 
-void peephole(IR* ir) {
+bool peephole(IR* ir) {
+  bool changed    = false;
   FunctionList* l = ir->functions;
   while (!is_nil_FunctionList(l)) {
     Function* f = head_FunctionList(l);
-    peephole_function(f);
+    changed |= peephole_function(f);
     l = tail_FunctionList(l);
   }
+  return changed;
 }
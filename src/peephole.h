@@ -3,6 +3,7 @@
 
 #include "ir.h"
 
-void peephole(IR*);
+// returns whether any function has been changed
+bool peephole(IR*);
 
 #endif
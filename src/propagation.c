@@ -1,20 +1,64 @@
 #include "propagation.h"
+#include "data_flow.h"
+#include "mem_stats.h"
 #include "util.h"
 
+DEFINE_TAGGED_ALLOCATOR(passes, MEM_PASSES)
+
 typedef struct {
   Function* f;
   IR* ir;
+
+  BBRefVec* parents;  // inst local id -> block containing it
+  BitSet* reach;      // reach-in set of the instruction being visited
+
+  bool changed;
 } Env;
 
 static Env* init_Env(IR* ir, Function* f) {
-  Env* env = malloc(sizeof(Env));
-  env->f   = f;
-  env->ir  = ir;
+  Env* env     = alloc_passes(sizeof(Env));
+  env->f       = f;
+  env->ir      = ir;
+  env->parents = new_BBRefVec(f->inst_count);
+  env->reach   = NULL;
+  env->changed = false;
+  resize_BBRefVec(env->parents, f->inst_count);
+  fill_BBRefVec(env->parents, NULL);
+
+  for (BBListIterator* it1 = front_BBList(f->blocks); !is_nil_BBListIterator(it1);
+       it1                 = next_BBListIterator(it1)) {
+    BasicBlock* b = data_BBListIterator(it1);
+    for (IRInstListIterator* it2 = b->instructions->from;; it2 = next_IRInstListIterator(it2)) {
+      set_BBRefVec(env->parents, data_IRInstListIterator(it2)->local_id, b);
+      if (it2 == b->instructions->to) {
+        break;
+      }
+    }
+  }
   return env;
 }
 
 static void finish_Env(Env* env) {
-  free(env);
+  release_BBRefVec(env->parents);
+  release_BitSet(env->reach);
+  free_passes(env);
+}
+
+static BasicBlock* find_parent_block(Env* env, IRInst* inst) {
+  BasicBlock* b = get_BBRefVec(env->parents, inst->local_id);
+  assert(b != NULL);
+  return b;
+}
+
+static void set_parent_block(Env* env, IRInst* inst, BasicBlock* b) {
+  if (length_BBRefVec(env->parents) <= inst->local_id) {
+    unsigned prev = length_BBRefVec(env->parents);
+    resize_BBRefVec(env->parents, inst->local_id + 1);
+    for (unsigned i = prev; i < inst->local_id; i++) {
+      set_BBRefVec(env->parents, i, NULL);
+    }
+  }
+  set_BBRefVec(env->parents, inst->local_id, b);
 }
 
 static Reg* new_reg(Env* env, DataSize size) {
@@ -49,21 +93,8 @@ static bool get_imm(Env* env, Reg* r, long* out) {
   return false;
 }
 
-static BasicBlock* find_parent_block(IRInst* inst) {
-  // TODO: Use cheaper way to obtain corresponding block
-  assert(inst->kind == IR_BR || inst->kind == IR_BR_CMP || inst->kind == IR_BR_CMP_IMM);
-  for (BBRefListIterator* it = front_BBRefList(inst->then_->preds); !is_nil_BBRefListIterator(it);
-       it                    = next_BBRefListIterator(it)) {
-    BasicBlock* b = data_BBRefListIterator(it);
-    if (last_IRInstRange(b->instructions) == inst) {
-      return b;
-    }
-  }
-  CCC_UNREACHABLE;
-}
-
-static void elim_branch(bool c, IRInst* inst) {
-  BasicBlock* bb = find_parent_block(inst);
+static void elim_branch(Env* env, bool c, IRInst* inst) {
+  BasicBlock* bb = find_parent_block(env, inst);
   BasicBlock *selected, *discarded;
   if (c) {
     selected  = inst->then_;
@@ -76,48 +107,72 @@ static void elim_branch(bool c, IRInst* inst) {
   inst->kind  = IR_JUMP;
   inst->jump  = selected;
   inst->then_ = inst->else_ = NULL;
-  resize_RegVec(inst->ras, 0);
+  truncate_ras(inst, 0);
+  env->changed = true;
 }
 
-static Reg* obtain_propagated_reg(Env* env, IRInst* inst, IRInst* def, Reg* r) {
-  BitSet* set = copy_BitSet(r->definitions);
-  and_BitSet(set, inst->reach_in);
-
-  if (count_BitSet(set) == 0) {
-    Reg* escape_reg = new_reg(env, r->size);
-    IRInst* mov     = new_move(env, escape_reg, r);
-
-    IRInstListIterator* it = get_iterator_IRInstList(env->f->instructions, def->local_id);
-    insert_IRInstListIterator(env->f->instructions, it, mov);
+// whether a definition of `r` reaches the instruction being visited
+static bool reaches(Env* env, Reg* r) {
+  return intersects_BitSet(env->reach, r->definitions);
+}
 
-    return escape_reg;
-  } else {
+// `r` itself if a definition of it reaches the instruction being visited (`reached`), or an escape
+// register copied from it right before `def` otherwise
+static Reg* obtain_propagated_reg(Env* env, IRInst* def, Reg* r, bool reached) {
+  if (reached) {
     return copy_Reg(r);
   }
-  release_BitSet(set);
+
+  Reg* escape_reg = new_reg(env, r->size);
+  IRInst* mov     = new_move(env, escape_reg, r);
+
+  IRInstListIterator* it = get_iterator_IRInstList(env->f->instructions, def->local_id);
+  insert_IRInstListIterator(env->f->instructions, it, mov);
+  set_parent_block(env, mov, find_parent_block(env, def));
+
+  return escape_reg;
 }
 
-static bool copy_propagation(Env* env, IRInst* inst, IRInst* def, Reg** out) {
+// operands rewritten earlier in the walk may be registers created in this pass, which are not
+// analyzed until the next iteration
+static bool is_analyzed(Reg* r) {
+  return r->definitions != NULL;
+}
+
+// no escape register is made unless `escape` is true
+static bool copy_propagation(Env* env, IRInst* def, bool escape, Reg** out) {
   Reg* r = get_RegVec(def->ras, 0);
   if (r->kind == REG_FIXED) {
     // TODO: Remove this after implementation of split in reg_alloc
     return false;
   }
+  if (!is_analyzed(r)) {
+    return false;
+  }
+  bool reached = reaches(env, r);
+  if (!reached && !escape) {
+    return false;
+  }
 
-  *out = obtain_propagated_reg(env, inst, def, r);
+  *out         = obtain_propagated_reg(env, def, r, reached);
+  env->changed = true;
   return true;
 }
 
-static bool copy_propagation2(Env* env, IRInst* inst, IRInst* def, Reg** out0, Reg** out1) {
+static bool copy_propagation2(Env* env, IRInst* def, Reg** out0, Reg** out1) {
   Reg* r0 = get_RegVec(def->ras, 0);
   Reg* r1 = get_RegVec(def->ras, 1);
   if (r0->kind == REG_FIXED || r1->kind == REG_FIXED) {
     // TODO: Remove this after implementation of split in reg_alloc
     return false;
   }
+  if (!is_analyzed(r0) || !is_analyzed(r1)) {
+    return false;
+  }
 
-  *out0 = obtain_propagated_reg(env, inst, def, r0);
-  *out1 = obtain_propagated_reg(env, inst, def, r1);
+  *out0        = obtain_propagated_reg(env, def, r0, reaches(env, r0));
+  *out1        = obtain_propagated_reg(env, def, r1, reaches(env, r1));
+  env->changed = true;
   return true;
 }
 
@@ -130,7 +185,8 @@ static void perform_propagation(Env* env, IRInst* inst) {
       if (get_imm(env, r, &imm)) {
         inst->kind = IR_IMM;
         inst->imm  = imm;
-        resize_RegVec(inst->ras, 0);
+        truncate_ras(inst, 0);
+        env->changed = true;
       }
       break;
     }
@@ -145,12 +201,14 @@ static void perform_propagation(Env* env, IRInst* inst) {
           long c     = eval_ArithOp(inst->binary_op, lhs_imm, rhs_imm);
           inst->kind = IR_IMM;
           inst->imm  = c;
-          resize_RegVec(inst->ras, 0);
-        } else {
-          // not foldable, but able to propagate
+          truncate_ras(inst, 0);
+          env->changed = true;
+        } else if (inst->binary_op != ARITH_DIV && inst->binary_op != ARITH_REM) {
+          // not foldable, but able to propagate unless into `idiv`, which takes no immediate
           inst->kind = IR_BIN_IMM;
           inst->imm  = rhs_imm;
-          resize_RegVec(inst->ras, 1);
+          truncate_ras(inst, 1);
+          env->changed = true;
         }
       }
       break;
@@ -166,12 +224,14 @@ static void perform_propagation(Env* env, IRInst* inst) {
           bool c     = eval_CompareOp(inst->predicate_op, lhs_imm, rhs_imm);
           inst->kind = IR_IMM;
           inst->imm  = c;
-          resize_RegVec(inst->ras, 0);
+          truncate_ras(inst, 0);
+          env->changed = true;
         } else {
           // not foldable, but able to propagate
           inst->kind = IR_CMP_IMM;
           inst->imm  = rhs_imm;
-          resize_RegVec(inst->ras, 1);
+          truncate_ras(inst, 1);
+          env->changed = true;
         }
       }
       break;
@@ -185,12 +245,13 @@ static void perform_propagation(Env* env, IRInst* inst) {
         if (get_imm(env, lhs, &lhs_imm)) {
           // foldable
           bool c = eval_CompareOp(inst->predicate_op, lhs_imm, rhs_imm);
-          elim_branch(c, inst);
+          elim_branch(env, c, inst);
         } else {
           // not foldable, but able to propagate
           inst->kind = IR_BR_CMP_IMM;
           inst->imm  = rhs_imm;
-          resize_RegVec(inst->ras, 1);
+          truncate_ras(inst, 1);
+          env->changed = true;
         }
       }
       break;
@@ -204,7 +265,8 @@ static void perform_propagation(Env* env, IRInst* inst) {
         long c     = eval_ArithOp(inst->binary_op, lhs_imm, inst->imm);
         inst->kind = IR_IMM;
         inst->imm  = c;
-        resize_RegVec(inst->ras, 0);
+        truncate_ras(inst, 0);
+        env->changed = true;
       }
       break;
     }
@@ -217,7 +279,8 @@ static void perform_propagation(Env* env, IRInst* inst) {
         bool c     = eval_CompareOp(inst->predicate_op, lhs_imm, inst->imm);
         inst->kind = IR_IMM;
         inst->imm  = c;
-        resize_RegVec(inst->ras, 0);
+        truncate_ras(inst, 0);
+        env->changed = true;
       }
       break;
     }
@@ -228,7 +291,7 @@ static void perform_propagation(Env* env, IRInst* inst) {
       if (get_imm(env, lhs, &lhs_imm)) {
         // foldable
         bool c = eval_CompareOp(inst->predicate_op, lhs_imm, inst->imm);
-        elim_branch(c, inst);
+        elim_branch(env, c, inst);
       }
       break;
     }
@@ -244,7 +307,7 @@ static void perform_propagation(Env* env, IRInst* inst) {
       }
 
       Reg* rr;
-      if (copy_propagation(env, inst, def, &rr)) {
+      if (copy_propagation(env, def, true, &rr)) {
         inst->kind = IR_MOV;
         release_Reg(get_RegVec(inst->ras, 0));
         set_RegVec(inst->ras, 0, rr);
@@ -262,7 +325,7 @@ static void perform_propagation(Env* env, IRInst* inst) {
       switch (def->kind) {
         case IR_ZEXT: {
           Reg* rr;
-          if (copy_propagation(env, inst, def, &rr)) {
+          if (copy_propagation(env, def, true, &rr)) {
             release_Reg(get_RegVec(inst->ras, 0));
             set_RegVec(inst->ras, 0, rr);
           }
@@ -270,7 +333,7 @@ static void perform_propagation(Env* env, IRInst* inst) {
         }
         case IR_CMP: {
           Reg *r0, *r1;
-          if (copy_propagation2(env, inst, def, &r0, &r1)) {
+          if (copy_propagation2(env, def, &r0, &r1)) {
             release_Reg(get_RegVec(inst->ras, 0));
             set_RegVec(inst->ras, 0, r0);
             push_RegVec(inst->ras, r1);
@@ -282,7 +345,7 @@ static void perform_propagation(Env* env, IRInst* inst) {
         }
         case IR_CMP_IMM: {
           Reg* rr;
-          if (copy_propagation(env, inst, def, &rr)) {
+          if (copy_propagation(env, def, true, &rr)) {
             release_Reg(get_RegVec(inst->ras, 0));
             set_RegVec(inst->ras, 0, rr);
 
@@ -320,30 +383,48 @@ static void perform_propagation(Env* env, IRInst* inst) {
       continue;
     }
 
+    // the escape register would be a copy of `def`, placed right before it
     Reg* rr;
-    if (copy_propagation(env, inst, def, &rr)) {
+    if (copy_propagation(env, def, false, &rr)) {
       release_Reg(get_RegVec(inst->ras, i));
       set_RegVec(inst->ras, i, rr);
     }
   }
 }
 
-static void propagation_function(IR* ir, Function* f) {
-  for (IRInstListIterator* it = back_IRInstList(f->instructions); !is_nil_IRInstListIterator(it);
-       it                     = prev_IRInstListIterator(it)) {
-    IRInst* inst = data_IRInstListIterator(it);
+// blocks are walked forward with the reach set, as `dead_code_elim` does with the live set
+static bool propagation_function(IR* ir, Function* f) {
+  Env* env = init_Env(ir, f);
+  for (BBListIterator* it1 = front_BBList(f->blocks); !is_nil_BBListIterator(it1);
+       it1                 = next_BBListIterator(it1)) {
+    BasicBlock* b = data_BBListIterator(it1);
+    if (env->reach == NULL) {
+      env->reach = copy_BitSet(b->reach_in);
+    } else {
+      copy_to_BitSet(env->reach, b->reach_in);
+    }
 
-    Env* env = init_Env(ir, f);
-    perform_propagation(env, inst);
-    finish_Env(env);
+    for (IRInstListIterator* it2 = b->instructions->from;; it2 = next_IRInstListIterator(it2)) {
+      IRInst* inst = data_IRInstListIterator(it2);
+      perform_propagation(env, inst);
+      step_reach_forward(f, env->reach, inst);
+      if (it2 == b->instructions->to) {
+        break;
+      }
+    }
   }
+  bool changed = env->changed;
+  finish_Env(env);
+  return changed;
 }
 
-void propagation(IR* ir) {
+bool propagation(IR* ir) {
+  bool changed    = false;
   FunctionList* l = ir->functions;
   while (!is_nil_FunctionList(l)) {
     Function* f = head_FunctionList(l);
-    propagation_function(ir, f);
+    changed |= propagation_function(ir, f);
     l = tail_FunctionList(l);
   }
+  return changed;
 }
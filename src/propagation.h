@@ -3,6 +3,7 @@
 
 #include "ir.h"
 
-void propagation(IR*);
+// returns whether any function has been changed
+bool propagation(IR*);
 
 #endif
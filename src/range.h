@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "util.h"
+
 #define DECLARE_RANGE(T, TList, Name)                                                              \
   typedef struct {                                                                                 \
     TList##Iterator* from;                                                                         \
@@ -23,19 +25,22 @@
   Name* copy_##Name(const Name* list);                                                             \
   void release_##Name(Name* list);
 
-#define DEFINE_RANGE(T, TList, Name)                                                               \
+#define DEFINE_RANGE(T, TList, Name) DEFINE_RANGE_WITH(heap, T, TList, Name)
+
+// allocated with `alloc_##A` and freed with `free_##A` (see util.h and arena.h)
+#define DEFINE_RANGE_WITH(A, T, TList, Name)                                                       \
   struct Name##Iterator {                                                                          \
     TList##Iterator* inner;                                                                        \
     Name* range;                                                                                   \
   };                                                                                               \
   static Name##Iterator* new_##Name##Iterator(TList##Iterator* inner, const Name* range) {         \
-    Name##Iterator* it = malloc(sizeof(Name##Iterator));                                           \
+    Name##Iterator* it = alloc_##A(sizeof(Name##Iterator));                                        \
     it->inner          = inner;                                                                    \
     it->range          = (Name*)range;                                                             \
     return it;                                                                                     \
   }                                                                                                \
   Name* new_unchecked_##Name(TList##Iterator* from, TList##Iterator* to) {                         \
-    Name* new = malloc(sizeof(Name));                                                              \
+    Name* new = alloc_##A(sizeof(Name));                                                           \
     new->from = from;                                                                              \
     new->to   = to;                                                                                \
     return new;                                                                                    \
@@ -75,6 +80,6 @@
            iter->inner == next_##TList##Iterator(iter->range->to);                                 \
   }                                                                                                \
   Name* copy_##Name(const Name* list) { return new_##Name(list->from, list->to); }                 \
-  void release_##Name(Name* list) { free(list); }
+  void release_##Name(Name* list) { free_##A(list); }
 
 #endif
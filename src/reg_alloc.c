@@ -1,492 +1,2514 @@
+#include <stdatomic.h>
+
 #include "reg_alloc.h"
 #include "arch.h"
 #include "bit_set.h"
-#include "indexed_list.h"
-#include "list.h"
+#include "mem_stats.h"
 #include "vector.h"
 
+DEFINE_TAGGED_ALLOCATOR(passes, MEM_PASSES)
+
+// linear scan over intervals with lifetime holes (Wimmer and Mössenböck, "Optimized Interval
+// Splitting in a Linear Scan Register Allocator")
+// an interval is split when it cannot stay in one register, at a block boundary or before a use,
+// and the parts on the stack are reloaded before their uses. locations that differ between split
+// parts are reconciled by moves at the split point or on CFG edges
+// registers which are never on the stack at once share a slot, and the slots are laid out in the
+// frame together with local variables
+// registers holding constants or addresses are computed again instead of being reloaded, and are
+// never stored
+// registers living through calls are given callee-saved registers if possible, since caller-saved
+// ones are saved and restored around each call; such a register is put on the stack across calls
+// instead when that is cheaper, weighting each move by the depth of loops it is executed in
+// with `RA_COLOR`, the parts are colored in an interference graph instead of the linear scan, see
+// `color_intervals`
+
 // TODO: Type and distinguish real and virtual register index
 // TODO: Stop using -1 or 0 to mark something
 
-static void release_unsigned(unsigned i) {}
-DECLARE_LIST(unsigned, UIList)
-DEFINE_LIST(release_unsigned, unsigned, UIList)
-
-DECLARE_INDEXED_LIST(unsigned, UIIList)
-DEFINE_INDEXED_LIST(release_unsigned, unsigned, UIIList)
-
-typedef struct {
-  UIIList* active;     // owned, a list of virtual registers
-  UIIList* available;  // owned, a list of real registers
-  UIVec* used_by;      // owned, -1 -> not used
-  UIVec* result;       // owned, -1 -> not allocated, -2 -> spilled
-  UIVec* locations;    // owned, -1 -> not spilled
-  unsigned usable_regs_count;
-  unsigned reserved_for_spill;
+static void release_interval_ref(Interval* iv) {}
+DECLARE_VECTOR(Interval*, IntervalRefVec)
+DEFINE_VECTOR(release_interval_ref, Interval*, IntervalRefVec)
 
-  unsigned* global_count;
+static void release_iterator_ref(IRInstListIterator* it) {}
+DECLARE_VECTOR(IRInstListIterator*, InstIterRefVec)
+DEFINE_VECTOR(release_iterator_ref, IRInstListIterator*, InstIterRefVec)
 
-  Function* f;
-} Env;
+static void release_inst_ref(IRInst* inst) {}
+DECLARE_VECTOR(IRInst*, InstRefVec)
+DEFINE_VECTOR(release_inst_ref, IRInst*, InstRefVec)
 
-static void add_to_available(Env* env, unsigned real);
+DECLARE_VECTOR(LiveRanges*, LiveRangesVec)
+DEFINE_VECTOR(release_LiveRanges, LiveRanges*, LiveRangesVec)
 
-static Env* init_Env(Function* f, unsigned* global_count, unsigned real_count) {
-  unsigned virt_count = f->reg_count;
+// a register, or the stack
+typedef struct {
+  unsigned real;  // -1 -> on the stack
+  unsigned slot;  // for `real == -1`, the virtual register or `temp_slot`
+} Location;
 
-  Env* env                = calloc(1, sizeof(Env));
-  env->f                  = f;
-  env->usable_regs_count  = real_count - 1;
-  env->reserved_for_spill = real_count - 1;
-  env->active             = new_UIIList(virt_count);
-  env->available          = new_UIIList(env->usable_regs_count);
-  env->used_by            = new_UIVec(env->usable_regs_count);
-  resize_UIVec(env->used_by, env->usable_regs_count);
-  fill_UIVec(env->used_by, -1);
+typedef struct {
+  Location from;
+  Location to;
+} Move;
 
-  env->result = new_UIVec(virt_count);
-  resize_UIVec(env->result, virt_count);
-  fill_UIVec(env->result, -1);
+static void release_Move(Move m) {}
+DECLARE_VECTOR(Move, MoveVec)
+DEFINE_VECTOR(release_Move, Move, MoveVec)
 
-  env->locations = new_UIVec(virt_count);
-  resize_UIVec(env->locations, virt_count);
-  fill_UIVec(env->locations, -1);
+static void release_MoveVec_(MoveVec* v) {
+  release_MoveVec(v);
+}
+DECLARE_VECTOR(MoveVec*, MoveVecVec)
+DEFINE_VECTOR(release_MoveVec_, MoveVec*, MoveVecVec)
 
-  env->global_count = global_count;
+typedef struct {
+  Function* f;
+  unsigned* global_inst_count;
+  unsigned* global_bb_count;
+  unsigned num_regs;
+
+  InstIterRefVec* insts;  // owned, position / 2 -> instruction
+  BBRefVec* blocks;       // owned, position / 2 -> the block of the instruction
+  UIVec* block_from;      // owned, local id of a block -> position of its label
+  UIVec* block_to;        // owned, local id of a block -> position after its last instruction
+  unsigned block_count;   // before blocks are inserted on edges
+  UIVec* calls;           // owned, positions of calls, ascending
+  UIVec* loop_depth;      // owned, local id of a block -> the number of loops it is in
+
+  UIVec* order;  // owned, real registers in the order of preference
+
+  IntervalRefVec* unhandled;  // owned, a binary heap ordered by `from`
+  IntervalRefVec* active;     // owned, intervals in registers which cover the current position
+  IntervalRefVec* inactive;   // owned, ditto, in a lifetime hole at the current position
+  RegIntervals* fixed;        // owned, real -> uses of the real register by fixed registers
+
+  UIVec* free_until;  // owned, real -> position, used in `try_alloc_free_reg`
+  UIVec* use_pos;     // owned, ditto, in `spill_at_interval`
+  UIVec* block_pos;   // owned, ditto
+
+  UIVec* sizes;                // owned, virtual -> the largest size it is accessed in
+  unsigned temp_slot;          // to break cycles of moves, numbered next to virtual registers
+  bool temp_used;              // whether `temp_slot` is needed
+  LiveRangesVec* stack_lives;  // owned, slot -> positions where the slot is in use, or NULL
+  InstRefVec* stack_insts;     // owned, loads and stores whose `stack_idx` is a slot for now
+  InstRefVec* remat_defs;      // owned, virtual -> its only definition if cheap to repeat, or NULL
+
+  RegAllocStats stats;
+} Env;
 
-  for (unsigned i = 0; i < env->usable_regs_count; i++) {
-    add_to_available(env, i);
+static bool compare_priority(Function* f, unsigned r1, unsigned r2);
+
+static Env* init_Env(Function* f,
+                     unsigned* global_inst_count,
+                     unsigned* global_bb_count,
+                     unsigned real_count) {
+  Env* env               = alloc_passes(sizeof(Env));
+  env->f                 = f;
+  env->global_inst_count = global_inst_count;
+  env->global_bb_count   = global_bb_count;
+  env->num_regs          = real_count;
+
+  env->insts      = new_InstIterRefVec(f->inst_count);
+  env->blocks     = new_BBRefVec(f->inst_count);
+  env->block_from = new_UIVec(f->bb_count);
+  resize_UIVec(env->block_from, f->bb_count);
+  env->block_to = new_UIVec(f->bb_count);
+  resize_UIVec(env->block_to, f->bb_count);
+  env->calls      = new_UIVec(f->call_count + 1);
+  env->loop_depth = new_UIVec(f->bb_count);
+  resize_UIVec(env->loop_depth, f->bb_count);
+  fill_UIVec(env->loop_depth, 0);
+
+  env->order = new_UIVec(real_count);
+  for (unsigned r = 0; r < real_count; r++) {
+    unsigned i = 0;
+    while (i < length_UIVec(env->order) && !compare_priority(f, r, get_UIVec(env->order, i))) {
+      i++;
+    }
+    push_UIVec(env->order, r);
+    for (unsigned j = length_UIVec(env->order) - 1; j > i; j--) {
+      set_UIVec(env->order, j, get_UIVec(env->order, j - 1));
+    }
+    set_UIVec(env->order, i, r);
   }
 
+  env->unhandled = new_IntervalRefVec(f->reg_count);
+  env->active    = new_IntervalRefVec(real_count);
+  env->inactive  = new_IntervalRefVec(real_count);
+
+  env->free_until = new_UIVec(real_count);
+  resize_UIVec(env->free_until, real_count);
+  env->use_pos = new_UIVec(real_count);
+  resize_UIVec(env->use_pos, real_count);
+  env->block_pos = new_UIVec(real_count);
+  resize_UIVec(env->block_pos, real_count);
+
+  env->sizes = new_UIVec(f->reg_count);
+  resize_UIVec(env->sizes, f->reg_count);
+  fill_UIVec(env->sizes, 0);
+  env->temp_slot   = f->reg_count;
+  env->stack_lives = new_LiveRangesVec(f->reg_count + 1);
+  resize_LiveRangesVec(env->stack_lives, f->reg_count + 1);
+  fill_LiveRangesVec(env->stack_lives, NULL);
+  env->stack_insts = new_InstRefVec(16);
+  env->remat_defs  = new_InstRefVec(f->reg_count);
+  resize_InstRefVec(env->remat_defs, f->reg_count);
+  fill_InstRefVec(env->remat_defs, NULL);
+
   return env;
 }
 
 static void release_Env(Env* env) {
-  release_UIIList(env->active);
-  release_UIIList(env->available);
-  release_UIVec(env->used_by);
-  release_UIVec(env->result);
-  release_UIVec(env->locations);
-  free(env);
+  release_InstIterRefVec(env->insts);
+  release_BBRefVec(env->blocks);
+  release_UIVec(env->block_from);
+  release_UIVec(env->block_to);
+  release_UIVec(env->calls);
+  release_UIVec(env->loop_depth);
+  release_UIVec(env->order);
+  release_IntervalRefVec(env->unhandled);
+  release_IntervalRefVec(env->active);
+  release_IntervalRefVec(env->inactive);
+  release_RegIntervals(env->fixed);
+  release_UIVec(env->free_until);
+  release_UIVec(env->use_pos);
+  release_UIVec(env->block_pos);
+  release_UIVec(env->sizes);
+  release_LiveRangesVec(env->stack_lives);
+  release_InstRefVec(env->stack_insts);
+  release_InstRefVec(env->remat_defs);
+  free_passes(env);
 }
 
 static IRInst* new_inst_(Env* env, IRInstKind kind) {
-  return new_inst(env->f->inst_count++, (*env->global_count)++, kind);
+  return new_inst(env->f->inst_count++, (*env->global_inst_count)++, kind);
 }
 
 static Interval* interval_of(Env* env, unsigned virtual) {
   return get_RegIntervals(env->f->intervals, virtual);
 }
 
+// the definition to compute the register again in place of reloading it from `slot`, or NULL
+static IRInst* remat_def(Env* env, unsigned slot) {
+  return slot == env->temp_slot ? NULL : get_InstRefVec(env->remat_defs, slot);
+}
+
+static BasicBlock* block_at(Env* env, unsigned pos) {
+  return get_BBRefVec(env->blocks, pos / 2);
+}
+
+static unsigned block_from(Env* env, BasicBlock* b) {
+  return get_UIVec(env->block_from, b->local_id);
+}
+
+static unsigned block_to(Env* env, BasicBlock* b) {
+  return get_UIVec(env->block_to, b->local_id);
+}
+
 // return true if r1 is preferred than r2
-static bool compare_priority(Env* env, unsigned r1, unsigned r2) {
-  if (get_BitSet(env->f->used_fixed_regs, r1)) {
+static bool compare_priority(Function* f, unsigned r1, unsigned r2) {
+  if (get_BitSet(f->used_fixed_regs, r1)) {
     return false;
   }
-  if (get_BitSet(env->f->used_fixed_regs, r2)) {
+  if (get_BitSet(f->used_fixed_regs, r2)) {
     return true;
   }
 
-  if (env->f->call_count > 0) {
+  if (f->call_count > 0) {
     return is_scratch[r1] < is_scratch[r2];
   } else {
     return is_scratch[r1] > is_scratch[r2];
   }
 }
 
-static void add_to_available(Env* env, unsigned real) {
-  UIIListIterator* it = front_UIIList(env->available);
-  while (true) {
-    if (is_nil_UIIListIterator(it) || compare_priority(env, real, data_UIIListIterator(it))) {
-      insert_with_idx_UIIListIterator(env->available, real, it, real);
-      break;
+// the register with the largest value, the most preferred one among ties
+static unsigned best_reg(Env* env, UIVec* values) {
+  unsigned best = get_UIVec(env->order, 0);
+  for (unsigned i = 1; i < length_UIVec(env->order); i++) {
+    unsigned r = get_UIVec(env->order, i);
+    if (get_UIVec(values, r) > get_UIVec(values, best)) {
+      best = r;
     }
-    it = next_UIIListIterator(it);
   }
+  return best;
 }
 
-static void add_to_active(Env* env, unsigned target_virt) {
-  Interval* current = interval_of(env, target_virt);
+static void number_positions(Env* env) {
+  for (BBListIterator* it = front_BBList(env->f->blocks); !is_nil_BBListIterator(it);
+       it                 = next_BBListIterator(it)) {
+    BasicBlock* b = data_BBListIterator(it);
+    set_UIVec(env->block_from, b->local_id, length_InstIterRefVec(env->insts) * 2);
 
-  UIIListIterator* it = front_UIIList(env->active);
-  while (true) {
-    if (is_nil_UIIListIterator(it) ||
-        interval_of(env, data_UIIListIterator(it))->to > current->to) {
-      insert_with_idx_UIIListIterator(env->active, target_virt, it, target_virt);
-      break;
+    for (IRInstListIterator* it2 = b->instructions->from;; it2 = next_IRInstListIterator(it2)) {
+      if (data_IRInstListIterator(it2)->kind == IR_CALL) {
+        push_UIVec(env->calls, length_InstIterRefVec(env->insts) * 2);
+      }
+      push_InstIterRefVec(env->insts, it2);
+      push_BBRefVec(env->blocks, b);
+      if (it2 == b->instructions->to) {
+        break;
+      }
     }
-    it = next_UIIListIterator(it);
+
+    set_UIVec(env->block_to, b->local_id, length_InstIterRefVec(env->insts) * 2);
+    env->block_count++;
   }
 }
 
-static unsigned find_free_reg(Env* env) {
-  if (is_empty_UIIList(env->available)) {
-    error("no free reg found");
+// collect edges to blocks on the current path of the depth-first search as pairs of (from, to)
+static void find_back_edges(BBRefVec* edges, BitSet* visited, BitSet* on_path, BasicBlock* b) {
+  set_BitSet(visited, b->local_id, true);
+  set_BitSet(on_path, b->local_id, true);
+
+  for (BBRefListIterator* it = front_BBRefList(b->succs); !is_nil_BBRefListIterator(it);
+       it                    = next_BBRefListIterator(it)) {
+    BasicBlock* s = data_BBRefListIterator(it);
+    if (get_BitSet(on_path, s->local_id)) {
+      push_BBRefVec(edges, b);
+      push_BBRefVec(edges, s);
+    } else if (!get_BitSet(visited, s->local_id)) {
+      find_back_edges(edges, visited, on_path, s);
+    }
   }
-  return head_UIIList(env->available);
-}
 
-static void alloc_specific_reg(Env* env, unsigned virtual, unsigned real) {
-  assert(get_UIVec(env->used_by, real) == -1);
-  set_UIVec(env->used_by, real, virtual);
-  set_UIVec(env->result, virtual, real);
-  remove_by_idx_UIIListIterator(env->available, real);
-  add_to_active(env, virtual);
+  set_BitSet(on_path, b->local_id, false);
 }
 
-static void alloc_reg(Env* env, unsigned virtual) {
-  unsigned real = find_free_reg(env);
-  alloc_specific_reg(env, virtual, real);
+// a loop is made of its header and the blocks reaching a back edge to it without passing it
+static void calc_loop_depth(Env* env) {
+  Function* f     = env->f;
+  BBRefVec* edges = new_BBRefVec(8);
+  BitSet* visited = zero_BitSet(f->bb_count);
+  BitSet* on_path = zero_BitSet(f->bb_count);
+  find_back_edges(edges, visited, on_path, f->entry);
+  release_BitSet(visited);
+  release_BitSet(on_path);
+
+  // loops which share the header are counted as one
+  BitSet* headers = zero_BitSet(f->bb_count);
+  BBRefVec* work  = new_BBRefVec(8);
+  for (unsigned i = 0; i < length_BBRefVec(edges); i += 2) {
+    BasicBlock* header = get_BBRefVec(edges, i + 1);
+    if (get_BitSet(headers, header->local_id)) {
+      continue;
+    }
+    set_BitSet(headers, header->local_id, true);
+
+    BitSet* body = zero_BitSet(f->bb_count);
+    set_BitSet(body, header->local_id, true);
+    for (unsigned j = i; j < length_BBRefVec(edges); j += 2) {
+      BasicBlock* from = get_BBRefVec(edges, j);
+      if (get_BBRefVec(edges, j + 1) == header && !get_BitSet(body, from->local_id)) {
+        set_BitSet(body, from->local_id, true);
+        push_BBRefVec(work, from);
+      }
+    }
+    while (length_BBRefVec(work) != 0) {
+      BasicBlock* b = get_BBRefVec(work, length_BBRefVec(work) - 1);
+      resize_BBRefVec(work, length_BBRefVec(work) - 1);
+      for (BBRefListIterator* it = front_BBRefList(b->preds); !is_nil_BBRefListIterator(it);
+           it                    = next_BBRefListIterator(it)) {
+        BasicBlock* p = data_BBRefListIterator(it);
+        if (!get_BitSet(body, p->local_id)) {
+          set_BitSet(body, p->local_id, true);
+          push_BBRefVec(work, p);
+        }
+      }
+    }
+
+    for (unsigned id = 0; id < f->bb_count; id++) {
+      if (get_BitSet(body, id)) {
+        set_UIVec(env->loop_depth, id, get_UIVec(env->loop_depth, id) + 1);
+      }
+    }
+    release_BitSet(body);
+  }
+  release_BBRefVec(work);
+  release_BitSet(headers);
+  release_BBRefVec(edges);
 }
 
-static void release_reg(Env* env, unsigned virtual) {
-  unsigned real = get_UIVec(env->result, virtual);
-  assert(real != -1 && real != -2);
+// the estimated number of times the instruction at `pos` is executed, relative to the others
+static unsigned long weight_at(Env* env, unsigned pos) {
+  unsigned depth       = get_UIVec(env->loop_depth, block_at(env, pos)->local_id);
+  unsigned long weight = 1;
+  for (unsigned i = 0; i < depth && i < 6; i++) {
+    weight *= 10;
+  }
+  return weight;
+}
 
-  set_UIVec(env->used_by, real, -1);
-  remove_by_idx_UIIListIterator(env->active, virtual);
-  add_to_available(env, real);
+static Interval* new_interval(IntervalKind kind, unsigned virtual) {
+  Interval* iv = alloc_tagged(MEM_REGS, sizeof(Interval));
+  iv->kind     = kind;
+  iv->virtual  = virtual;
+  iv->from     = -1;
+  iv->to       = -1;
+  iv->ranges   = new_LiveRanges(1);
+  iv->uses     = new_UIVec(2);
+  iv->real     = -1;
+  return iv;
 }
 
-static void expire_old_intervals(Env* env, Interval* target_iv) {
-  UIIListIterator* it = front_UIIList(env->active);
-  while (!is_nil_UIIListIterator(it)) {
-    unsigned virtual = data_UIIListIterator(it);
-    Interval* intv   = interval_of(env, virtual);
-    if (intv->to > target_iv->from) {
-      return;
+// the index of the first range which ends after `pos`
+static unsigned find_range(Interval* iv, unsigned pos) {
+  unsigned lo = 0;
+  unsigned hi = length_LiveRanges(iv->ranges);
+  while (lo < hi) {
+    unsigned mid = (lo + hi) / 2;
+    if (get_LiveRanges(iv->ranges, mid).to <= pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-    // NOTE: obtain `it` earlier because `release_reg` modifies active list
-    it = next_UIIListIterator(it);
-
-    release_reg(env, virtual);
   }
+  return lo;
 }
 
-static void alloc_stack(Env* env, unsigned virt) {
-  // TODO: Store the size of spilled registers and use that here
-  env->f->stack_count += 8;
-  set_UIVec(env->locations, virt, env->f->stack_count);
-  set_UIVec(env->result, virt, -2);  // mark as spilled
+static bool covers(Interval* iv, unsigned pos) {
+  unsigned i = find_range(iv, pos);
+  return i < length_LiveRanges(iv->ranges) && get_LiveRanges(iv->ranges, i).from <= pos;
 }
 
-static void spill_reg(Env* env, unsigned virt) {
-  release_reg(env, virt);
-  alloc_stack(env, virt);
-}
-
-static void spill_at_interval(Env* env, unsigned target) {
-  UIIListIterator* spill_ptr = back_UIIList(env->active);
-  unsigned spill;
-  Interval* spill_intv = NULL;
-  while (true) {
-    spill      = data_UIIListIterator(spill_ptr);
-    spill_intv = interval_of(env, spill);
-    if (spill_intv->kind != IV_FIXED) {
-      break;
+// the position of the first call from `pos` which `iv` lives through, -1 if not found
+static unsigned next_call_through(Env* env, Interval* iv, unsigned pos) {
+  unsigned lo = 0;
+  unsigned hi = length_UIVec(env->calls);
+  while (lo < hi) {
+    unsigned mid = (lo + hi) / 2;
+    if (get_UIVec(env->calls, mid) < pos) {
+      lo = mid + 1;
     } else {
-      spill_ptr = prev_UIIListIterator(spill_ptr);
+      hi = mid;
     }
   }
-  assert(spill_intv->kind != IV_FIXED);
-  Interval* target_intv = interval_of(env, target);
-  if (spill_intv->to > target_intv->to) {
-    unsigned r = get_UIVec(env->result, spill);
-    spill_reg(env, spill);
-    alloc_specific_reg(env, target, r);
-  } else {
-    alloc_stack(env, target);
+  for (unsigned i = lo; i < length_UIVec(env->calls); i++) {
+    unsigned call = get_UIVec(env->calls, i);
+    if (call >= iv->to) {
+      break;
+    }
+    if (covers(iv, call) && covers(iv, call + 1)) {
+      return call;
+    }
   }
+  return -1;
 }
 
-static void sort_intervals_insert_reg(RegIntervals* ivs, Interval* t, unsigned v, UIList* l) {
-  if (is_nil_UIList(l)) {
-    insert_UIList(v, l);
-    return;
+// the first position from `pos` where the both are alive, -1 if not found
+static unsigned next_intersection(Interval* a, Interval* b, unsigned pos) {
+  unsigned i = find_range(a, pos);
+  unsigned j = find_range(b, pos);
+  while (i < length_LiveRanges(a->ranges) && j < length_LiveRanges(b->ranges)) {
+    LiveRange ra = get_LiveRanges(a->ranges, i);
+    LiveRange rb = get_LiveRanges(b->ranges, j);
+
+    unsigned from = ra.from > rb.from ? ra.from : rb.from;
+    from          = from > pos ? from : pos;
+    unsigned to   = ra.to < rb.to ? ra.to : rb.to;
+    if (from < to) {
+      return from;
+    }
+
+    if (ra.to <= rb.to) {
+      i++;
+    } else {
+      j++;
+    }
   }
+  return -1;
+}
 
-  Interval* intv = get_RegIntervals(ivs, head_UIList(l));
-  if (intv->from > t->from) {
-    insert_UIList(v, l);
-    return;
+// the index of the first use from `pos`
+static unsigned find_use(Interval* iv, unsigned pos) {
+  unsigned lo = 0;
+  unsigned hi = length_UIVec(iv->uses);
+  while (lo < hi) {
+    unsigned mid = (lo + hi) / 2;
+    if (get_UIVec(iv->uses, mid) < pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
+  return lo;
+}
 
-  sort_intervals_insert_reg(ivs, t, v, tail_UIList(l));
+// the first use from `pos`, -1 if not found
+static unsigned next_use(Interval* iv, unsigned pos) {
+  unsigned i = find_use(iv, pos);
+  return i == length_UIVec(iv->uses) ? -1 : get_UIVec(iv->uses, i);
 }
 
-// TODO: Faster sort
-static UIList* sort_intervals(RegIntervals* ivs) {
-  unsigned len   = length_RegIntervals(ivs);
-  UIList* result = nil_UIList();
-  for (unsigned i = 0; i < len; i++) {
-    Interval* interval = get_RegIntervals(ivs, i);
-    sort_intervals_insert_reg(ivs, interval, i, result);
+// the first position from `pos` where `iv` is alive, -1 if not found
+static unsigned next_alive(Interval* iv, unsigned pos) {
+  unsigned i = find_range(iv, pos);
+  if (i == length_LiveRanges(iv->ranges)) {
+    return -1;
   }
-  return result;
+  unsigned from = get_LiveRanges(iv->ranges, i).from;
+  return from > pos ? from : pos;
 }
 
-static void walk_regs(Env* env, UIList* l) {
-  if (is_nil_UIList(l)) {
-    return;
+// the latest position up to `pos` where a value can be moved between locations
+// no moves are inserted into call blocks, because registers are saved and restored around them
+static unsigned spill_position(Env* env, unsigned pos) {
+  BasicBlock* b = block_at(env, pos);
+  return b->is_call_bb ? block_from(env, b) : pos;
+}
+
+// ditto, where a register can be loaded before the instruction reads it
+static unsigned reload_position(Env* env, unsigned pos) {
+  return spill_position(env, pos & ~1u);
+}
+
+static bool is_block_start(Env* env, unsigned pos) {
+  return block_from(env, block_at(env, pos)) == pos;
+}
+
+// split `iv` at `pos`; the rest is returned and linked after `iv`
+static Interval* split_interval(Interval* iv, unsigned pos) {
+  assert(iv->from < pos && pos < iv->to);
+
+  Interval* rest = new_interval(iv->kind, iv->virtual);
+
+  unsigned i = find_range(iv, pos);
+  for (unsigned j = i; j < length_LiveRanges(iv->ranges); j++) {
+    LiveRange r = get_LiveRanges(iv->ranges, j);
+    if (r.from < pos) {
+      r.from = pos;
+    }
+    push_LiveRanges(rest->ranges, r);
+  }
+  if (get_LiveRanges(iv->ranges, i).from < pos) {
+    ptr_LiveRanges(iv->ranges, i)->to = pos;
+    i++;
   }
+  resize_LiveRanges(iv->ranges, i);
 
-  unsigned virtual = head_UIList(l);
-  Interval* iv     = interval_of(env, virtual);
+  unsigned k = find_use(iv, pos);
+  for (unsigned j = k; j < length_UIVec(iv->uses); j++) {
+    push_UIVec(rest->uses, get_UIVec(iv->uses, j));
+  }
+  resize_UIVec(iv->uses, k);
 
-  expire_old_intervals(env, iv);
+  rest->from = get_LiveRanges(rest->ranges, 0).from;
+  rest->to   = iv->to;
+  iv->to     = get_LiveRanges(iv->ranges, i - 1).to;
 
-  switch (iv->kind) {
-    case IV_VIRTUAL:
-      if (is_empty_UIIList(env->available)) {
-        spill_at_interval(env, virtual);
-      } else {
-        alloc_reg(env, virtual);
-      }
+  rest->next = iv->next;
+  iv->next   = rest;
+  return rest;
+}
+
+static bool precedes(Interval* a, Interval* b) {
+  return a->from < b->from || (a->from == b->from && a->virtual < b->virtual);
+}
+
+static void swap_intervals(IntervalRefVec* v, unsigned i, unsigned j) {
+  Interval* t = get_IntervalRefVec(v, i);
+  set_IntervalRefVec(v, i, get_IntervalRefVec(v, j));
+  set_IntervalRefVec(v, j, t);
+}
+
+static void push_unhandled(Env* env, Interval* iv) {
+  IntervalRefVec* h = env->unhandled;
+  push_IntervalRefVec(h, iv);
+  for (unsigned i = length_IntervalRefVec(h) - 1; i > 0;) {
+    unsigned parent = (i - 1) / 2;
+    if (!precedes(get_IntervalRefVec(h, i), get_IntervalRefVec(h, parent))) {
       break;
-    case IV_FIXED: {
-      unsigned u = get_UIVec(env->used_by, iv->fixed_real);
-      if (u != -1) {
-        spill_reg(env, u);
+    }
+    swap_intervals(h, i, parent);
+    i = parent;
+  }
+}
+
+static Interval* pop_unhandled(Env* env) {
+  IntervalRefVec* h = env->unhandled;
+  unsigned len      = length_IntervalRefVec(h);
+  Interval* top     = get_IntervalRefVec(h, 0);
+  set_IntervalRefVec(h, 0, get_IntervalRefVec(h, len - 1));
+  resize_IntervalRefVec(h, --len);
+  for (unsigned i = 0;;) {
+    unsigned min = i;
+    for (unsigned c = 2 * i + 1; c <= 2 * i + 2 && c < len; c++) {
+      if (precedes(get_IntervalRefVec(h, c), get_IntervalRefVec(h, min))) {
+        min = c;
       }
-      alloc_specific_reg(env, virtual, iv->fixed_real);
-      break;
     }
-    case IV_UNSET:
-      assert(iv->from == -1 && iv->to == -1);
+    if (min == i) {
       break;
-    default:
-      CCC_UNREACHABLE;
+    }
+    swap_intervals(h, i, min);
+    i = min;
   }
+  return top;
+}
 
-  walk_regs(env, tail_UIList(l));
+// the order is not kept
+static void remove_interval_at(IntervalRefVec* v, unsigned i) {
+  unsigned len = length_IntervalRefVec(v);
+  set_IntervalRefVec(v, i, get_IntervalRefVec(v, len - 1));
+  resize_IntervalRefVec(v, len - 1);
 }
 
-static bool assign_reg(Env* env, Reg* r) {
-  unsigned real = get_UIVec(env->result, r->virtual);
-  if (real == -1) {
-    error("failed to allocate register: %d", r->virtual);
-  }
+// slots are shared and placed in the frame after all moves are inserted, see `allocate_frame`
+static void alloc_stack(Env* env, Interval* iv) {
+  iv->real = -1;
+}
 
-  if (r->kind == REG_FIXED) {
-    assert(r->real == real);
+// whether `iv` can be on the stack from `pos` until it is reloaded before the next use
+static bool can_spill_from(Env* env, Interval* iv, unsigned pos) {
+  unsigned at = spill_position(env, pos);
+  // moves to and from the part are inserted before different instructions, unless the part starts
+  // at a block and is joined with the previous one on the edges, so that it is spilled as a whole
+  if ((at & ~1u) <= iv->from && !(at <= iv->from && is_block_start(env, iv->from))) {
+    return false;
   }
 
-  r->kind = REG_REAL;
-
-  if (real == -2) {
-    r->real = env->reserved_for_spill;
+  unsigned use = next_use(iv, at);
+  if (use == -1) {
     return true;
   }
+  unsigned reload = reload_position(env, use);
+  return reload > next_alive(iv, at) && reload >= pos;
+}
 
-  r->real = real;
-  return false;
+// put `iv` on the stack from `pos`, see `can_spill_from`
+static void spill_from(Env* env, Interval* iv, unsigned pos) {
+  unsigned at    = spill_position(env, pos);
+  Interval* rest = at <= iv->from ? iv : split_interval(iv, at);
+  unsigned use   = next_use(rest, rest->from);
+  if (use != -1) {
+    push_unhandled(env, split_interval(rest, reload_position(env, use)));
+  }
+  alloc_stack(env, rest);
 }
 
-static void emit_spill_load(Env* env, Reg* r, IRInstListIterator* it) {
-  IRInst* inst    = new_inst_(env, IR_STACK_LOAD);
-  inst->rd        = copy_Reg(r);
-  inst->stack_idx = get_UIVec(env->locations, r->virtual);
-  inst->data_size = r->size;
-  insert_IRInstListIterator(env->f->instructions, it, inst);
+// a register free for the whole `current`, callee-saved one first if `current` lives through calls
+// and caller-saved one first otherwise, or the one free the longest if there is no such register
+static unsigned choose_free_reg(Env* env, Interval* current) {
+  bool through_calls = next_call_through(env, current, current->from) != -1;
+  unsigned other     = -1;
+  for (unsigned i = 0; i < length_UIVec(env->order); i++) {
+    unsigned r = get_UIVec(env->order, i);
+    if (get_UIVec(env->free_until, r) < current->to) {
+      continue;
+    }
+    if (is_scratch[r] != through_calls) {
+      return r;
+    }
+    if (other == -1) {
+      other = r;
+    }
+  }
+  return other != -1 ? other : best_reg(env, env->free_until);
 }
 
-static void emit_spill_store(Env* env, Reg* r, IRInstListIterator* it) {
-  IRInst* inst = new_inst_(env, IR_STACK_STORE);
-  push_RegVec(inst->ras, copy_Reg(r));
-  inst->stack_idx = get_UIVec(env->locations, r->virtual);
-  inst->data_size = r->size;
+static bool try_alloc_free_reg(Env* env, Interval* current) {
+  fill_UIVec(env->free_until, -1);
 
-  insert_IRInstListIterator(env->f->instructions, it, inst);
+  for (unsigned i = 0; i < length_IntervalRefVec(env->active); i++) {
+    Interval* iv = get_IntervalRefVec(env->active, i);
+    set_UIVec(env->free_until, iv->real, 0);
+  }
+  for (unsigned i = 0; i < length_IntervalRefVec(env->inactive); i++) {
+    Interval* iv = get_IntervalRefVec(env->inactive, i);
+    unsigned pos = next_intersection(iv, current, current->from);
+    if (pos < get_UIVec(env->free_until, iv->real)) {
+      set_UIVec(env->free_until, iv->real, pos);
+    }
+  }
+
+  unsigned real  = choose_free_reg(env, current);
+  unsigned until = get_UIVec(env->free_until, real);
+  if (until <= current->from) {
+    return false;
+  }
+
+  if (until < current->to) {
+    // available for the first part
+    unsigned pos = reload_position(env, until);
+    if (pos <= current->from) {
+      return false;
+    }
+    push_unhandled(env, split_interval(current, pos));
+  }
+
+  current->real = real;
+  return true;
 }
 
-static void assign_reg_num(Env* env) {
-  for (IRInstListIterator* it             = front_IRInstList(env->f->instructions);
-       !is_nil_IRInstListIterator(it); it = next_IRInstListIterator(it)) {
-    IRInst* inst = data_IRInstListIterator(it);
+static void block_reg(Env* env, unsigned real, unsigned pos) {
+  if (pos < get_UIVec(env->block_pos, real)) {
+    set_UIVec(env->block_pos, real, pos);
+  }
+  if (pos < get_UIVec(env->use_pos, real)) {
+    set_UIVec(env->use_pos, real, pos);
+  }
+}
 
-    for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
-      Reg* ra = get_RegVec(inst->ras, i);
+static void use_reg(Env* env, unsigned real, unsigned pos) {
+  if (pos < get_UIVec(env->use_pos, real)) {
+    set_UIVec(env->use_pos, real, pos);
+  }
+}
 
-      if (assign_reg(env, ra)) {
-        emit_spill_load(env, ra, it);
-      }
+// no register is free for the whole `current`: spill either `current` or the intervals in the
+// register whose next use is the farthest
+static void spill_at_interval(Env* env, Interval* current) {
+  unsigned position = current->from;
+  fill_UIVec(env->use_pos, -1);
+  fill_UIVec(env->block_pos, -1);
+
+  for (unsigned i = 0; i < length_IntervalRefVec(env->active); i++) {
+    Interval* iv = get_IntervalRefVec(env->active, i);
+    if (iv->kind == IV_FIXED || !can_spill_from(env, iv, position)) {
+      block_reg(env, iv->real, 0);
+    } else {
+      use_reg(env, iv->real, next_use(iv, position));
     }
-
-    if (inst->rd != NULL) {
-      if (assign_reg(env, inst->rd)) {
-        emit_spill_store(env, inst->rd, next_IRInstListIterator(it));
-      }
+  }
+  for (unsigned i = 0; i < length_IntervalRefVec(env->inactive); i++) {
+    Interval* iv = get_IntervalRefVec(env->inactive, i);
+    unsigned pos = next_intersection(iv, current, position);
+    if (pos == -1) {
+      continue;
+    }
+    if (iv->kind == IV_FIXED || !can_spill_from(env, iv, next_alive(iv, position))) {
+      // `current` has to leave the register where it can be moved, which is before a call block
+      block_reg(env, iv->real, reload_position(env, pos));
+    } else {
+      use_reg(env, iv->real, next_use(iv, position));
     }
   }
-}
 
-static void calc_preserve_regs(Env* env, BBListIterator* it) {
-  if (is_nil_BBListIterator(it)) {
+  unsigned real      = best_reg(env, env->use_pos);
+  unsigned first_use = next_use(current, position);
+  bool can_spill     = first_use == -1 || reload_position(env, first_use) > position;
+  if (can_spill && get_UIVec(env->use_pos, real) < first_use) {
+    // all the others are used before `current`
+    if (first_use != -1) {
+      push_unhandled(env, split_interval(current, reload_position(env, first_use)));
+    }
+    alloc_stack(env, current);
     return;
   }
 
-  BasicBlock* b = data_BBListIterator(it);
+  unsigned block = get_UIVec(env->block_pos, real);
+  if (block <= position) {
+    error("no free reg found");
+  }
+  current->real = real;
+  if (block < current->to) {
+    push_unhandled(env, split_interval(current, block));
+  }
 
-  if (b->is_call_bb) {
-    b->should_preserve = new_BitSet(env->usable_regs_count + 1);
-    BitSet* s          = copy_BitSet(b->live_in);
-    and_BitSet(s, b->live_out);
-    for (unsigned i = 0; i < length_BitSet(s); i++) {
-      if (get_BitSet(s, i)) {
-        unsigned real = get_UIVec(env->result, i);
-        if (real != -2) {
-          assert(real != -1);
-          set_BitSet(b->should_preserve, real, true);
-        }
-      }
+  for (unsigned i = length_IntervalRefVec(env->active); i > 0; i--) {
+    Interval* iv = get_IntervalRefVec(env->active, i - 1);
+    if (iv->real == real) {
+      spill_from(env, iv, position);
+      remove_interval_at(env->active, i - 1);
+    }
+  }
+  for (unsigned i = length_IntervalRefVec(env->inactive); i > 0; i--) {
+    Interval* iv = get_IntervalRefVec(env->inactive, i - 1);
+    if (iv->real == real && iv->kind != IV_FIXED &&
+        next_intersection(iv, current, position) != -1) {
+      spill_from(env, iv, next_alive(iv, position));
+      remove_interval_at(env->inactive, i - 1);
     }
-    release_BitSet(s);
   }
+}
+
+// the first position after `pos` where a move can be inserted after the instruction at `pos`
+static unsigned position_after(Env* env, unsigned pos) {
+  unsigned next = (pos | 1) + 1;
+  BasicBlock* b = block_at(env, pos);
+  return b->is_call_bb && next < block_to(env, b) ? block_to(env, b) : next;
+}
 
-  calc_preserve_regs(env, next_BBListIterator(it));
+// whether a block from `pos` jumps back to a block where `iv` is alive before `pos`, so that `iv`
+// would be reloaded on the edge if it is on the stack from `pos`
+static bool jumps_back(Env* env, Interval* iv, unsigned pos) {
+  for (unsigned p = block_from(env, block_at(env, pos)); p < iv->to;) {
+    BasicBlock* b = block_at(env, p);
+    for (BBRefListIterator* it = front_BBRefList(b->succs); !is_nil_BBRefListIterator(it);
+         it                    = next_BBRefListIterator(it)) {
+      unsigned start = block_from(env, data_BBRefListIterator(it));
+      if (start < pos && covers(iv, start)) {
+        return true;
+      }
+    }
+    p = block_to(env, b);
+  }
+  return false;
 }
 
-static void reg_alloc_function(unsigned num_regs, unsigned* global_inst_count, Function* ir) {
-  RegIntervals* ivs    = ir->intervals;
-  Env* env             = init_Env(ir, global_inst_count, num_regs);
-  UIList* ordered_regs = sort_intervals(ivs);
+// `iv` in a caller-saved register is saved and restored around each call it lives through
+// put it on the stack from its last use before them instead, if the store there and a reload (or a
+// store for a definition) at the first use after each call are executed less often
+static void spill_around_calls(Env* env, Interval* iv) {
+  unsigned call = next_call_through(env, iv, iv->from);
+  if (call == -1) {
+    return;
+  }
+  unsigned i    = find_use(iv, call);
+  unsigned last = i == 0 ? iv->from : get_UIVec(iv->uses, i - 1);
+  unsigned pos  = position_after(env, last);
+  call          = next_call_through(env, iv, pos);
+  if (call == -1 || next_use(iv, pos) < call || jumps_back(env, iv, pos)) {
+    return;
+  }
 
-  walk_regs(env, ordered_regs);
+  unsigned long saves = 0;
+  // a register computed again is never stored
+  unsigned long spills = remat_def(env, iv->virtual) == NULL ? weight_at(env, pos) : 0;
+  unsigned prev_use    = -1;
+  for (unsigned c = call; c != -1; c = next_call_through(env, iv, c + 2)) {
+    saves += 2 * weight_at(env, c);
+    unsigned use = next_use(iv, c);
+    if (use != -1 && use != prev_use) {
+      spills += weight_at(env, use);
+      prev_use = use;
+    }
+  }
 
-  release_UIList(ordered_regs);
+  if (spills < saves && can_spill_from(env, iv, pos)) {
+    spill_from(env, iv, pos);
+  }
+}
 
-  assign_reg_num(env);
-  calc_preserve_regs(env, front_BBList(ir->blocks));
+static void walk_intervals(Env* env) {
+  while (length_IntervalRefVec(env->unhandled) != 0) {
+    Interval* current = pop_unhandled(env);
+    unsigned position = current->from;
+
+    for (unsigned i = length_IntervalRefVec(env->active); i > 0; i--) {
+      Interval* iv = get_IntervalRefVec(env->active, i - 1);
+      if (iv->to <= position) {
+        remove_interval_at(env->active, i - 1);
+      } else if (!covers(iv, position)) {
+        remove_interval_at(env->active, i - 1);
+        push_IntervalRefVec(env->inactive, iv);
+      }
+    }
+    for (unsigned i = length_IntervalRefVec(env->inactive); i > 0; i--) {
+      Interval* iv = get_IntervalRefVec(env->inactive, i - 1);
+      if (iv->to <= position) {
+        remove_interval_at(env->inactive, i - 1);
+      } else if (covers(iv, position)) {
+        remove_interval_at(env->inactive, i - 1);
+        push_IntervalRefVec(env->active, iv);
+      }
+    }
 
-  ir->used_regs = zero_BitSet(num_regs);
-  for (unsigned i = 0; i < length_UIVec(env->result); i++) {
-    unsigned real = get_UIVec(env->result, i);
-    if (real == -2) {
-      set_BitSet(ir->used_regs, env->reserved_for_spill, true);
-    } else if (real != -1) {
-      set_BitSet(ir->used_regs, real, true);
+    if (!try_alloc_free_reg(env, current)) {
+      spill_at_interval(env, current);
+    }
+    if (current->real != -1 && is_scratch[current->real]) {
+      spill_around_calls(env, current);
+    }
+    if (current->real != -1) {
+      push_IntervalRefVec(env->active, current);
     }
   }
+}
 
-  release_Env(env);
+// the part of `virtual` alive at `pos`, NULL if not alive
+static Interval* interval_at(Env* env, unsigned virtual, unsigned pos) {
+  for (Interval* iv = interval_of(env, virtual); iv != NULL; iv = iv->next) {
+    if (pos < iv->to) {
+      return iv->from <= pos && covers(iv, pos) ? iv : NULL;
+    }
+  }
+  return NULL;
 }
 
-static void reg_alloc_functions(unsigned num_regs, unsigned* inst_count, FunctionList* l) {
-  if (is_nil_FunctionList(l)) {
-    return;
+static Location location_of(Env* env, Interval* iv) {
+  Location l = {.real = iv->real, .slot = -1};
+  if (iv->real == -1) {
+    l.slot = iv->virtual;
   }
+  return l;
+}
 
-  reg_alloc_function(num_regs, inst_count, head_FunctionList(l));
+static bool same_location(Location a, Location b) {
+  return a.real == b.real && a.slot == b.slot;
+}
 
-  reg_alloc_functions(num_regs, inst_count, tail_FunctionList(l));
+// ranges are sorted and merged in `assign_slots`
+static void add_stack_life(Env* env, unsigned slot, unsigned from, unsigned to) {
+  LiveRanges* lives = get_LiveRangesVec(env->stack_lives, slot);
+  if (lives == NULL) {
+    lives = new_LiveRanges(4);
+    set_LiveRangesVec(env->stack_lives, slot, lives);
+  }
+  push_LiveRanges(lives, (LiveRange){from, to});
 }
 
-static Interval* new_interval(unsigned from, unsigned to) {
-  Interval* iv = calloc(1, sizeof(Interval));
-  iv->from     = from;
-  iv->to       = to;
-  return iv;
+static DataSize slot_size(Env* env, unsigned slot) {
+  return slot == env->temp_slot ? SIZE_QWORD : get_UIVec(env->sizes, slot);
 }
 
-static void set_interval_kind(Interval* iv, Reg* r) {
-  switch (r->kind) {
-    case REG_FIXED:
-      assert(iv->kind == IV_UNSET || iv->kind == IV_FIXED);
-      iv->kind       = IV_FIXED;
-      iv->fixed_real = r->real;
-      break;
-    case REG_VIRT:
-      assert(iv->kind == IV_UNSET || iv->kind == IV_VIRTUAL);
-      iv->kind = IV_VIRTUAL;
-      break;
-    case REG_REAL:
-      assert(false && "real registers found in register allocation");
-      break;
-    default:
-      CCC_UNREACHABLE;
-  }
+// compute the value of `def` again into `real`
+static IRInst* copy_def(Env* env, IRInst* def, unsigned real) {
+  IRInst* inst      = new_inst_(env, def->kind);
+  inst->imm         = def->imm;
+  inst->stack_idx   = def->stack_idx;
+  inst->global_name = def->global_name;
+  inst->global_kind = def->global_kind;
+  inst->rd          = new_real_Reg(def->rd->size, real);
+  return inst;
 }
 
-static void add_range(Interval* iv, unsigned from, unsigned to) {
-  if (iv->from == -1 || iv->from > from) {
-    iv->from = from;
-  }
-  if (iv->to == -1 || iv->to < to) {
-    iv->to = to;
+// registers are moved as a whole, and slots in the largest size the value is accessed in
+static void emit_move(Env* env, Move m, IRInstListIterator* it) {
+  IRInst* inst;
+  if (m.from.real != -1 && m.to.real != -1) {
+    inst     = new_inst_(env, IR_MOV);
+    inst->rd = new_real_Reg(SIZE_QWORD, m.to.real);
+    push_RegVec(inst->ras, new_real_Reg(SIZE_QWORD, m.from.real));
+  } else if (m.to.real == -1 && remat_def(env, m.to.slot) != NULL) {
+    env->stats.avoided++;
+    return;
+  } else if (m.from.real == -1 && remat_def(env, m.from.slot) != NULL) {
+    env->stats.remats++;
+    inst = copy_def(env, remat_def(env, m.from.slot), m.to.real);
+  } else if (m.to.real == -1) {
+    assert(m.from.real != -1);
+    env->stats.stores++;
+    DataSize size = slot_size(env, m.to.slot);
+    inst          = new_inst_(env, IR_STACK_STORE);
+    push_RegVec(inst->ras, new_real_Reg(size, m.from.real));
+    inst->stack_idx = m.to.slot;
+    inst->data_size = size;
+    push_InstRefVec(env->stack_insts, inst);
+  } else {
+    env->stats.loads++;
+    DataSize size   = slot_size(env, m.from.slot);
+    inst            = new_inst_(env, IR_STACK_LOAD);
+    inst->rd        = new_real_Reg(size, m.to.real);
+    inst->stack_idx = m.from.slot;
+    inst->data_size = size;
+    push_InstRefVec(env->stack_insts, inst);
   }
+  insert_IRInstListIterator(env->f->instructions, it, inst);
 }
 
-static void set_from(Interval* iv, unsigned from) {
-  iv->from = from;
-  if (iv->to == -1) {
-    iv->to = from;
+static bool is_read_by_moves(MoveVec* moves, Location l) {
+  for (unsigned i = 0; i < length_MoveVec(moves); i++) {
+    if (same_location(get_MoveVec(moves, i).from, l)) {
+      return true;
+    }
   }
+  return false;
 }
 
-static void build_intervals_insts(RegIntervals* ivs, IRInstRange* insts, unsigned block_from) {
-  // reverse order
-  for (IRInstRangeIterator* it = back_IRInstRange(insts); !is_nil_IRInstRangeIterator(it);
-       it                      = prev_IRInstRangeIterator(it)) {
-    IRInst* inst = data_IRInstRangeIterator(it);
-
-    for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
-      Reg* ra = get_RegVec(inst->ras, i);
-
-      Interval* iv = get_RegIntervals(ivs, ra->virtual);
-      add_range(iv, block_from, inst->local_id);
-      set_interval_kind(iv, ra);
+// emit `moves` before `it` as if they are performed at once
+// destinations are distinct, and a stack slot is not written and read at the same time
+static void emit_parallel_moves(Env* env, MoveVec* moves, IRInstListIterator* it) {
+  while (length_MoveVec(moves) != 0) {
+    bool progress = false;
+    for (unsigned i = 0; i < length_MoveVec(moves);) {
+      Move m = get_MoveVec(moves, i);
+      if (is_read_by_moves(moves, m.to)) {
+        i++;
+        continue;
+      }
+      emit_move(env, m, it);
+      set_MoveVec(moves, i, get_MoveVec(moves, length_MoveVec(moves) - 1));
+      resize_MoveVec(moves, length_MoveVec(moves) - 1);
+      progress = true;
     }
 
-    if (inst->rd != NULL) {
-      Interval* iv = get_RegIntervals(ivs, inst->rd->virtual);
-      set_from(iv, inst->local_id);
-      set_interval_kind(iv, inst->rd);
+    if (!progress) {
+      // only cycles of registers are left; one is saved on the stack to break the cycle
+      env->temp_used = true;
+      Move* m        = ptr_MoveVec(moves, 0);
+      Location temp = {.real = -1, .slot = env->temp_slot};
+      emit_move(env, (Move){m->from, temp}, it);
+      m->from = temp;
     }
   }
 }
 
-static RegIntervals* build_intervals(Function* ir) {
-  RegIntervals* ivs = new_RegIntervals(ir->reg_count);
-  for (unsigned i = 0; i < ir->reg_count; i++) {
-    push_RegIntervals(ivs, new_interval(-1, -1));
+static void assign_reg(Env* env, Reg* r, unsigned pos) {
+  Interval* iv = interval_at(env, r->virtual, pos);
+  if (iv == NULL || iv->real == -1) {
+    error("failed to allocate register: %d", r->virtual);
   }
 
-  // reverse order
-  for (BBListIterator* it = back_BBList(ir->blocks); !is_nil_BBListIterator(it);
-       it                 = prev_BBListIterator(it)) {
-    BasicBlock* b       = data_BBListIterator(it);
-    unsigned block_from = head_IRInstRange(b->instructions)->local_id;
-    unsigned block_to   = last_IRInstRange(b->instructions)->local_id;
+  if (r->kind == REG_FIXED) {
+    assert(r->real == iv->real);
+  }
+
+  r->kind = REG_REAL;
+  r->real = iv->real;
+}
+
+// moves between split parts, by instruction they are inserted before
+static MoveVecVec* collect_split_moves(Env* env) {
+  MoveVecVec* moves = new_MoveVecVec(length_InstIterRefVec(env->insts));
+  resize_MoveVecVec(moves, length_InstIterRefVec(env->insts));
+  fill_MoveVecVec(moves, NULL);
+
+  for (unsigned v = 0; v < env->f->reg_count; v++) {
+    for (Interval* iv = interval_of(env, v); iv->next != NULL; iv = iv->next) {
+      Interval* rest = iv->next;
+      // parts are joined on edges when split at the start of a block
+      if (iv->to != rest->from || is_block_start(env, rest->from)) {
+        continue;
+      }
 
-    for (unsigned vi = 0; vi < length_BitSet(b->live_out); vi++) {
-      if (get_BitSet(b->live_out, vi)) {
-        Interval* iv = get_RegIntervals(ivs, vi);
-        add_range(iv, block_from, block_to);
+      Move m = {location_of(env, iv), location_of(env, rest)};
+      if (same_location(m.from, m.to)) {
+        continue;
+      }
+      unsigned idx = rest->from / 2;
+      if (get_MoveVecVec(moves, idx) == NULL) {
+        set_MoveVecVec(moves, idx, new_MoveVec(1));
       }
+      push_MoveVec(get_MoveVecVec(moves, idx), m);
+    }
+  }
+  return moves;
+}
+
+static void assign_reg_num(Env* env) {
+  MoveVecVec* moves = collect_split_moves(env);
+
+  for (unsigned k = 0; k < length_InstIterRefVec(env->insts); k++) {
+    IRInstListIterator* it = get_InstIterRefVec(env->insts, k);
+    IRInst* inst           = data_IRInstListIterator(it);
+
+    for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
+      assign_reg(env, get_RegVec(inst->ras, i), 2 * k);
+    }
+    if (inst->rd != NULL) {
+      assign_reg(env, inst->rd, 2 * k + 1);
     }
 
-    build_intervals_insts(ivs, b->instructions, block_from);
+    MoveVec* ms = get_MoveVecVec(moves, k);
+    if (ms != NULL) {
+      emit_parallel_moves(env, ms, it);
+    }
   }
 
-  return ivs;
+  release_MoveVecVec(moves);
 }
 
-static void liveness_functions(FunctionList* l) {
-  if (is_nil_FunctionList(l)) {
+// the moves to be done on the edge to match locations at the end of `from` and the start of `to`
+static MoveVec* edge_moves(Env* env, BasicBlock* from, BasicBlock* to) {
+  MoveVec* moves = new_MoveVec(1);
+  unsigned end   = block_to(env, from) - 1;
+  unsigned start = block_from(env, to);
+  for (BitSetIterator bi = iter_BitSet(to->live_in); next_BitSet(&bi);) {
+    unsigned v = bi.idx;
+    if (interval_of(env, v)->next == NULL) {
+      continue;
+    }
+    Interval* iv1 = interval_at(env, v, end);
+    Interval* iv2 = interval_at(env, v, start);
+    assert(iv1 != NULL && iv2 != NULL);
+    if (iv1 != iv2) {
+      Move m = {location_of(env, iv1), location_of(env, iv2)};
+      if (!same_location(m.from, m.to)) {
+        push_MoveVec(moves, m);
+      }
+      if (m.from.real != -1 && m.to.real == -1) {
+        // the slot is written on the edge, while others may be read from there
+        add_stack_life(env, v, end, end + 1);
+      }
+    }
+  }
+  return moves;
+}
+
+// the moves are placed at the end of `from` or the start of `to` if they are only on the edge, or
+// in a new block on the edge otherwise
+static void resolve_edge(Env* env, BasicBlock* from, BasicBlock* to) {
+  MoveVec* moves = edge_moves(env, from, to);
+  if (length_MoveVec(moves) == 0) {
+    release_MoveVec(moves);
     return;
   }
 
-  Function* f  = head_FunctionList(l);
-  f->intervals = build_intervals(f);
+  IRInstListIterator* it;
+  IRInst* last = last_IRInstRange(from->instructions);
+  if (is_single_BBRefList(from->succs) && last->kind == IR_JUMP && !from->is_call_bb) {
+    it = from->instructions->to;
+  } else if (is_single_BBRefList(to->preds) && !to->is_call_bb) {
+    it = next_IRInstListIterator(to->instructions->from);
+  } else {
+    BasicBlock* b = split_edge(env->f, env->global_inst_count, env->global_bb_count, from, to);
+    it            = b->instructions->to;
+  }
+  emit_parallel_moves(env, moves, it);
+  release_MoveVec(moves);
+}
+
+static void resolve_data_flow(Env* env) {
+  BBRefVec* succs    = new_BBRefVec(2);
+  BBListIterator* it = front_BBList(env->f->blocks);
+  for (unsigned i = 0; i < env->block_count; i++, it = next_BBListIterator(it)) {
+    BasicBlock* b = data_BBListIterator(it);
+
+    // edges are copied, since `b->succs` is modified when an edge is split
+    resize_BBRefVec(succs, 0);
+    for (BBRefListIterator* it2 = front_BBRefList(b->succs); !is_nil_BBRefListIterator(it2);
+         it2                    = next_BBRefListIterator(it2)) {
+      BasicBlock* s = data_BBRefListIterator(it2);
+      bool seen     = false;
+      for (unsigned j = 0; j < length_BBRefVec(succs); j++) {
+        seen |= get_BBRefVec(succs, j) == s;
+      }
+      if (!seen) {
+        push_BBRefVec(succs, s);
+      }
+    }
+
+    for (unsigned j = 0; j < length_BBRefVec(succs); j++) {
+      resolve_edge(env, b, get_BBRefVec(succs, j));
+    }
+  }
+  release_BBRefVec(succs);
+}
+
+static unsigned call_position(Env* env, BasicBlock* b) {
+  for (unsigned pos = block_from(env, b); pos < block_to(env, b); pos += 2) {
+    IRInst* inst = data_IRInstListIterator(get_InstIterRefVec(env->insts, pos / 2));
+    if (inst->kind == IR_CALL) {
+      return pos;
+    }
+  }
+  CCC_UNREACHABLE;
+}
+
+static void calc_preserve_regs(Env* env, BBListIterator* it, unsigned count) {
+  if (count == 0) {
+    return;
+  }
+
+  BasicBlock* b = data_BBListIterator(it);
+
+  if (b->is_call_bb) {
+    b->should_preserve = zero_BitSet(env->num_regs);
+    BitSet* s          = copy_BitSet(b->live_in);
+    and_BitSet(s, b->live_out);
+    unsigned pos = call_position(env, b);
+    for (BitSetIterator bi = iter_BitSet(s); next_BitSet(&bi);) {
+      // split parts are not changed in call blocks
+      Interval* iv = interval_at(env, bi.idx, pos);
+      assert(iv != NULL);
+      if (iv->real != -1) {
+        set_BitSet(b->should_preserve, iv->real, true);
+      }
+    }
+    release_BitSet(s);
+  }
+
+  calc_preserve_regs(env, next_BBListIterator(it), count - 1);
+}
+
+static void set_interval_kind(Interval* iv, Reg* r) {
+  switch (r->kind) {
+    case REG_FIXED:
+      assert(iv->kind == IV_UNSET || iv->kind == IV_FIXED);
+      iv->kind       = IV_FIXED;
+      iv->fixed_real = r->real;
+      iv->real       = r->real;
+      break;
+    case REG_VIRT:
+      assert(iv->kind == IV_UNSET || iv->kind == IV_VIRTUAL);
+      iv->kind = IV_VIRTUAL;
+      break;
+    case REG_REAL:
+      assert(false && "real registers found in register allocation");
+      break;
+    default:
+      CCC_UNREACHABLE;
+  }
+}
+
+// ranges and uses are collected backward, and reversed in `finish_interval`
+static void add_range(Interval* iv, unsigned from, unsigned to) {
+  unsigned len = length_LiveRanges(iv->ranges);
+  if (len != 0) {
+    LiveRange* first = ptr_LiveRanges(iv->ranges, len - 1);
+    if (first->from <= to) {
+      first->from = from < first->from ? from : first->from;
+      first->to   = to > first->to ? to : first->to;
+      return;
+    }
+  }
+  push_LiveRanges(iv->ranges, (LiveRange){from, to});
+}
+
+static void add_use(Interval* iv, unsigned pos) {
+  unsigned len = length_UIVec(iv->uses);
+  if (len == 0 || get_UIVec(iv->uses, len - 1) != pos) {
+    push_UIVec(iv->uses, pos);
+  }
+}
+
+static void finish_interval(Interval* iv) {
+  unsigned len = length_LiveRanges(iv->ranges);
+  if (len == 0) {
+    return;
+  }
+  for (unsigned i = 0; i < len / 2; i++) {
+    LiveRange t = get_LiveRanges(iv->ranges, i);
+    set_LiveRanges(iv->ranges, i, get_LiveRanges(iv->ranges, len - 1 - i));
+    set_LiveRanges(iv->ranges, len - 1 - i, t);
+  }
+  unsigned uses = length_UIVec(iv->uses);
+  for (unsigned i = 0; i < uses / 2; i++) {
+    unsigned t = get_UIVec(iv->uses, i);
+    set_UIVec(iv->uses, i, get_UIVec(iv->uses, uses - 1 - i));
+    set_UIVec(iv->uses, uses - 1 - i, t);
+  }
+  iv->from = get_LiveRanges(iv->ranges, 0).from;
+  iv->to   = get_LiveRanges(iv->ranges, len - 1).to;
+}
+
+static void widen_size(Env* env, Reg* r) {
+  if (r->size > get_UIVec(env->sizes, r->virtual)) {
+    set_UIVec(env->sizes, r->virtual, r->size);
+  }
+}
+
+static void build_intervals_insts(Env* env, RegIntervals* ivs, BitSet* live, BasicBlock* b) {
+  unsigned from = block_from(env, b);
+
+  // reverse order
+  for (unsigned pos = block_to(env, b); pos > from;) {
+    pos -= 2;
+    IRInst* inst = data_IRInstListIterator(get_InstIterRefVec(env->insts, pos / 2));
+
+    if (inst->rd != NULL) {
+      Interval* iv = get_RegIntervals(ivs, inst->rd->virtual);
+      if (get_BitSet(live, inst->rd->virtual)) {
+        // alive from the start of the block so far
+        ptr_LiveRanges(iv->ranges, length_LiveRanges(iv->ranges) - 1)->from = pos + 1;
+      } else {
+        add_range(iv, pos + 1, pos + 2);
+      }
+      add_use(iv, pos + 1);
+      set_interval_kind(iv, inst->rd);
+      widen_size(env, inst->rd);
+      set_BitSet(live, inst->rd->virtual, false);
+    }
+
+    for (unsigned i = 0; i < length_RegVec(inst->ras); i++) {
+      Reg* ra = get_RegVec(inst->ras, i);
+
+      Interval* iv = get_RegIntervals(ivs, ra->virtual);
+      add_range(iv, from, pos + 1);
+      add_use(iv, pos);
+      set_interval_kind(iv, ra);
+      widen_size(env, ra);
+      set_BitSet(live, ra->virtual, true);
+    }
+  }
+}
+
+static RegIntervals* build_intervals(Env* env) {
+  Function* f       = env->f;
+  RegIntervals* ivs = new_RegIntervals(f->reg_count);
+  for (unsigned i = 0; i < f->reg_count; i++) {
+    push_RegIntervals(ivs, new_interval(IV_UNSET, i));
+  }
+
+  // reverse order
+  BitSet* live = zero_BitSet(f->reg_count);
+  for (BBListIterator* it = back_BBList(f->blocks); !is_nil_BBListIterator(it);
+       it                 = prev_BBListIterator(it)) {
+    BasicBlock* b = data_BBListIterator(it);
+    copy_to_BitSet(live, b->live_out);
+
+    for (BitSetIterator bi = iter_BitSet(b->live_out); next_BitSet(&bi);) {
+      add_range(get_RegIntervals(ivs, bi.idx), block_from(env, b), block_to(env, b));
+    }
+
+    build_intervals_insts(env, ivs, live, b);
+  }
+  release_BitSet(live);
+
+  for (unsigned i = 0; i < f->reg_count; i++) {
+    finish_interval(get_RegIntervals(ivs, i));
+  }
+  return ivs;
+}
+
+static bool is_cheap_def(IRInst* inst) {
+  switch (inst->kind) {
+    case IR_IMM:
+    case IR_STACK_ADDR:
+    case IR_GLOBAL_ADDR:
+      return inst->rd->kind == REG_VIRT;
+    default:
+      return false;
+  }
+}
+
+// registers defined only once without operands, whose value is the same wherever they are alive
+static void find_remat_defs(Env* env) {
+  BitSet* defined = zero_BitSet(env->f->reg_count);
+  for (unsigned k = 0; k < length_InstIterRefVec(env->insts); k++) {
+    IRInst* inst = data_IRInstListIterator(get_InstIterRefVec(env->insts, k));
+    if (inst->rd == NULL) {
+      continue;
+    }
+    unsigned v = inst->rd->virtual;
+    bool once  = !get_BitSet(defined, v);
+    set_BitSet(defined, v, true);
+    set_InstRefVec(env->remat_defs, v, once && is_cheap_def(inst) ? inst : NULL);
+  }
+  release_BitSet(defined);
+}
+
+static int compare_range(const void* a, const void* b) {
+  unsigned fa = ((const LiveRange*)a)->from;
+  unsigned fb = ((const LiveRange*)b)->from;
+  return (fa > fb) - (fa < fb);
+}
+
+// make `ranges` ascending and disjoint
+static void sort_ranges(LiveRanges* ranges) {
+  unsigned len = length_LiveRanges(ranges);
+  if (len == 0) {
+    return;
+  }
+  qsort(data_LiveRanges(ranges), len, sizeof(LiveRange), compare_range);
+
+  unsigned merged = 0;
+  for (unsigned i = 1; i < len; i++) {
+    LiveRange r     = get_LiveRanges(ranges, i);
+    LiveRange* last = ptr_LiveRanges(ranges, merged);
+    if (r.from <= last->to) {
+      last->to = r.to > last->to ? r.to : last->to;
+    } else {
+      set_LiveRanges(ranges, ++merged, r);
+    }
+  }
+  resize_LiveRanges(ranges, merged + 1);
+}
+
+// fixed registers assigned to the same real register are put together into one interval
+static void build_fixed_intervals(Env* env) {
+  env->fixed = new_RegIntervals(env->num_regs);
+  for (unsigned r = 0; r < env->num_regs; r++) {
+    Interval* iv   = new_interval(IV_FIXED, -1);
+    iv->fixed_real = r;
+    iv->real       = r;
+    push_RegIntervals(env->fixed, iv);
+  }
+
+  for (unsigned v = 0; v < env->f->reg_count; v++) {
+    Interval* iv = interval_of(env, v);
+    if (iv->kind != IV_FIXED) {
+      continue;
+    }
+    LiveRanges* ranges = get_RegIntervals(env->fixed, iv->fixed_real)->ranges;
+    for (unsigned i = 0; i < length_LiveRanges(iv->ranges); i++) {
+      push_LiveRanges(ranges, get_LiveRanges(iv->ranges, i));
+    }
+  }
+
+  // the divisor must not be in rax or rdx, and no value may be kept in them over a division
+  for (unsigned k = 0; k < length_InstIterRefVec(env->insts); k++) {
+    if (is_division(data_IRInstListIterator(get_InstIterRefVec(env->insts, k)))) {
+      LiveRange clobber = {2 * k, 2 * k + 2};
+      push_LiveRanges(get_RegIntervals(env->fixed, rax_reg_id)->ranges, clobber);
+      push_LiveRanges(get_RegIntervals(env->fixed, rdx_reg_id)->ranges, clobber);
+    }
+  }
+
+  for (unsigned r = 0; r < env->num_regs; r++) {
+    Interval* iv = get_RegIntervals(env->fixed, r);
+    unsigned len = length_LiveRanges(iv->ranges);
+    if (len == 0) {
+      continue;
+    }
+    sort_ranges(iv->ranges);
+    iv->from = get_LiveRanges(iv->ranges, 0).from;
+    iv->to   = get_LiveRanges(iv->ranges, length_LiveRanges(iv->ranges) - 1).to;
+
+    push_IntervalRefVec(env->inactive, iv);
+  }
+}
+
+// a local variable or a stack slot in the frame
+typedef struct {
+  unsigned size;
+  unsigned align;
+  unsigned uses;      // instructions accessing it
+  LiveRanges* lives;  // owned, for slots, positions where any of the virtual registers in it is
+  unsigned offset;    // used as `stack_idx`, filled in `layout_frame`
+} StackObject;
+
+static void release_StackObject(StackObject o) {
+  release_LiveRanges(o.lives);
+}
+DECLARE_VECTOR(StackObject, StackObjects)
+DEFINE_VECTOR(release_StackObject, StackObject, StackObjects)
+
+// natural alignment of scalars, which is enough for the others
+static unsigned align_of_size(unsigned size) {
+  unsigned align = 1;
+  while (align < 8 && align * 2 <= size) {
+    align *= 2;
+  }
+  return align;
+}
+
+static bool ranges_intersect(LiveRanges* a, LiveRanges* b) {
+  unsigned i = 0;
+  unsigned j = 0;
+  while (i < length_LiveRanges(a) && j < length_LiveRanges(b)) {
+    LiveRange ra = get_LiveRanges(a, i);
+    LiveRange rb = get_LiveRanges(b, j);
+    if (ra.from < rb.to && rb.from < ra.to) {
+      return true;
+    }
+    if (ra.to <= rb.to) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+  return false;
+}
+
+// a slot is in use where the parts on the stack are, and where a value is stored into it
+static void collect_stack_lives(Env* env) {
+  for (unsigned v = 0; v < env->f->reg_count; v++) {
+    for (Interval* iv = interval_of(env, v); iv != NULL; iv = iv->next) {
+      if (iv->kind != IV_VIRTUAL || iv->real != -1) {
+        continue;
+      }
+      for (unsigned i = 0; i < length_LiveRanges(iv->ranges); i++) {
+        LiveRange r = get_LiveRanges(iv->ranges, i);
+        if (i == 0) {
+          // the store is inserted before the instruction, where the previous value can be loaded
+          unsigned before = r.from & ~1u;
+          r.from          = before == 0 ? 0 : before - 1;
+        }
+        add_stack_life(env, v, r.from, r.to);
+      }
+    }
+  }
+}
+
+typedef struct {
+  unsigned from;  // of the first range
+  unsigned slot;
+} SlotOrder;
+
+static int compare_slot_order(const void* a, const void* b) {
+  const SlotOrder* sa = a;
+  const SlotOrder* sb = b;
+  if (sa->from != sb->from) {
+    return (sa->from > sb->from) - (sa->from < sb->from);
+  }
+  return (sa->slot > sb->slot) - (sa->slot < sb->slot);
+}
+
+// share slots among virtual registers of the same size which are not on the stack at once
+// returns slot -> index in `objects`
+static UIVec* assign_slots(Env* env, StackObjects* objects) {
+  collect_stack_lives(env);
+
+  UIVec* slot_objects = new_UIVec(env->temp_slot + 1);
+  resize_UIVec(slot_objects, env->temp_slot + 1);
+  fill_UIVec(slot_objects, -1);
+
+  // in the order of the first use, as in linear scan
+  SlotOrder* order = alloc_passes(sizeof(SlotOrder) * (env->temp_slot + 1));
+  unsigned count   = 0;
+  for (unsigned v = 0; v < env->f->reg_count; v++) {
+    LiveRanges* lives = get_LiveRangesVec(env->stack_lives, v);
+    // registers computed again are never stored
+    if (lives != NULL && remat_def(env, v) == NULL) {
+      sort_ranges(lives);
+      order[count++] = (SlotOrder){get_LiveRanges(lives, 0).from, v};
+    }
+  }
+  qsort(order, count, sizeof(SlotOrder), compare_slot_order);
+
+  unsigned first = length_StackObjects(objects);
+  for (unsigned k = 0; k < count; k++) {
+    unsigned v        = order[k].slot;
+    LiveRanges* lives = get_LiveRangesVec(env->stack_lives, v);
+    unsigned size     = get_UIVec(env->sizes, v);
+
+    unsigned i = first;
+    for (; i < length_StackObjects(objects); i++) {
+      StackObject* o = ptr_StackObjects(objects, i);
+      if (o->size == size && !ranges_intersect(o->lives, lives)) {
+        break;
+      }
+    }
+    if (i == length_StackObjects(objects)) {
+      StackObject o = {.size = size, .align = align_of_size(size), .lives = new_LiveRanges(4)};
+      push_StackObjects(objects, o);
+    }
+
+    LiveRanges* merged = get_StackObjects(objects, i).lives;
+    for (unsigned j = 0; j < length_LiveRanges(lives); j++) {
+      push_LiveRanges(merged, get_LiveRanges(lives, j));
+    }
+    sort_ranges(merged);
+    set_UIVec(slot_objects, v, i);
+  }
+  free_passes(order);
+
+  if (env->temp_used) {
+    StackObject o = {.size = SIZE_QWORD, .align = SIZE_QWORD};
+    set_UIVec(slot_objects, env->temp_slot, length_StackObjects(objects));
+    push_StackObjects(objects, o);
+  }
+
+  for (unsigned i = 0; i < length_InstRefVec(env->stack_insts); i++) {
+    IRInst* inst = get_InstRefVec(env->stack_insts, i);
+    ptr_StackObjects(objects, get_UIVec(slot_objects, inst->stack_idx))->uses++;
+  }
+  return slot_objects;
+}
+
+// the local variable ending at `stack_idx` (see `vars` in `Function`)
+static unsigned var_size(Function* f, unsigned stack_idx) {
+  unsigned lo = 0;
+  unsigned hi = length_UIVec(f->vars);
+  while (lo < hi) {
+    unsigned mid = (lo + hi) / 2;
+    if (get_UIVec(f->vars, mid) < stack_idx) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == length_UIVec(f->vars) || get_UIVec(f->vars, lo) != stack_idx) {
+    error("unknown local variable at %d in %s", stack_idx, f->name);
+  }
+  return stack_idx - (lo == 0 ? 0 : get_UIVec(f->vars, lo - 1));
+}
+
+// variables whose address is still taken after optimizations
+// returns `stack_idx` of a variable -> index in `objects`
+static UIVec* collect_vars(Function* f, StackObjects* objects) {
+  UIVec* var_objects = new_UIVec(f->stack_count + 1);
+  resize_UIVec(var_objects, f->stack_count + 1);
+  fill_UIVec(var_objects, -1);
+
+  for (IRInstListIterator* it = front_IRInstList(f->instructions); !is_nil_IRInstListIterator(it);
+       it                     = next_IRInstListIterator(it)) {
+    IRInst* inst = data_IRInstListIterator(it);
+    if (inst->kind != IR_STACK_ADDR) {
+      continue;
+    }
+    unsigned idx = inst->stack_idx;
+    if (get_UIVec(var_objects, idx) == -1) {
+      unsigned size = var_size(f, idx);
+      StackObject o = {.size = size, .align = align_of_size(size)};
+      set_UIVec(var_objects, idx, length_StackObjects(objects));
+      push_StackObjects(objects, o);
+    }
+    ptr_StackObjects(objects, get_UIVec(var_objects, idx))->uses++;
+  }
+  return var_objects;
+}
+
+static unsigned round_up(unsigned n, unsigned align) {
+  return (n + align - 1) / align * align;
+}
+
+static int compare_uses(const void* a, const void* b) {
+  const StackObject* oa = *(const StackObject* const*)a;
+  const StackObject* ob = *(const StackObject* const*)b;
+  if (oa->uses != ob->uses) {
+    return (oa->uses < ob->uses) - (oa->uses > ob->uses);
+  }
+  return (oa > ob) - (oa < ob);
+}
+
+// place objects from the frame pointer in the order of uses, filling gaps left for alignment
+// returns the size of the frame
+static unsigned layout_frame(StackObjects* objects) {
+  unsigned count    = length_StackObjects(objects);
+  StackObject** hot = alloc_passes(sizeof(StackObject*) * (count + 1));
+  for (unsigned i = 0; i < count; i++) {
+    hot[i] = ptr_StackObjects(objects, i);
+  }
+  qsort(hot, count, sizeof(StackObject*), compare_uses);
+
+  // an object at `offset` takes the bytes in [offset - size, offset) below the frame pointer
+  LiveRanges* gaps = new_LiveRanges(4);
+  unsigned top     = 0;
+  for (unsigned i = 0; i < count; i++) {
+    StackObject* o = hot[i];
+
+    unsigned j = 0;
+    for (; j < length_LiveRanges(gaps); j++) {
+      LiveRange g = get_LiveRanges(gaps, j);
+      if (round_up(g.from + o->size, o->align) <= g.to) {
+        break;
+      }
+    }
+    if (j == length_LiveRanges(gaps)) {
+      o->offset = round_up(top + o->size, o->align);
+      if (o->offset - o->size > top) {
+        push_LiveRanges(gaps, (LiveRange){top, o->offset - o->size});
+      }
+      top = o->offset;
+      continue;
+    }
+
+    LiveRange g = get_LiveRanges(gaps, j);
+    o->offset   = round_up(g.from + o->size, o->align);
+    // the rest of the gap on each side
+    set_LiveRanges(gaps, j, (LiveRange){o->offset, g.to});
+    if (o->offset - o->size > g.from) {
+      push_LiveRanges(gaps, (LiveRange){g.from, o->offset - o->size});
+    }
+  }
+
+  release_LiveRanges(gaps);
+  free_passes(hot);
+  return top;
+}
+
+// variables and slots are put together into the frame
+static void allocate_frame(Env* env) {
+  Function* f           = env->f;
+  StackObjects* objects = new_StackObjects(16);
+  UIVec* var_objects    = collect_vars(f, objects);
+  UIVec* slot_objects   = assign_slots(env, objects);
+  f->stack_count        = layout_frame(objects);
+
+  for (IRInstListIterator* it = front_IRInstList(f->instructions); !is_nil_IRInstListIterator(it);
+       it                     = next_IRInstListIterator(it)) {
+    IRInst* inst = data_IRInstListIterator(it);
+    if (inst->kind == IR_STACK_ADDR) {
+      inst->stack_idx = get_StackObjects(objects, get_UIVec(var_objects, inst->stack_idx)).offset;
+    }
+  }
+  for (unsigned i = 0; i < length_InstRefVec(env->stack_insts); i++) {
+    IRInst* inst    = get_InstRefVec(env->stack_insts, i);
+    inst->stack_idx = get_StackObjects(objects, get_UIVec(slot_objects, inst->stack_idx)).offset;
+  }
+
+  release_UIVec(var_objects);
+  release_UIVec(slot_objects);
+  release_StackObjects(objects);
+}
+
+// graph coloring with iterated register coalescing (George and Appel, "Iterated Register
+// Coalescing"), used in place of `walk_intervals` with `RA_COLOR`
+// nodes are real registers, which are precolored, followed by the parts of intervals in registers;
+// parts interfere if they are alive at the same position. a node which cannot be colored is put
+// on the stack except around its uses, and the graph is built again with the new parts
+
+typedef enum {
+  NODE_PRECOLORED,
+  NODE_INITIAL,
+  NODE_SIMPLIFY,
+  NODE_FREEZE,
+  NODE_SPILL,
+  NODE_SPILLED,
+  NODE_COALESCED,
+  NODE_COLORED,
+  NODE_SELECTED,
+} NodeState;
+
+typedef enum {
+  MOVE_WORKLIST,
+  MOVE_ACTIVE,
+  MOVE_COALESCED,
+  MOVE_CONSTRAINED,
+  MOVE_FROZEN,
+} MoveState;
+
+typedef struct {
+  unsigned src;
+  unsigned dst;
+  unsigned long weight;  // see `weight_at`
+  MoveState state;
+} NodeMove;
+
+static void release_NodeMove(NodeMove m) {}
+DECLARE_VECTOR(NodeMove, NodeMoves)
+DEFINE_VECTOR(release_NodeMove, NodeMove, NodeMoves)
+
+DECLARE_VECTOR(UIVec*, UIVecVec)
+DEFINE_VECTOR(release_UIVec, UIVec*, UIVecVec)
+
+typedef struct {
+  Env* env;
+  unsigned k;      // the number of colors, and of precolored nodes
+  unsigned count;  // nodes
+
+  IntervalRefVec* parts;  // owned, node -> the part, NULL for precolored nodes
+  UIVec* first_node;      // owned, virtual -> the node of its first part in a register
+
+  BSVec* adj_set;        // owned, node -> nodes interfering with it
+  UIVecVec* adj_list;    // owned, ditto, only for nodes which are not precolored
+  UIVec* degree;         // owned, node -> the length of `adj_list`
+  UIVecVec* move_list;   // owned, node -> moves from or to it
+  NodeMoves* moves;      // owned
+  UIVec* alias;          // owned, node -> the node it is coalesced into
+  UIVec* color;          // owned, node -> real register
+  UIVec* state;          // owned, node -> `NodeState`
+  unsigned long* cost;   // owned, node -> the estimated cost of spilling it
+  BitSet* spillable;     // owned, nodes which can be put on the stack, see `can_spill_part`
+  BitSet* used_colors;   // owned, used in `assign_colors`
+  UIVec* marks;          // owned, node -> `stamp` when it is counted in `conservative`
+  unsigned stamp;
+
+  // a node can be left in a list after it has moved to another; `state` tells which is current
+  UIVec* simplify_list;  // owned
+  UIVec* freeze_list;    // owned
+  UIVec* spill_list;     // owned
+  UIVec* move_worklist;  // owned, moves ordered by weight, the heaviest last
+  UIVec* select_stack;   // owned
+  UIVec* spilled;        // owned
+} Graph;
+
+static bool is_precolored(Graph* g, unsigned n) {
+  return n < g->k;
+}
+
+static bool is_adjacent(Graph* g, unsigned u, unsigned v) {
+  if (is_precolored(g, u)) {
+    if (is_precolored(g, v)) {
+      return u != v;
+    }
+    return get_BitSet(get_BSVec(g->adj_set, v), u);
+  }
+  return get_BitSet(get_BSVec(g->adj_set, u), v);
+}
+
+static void add_adjacent(Graph* g, unsigned u, unsigned v) {
+  if (is_precolored(g, u)) {
+    return;
+  }
+  set_BitSet(get_BSVec(g->adj_set, u), v, true);
+  push_UIVec(get_UIVecVec(g->adj_list, u), v);
+  set_UIVec(g->degree, u, get_UIVec(g->degree, u) + 1);
+}
+
+static void add_edge(Graph* g, unsigned u, unsigned v) {
+  if (u == v || is_adjacent(g, u, v)) {
+    return;
+  }
+  add_adjacent(g, u, v);
+  add_adjacent(g, v, u);
+}
+
+// whether `n` has left the graph, by simplification or coalescing
+static bool is_removed(Graph* g, unsigned n) {
+  NodeState s = get_UIVec(g->state, n);
+  return s == NODE_SELECTED || s == NODE_COALESCED;
+}
+
+static unsigned get_alias(Graph* g, unsigned n) {
+  while (get_UIVec(g->state, n) == NODE_COALESCED) {
+    n = get_UIVec(g->alias, n);
+  }
+  return n;
+}
+
+static void set_state(Graph* g, unsigned n, NodeState s, UIVec* list) {
+  set_UIVec(g->state, n, s);
+  if (list != NULL) {
+    push_UIVec(list, n);
+  }
+}
+
+// a node which is still in the state of `list`, -1 if there is none
+static unsigned pop_node(Graph* g, UIVec* list, NodeState s) {
+  while (length_UIVec(list) != 0) {
+    unsigned n = get_UIVec(list, length_UIVec(list) - 1);
+    resize_UIVec(list, length_UIVec(list) - 1);
+    if (get_UIVec(g->state, n) == s) {
+      return n;
+    }
+  }
+  return -1;
+}
+
+static bool is_pending(NodeMove* m) {
+  return m->state == MOVE_WORKLIST || m->state == MOVE_ACTIVE;
+}
+
+static bool is_move_related(Graph* g, unsigned n) {
+  UIVec* ms = get_UIVecVec(g->move_list, n);
+  for (unsigned i = 0; i < length_UIVec(ms); i++) {
+    if (is_pending(ptr_NodeMoves(g->moves, get_UIVec(ms, i)))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// the part of `virtual` in a register at `pos` as a node, -1 if it is on the stack
+static unsigned node_at(Graph* g, Reg* r, unsigned pos) {
+  if (r->kind == REG_FIXED) {
+    return r->real;
+  }
+  Interval* iv = interval_at(g->env, r->virtual, pos);
+  if (iv == NULL || iv->real == -1) {
+    return -1;
+  }
+  for (unsigned n = get_UIVec(g->first_node, r->virtual);; n++) {
+    if (get_IntervalRefVec(g->parts, n) == iv) {
+      return n;
+    }
+  }
+}
+
+// whether `spill_part` puts any part of `iv` on the stack
+static bool can_spill_part(Env* env, Interval* iv) {
+  unsigned use = next_use(iv, iv->from);
+  if (use == -1 || reload_position(env, use) > iv->from) {
+    return true;
+  }
+  for (;;) {
+    unsigned pos = position_after(env, use);
+    if (pos >= iv->to) {
+      return false;
+    }
+    use = next_use(iv, pos);
+    if (use == -1 || reload_position(env, use) > pos) {
+      return true;
+    }
+  }
+}
+
+// keep `iv` in registers only around its uses, and on the stack between them
+static void spill_part(Env* env, Interval* iv) {
+  for (;;) {
+    unsigned use = next_use(iv, iv->from);
+    if (use == -1) {
+      iv->real = -1;
+      return;
+    }
+    unsigned reload = reload_position(env, use);
+    if (reload > iv->from) {
+      Interval* rest = split_interval(iv, reload);
+      iv->real       = -1;
+      iv             = rest;
+    }
+    // in a register, to be colored again
+    iv->real = 0;
+
+    // uses which cannot be reloaded separately are kept in the same part
+    unsigned pos = position_after(env, use);
+    for (use = next_use(iv, pos); use != -1 && reload_position(env, use) <= pos;
+         use = next_use(iv, pos)) {
+      pos = position_after(env, use);
+    }
+    if (pos >= iv->to) {
+      return;
+    }
+    iv       = split_interval(iv, pos);
+    iv->real = -1;
+  }
+}
+
+static void add_move(Graph* g, unsigned src, unsigned dst, unsigned long weight) {
+  if (src == -1 || dst == -1 || src == dst || (is_precolored(g, src) && is_precolored(g, dst))) {
+    return;
+  }
+  unsigned idx = length_NodeMoves(g->moves);
+  push_NodeMoves(g->moves, (NodeMove){src, dst, weight, MOVE_WORKLIST});
+  push_UIVec(get_UIVecVec(g->move_list, src), idx);
+  push_UIVec(get_UIVecVec(g->move_list, dst), idx);
+}
+
+static void add_node(Graph* g, Interval* part) {
+  push_IntervalRefVec(g->parts, part);
+  push_BSVec(g->adj_set, NULL);
+  push_UIVecVec(g->adj_list, new_UIVec(4));
+  push_UIVecVec(g->move_list, new_UIVec(1));
+  g->count++;
+}
+
+static void collect_nodes(Graph* g) {
+  for (unsigned r = 0; r < g->k; r++) {
+    add_node(g, NULL);
+  }
+
+  Function* f = g->env->f;
+  for (unsigned v = 0; v < f->reg_count; v++) {
+    push_UIVec(g->first_node, g->count);
+    Interval* iv = interval_of(g->env, v);
+    if (iv->kind != IV_VIRTUAL) {
+      continue;
+    }
+    for (; iv != NULL; iv = iv->next) {
+      if (iv->real != -1) {
+        add_node(g, iv);
+      }
+    }
+  }
+
+  for (unsigned n = 0; n < g->count; n++) {
+    set_BSVec(g->adj_set, n, zero_BitSet(g->count));
+  }
+  g->degree = new_UIVec(g->count);
+  resize_UIVec(g->degree, g->count);
+  fill_UIVec(g->degree, 0);
+  g->alias = new_UIVec(g->count);
+  resize_UIVec(g->alias, g->count);
+  g->color = new_UIVec(g->count);
+  resize_UIVec(g->color, g->count);
+  g->state = new_UIVec(g->count);
+  resize_UIVec(g->state, g->count);
+  g->marks = new_UIVec(g->count);
+  resize_UIVec(g->marks, g->count);
+  fill_UIVec(g->marks, 0);
+  g->cost      = alloc_passes(sizeof(unsigned long) * g->count);
+  g->spillable = zero_BitSet(g->count);
+
+  for (unsigned n = 0; n < g->count; n++) {
+    set_UIVec(g->alias, n, n);
+    set_UIVec(g->color, n, n);
+    set_UIVec(g->state, n, is_precolored(g, n) ? NODE_PRECOLORED : NODE_INITIAL);
+  }
+}
+
+typedef struct {
+  unsigned from;
+  unsigned node;
+} NodeStart;
+
+static int compare_node_start(const void* a, const void* b) {
+  const NodeStart* sa = a;
+  const NodeStart* sb = b;
+  if (sa->from != sb->from) {
+    return (sa->from > sb->from) - (sa->from < sb->from);
+  }
+  return (sa->node > sb->node) - (sa->node < sb->node);
+}
+
+// sweep over parts in the order of their starts, keeping the ones not ended yet
+static void build_edges(Graph* g) {
+  unsigned count    = g->count - g->k;
+  NodeStart* starts = alloc_passes(sizeof(NodeStart) * (count == 0 ? 1 : count));
+  for (unsigned i = 0; i < count; i++) {
+    unsigned n = g->k + i;
+    starts[i]  = (NodeStart){get_IntervalRefVec(g->parts, n)->from, n};
+  }
+  qsort(starts, count, sizeof(NodeStart), compare_node_start);
+
+  UIVec* active = new_UIVec(g->k);
+  for (unsigned i = 0; i < count; i++) {
+    unsigned n    = starts[i].node;
+    Interval* cur = get_IntervalRefVec(g->parts, n);
+
+    for (unsigned j = length_UIVec(active); j > 0; j--) {
+      unsigned m   = get_UIVec(active, j - 1);
+      Interval* iv = get_IntervalRefVec(g->parts, m);
+      if (iv->to <= cur->from) {
+        set_UIVec(active, j - 1, get_UIVec(active, length_UIVec(active) - 1));
+        resize_UIVec(active, length_UIVec(active) - 1);
+      } else if (next_intersection(iv, cur, cur->from) != -1) {
+        add_edge(g, m, n);
+      }
+    }
+    push_UIVec(active, n);
+
+    for (unsigned r = 0; r < g->k; r++) {
+      Interval* fixed = get_RegIntervals(g->env->fixed, r);
+      if (length_LiveRanges(fixed->ranges) != 0 && next_intersection(fixed, cur, cur->from) != -1) {
+        add_edge(g, r, n);
+      }
+    }
+  }
+
+  release_UIVec(active);
+  free_passes(starts);
+}
+
+typedef struct {
+  unsigned long weight;
+  unsigned move;
+} MoveOrder;
+
+static int compare_move_order(const void* a, const void* b) {
+  const MoveOrder* ma = a;
+  const MoveOrder* mb = b;
+  if (ma->weight != mb->weight) {
+    return (ma->weight > mb->weight) - (ma->weight < mb->weight);
+  }
+  return (ma->move < mb->move) - (ma->move > mb->move);
+}
+
+// `IR_MOV` between registers, and split parts next to each other
+static void build_moves(Graph* g) {
+  Env* env = g->env;
+  for (unsigned k = 0; k < length_InstIterRefVec(env->insts); k++) {
+    IRInst* inst = data_IRInstListIterator(get_InstIterRefVec(env->insts, k));
+    if (inst->kind == IR_MOV) {
+      unsigned src = node_at(g, get_RegVec(inst->ras, 0), 2 * k);
+      unsigned dst = node_at(g, inst->rd, 2 * k + 1);
+      add_move(g, src, dst, weight_at(env, 2 * k));
+    }
+  }
+  for (unsigned n = g->k; n + 1 < g->count; n++) {
+    Interval* iv = get_IntervalRefVec(g->parts, n);
+    if (iv->next == get_IntervalRefVec(g->parts, n + 1) && iv->to == iv->next->from) {
+      add_move(g, n, n + 1, weight_at(env, iv->to));
+    }
+  }
+
+  unsigned len     = length_NodeMoves(g->moves);
+  MoveOrder* order = alloc_passes(sizeof(MoveOrder) * (len == 0 ? 1 : len));
+  for (unsigned i = 0; i < len; i++) {
+    order[i] = (MoveOrder){get_NodeMoves(g->moves, i).weight, i};
+  }
+  qsort(order, len, sizeof(MoveOrder), compare_move_order);
+  for (unsigned i = 0; i < len; i++) {
+    push_UIVec(g->move_worklist, order[i].move);
+  }
+  free_passes(order);
+}
+
+// uses are weighted by the depth of loops; definitions of registers computed again are not stored
+static void estimate_costs(Graph* g) {
+  for (unsigned n = g->k; n < g->count; n++) {
+    Interval* iv  = get_IntervalRefVec(g->parts, n);
+    bool is_remat = remat_def(g->env, iv->virtual) != NULL;
+    for (unsigned i = 0; i < length_UIVec(iv->uses); i++) {
+      unsigned use = get_UIVec(iv->uses, i);
+      if (!is_remat || use % 2 == 0) {
+        g->cost[n] += weight_at(g->env, use);
+      }
+    }
+    set_BitSet(g->spillable, n, can_spill_part(g->env, iv));
+  }
+}
+
+static void make_worklist(Graph* g) {
+  for (unsigned n = g->k; n < g->count; n++) {
+    if (get_UIVec(g->degree, n) >= g->k) {
+      set_state(g, n, NODE_SPILL, g->spill_list);
+    } else if (is_move_related(g, n)) {
+      set_state(g, n, NODE_FREEZE, g->freeze_list);
+    } else {
+      set_state(g, n, NODE_SIMPLIFY, g->simplify_list);
+    }
+  }
+}
+
+static void enable_moves(Graph* g, unsigned n) {
+  UIVec* ms = get_UIVecVec(g->move_list, n);
+  for (unsigned i = 0; i < length_UIVec(ms); i++) {
+    NodeMove* m = ptr_NodeMoves(g->moves, get_UIVec(ms, i));
+    if (m->state == MOVE_ACTIVE) {
+      m->state = MOVE_WORKLIST;
+      push_UIVec(g->move_worklist, get_UIVec(ms, i));
+    }
+  }
+}
+
+static void decrement_degree(Graph* g, unsigned n) {
+  if (is_precolored(g, n)) {
+    return;
+  }
+  unsigned degree = get_UIVec(g->degree, n);
+  set_UIVec(g->degree, n, degree - 1);
+  if (degree != g->k || get_UIVec(g->state, n) != NODE_SPILL) {
+    return;
+  }
+
+  enable_moves(g, n);
+  UIVec* adj = get_UIVecVec(g->adj_list, n);
+  for (unsigned i = 0; i < length_UIVec(adj); i++) {
+    if (!is_removed(g, get_UIVec(adj, i))) {
+      enable_moves(g, get_UIVec(adj, i));
+    }
+  }
+  if (is_move_related(g, n)) {
+    set_state(g, n, NODE_FREEZE, g->freeze_list);
+  } else {
+    set_state(g, n, NODE_SIMPLIFY, g->simplify_list);
+  }
+}
+
+static void simplify(Graph* g, unsigned n) {
+  set_state(g, n, NODE_SELECTED, g->select_stack);
+  UIVec* adj = get_UIVecVec(g->adj_list, n);
+  for (unsigned i = 0; i < length_UIVec(adj); i++) {
+    if (!is_removed(g, get_UIVec(adj, i))) {
+      decrement_degree(g, get_UIVec(adj, i));
+    }
+  }
+}
+
+static void add_worklist(Graph* g, unsigned n) {
+  if (get_UIVec(g->state, n) == NODE_FREEZE && !is_move_related(g, n) &&
+      get_UIVec(g->degree, n) < g->k) {
+    set_state(g, n, NODE_SIMPLIFY, g->simplify_list);
+  }
+}
+
+// George's test: coalescing `n` into a precolored node `r` does not make it harder to color
+static bool can_coalesce_into_reg(Graph* g, unsigned n, unsigned r) {
+  UIVec* adj = get_UIVecVec(g->adj_list, n);
+  for (unsigned i = 0; i < length_UIVec(adj); i++) {
+    unsigned t = get_UIVec(adj, i);
+    if (!is_removed(g, t) && get_UIVec(g->degree, t) >= g->k && !is_precolored(g, t) &&
+        !is_adjacent(g, t, r)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static unsigned count_significant(Graph* g, unsigned n, unsigned count) {
+  UIVec* adj = get_UIVecVec(g->adj_list, n);
+  for (unsigned i = 0; i < length_UIVec(adj); i++) {
+    unsigned t = get_UIVec(adj, i);
+    if (is_removed(g, t) || get_UIVec(g->marks, t) == g->stamp) {
+      continue;
+    }
+    set_UIVec(g->marks, t, g->stamp);
+    if (get_UIVec(g->degree, t) >= g->k) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Briggs's test: the node made of `u` and `v` has less than k neighbors of significant degree
+static bool conservative(Graph* g, unsigned u, unsigned v) {
+  g->stamp++;
+  return count_significant(g, v, count_significant(g, u, 0)) < g->k;
+}
+
+static void combine(Graph* g, unsigned u, unsigned v) {
+  set_UIVec(g->state, v, NODE_COALESCED);
+  set_UIVec(g->alias, v, u);
+  UIVec* ms = get_UIVecVec(g->move_list, v);
+  for (unsigned i = 0; i < length_UIVec(ms); i++) {
+    push_UIVec(get_UIVecVec(g->move_list, u), get_UIVec(ms, i));
+  }
+  enable_moves(g, v);
+
+  UIVec* adj = get_UIVecVec(g->adj_list, v);
+  for (unsigned i = 0; i < length_UIVec(adj); i++) {
+    unsigned t = get_UIVec(adj, i);
+    if (!is_removed(g, t)) {
+      add_edge(g, t, u);
+      decrement_degree(g, t);
+    }
+  }
+  if (get_UIVec(g->degree, u) >= g->k && get_UIVec(g->state, u) == NODE_FREEZE) {
+    set_state(g, u, NODE_SPILL, g->spill_list);
+  }
+}
+
+static void coalesce(Graph* g, unsigned idx) {
+  NodeMove* m = ptr_NodeMoves(g->moves, idx);
+  unsigned x  = get_alias(g, m->src);
+  unsigned y  = get_alias(g, m->dst);
+  unsigned u  = is_precolored(g, y) ? y : x;
+  unsigned v  = is_precolored(g, y) ? x : y;
+
+  if (u == v) {
+    m->state = MOVE_COALESCED;
+    add_worklist(g, u);
+  } else if (is_precolored(g, v) || is_adjacent(g, u, v)) {
+    m->state = MOVE_CONSTRAINED;
+    add_worklist(g, u);
+    add_worklist(g, v);
+  } else if (is_precolored(g, u) ? can_coalesce_into_reg(g, v, u) : conservative(g, u, v)) {
+    m->state = MOVE_COALESCED;
+    combine(g, u, v);
+    add_worklist(g, u);
+  } else {
+    m->state = MOVE_ACTIVE;
+  }
+}
+
+static void freeze_moves(Graph* g, unsigned u) {
+  UIVec* ms = get_UIVecVec(g->move_list, u);
+  for (unsigned i = 0; i < length_UIVec(ms); i++) {
+    NodeMove* m = ptr_NodeMoves(g->moves, get_UIVec(ms, i));
+    if (!is_pending(m)) {
+      continue;
+    }
+    unsigned x = get_alias(g, m->src);
+    unsigned y = get_alias(g, m->dst);
+    unsigned v = y == get_alias(g, u) ? x : y;
+    m->state   = MOVE_FROZEN;
+    if (get_UIVec(g->state, v) == NODE_FREEZE && !is_move_related(g, v)) {
+      set_state(g, v, NODE_SIMPLIFY, g->simplify_list);
+    }
+  }
+}
+
+static void freeze(Graph* g, unsigned n) {
+  set_state(g, n, NODE_SIMPLIFY, g->simplify_list);
+  freeze_moves(g, n);
+}
+
+// whether spilling `a` costs less than spilling `b` relative to their degrees
+static bool cheaper_spill(Graph* g, unsigned a, unsigned b) {
+  bool sa = get_BitSet(g->spillable, a);
+  bool sb = get_BitSet(g->spillable, b);
+  if (sa != sb) {
+    return sa;
+  }
+  return g->cost[a] * get_UIVec(g->degree, b) < g->cost[b] * get_UIVec(g->degree, a);
+}
+
+// the node in `spill_list` which is the cheapest to spill, -1 if there is none
+// the list is compacted on the way, since nodes may be left in it more than once
+static unsigned choose_spill(Graph* g) {
+  g->stamp++;
+  unsigned best = -1;
+  unsigned len  = 0;
+  for (unsigned i = 0; i < length_UIVec(g->spill_list); i++) {
+    unsigned n = get_UIVec(g->spill_list, i);
+    if (get_UIVec(g->state, n) != NODE_SPILL || get_UIVec(g->marks, n) == g->stamp) {
+      continue;
+    }
+    set_UIVec(g->marks, n, g->stamp);
+    set_UIVec(g->spill_list, len++, n);
+    if (best == -1 || cheaper_spill(g, n, best)) {
+      best = n;
+    }
+  }
+  resize_UIVec(g->spill_list, len);
+  return best;
+}
+
+// simplify `n` optimistically; it is spilled only if no color is left for it in `assign_colors`
+static void select_spill(Graph* g, unsigned n) {
+  set_state(g, n, NODE_SIMPLIFY, g->simplify_list);
+  freeze_moves(g, n);
+}
+
+static bool has_color(Graph* g, unsigned n) {
+  NodeState s = get_UIVec(g->state, n);
+  return s == NODE_PRECOLORED || s == NODE_COLORED;
+}
+
+// the color of a node it is moved from or to if possible, so that the move can be removed
+// otherwise a callee-saved register first if the part lives through calls, see `choose_free_reg`
+static unsigned choose_color(Graph* g, unsigned n) {
+  UIVec* ms = get_UIVecVec(g->move_list, n);
+  for (unsigned i = 0; i < length_UIVec(ms); i++) {
+    NodeMove* m = ptr_NodeMoves(g->moves, get_UIVec(ms, i));
+    unsigned x  = get_alias(g, m->src);
+    unsigned y  = get_alias(g, m->dst);
+    unsigned t  = x == n ? y : x;
+    if (has_color(g, t) && !get_BitSet(g->used_colors, get_UIVec(g->color, t))) {
+      return get_UIVec(g->color, t);
+    }
+  }
+
+  Interval* iv       = get_IntervalRefVec(g->parts, n);
+  bool through_calls = next_call_through(g->env, iv, iv->from) != -1;
+  unsigned other     = -1;
+  for (unsigned i = 0; i < length_UIVec(g->env->order); i++) {
+    unsigned r = get_UIVec(g->env->order, i);
+    if (get_BitSet(g->used_colors, r)) {
+      continue;
+    }
+    if (is_scratch[r] != through_calls) {
+      return r;
+    }
+    if (other == -1) {
+      other = r;
+    }
+  }
+  return other;
+}
+
+static void assign_colors(Graph* g) {
+  while (length_UIVec(g->select_stack) != 0) {
+    unsigned n = get_UIVec(g->select_stack, length_UIVec(g->select_stack) - 1);
+    resize_UIVec(g->select_stack, length_UIVec(g->select_stack) - 1);
+
+    clear_BitSet(g->used_colors);
+    UIVec* adj = get_UIVecVec(g->adj_list, n);
+    for (unsigned i = 0; i < length_UIVec(adj); i++) {
+      unsigned t = get_alias(g, get_UIVec(adj, i));
+      if (has_color(g, t)) {
+        set_BitSet(g->used_colors, get_UIVec(g->color, t), true);
+      }
+    }
+
+    unsigned color = choose_color(g, n);
+    if (color == -1) {
+      set_state(g, n, NODE_SPILLED, g->spilled);
+    } else {
+      set_state(g, n, NODE_COLORED, NULL);
+      set_UIVec(g->color, n, color);
+    }
+  }
+}
+
+static Graph* build_graph(Env* env) {
+  Graph* g = alloc_passes(sizeof(Graph));
+  g->env   = env;
+  g->k     = env->num_regs;
+
+  g->parts         = new_IntervalRefVec(env->f->reg_count + g->k);
+  g->first_node    = new_UIVec(env->f->reg_count);
+  g->adj_set       = new_BSVec(env->f->reg_count + g->k);
+  g->adj_list      = new_UIVecVec(env->f->reg_count + g->k);
+  g->move_list     = new_UIVecVec(env->f->reg_count + g->k);
+  g->moves         = new_NodeMoves(16);
+  g->used_colors   = zero_BitSet(g->k);
+  g->simplify_list = new_UIVec(16);
+  g->freeze_list   = new_UIVec(16);
+  g->spill_list    = new_UIVec(16);
+  g->move_worklist = new_UIVec(16);
+  g->select_stack  = new_UIVec(16);
+  g->spilled       = new_UIVec(1);
+
+  collect_nodes(g);
+  build_edges(g);
+  build_moves(g);
+  estimate_costs(g);
+  return g;
+}
+
+static void release_Graph(Graph* g) {
+  release_IntervalRefVec(g->parts);
+  release_UIVec(g->first_node);
+  release_BSVec(g->adj_set);
+  release_UIVecVec(g->adj_list);
+  release_UIVec(g->degree);
+  release_UIVecVec(g->move_list);
+  release_NodeMoves(g->moves);
+  release_UIVec(g->alias);
+  release_UIVec(g->color);
+  release_UIVec(g->state);
+  free_passes(g->cost);
+  release_BitSet(g->spillable);
+  release_BitSet(g->used_colors);
+  release_UIVec(g->marks);
+  release_UIVec(g->simplify_list);
+  release_UIVec(g->freeze_list);
+  release_UIVec(g->spill_list);
+  release_UIVec(g->move_worklist);
+  release_UIVec(g->select_stack);
+  release_UIVec(g->spilled);
+  free_passes(g);
+}
+
+// a part too short to be spilled is left without a color: make room for it by spilling the cheapest
+// of the colored neighbors instead, as `spill_at_interval` does, or -1 if all of them are precolored
+// or too short as well
+static unsigned colored_neighbor_to_spill(Graph* g, unsigned n) {
+  unsigned best = -1;
+  UIVec* adj    = get_UIVecVec(g->adj_list, n);
+  for (unsigned i = 0; i < length_UIVec(adj); i++) {
+    unsigned t = get_UIVec(adj, i);
+    if (is_precolored(g, t) || !get_BitSet(g->spillable, t) || !has_color(g, get_alias(g, t))) {
+      continue;
+    }
+    if (best == -1 || g->cost[t] < g->cost[best]) {
+      best = t;
+    }
+  }
+  return best;
+}
+
+typedef enum {
+  COLOR_DONE,
+  COLOR_SPILLED,  // some nodes are put on the stack around their uses, to be colored again
+  COLOR_STUCK,    // a node can be neither colored nor spilled, and neither can its neighbors
+} ColorResult;
+
+static ColorResult color_graph(Env* env) {
+  Graph* g = build_graph(env);
+  make_worklist(g);
+
+  for (;;) {
+    unsigned n;
+    if ((n = pop_node(g, g->simplify_list, NODE_SIMPLIFY)) != -1) {
+      simplify(g, n);
+    } else if (length_UIVec(g->move_worklist) != 0) {
+      unsigned idx = get_UIVec(g->move_worklist, length_UIVec(g->move_worklist) - 1);
+      resize_UIVec(g->move_worklist, length_UIVec(g->move_worklist) - 1);
+      if (get_NodeMoves(g->moves, idx).state == MOVE_WORKLIST) {
+        coalesce(g, idx);
+      }
+    } else if ((n = pop_node(g, g->freeze_list, NODE_FREEZE)) != -1) {
+      freeze(g, n);
+    } else if ((n = choose_spill(g)) != -1) {
+      select_spill(g, n);
+    } else {
+      break;
+    }
+  }
+  assign_colors(g);
+
+  ColorResult result = length_UIVec(g->spilled) == 0 ? COLOR_DONE : COLOR_SPILLED;
+  BitSet* spill      = zero_BitSet(g->count);
+  for (unsigned i = 0; i < length_UIVec(g->spilled); i++) {
+    unsigned n = get_UIVec(g->spilled, i);
+    unsigned t = get_BitSet(g->spillable, n) ? n : colored_neighbor_to_spill(g, n);
+    if (t == -1) {
+      result = COLOR_STUCK;
+      break;
+    }
+    set_BitSet(spill, t, true);
+  }
+  if (result == COLOR_SPILLED) {
+    for (unsigned n = g->k; n < g->count; n++) {
+      if (get_BitSet(spill, n)) {
+        spill_part(env, get_IntervalRefVec(g->parts, n));
+      }
+    }
+  }
+  release_BitSet(spill);
+  if (result == COLOR_DONE) {
+    for (unsigned n = g->k; n < g->count; n++) {
+      get_IntervalRefVec(g->parts, n)->real = get_UIVec(g->color, get_alias(g, n));
+    }
+  }
+
+  release_Graph(g);
+  return result;
+}
+
+// returns false if the graph gets stuck, leaving the intervals split
+static bool color_intervals(Env* env) {
+  for (unsigned v = 0; v < env->f->reg_count; v++) {
+    Interval* iv = interval_of(env, v);
+    if (iv->kind == IV_VIRTUAL) {
+      // in a register until it is spilled; the register is chosen in `assign_colors`
+      iv->real = 0;
+    }
+  }
+  ColorResult result;
+  while ((result = color_graph(env)) == COLOR_SPILLED) {
+  }
+  return result == COLOR_DONE;
+}
+
+// moves between the same register are left by coalescing
+static void remove_self_moves(Env* env) {
+  IRInstList* insts = env->f->instructions;
+  for (IRInstListIterator* it = front_IRInstList(insts); !is_nil_IRInstListIterator(it);) {
+    IRInst* inst = data_IRInstListIterator(it);
+    if (inst->kind == IR_MOV && get_RegVec(inst->ras, 0)->real == inst->rd->real &&
+        get_RegVec(inst->ras, 0)->size == inst->rd->size) {
+      it = remove_IRInstListIterator(insts, it);
+      env->stats.coalesced++;
+    } else {
+      it = next_IRInstListIterator(it);
+    }
+  }
+}
+
+static struct {
+  atomic_ulong stores;
+  atomic_ulong loads;
+  atomic_ulong remats;
+  atomic_ulong avoided;
+  atomic_ulong coalesced;
+} stats;
+
+static void add_stats(const RegAllocStats* s) {
+  atomic_fetch_add_explicit(&stats.stores, s->stores, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.loads, s->loads, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.remats, s->remats, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.avoided, s->avoided, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.coalesced, s->coalesced, memory_order_relaxed);
+}
+
+static void reg_alloc_function(RegAllocKind kind,
+                               unsigned num_regs,
+                               unsigned* global_inst_count,
+                               unsigned* global_bb_count,
+                               Function* ir) {
+  Env* env = init_Env(ir, global_inst_count, global_bb_count, num_regs);
+  number_positions(env);
+
+  release_RegIntervals(ir->intervals);
+  ir->intervals = build_intervals(env);
+  build_fixed_intervals(env);
+  find_remat_defs(env);
+  calc_loop_depth(env);
+
+  bool colored = kind == RA_COLOR && color_intervals(env);
+  if (kind == RA_COLOR && !colored) {
+    // linear scan splits a part where its register gets blocked, which coloring cannot do
+    release_RegIntervals(ir->intervals);
+    ir->intervals = build_intervals(env);
+  }
+  if (!colored) {
+    for (unsigned v = 0; v < ir->reg_count; v++) {
+      Interval* iv = interval_of(env, v);
+      if (iv->kind == IV_VIRTUAL) {
+        push_unhandled(env, iv);
+      }
+    }
+    walk_intervals(env);
+  }
+
+  calc_preserve_regs(env, front_BBList(ir->blocks), env->block_count);
+  assign_reg_num(env);
+  resolve_data_flow(env);
+  allocate_frame(env);
+  if (kind == RA_COLOR) {
+    remove_self_moves(env);
+  }
+
+  ir->used_regs = zero_BitSet(num_regs);
+  for (unsigned v = 0; v < ir->reg_count; v++) {
+    for (Interval* iv = interval_of(env, v); iv != NULL; iv = iv->next) {
+      if (iv->real != -1) {
+        set_BitSet(ir->used_regs, iv->real, true);
+      }
+    }
+  }
+
+  add_stats(&env->stats);
+  release_Env(env);
+}
+
+static void reg_alloc_functions(RegAllocKind kind, unsigned num_regs, IR* ir, FunctionList* l) {
+  if (is_nil_FunctionList(l)) {
+    return;
+  }
+
+  reg_alloc_function(kind, num_regs, &ir->inst_count, &ir->bb_count, head_FunctionList(l));
+
+  reg_alloc_functions(kind, num_regs, ir, tail_FunctionList(l));
+}
 
-  liveness_functions(tail_FunctionList(l));
+void reg_alloc(RegAllocKind kind, unsigned num_regs, IR* ir) {
+  reg_alloc_functions(kind, num_regs, ir, ir->functions);
 }
 
-static void liveness(IR* ir) {
-  liveness_functions(ir->functions);
+RegAllocStats reg_alloc_stats() {
+  return (RegAllocStats){
+      .stores    = atomic_load(&stats.stores),
+      .loads     = atomic_load(&stats.loads),
+      .remats    = atomic_load(&stats.remats),
+      .avoided   = atomic_load(&stats.avoided),
+      .coalesced = atomic_load(&stats.coalesced),
+  };
 }
 
-void reg_alloc(unsigned num_regs, IR* ir) {
-  liveness(ir);
-  reg_alloc_functions(num_regs, &ir->inst_count, ir->functions);
+void print_reg_alloc_stats(FILE* f) {
+  RegAllocStats s = reg_alloc_stats();
+  fprintf(f, "register allocation\n");
+  fprintf(f, "  %-14s %12lu\n", "spills", s.stores);
+  fprintf(f, "  %-14s %12lu\n", "reloads", s.loads);
+  fprintf(f, "  %-14s %12lu\n", "remats", s.remats);
+  fprintf(f, "  %-14s %12lu\n", "spills avoided", s.avoided);
+  fprintf(f, "  %-14s %12lu\n", "moves removed", s.coalesced);
 }
@@ -1,8 +1,27 @@
 #ifndef CCC_REG_ALLOC_H
 #define CCC_REG_ALLOC_H
 
+#include <stdio.h>
+
 #include "ir.h"
 
-void reg_alloc(unsigned num_regs, IR* ir);
+typedef enum {
+  RA_LINEAR,  // linear scan
+  RA_COLOR,   // graph coloring with move coalescing, slower but removes more moves
+} RegAllocKind;
+
+void reg_alloc(RegAllocKind, unsigned num_regs, IR* ir);
+
+// moves inserted or removed by `reg_alloc`, summed over all functions from any thread
+typedef struct {
+  unsigned long stores;     // spills
+  unsigned long loads;      // reloads
+  unsigned long remats;     // definitions computed again in place of reloads
+  unsigned long avoided;    // spills not needed since the value is computed again
+  unsigned long coalesced;  // moves between registers removed by `RA_COLOR`
+} RegAllocStats;
+
+RegAllocStats reg_alloc_stats();
+void print_reg_alloc_stats(FILE*);
 
 #endif
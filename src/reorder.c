@@ -1,4 +1,7 @@
 #include "reorder.h"
+#include "mem_stats.h"
+
+DEFINE_TAGGED_ALLOCATOR(passes, MEM_PASSES)
 
 typedef struct {
   BBList* bbs;
@@ -6,7 +9,7 @@ typedef struct {
 } Env;
 
 Env* init_Env(unsigned expected_bb_count) {
-  Env* env     = calloc(1, sizeof(Env));
+  Env* env     = alloc_passes(sizeof(Env));
   env->bbs     = new_BBList();
   env->visited = zero_BitSet(expected_bb_count);
   return env;
@@ -42,21 +45,55 @@ void traverse_blocks(Env* env, BasicBlock* b) {
   push_front_BBList(env->bbs, b);
 }
 
-void number_insts_and_blocks(Function* f) {
+static bool same_insts(IRInstList* a, IRInstList* b) {
+  IRInstListIterator* it1 = front_IRInstList(a);
+  IRInstListIterator* it2 = front_IRInstList(b);
+  while (!is_nil_IRInstListIterator(it1) && !is_nil_IRInstListIterator(it2)) {
+    if (data_IRInstListIterator(it1) != data_IRInstListIterator(it2)) {
+      return false;
+    }
+    it1 = next_IRInstListIterator(it1);
+    it2 = next_IRInstListIterator(it2);
+  }
+  return is_nil_IRInstListIterator(it1) && is_nil_IRInstListIterator(it2);
+}
+
+// release the instructions of `old` that are not in `insts`, which belong to removed blocks
+static void release_dropped_insts(IRInstList* old, IRInstList* insts) {
+  for (IRInstListIterator* it = front_IRInstList(old); !is_nil_IRInstListIterator(it);
+       it                     = next_IRInstListIterator(it)) {
+    IRInst* inst = data_IRInstListIterator(it);
+    // a kept instruction is found at its new `local_id`
+    IRInstListIterator* kept = inst->local_id < capacity_IRInstList(insts)
+                                   ? get_iterator_IRInstList(insts, inst->local_id)
+                                   : NULL;
+    if (kept == NULL || data_IRInstListIterator(kept) != inst) {
+      release_inst(inst);
+    }
+  }
+}
+
+// returns whether the order or any `local_id` has changed
+bool number_insts_and_blocks(Function* f) {
   IRInstList* insts   = new_IRInstList(capacity_IRInstList(f->instructions));
   unsigned inst_count = 0;
   unsigned bb_count   = 0;
+  bool changed        = false;
   for (BBListIterator* it1 = front_BBList(f->blocks); !is_nil_BBListIterator(it1);
        it1                 = next_BBListIterator(it1)) {
     BasicBlock* b = data_BBListIterator(it1);
-    b->local_id   = bb_count++;
+    changed |= b->local_id != bb_count;
+    b->local_id = bb_count++;
 
     IRInstListIterator* before_from = back_IRInstList(insts);
-    for (IRInstRangeIterator* it2              = front_IRInstRange(b->instructions);
-         !is_nil_IRInstRangeIterator(it2); it2 = next_IRInstRangeIterator(it2)) {
-      IRInst* inst   = data_IRInstRangeIterator(it2);
+    for (IRInstListIterator* it2 = b->instructions->from;; it2 = next_IRInstListIterator(it2)) {
+      IRInst* inst = data_IRInstListIterator(it2);
+      changed |= inst->local_id != inst_count;
       inst->local_id = inst_count++;
       push_back_IRInstList(insts, inst);
+      if (it2 == b->instructions->to) {
+        break;
+      }
     }
     IRInstListIterator* to = back_IRInstList(insts);
 
@@ -69,41 +106,57 @@ void number_insts_and_blocks(Function* f) {
     b->instructions->to = to;
   }
 
+  changed |= f->instructions == NULL || !same_insts(f->instructions, insts);
   if (f->instructions != NULL) {
-    // TODO: shallow release
-    // TODO: we need to make sure that all instructions in `f->instructions` are in `insts` here
-    // release_IRInstList(f->instructions);
+    release_dropped_insts(f->instructions, insts);
+    shallow_release_IRInstList(f->instructions);
   }
   f->instructions = insts;
+  return changed;
+}
+
+static bool same_order(BBList* a, BBList* b) {
+  BBListIterator* it1 = front_BBList(a);
+  BBListIterator* it2 = front_BBList(b);
+  while (!is_nil_BBListIterator(it1) && !is_nil_BBListIterator(it2)) {
+    if (data_BBListIterator(it1) != data_BBListIterator(it2)) {
+      return false;
+    }
+    it1 = next_BBListIterator(it1);
+    it2 = next_BBListIterator(it2);
+  }
+  return is_nil_BBListIterator(it1) && is_nil_BBListIterator(it2);
 }
 
 // change `local_id`s of `BasicBlock` and `IRInst`
-static void reorder_blocks_function(Function* ir) {
+static bool reorder_blocks_function(Function* ir) {
   Env* env = init_Env(ir->bb_count);
 
   traverse_blocks(env, ir->entry);
+  bool changed = ir->blocks == NULL || !same_order(ir->blocks, env->bbs);
   if (ir->blocks != NULL) {
-    // TODO: shallow release
-    /* release_BBList(ir->blocks); */
+    shallow_release_BBList(ir->blocks);
   }
   ir->blocks = env->bbs;
   release_BitSet(env->visited);
+  free_passes(env);
 
-  number_insts_and_blocks(ir);
+  changed |= number_insts_and_blocks(ir);
+  return changed;
 }
 
-static void reorder_blocks_functions(FunctionList* l) {
+static bool reorder_blocks_functions(FunctionList* l) {
   if (is_nil_FunctionList(l)) {
-    return;
+    return false;
   }
 
-  reorder_blocks_function(head_FunctionList(l));
+  bool changed = reorder_blocks_function(head_FunctionList(l));
 
-  reorder_blocks_functions(tail_FunctionList(l));
+  return reorder_blocks_functions(tail_FunctionList(l)) || changed;
 }
 
-void reorder_blocks(IR* ir) {
-  reorder_blocks_functions(ir->functions);
+bool reorder_blocks(IR* ir) {
+  return reorder_blocks_functions(ir->functions);
 }
 
 static void mark_visited(BitSet* visited, BasicBlock* target) {
@@ -120,32 +173,36 @@ static void mark_visited(BitSet* visited, BasicBlock* target) {
   }
 }
 
-static void remove_dead(Function* f, BasicBlock* entry) {
+static bool remove_dead(Function* f, BasicBlock* entry) {
   BitSet* visited = zero_BitSet(f->bb_count);
   mark_visited(visited, entry);
 
+  bool changed = false;
   BBListIterator* it = front_BBList(f->blocks);
   while (!is_nil_BBListIterator(it)) {
     BasicBlock* bb = data_BBListIterator(it);
     it             = next_BBListIterator(it);
-    if (!get_BitSet(visited, bb->local_id)) {
+    // the exit is kept even if an infinite loop makes it unreachable
+    if (!get_BitSet(visited, bb->local_id) && bb != f->exit) {
       detach_BasicBlock(f, bb);
+      changed = true;
     }
   }
   release_BitSet(visited);
+  return changed;
 }
 
-static void remove_dead_functions(FunctionList* l) {
+static bool remove_dead_functions(FunctionList* l) {
   if (is_nil_FunctionList(l)) {
-    return;
+    return false;
   }
 
-  Function* f = head_FunctionList(l);
-  remove_dead(f, f->entry);
+  Function* f  = head_FunctionList(l);
+  bool changed = remove_dead(f, f->entry);
 
-  remove_dead_functions(tail_FunctionList(l));
+  return remove_dead_functions(tail_FunctionList(l)) || changed;
 }
 
-void remove_dead_blocks(IR* ir) {
-  remove_dead_functions(ir->functions);
+bool remove_dead_blocks(IR* ir) {
+  return remove_dead_functions(ir->functions);
 }
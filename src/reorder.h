@@ -3,7 +3,8 @@
 
 #include "ir.h"
 
-void reorder_blocks(IR*);
-void remove_dead_blocks(IR*);
+// these return whether any function has been changed
+bool reorder_blocks(IR*);
+bool remove_dead_blocks(IR*);
 
 #endif
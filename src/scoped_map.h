@@ -0,0 +1,122 @@
+#ifndef CCC_SCOPED_MAP_H
+#define CCC_SCOPED_MAP_H
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "map.h"
+#include "vector.h"
+
+// map from interned string to `T` with nested scopes
+// names inserted in a scope are dropped when it is closed, bringing back the ones they shadowed
+#define DECLARE_SCOPED_MAP(T, Name)                                                                \
+  typedef struct Name Name;                                                                        \
+  Name* new_##Name(unsigned size);                                                                 \
+  void start_scope_##Name(Name*);                                                                  \
+  void end_scope_##Name(Name*);                                                                    \
+  void insert_##Name(Name*, const char* k, T v);                                                   \
+  bool lookup_##Name(Name*, const char* k, T* out);                                                \
+  bool lookup_local_##Name(Name*, const char* k, T* out);                                          \
+  void release_##Name(Name*);
+
+// a single map holds the innermost binding of each name, and an undo log records what each
+// insertion shadowed, so that opening and closing a scope costs O(names declared in it)
+// values are owned: the ones dropped at the end of a scope are released
+#define DEFINE_SCOPED_MAP(release_T, T, Name)                                                      \
+  typedef struct {                                                                                 \
+    T value;                                                                                       \
+    unsigned depth; /* of the scope where `value` is inserted */                                   \
+  } Name##Binding;                                                                                 \
+  static Name##Binding copy_##Name##Binding(Name##Binding b) { return b; }                         \
+  static void release_##Name##Binding(Name##Binding b) { release_T(b.value); }                     \
+  DECLARE_MAP(Name##Binding, Name##Bindings)                                                       \
+  DEFINE_MAP(copy_##Name##Binding, release_##Name##Binding, Name##Binding, Name##Bindings)         \
+  typedef struct {                                                                                 \
+    const char* key; /* NULL at the start of a scope */                                            \
+    bool is_shadowing;                                                                             \
+    Name##Binding shadowed; /* if `is_shadowing` */                                                \
+  } Name##Undo;                                                                                    \
+  static void release_##Name##Undo(Name##Undo u) {}                                                \
+  DECLARE_VECTOR(Name##Undo, Name##UndoLog)                                                        \
+  DEFINE_VECTOR_WITH(maps, release_##Name##Undo, Name##Undo, Name##UndoLog)                        \
+  struct Name {                                                                                    \
+    Name##Bindings* bindings;                                                                      \
+    Name##UndoLog* log;                                                                            \
+    unsigned depth;                                                                                \
+  };                                                                                               \
+  Name* new_##Name(unsigned size) {                                                                \
+    Name* m     = alloc_maps(sizeof(Name));                                                        \
+    m->bindings = new_##Name##Bindings(size);                                                      \
+    m->log      = new_##Name##UndoLog(size);                                                       \
+    return m;                                                                                      \
+  }                                                                                                \
+  void start_scope_##Name(Name* m) {                                                               \
+    Name##Undo marker = {.key = NULL};                                                             \
+    push_##Name##UndoLog(m->log, marker);                                                          \
+    m->depth++;                                                                                    \
+  }                                                                                                \
+  void end_scope_##Name(Name* m) {                                                                 \
+    assert(m->depth != 0);                                                                         \
+    unsigned len = length_##Name##UndoLog(m->log);                                                 \
+    for (;;) {                                                                                     \
+      Name##Undo u = get_##Name##UndoLog(m->log, --len);                                           \
+      if (u.key == NULL) {                                                                         \
+        break;                                                                                     \
+      }                                                                                            \
+      release_##Name##Binding(get_##Name##Bindings(m->bindings, u.key));                           \
+      if (u.is_shadowing) {                                                                        \
+        insert_##Name##Bindings(m->bindings, u.key, u.shadowed);                                   \
+      } else {                                                                                     \
+        remove_##Name##Bindings(m->bindings, u.key);                                               \
+      }                                                                                            \
+    }                                                                                              \
+    resize_##Name##UndoLog(m->log, len);                                                           \
+    m->depth--;                                                                                    \
+  }                                                                                                \
+  void insert_##Name(Name* m, const char* k, T v) {                                                \
+    Name##Binding old = {.depth = 0};                                                              \
+    bool found = lookup_##Name##Bindings(m->bindings, k, &old);                                    \
+    if (found && old.depth == m->depth) {                                                          \
+      /* redeclared in the same scope: the old value may still be referenced */                    \
+      insert_##Name##Bindings(m->bindings, k, (Name##Binding){v, m->depth});                       \
+      return;                                                                                      \
+    }                                                                                              \
+    if (m->depth != 0) {                                                                           \
+      Name##Undo u = {.key = k, .is_shadowing = found, .shadowed = old};                           \
+      push_##Name##UndoLog(m->log, u);                                                             \
+    }                                                                                              \
+    insert_##Name##Bindings(m->bindings, k, (Name##Binding){v, m->depth});                         \
+  }                                                                                                \
+  bool lookup_##Name(Name* m, const char* k, T* out) {                                             \
+    Name##Binding b;                                                                               \
+    if (!lookup_##Name##Bindings(m->bindings, k, &b)) {                                            \
+      return false;                                                                                \
+    }                                                                                              \
+    if (out != NULL) {                                                                             \
+      *out = b.value;                                                                              \
+    }                                                                                              \
+    return true;                                                                                   \
+  }                                                                                                \
+  bool lookup_local_##Name(Name* m, const char* k, T* out) {                                       \
+    Name##Binding b;                                                                               \
+    if (!lookup_##Name##Bindings(m->bindings, k, &b) || b.depth != m->depth) {                     \
+      return false;                                                                                \
+    }                                                                                              \
+    if (out != NULL) {                                                                             \
+      *out = b.value;                                                                              \
+    }                                                                                              \
+    return true;                                                                                   \
+  }                                                                                                \
+  void release_##Name(Name* m) {                                                                   \
+    if (m == NULL) {                                                                               \
+      return;                                                                                      \
+    }                                                                                              \
+    while (m->depth != 0) {                                                                        \
+      end_scope_##Name(m);                                                                         \
+    }                                                                                              \
+    release_##Name##Bindings(m->bindings);                                                         \
+    release_##Name##UndoLog(m->log);                                                               \
+    free_maps(m);                                                                                  \
+  }
+
+#endif
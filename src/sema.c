@@ -1,29 +1,40 @@
 #include "sema.h"
 #include "const_fold_tree.h"
 #include "map.h"
+#include "scoped_map.h"
 #include "type.h"
+#include "util.h"
 
 DECLARE_MAP(Type*, TypeMap)
-DEFINE_MAP(copy_Type, release_Type, Type*, TypeMap)
+DEFINE_MAP(copy_Type, release_dummy, Type*, TypeMap)
 
-typedef struct {
+DECLARE_SCOPED_MAP(Type*, ScopedTypeMap)
+DEFINE_SCOPED_MAP(release_dummy, Type*, ScopedTypeMap)
+
+static void release_long(long l) {}
+DECLARE_SCOPED_MAP(long, ScopedEnumMap)
+DEFINE_SCOPED_MAP(release_long, long, ScopedEnumMap)
+
+struct Sema {
   TypeMap* names;
   TypeMap* tagged_types;
   TypeMap* typedefs;
   EnumMap* enum_consts;
-} GlobalEnv;
+};
+
+typedef Sema GlobalEnv;
 
 typedef struct {
-  TypeMap* vars;
+  ScopedTypeMap* vars;
   Type* ret_ty;
   GlobalEnv* global;
   UIMap* named_labels;
   unsigned label_count;
   Statement* current_switch;
   bool is_global_only;
-  TypeMap* tagged_types;
-  TypeMap* typedefs;
-  EnumMap* enum_consts;
+  ScopedTypeMap* tagged_types;
+  ScopedTypeMap* typedefs;
+  ScopedEnumMap* enum_consts;
 } Env;
 
 static GlobalEnv* init_GlobalEnv() {
@@ -37,13 +48,13 @@ static GlobalEnv* init_GlobalEnv() {
 
 static Env* init_Env(GlobalEnv* global, Type* ret) {
   Env* env          = calloc(1, sizeof(Env));
-  env->vars         = new_TypeMap(64);
+  env->vars         = new_ScopedTypeMap(64);
   env->global       = global;
   env->ret_ty       = ret;
   env->named_labels = new_UIMap(32);
-  env->tagged_types = new_TypeMap(16);
-  env->typedefs     = new_TypeMap(16);
-  env->enum_consts  = new_EnumMap(64);
+  env->tagged_types = new_ScopedTypeMap(16);
+  env->typedefs     = new_ScopedTypeMap(16);
+  env->enum_consts  = new_ScopedEnumMap(64);
   return env;
 }
 
@@ -55,9 +66,10 @@ static Env* fake_env(GlobalEnv* global) {
 }
 
 static void release_Env(Env* env) {
-  release_TypeMap(env->vars);
-  release_TypeMap(env->tagged_types);
-  release_TypeMap(env->typedefs);
+  release_ScopedTypeMap(env->vars);
+  release_ScopedTypeMap(env->tagged_types);
+  release_ScopedTypeMap(env->typedefs);
+  release_ScopedEnumMap(env->enum_consts);
   free(env);
 }
 
@@ -72,7 +84,7 @@ static void add_var(Env* env, const char* name, Type* ty) {
   if (env->is_global_only) {
     insert_TypeMap(env->global->names, name, ty);
   } else {
-    insert_TypeMap(env->vars, name, ty);
+    insert_ScopedTypeMap(env->vars, name, ty);
   }
 }
 
@@ -80,12 +92,12 @@ static void add_tagged_type(Env* env, const char* name, Type* ty) {
   if (env->is_global_only) {
     insert_TypeMap(env->global->tagged_types, name, ty);
   } else {
-    insert_TypeMap(env->tagged_types, name, ty);
+    insert_ScopedTypeMap(env->tagged_types, name, ty);
   }
 }
 
 static bool lookup_tagged_type(Env* env, const char* name, Type** t) {
-  if (env->is_global_only || !lookup_TypeMap(env->tagged_types, name, t)) {
+  if (env->is_global_only || !lookup_ScopedTypeMap(env->tagged_types, name, t)) {
     if (!lookup_TypeMap(env->global->tagged_types, name, t)) {
       return false;
     }
@@ -97,12 +109,12 @@ static void add_enum_const(Env* env, const char* name, long v) {
   if (env->is_global_only) {
     insert_EnumMap(env->global->enum_consts, name, v);
   } else {
-    insert_EnumMap(env->enum_consts, name, v);
+    insert_ScopedEnumMap(env->enum_consts, name, v);
   }
 }
 
 static bool lookup_enum_const(Env* env, const char* name, long* t) {
-  if (env->is_global_only || !lookup_EnumMap(env->enum_consts, name, t)) {
+  if (env->is_global_only || !lookup_ScopedEnumMap(env->enum_consts, name, t)) {
     if (!lookup_EnumMap(env->global->enum_consts, name, t)) {
       return false;
     }
@@ -114,13 +126,13 @@ static void add_typedef(Env* env, const char* name, Type* ty) {
   if (env->is_global_only) {
     insert_TypeMap(env->global->typedefs, name, ty);
   } else {
-    insert_TypeMap(env->typedefs, name, ty);
+    insert_ScopedTypeMap(env->typedefs, name, ty);
   }
 }
 
 static Type* get_typedef(Env* env, const char* name) {
   Type* ty;
-  if (env->is_global_only || !lookup_TypeMap(env->typedefs, name, &ty)) {
+  if (env->is_global_only || !lookup_ScopedTypeMap(env->typedefs, name, &ty)) {
     if (!lookup_TypeMap(env->global->typedefs, name, &ty)) {
       error("typedef name %s could not found", name);
     }
@@ -178,7 +190,7 @@ static void set_default(Env* env, Statement* s) {
 
 static Type* get_var(Env* env, const char* name) {
   Type* ty;
-  if (env->is_global_only || !lookup_TypeMap(env->vars, name, &ty)) {
+  if (env->is_global_only || !lookup_ScopedTypeMap(env->vars, name, &ty)) {
     if (!lookup_TypeMap(env->global->names, name, &ty)) {
       error("undeclared identifier \"%s\"", name);
     }
@@ -314,7 +326,11 @@ static Type* translate_base_type(BaseType t) {
 }
 
 static Type* translate_declaration_specifiers(Env* env, DeclarationSpecifiers* spec);
-static void extract_declarator(Env* env, Declarator* decl, Type* base, char** name, Type** type);
+static void extract_declarator(Env* env,
+                               Declarator* decl,
+                               Type* base,
+                               const char** name,
+                               Type** type);
 
 typedef struct {
   StringVec* fields;
@@ -340,7 +356,7 @@ static void translate_struct_declarators(StructTranslationEnv* senv,
   }
 
   Declarator* decl = head_DeclaratorList(l);
-  char* name;
+  const char* name;
   Type* type;
   extract_declarator(senv->env, decl, base_ty, &name, &type);
 
@@ -376,14 +392,14 @@ static Type* translate_struct_specifier(Env* env, StructSpecifier* spec) {
       if (lookup_tagged_type(env, spec->tag, &ty)) {
         return copy_Type(ty);
       } else {
-        return struct_ty(strdup(spec->tag), NULL, NULL);
+        return struct_ty(spec->tag, NULL, NULL);
       }
     }
     case SS_DECL: {
       StructTranslationEnv* senv = init_StructTranslationEnv(env);
       translate_struct_declarations(env, senv, spec->declarations);
       if (spec->tag != NULL) {
-        Type* type = struct_ty(strdup(spec->tag), senv->fields, senv->field_map);
+        Type* type = struct_ty(spec->tag, senv->fields, senv->field_map);
         add_tagged_type(env, spec->tag, copy_Type(type));
         return type;
       } else {
@@ -414,7 +430,7 @@ static void translate_enumerators(Env* env, EnumTranslationEnv* eenv, Enumerator
   }
 
   Enumerator* e = head_EnumeratorList(l);
-  push_StringVec(eenv->enums, strdup(e->name));
+  push_StringVec(eenv->enums, e->name);
   if (e->value != NULL) {
     eenv->current_value = eval_constant(env, e->value);
   } else {
@@ -433,14 +449,14 @@ static Type* translate_enum_specifier(Env* env, EnumSpecifier* spec) {
       if (lookup_tagged_type(env, spec->tag, &ty)) {
         return copy_Type(ty);
       } else {
-        return struct_ty(strdup(spec->tag), NULL, NULL);
+        return struct_ty(spec->tag, NULL, NULL);
       }
     }
     case ES_DECL: {
       EnumTranslationEnv* senv = init_EnumTranslationEnv();
       translate_enumerators(env, senv, spec->enums);
       if (spec->tag != NULL) {
-        Type* type = enum_ty(strdup(spec->tag), senv->enums, senv->enum_map);
+        Type* type = enum_ty(spec->tag, senv->enums, senv->enum_map);
         add_tagged_type(env, spec->tag, copy_Type(type));
         return type;
       } else {
@@ -470,7 +486,7 @@ static Type* translate_declaration_specifiers(Env* env, DeclarationSpecifiers* s
 static void extract_direct_declarator(Env* env,
                                       DirectDeclarator* decl,
                                       Type* base,
-                                      char** name,
+                                      const char** name,
                                       Type** type) {
   switch (decl->kind) {
     case DE_DIRECT_ABSTRACT:
@@ -507,7 +523,11 @@ static void extract_direct_declarator(Env* env,
 
 // extract `Decalrator` and store the result to `name` and `type`
 // if `name` is NULL, this accepts abstract declarator
-static void extract_declarator(Env* env, Declarator* decl, Type* base, char** name, Type** type) {
+static void extract_declarator(Env* env,
+                               Declarator* decl,
+                               Type* base,
+                               const char** name,
+                               Type** type) {
   extract_direct_declarator(env, decl->direct, ptrify(base, decl->num_ptrs), name, type);
 }
 
@@ -638,13 +658,12 @@ static Expr* build_struct_copy(Expr* opr1, Expr* opr2) {
 
   Expr* node = NULL;
   for (unsigned i = 0; i < length_StringVec(ty->fields); i++) {
-    char* k   = get_StringVec(ty->fields, i);
-    Expr* lhs = new_node_member(copy_node(opr1), strdup(k));
-    Expr* rhs = new_node_member(copy_node(opr2), strdup(k));
+    const char* k = get_StringVec(ty->fields, i);
+    Expr* lhs     = new_node_member(copy_node(opr1), k);
+    Expr* rhs     = new_node_member(copy_node(opr2), k);
 
     node = build_comma(node, new_node_assign(lhs, rhs));
   }
-  release_expr(opr2);
 
   return build_comma(node, opr1);
 }
@@ -663,10 +682,8 @@ static Type* promoted_type(Type* opr) {
   }
   if (compare_rank_ty(opr, int_) <= 0) {
     if (is_representable_in_ty(opr, int_)) {
-      release_Type(uint_);
       return int_;
     } else {
-      release_Type(int_);
       return uint_;
     }
   }
@@ -950,7 +967,6 @@ static Type* try_complete(Env* env, Type* ty) {
 
     Type* comp;
     if (lookup_tagged_type(env, ty->tag, &comp)) {
-      release_Type(ty);
       return copy_Type(comp);
     }
   }
@@ -1179,9 +1195,6 @@ Type* sema_expr_raw(Env* env, Expr* expr) {
       CCC_UNREACHABLE;
   }
 
-  if (expr->type != NULL) {
-    release_Type(expr->type);
-  }
   expr->type = try_complete(env, t);
   return expr->type;
 }
@@ -1262,16 +1275,14 @@ static Initializer* build_string_initializer(Env* env, Type* type, Expr* init) {
   }
 
   // rewrite `= "hello"` to `= {'h', 'e', 'l', 'l', 'o', 0}`
-  char* p               = init->string;
   InitializerList* list = nil_InitializerList();
   InitializerList* cur  = list;
 
   for (unsigned i = 0; i < length_of_ty(type); i++) {
+    // the rest of the array is zero-filled
     Initializer* c_init = new_Initializer(IN_EXPR);
-    c_init->expr        = new_node_num(*p);
+    c_init->expr        = new_node_num(i < init->str_len ? init->string[i] : 0);
     cur                 = snoc_InitializerList(c_init, cur);
-
-    p++;
   }
 
   Initializer* new_init = new_Initializer(IN_LIST);
@@ -1329,7 +1340,7 @@ static void sema_init_declarator(Env* env,
                                  DeclarationSpecifiers* spec,
                                  Type* base_ty,
                                  InitDeclarator* decl) {
-  char* name;
+  const char* name;
   Type* ty;
   extract_declarator(env, decl->declarator, base_ty, &name, &ty);
 
@@ -1386,28 +1397,27 @@ static void sema_decl(Env* env, Declaration* decl) {
 
 static void sema_items(Env* env, BlockItemList* l);
 
-static TypeMap* start_scope(Env* env) {
-  TypeMap* save = env->vars;
-  TypeMap* inst = shallow_copy_TypeMap(env->vars);
-
-  env->vars = inst;
-
-  return save;
+static void start_scope(Env* env) {
+  start_scope_ScopedTypeMap(env->vars);
+  start_scope_ScopedTypeMap(env->tagged_types);
+  start_scope_ScopedTypeMap(env->typedefs);
+  start_scope_ScopedEnumMap(env->enum_consts);
 }
 
-static void end_scope(Env* env, TypeMap* save) {
-  // TODO: shallow release
-  /* release_TypeMap(env->vars); */
-  env->vars = save;
+static void end_scope(Env* env) {
+  end_scope_ScopedTypeMap(env->vars);
+  end_scope_ScopedTypeMap(env->tagged_types);
+  end_scope_ScopedTypeMap(env->typedefs);
+  end_scope_ScopedEnumMap(env->enum_consts);
 }
 
 static void sema_stmt(Env* env, Statement* stmt) {
   switch (stmt->kind) {
     case ST_COMPOUND: {
       // block
-      TypeMap* save = start_scope(env);
+      start_scope(env);
       sema_items(env, stmt->items);
-      end_scope(env, save);
+      end_scope(env);
       break;
     }
     case ST_EXPRESSION:
@@ -1433,7 +1443,7 @@ static void sema_stmt(Env* env, Statement* stmt) {
       sema_stmt(env, stmt->body);
       break;
     case ST_FOR: {
-      TypeMap* save = start_scope(env);
+      start_scope(env);
       if (stmt->init_decl != NULL) {
         sema_decl(env, stmt->init_decl);
       } else if (stmt->init != NULL) {
@@ -1444,7 +1454,7 @@ static void sema_stmt(Env* env, Statement* stmt) {
         sema_expr(env, stmt->after);
       }
       sema_stmt(env, stmt->body);
-      end_scope(env, save);
+      end_scope(env);
       break;
     }
     case ST_BREAK:
@@ -1538,7 +1548,7 @@ static TypeVec* param_types(Env* env, ParamList* cur) {
         error("parameter name omitted");
       }
       Type* type;
-      char* name;
+      const char* name;
       extract_declarator(env, d->decl, base_ty, &name, &type);
       push_TypeVec(params, type);
       add_var(env, name, copy_Type(type));
@@ -1548,21 +1558,28 @@ static TypeVec* param_types(Env* env, ParamList* cur) {
   return params;
 }
 
-static void sema_function(GlobalEnv* global, FunctionDef* f) {
+static void sema_function_decl(GlobalEnv* global, FunctionDef* f) {
   if (f->spec->is_typedef) {
     error("typedef declaration specifier is invalid in function definition");
   }
-  Type* base_ty = translate_declaration_specifiers(fake_env(global), f->spec);
+  Env* env      = fake_env(global);
+  Type* base_ty = translate_declaration_specifiers(env, f->spec);
   Type* ret;
-  char* name;
-  extract_declarator(fake_env(global), f->decl, base_ty, &name, &ret);
+  const char* name;
+  extract_declarator(env, f->decl, base_ty, &name, &ret);
 
-  Env* env        = init_Env(global, ret);
   TypeVec* params = param_types(env, f->params);
   Type* ty        = func_ty(ret, params, f->is_vararg);
   f->type         = copy_Type(ty);
 
-  add_var(fake_env(global), name, ty);
+  add_var(env, name, ty);
+  release_Env(env);
+}
+
+void sema_function_body(GlobalEnv* global, FunctionDef* f) {
+  Env* env = init_Env(global, f->type->ret);
+  // declares the parameters in the scope of the body
+  param_types(env, f->params);
   sema_items(env, f->items);
 
   f->named_labels = env->named_labels;
@@ -1571,46 +1588,58 @@ static void sema_function(GlobalEnv* global, FunctionDef* f) {
   release_Env(env);
 }
 
-static void sema_translation_unit(GlobalEnv* global, TranslationUnit* l) {
-  if (is_nil_TranslationUnit(l)) {
-    return;
-  }
-
-  ExternalDecl* d = head_TranslationUnit(l);
+void sema_external_decl(GlobalEnv* global, ExternalDecl* d) {
   switch (d->kind) {
     case EX_FUNC:
-      sema_function(global, d->func);
+      sema_function_decl(global, d->func);
       break;
     case EX_FUNC_DECL: {
       FunctionDecl* f = d->func_decl;
       if (f->spec->is_typedef) {
         error("typedef declaration specifier is invalid in function declaration");
       }
-      Type* base_ty = translate_declaration_specifiers(fake_env(global), f->spec);
+      Env* env      = fake_env(global);
+      Type* base_ty = translate_declaration_specifiers(env, f->spec);
       Type* ret;
-      char* name;
-      extract_declarator(fake_env(global), f->decl, base_ty, &name, &ret);
-      TypeVec* params = param_types(fake_env(global), f->params);
+      const char* name;
+      extract_declarator(env, f->decl, base_ty, &name, &ret);
+      TypeVec* params = param_types(env, f->params);
       Type* ty        = func_ty(ret, params, f->is_vararg);
       f->type         = copy_Type(ty);
-      add_var(fake_env(global), name, ty);
+      add_var(env, name, ty);
+      release_Env(env);
       break;
     }
     case EX_DECL: {
       Declaration* decl = d->decl;
-      Type* base_ty     = translate_declaration_specifiers(fake_env(global), decl->spec);
+      Env* env          = fake_env(global);
+      Type* base_ty     = translate_declaration_specifiers(env, decl->spec);
       // TODO: check if the declaration is `extern`
-      sema_init_decl_list(fake_env(global), true, decl->spec, base_ty, decl->declarators);
+      sema_init_decl_list(env, true, decl->spec, base_ty, decl->declarators);
+      release_Env(env);
       break;
     }
     default:
       CCC_UNREACHABLE;
   }
-  sema_translation_unit(global, tail_TranslationUnit(l));
+}
+
+Sema* new_Sema() {
+  return init_GlobalEnv();
+}
+
+void release_Sema(Sema* s) {
+  release_GlobalEnv(s);
 }
 
 void sema(AST* ast) {
   GlobalEnv* env = init_GlobalEnv();
-  sema_translation_unit(env, ast);
+  for (TranslationUnit* l = ast; !is_nil_TranslationUnit(l); l = tail_TranslationUnit(l)) {
+    ExternalDecl* d = head_TranslationUnit(l);
+    sema_external_decl(env, d);
+    if (d->kind == EX_FUNC) {
+      sema_function_body(env, d->func);
+    }
+  }
   release_GlobalEnv(env);
 }
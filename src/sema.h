@@ -6,4 +6,14 @@
 // semantic analysis.
 void sema(AST*);
 
+// the state of `sema` between external declarations, to analyze them one at a time
+typedef struct Sema Sema;
+
+Sema* new_Sema();
+// analyze `d` after the declarations given so far, except the body of a function definition
+void sema_external_decl(Sema*, ExternalDecl* d);
+// the body of a function definition, after its declaration is given to `sema_external_decl`
+void sema_function_body(Sema*, FunctionDef*);
+void release_Sema(Sema*);
+
 #endif
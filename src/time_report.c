@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "time_report.h"
+#include "vector.h"
+
+typedef struct {
+  const char* name;
+  Measure measure;
+} Phase;
+
+typedef struct {
+  const char* name;
+  const char* function;
+  unsigned function_idx;
+  int iteration;
+  unsigned seq;  // the order of addition
+  Measure measure;
+} Pass;
+
+static void release_Phase(Phase p) {}
+DECLARE_VECTOR(Phase, PhaseVec)
+DEFINE_VECTOR(release_Phase, Phase, PhaseVec)
+
+static void release_Pass(Pass p) {}
+DECLARE_VECTOR(Pass, PassVec)
+DEFINE_VECTOR(release_Pass, Pass, PassVec)
+
+struct TimeReport {
+  PhaseVec* phases;
+  PassVec* passes;
+  pthread_mutex_t lock;  // for `passes`
+};
+
+static double clock_seconds(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_seconds(bool per_thread) {
+  return clock_seconds(per_thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID);
+}
+
+Timer start_Timer(bool per_thread) {
+  Timer t = {
+      .per_thread = per_thread,
+      .wall       = clock_seconds(CLOCK_MONOTONIC),
+      .cpu        = cpu_seconds(per_thread),
+      .allocs     = thread_heap_stats()->allocs,
+      .heap       = start_heap_peak(),
+  };
+  return t;
+}
+
+Measure stop_Timer(Timer* t) {
+  Measure m = {
+      .start     = t->wall,
+      .wall      = clock_seconds(CLOCK_MONOTONIC) - t->wall,
+      .cpu       = cpu_seconds(t->per_thread) - t->cpu,
+      .allocs    = thread_heap_stats()->allocs - t->allocs,
+      .peak_heap = end_heap_peak(t->heap),
+  };
+  return m;
+}
+
+TimeReport* new_TimeReport() {
+  TimeReport* r = calloc(1, sizeof(TimeReport));
+  r->phases     = new_PhaseVec(16);
+  r->passes     = new_PassVec(64);
+  pthread_mutex_init(&r->lock, NULL);
+  return r;
+}
+
+void add_phase_TimeReport(TimeReport* r, const char* name, Measure m) {
+  Phase p = {.name = name, .measure = m};
+  push_PhaseVec(r->phases, p);
+}
+
+void add_pass_TimeReport(TimeReport* r,
+                         const char* name,
+                         const char* function,
+                         unsigned function_idx,
+                         int iteration,
+                         Measure m) {
+  Pass p = {
+      .name         = name,
+      .function     = function,
+      .function_idx = function_idx,
+      .iteration    = iteration,
+      .measure      = m,
+  };
+  pthread_mutex_lock(&r->lock);
+  p.seq = length_PassVec(r->passes);
+  push_PassVec(r->passes, p);
+  pthread_mutex_unlock(&r->lock);
+}
+
+static int compare_Pass(const void* a, const void* b) {
+  const Pass* p1 = a;
+  const Pass* p2 = b;
+  if (p1->function_idx != p2->function_idx) {
+    return p1->function_idx < p2->function_idx ? -1 : 1;
+  }
+  return p1->seq < p2->seq ? -1 : (p1->seq > p2->seq);
+}
+
+// passes in the order of functions, independent of the scheduling of threads
+static void sort_passes(TimeReport* r) {
+  qsort(data_PassVec(r->passes), length_PassVec(r->passes), sizeof(Pass), compare_Pass);
+}
+
+// wall and CPU times and allocations add up, and the peak is the largest one
+static void accumulate(Measure* acc, Measure m) {
+  acc->wall += m.wall;
+  acc->cpu += m.cpu;
+  acc->allocs += m.allocs;
+  if (m.peak_heap > acc->peak_heap) {
+    acc->peak_heap = m.peak_heap;
+  }
+}
+
+static void print_header(FILE* f, const char* title) {
+  fprintf(f, "%-24s %12s %12s %12s %16s\n", title, "wall (ms)", "cpu (ms)", "allocs",
+          "peak heap (KiB)");
+}
+
+static void print_row(FILE* f, const char* label, Measure m) {
+  fprintf(f, "%-24s %12.3f %12.3f ", label, m.wall * 1e3, m.cpu * 1e3);
+  if (heap_stats_available()) {
+    fprintf(f, "%12lu %16.1f\n", m.allocs, m.peak_heap / 1024.0);
+  } else {
+    fprintf(f, "%12s %16s\n", "-", "-");
+  }
+}
+
+typedef struct {
+  char label[64];
+  Measure measure;
+} Row;
+
+static void release_Row(Row r) {}
+DECLARE_VECTOR(Row, RowVec)
+DEFINE_VECTOR(release_Row, Row, RowVec)
+
+// add `m` to the row of `label`, which is appended if not found
+static void add_to_row(RowVec* rows, const char* label, Measure m) {
+  for (unsigned i = 0; i < length_RowVec(rows); i++) {
+    Row* row = ptr_RowVec(rows, i);
+    if (strcmp(row->label, label) == 0) {
+      accumulate(&row->measure, m);
+      return;
+    }
+  }
+  Row row = {.measure = m};
+  snprintf(row.label, sizeof(row.label), "%s", label);
+  push_RowVec(rows, row);
+}
+
+static void print_rows(FILE* f, const char* title, RowVec* rows) {
+  fputc('\n', f);
+  print_header(f, title);
+  for (unsigned i = 0; i < length_RowVec(rows); i++) {
+    Row row = get_RowVec(rows, i);
+    print_row(f, row.label, row.measure);
+  }
+}
+
+void print_TimeReport(FILE* f, TimeReport* r) {
+  sort_passes(r);
+
+  print_header(f, "phase");
+  Measure total = {0};
+  for (unsigned i = 0; i < length_PhaseVec(r->phases); i++) {
+    Phase p = get_PhaseVec(r->phases, i);
+    print_row(f, p.name, p.measure);
+    accumulate(&total, p.measure);
+  }
+  print_row(f, "total", total);
+
+  if (length_PassVec(r->passes) == 0) {
+    return;
+  }
+
+  RowVec* by_pass      = new_RowVec(16);
+  RowVec* by_iteration = new_RowVec(16);
+  RowVec* by_function  = new_RowVec(16);
+  for (unsigned i = 0; i < length_PassVec(r->passes); i++) {
+    Pass p = get_PassVec(r->passes, i);
+    add_to_row(by_pass, p.name, p.measure);
+
+    char iteration[16] = "final";
+    if (p.iteration >= 0) {
+      snprintf(iteration, sizeof(iteration), "%d", p.iteration);
+    }
+    add_to_row(by_iteration, iteration, p.measure);
+
+    // functions are sorted, so only the last row has to be checked
+    unsigned len = length_RowVec(by_function);
+    if (len != 0 && strcmp(ptr_RowVec(by_function, len - 1)->label, p.function) == 0) {
+      accumulate(&ptr_RowVec(by_function, len - 1)->measure, p.measure);
+    } else {
+      Row row = {.measure = p.measure};
+      snprintf(row.label, sizeof(row.label), "%s", p.function);
+      push_RowVec(by_function, row);
+    }
+  }
+  print_rows(f, "pass", by_pass);
+  print_rows(f, "iteration", by_iteration);
+  print_rows(f, "function", by_function);
+
+  release_RowVec(by_pass);
+  release_RowVec(by_iteration);
+  release_RowVec(by_function);
+}
+
+static void print_json_measure(FILE* f, Measure m) {
+  fprintf(f, "\"wall_ms\": %.6f, \"cpu_ms\": %.6f", m.wall * 1e3, m.cpu * 1e3);
+  if (heap_stats_available()) {
+    fprintf(f, ", \"allocs\": %lu, \"peak_heap_bytes\": %ld", m.allocs, m.peak_heap);
+  } else {
+    fprintf(f, ", \"allocs\": null, \"peak_heap_bytes\": null");
+  }
+}
+
+void print_json_TimeReport(FILE* f, TimeReport* r) {
+  sort_passes(r);
+
+  fprintf(f, "{\n  \"phases\": [");
+  for (unsigned i = 0; i < length_PhaseVec(r->phases); i++) {
+    Phase p = get_PhaseVec(r->phases, i);
+    fprintf(f, "%s\n    {\"name\": \"%s\", ", i == 0 ? "" : ",", p.name);
+    print_json_measure(f, p.measure);
+    fprintf(f, "}");
+  }
+  fprintf(f, "\n  ],\n  \"passes\": [");
+  for (unsigned i = 0; i < length_PassVec(r->passes); i++) {
+    Pass p = get_PassVec(r->passes, i);
+    // function names are C identifiers, which need no escaping
+    fprintf(f, "%s\n    {\"name\": \"%s\", \"function\": \"%s\", \"iteration\": ",
+            i == 0 ? "" : ",", p.name, p.function);
+    if (p.iteration >= 0) {
+      fprintf(f, "%d, ", p.iteration);
+    } else {
+      fprintf(f, "null, ");
+    }
+    print_json_measure(f, p.measure);
+    fprintf(f, "}");
+  }
+  fprintf(f, "\n  ]\n}\n");
+}
+
+void release_TimeReport(TimeReport* r) {
+  release_PhaseVec(r->phases);
+  release_PassVec(r->passes);
+  pthread_mutex_destroy(&r->lock);
+  free(r);
+}
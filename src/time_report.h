@@ -0,0 +1,56 @@
+#ifndef CCC_TIME_REPORT_H
+#define CCC_TIME_REPORT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "heap_stats.h"
+
+// resources spent in a part of the compilation
+typedef struct {
+  double start;  // seconds, on a monotonic clock
+  double wall;   // seconds
+  double cpu;   // seconds
+  unsigned long allocs;
+  long peak_heap;  // bytes, above the usage at the start
+} Measure;
+
+// a running measurement
+// CPU time is of the calling thread if `per_thread`, otherwise of the whole process
+typedef struct {
+  bool per_thread;
+  double wall;
+  double cpu;
+  unsigned long allocs;
+  HeapPeak heap;
+} Timer;
+
+Timer start_Timer(bool per_thread);
+Measure stop_Timer(Timer*);
+
+typedef struct TimeReport TimeReport;
+
+TimeReport* new_TimeReport();
+
+// a phase run on the whole translation unit
+void add_phase_TimeReport(TimeReport*, const char* name, Measure);
+
+// a pass run on `function`, the `function_idx`-th function in the translation unit
+// `iteration` is the one of the optimization loop, or -1 for passes outside of it
+// can be called from multiple threads; passes are ordered by function when printed
+void add_pass_TimeReport(TimeReport*,
+                         const char* name,
+                         const char* function,
+                         unsigned function_idx,
+                         int iteration,
+                         Measure);
+
+// human-readable tables of phases, and of passes summed up by pass, iteration and function
+void print_TimeReport(FILE*, TimeReport*);
+
+// every measurement as is
+void print_json_TimeReport(FILE*, TimeReport*);
+
+void release_TimeReport(TimeReport*);
+
+#endif
@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+#include "vector.h"
+
+typedef struct {
+  TraceEvent event;
+  unsigned thread;
+} Span;
+
+static void release_Span(Span s) {}
+DECLARE_VECTOR(Span, SpanVec)
+DEFINE_VECTOR(release_Span, Span, SpanVec)
+
+struct Trace {
+  SpanVec* spans;
+  pthread_mutex_t lock;  // for `spans`
+  double origin;         // the time `Trace` is created, shown as zero
+};
+
+// small sequential numbers for threads, in the order of their first event
+static atomic_uint thread_count;
+static _Thread_local unsigned thread_id;  // 0 if not assigned
+
+static unsigned current_thread() {
+  if (thread_id == 0) {
+    thread_id = atomic_fetch_add(&thread_count, 1) + 1;
+  }
+  return thread_id;
+}
+
+Trace* new_Trace() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  Trace* t  = calloc(1, sizeof(Trace));
+  t->spans  = new_SpanVec(64);
+  t->origin = ts.tv_sec + ts.tv_nsec * 1e-9;
+  pthread_mutex_init(&t->lock, NULL);
+  return t;
+}
+
+void add_Trace(Trace* t, TraceEvent e) {
+  Span s = {.event = e, .thread = current_thread()};
+  pthread_mutex_lock(&t->lock);
+  push_SpanVec(t->spans, s);
+  pthread_mutex_unlock(&t->lock);
+}
+
+static void print_Span(FILE* f, const Trace* t, Span s) {
+  TraceEvent e = s.event;
+  // timestamps are in microseconds; names are C identifiers, which need no escaping
+  fprintf(f, "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, ", e.name,
+          e.category, s.thread);
+  fprintf(f, "\"ts\": %.3f, \"dur\": %.3f, \"args\": {", (e.start - t->origin) * 1e6,
+          e.duration * 1e6);
+
+  const char* sep = "";
+  if (e.function != NULL) {
+    fprintf(f, "\"function\": \"%s\"", e.function);
+    sep = ", ";
+  }
+  if (e.iteration >= 0) {
+    fprintf(f, "%s\"iteration\": %d", sep, e.iteration);
+    sep = ", ";
+  }
+  for (unsigned i = 0; i < e.num_counters; i++) {
+    fprintf(f, "%s\"%s\": %ld", sep, e.counters[i].name, e.counters[i].value);
+    sep = ", ";
+  }
+  fprintf(f, "}}");
+}
+
+void print_Trace(FILE* f, Trace* t) {
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (unsigned i = 0; i < length_SpanVec(t->spans); i++) {
+    print_Span(f, t, get_SpanVec(t->spans, i));
+    fprintf(f, i + 1 == length_SpanVec(t->spans) ? "\n" : ",\n");
+  }
+  fprintf(f, "]}\n");
+}
+
+void release_Trace(Trace* t) {
+  release_SpanVec(t->spans);
+  pthread_mutex_destroy(&t->lock);
+  free(t);
+}
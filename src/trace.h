@@ -0,0 +1,38 @@
+#ifndef CCC_TRACE_H
+#define CCC_TRACE_H
+
+#include <stdio.h>
+
+// spans of the compilation, written in the trace event format of chrome://tracing and Perfetto
+typedef struct Trace Trace;
+
+typedef struct {
+  const char* name;
+  long value;
+} TraceCounter;
+
+#define MAX_TRACE_COUNTERS 4
+
+typedef struct {
+  const char* name;
+  const char* category;
+  double start;     // seconds, on the clock of `Measure::start` (see time_report.h)
+  double duration;  // seconds
+
+  const char* function;  // nullable
+  int iteration;         // of the optimization loop, or -1
+
+  unsigned num_counters;
+  TraceCounter counters[MAX_TRACE_COUNTERS];
+} TraceEvent;
+
+Trace* new_Trace();
+
+// record `e` as a span on the calling thread
+// can be called from multiple threads
+void add_Trace(Trace*, TraceEvent e);
+
+void print_Trace(FILE*, Trace*);
+void release_Trace(Trace*);
+
+#endif
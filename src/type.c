@@ -1,9 +1,14 @@
 #include "type.h"
 #include "error.h"
+#include "util.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+Arena* type_arena;
+
+DEFINE_ARENA_ALLOCATOR(types, type_arena)
+
 DataSize to_data_size(unsigned i) {
   switch (i) {
     case 1:
@@ -27,25 +32,16 @@ static void release_long(long l) {}
 static long copy_long(long l) {
   return l;
 }
-DEFINE_MAP(copy_long, release_long, long, EnumMap)
-
-static void release_Field(Field* field) {
-  if (field == NULL) {
-    return;
-  }
-
-  release_Type(field->type);
-  free(field);
-}
+DEFINE_MAP_WITH(types, copy_long, release_long, long, EnumMap)
 
 static Field* copy_Field(Field* field) {
   return new_Field(copy_Type(field->type), field->offset);
 }
 
-DEFINE_MAP(copy_Field, release_Field, Field*, FieldMap)
+DEFINE_MAP_WITH(types, copy_Field, release_dummy, Field*, FieldMap)
 
 Field* new_Field(Type* ty, unsigned offset) {
-  Field* f  = calloc(1, sizeof(Field));
+  Field* f  = alloc_types(sizeof(Field));
   f->type   = ty;
   f->offset = offset;
   return f;
@@ -59,34 +55,15 @@ static bool equal_to_Field(Field* f1, Field* f2) {
   return equal_to_Type(f1->type, f2->type);
 }
 
-static void release_string(char* s) {
-  free(s);
-}
-DEFINE_VECTOR(release_string, char*, StringVec)
+static void release_string(const char* s) {}
+DEFINE_VECTOR_WITH(types, release_string, const char*, StringVec)
 
 Type* new_Type(TypeKind kind) {
-  Type* ty = calloc(1, sizeof(Type));
+  Type* ty = alloc_types(sizeof(Type));
   ty->kind = kind;
   return ty;
 }
 
-void release_Type(Type* ty) {
-  if (ty == NULL) {
-    return;
-  }
-
-  release_Type(ty->ptr_to);
-  release_Type(ty->ret);
-  release_TypeVec(ty->params);
-  release_Type(ty->element);
-  release_StringVec(ty->fields);
-  release_FieldMap(ty->field_map);
-  release_StringVec(ty->enums);
-  release_EnumMap(ty->enum_map);
-  free(ty->tag);
-  free(ty);
-}
-
 Type* copy_Type(const Type* ty) {
   Type* new = new_Type(ty->kind);
   *new      = *ty;
@@ -107,15 +84,11 @@ Type* copy_Type(const Type* ty) {
   if (ty->element != NULL) {
     new->element = copy_Type(ty->element);
   }
-  if (ty->tag != NULL) {
-    new->tag = strdup(ty->tag);
-  }
   if (ty->fields != NULL) {
     unsigned len = length_StringVec(ty->fields);
     new->fields  = new_StringVec(len);
     for (unsigned i = 0; i < len; i++) {
-      char* t = get_StringVec(ty->fields, i);
-      push_StringVec(new->fields, strdup(t));
+      push_StringVec(new->fields, get_StringVec(ty->fields, i));
     }
   }
   if (ty->field_map != NULL) {
@@ -125,8 +98,7 @@ Type* copy_Type(const Type* ty) {
     unsigned len = length_StringVec(ty->enums);
     new->enums   = new_StringVec(len);
     for (unsigned i = 0; i < len; i++) {
-      char* t = get_StringVec(ty->enums, i);
-      push_StringVec(new->enums, strdup(t));
+      push_StringVec(new->enums, get_StringVec(ty->enums, i));
     }
   }
   if (ty->enum_map != NULL) {
@@ -136,7 +108,7 @@ Type* copy_Type(const Type* ty) {
   return new;
 }
 
-DEFINE_VECTOR(release_Type, Type*, TypeVec)
+DEFINE_VECTOR_WITH(types, release_dummy, Type*, TypeVec)
 DECLARE_VECTOR_PRINTER(TypeVec)
 
 static void print_Field(FILE* p, Field* f) {
@@ -236,11 +208,8 @@ bool equal_to_Type(const Type* a, const Type* b) {
     return false;
   }
 
-  if ((bool)a->tag != (bool)b->tag) {
-    return false;
-  }
-  // if a->tag == NULL, b->tag would be NULL
-  if (a->tag != NULL && strcmp(a->tag, b->tag) != 0) {
+  // tags are interned
+  if (a->tag != b->tag) {
     return false;
   }
 
@@ -259,9 +228,9 @@ bool equal_to_Type(const Type* a, const Type* b) {
         return false;
       }
       for (unsigned i = 0; i < length_StringVec(a->fields); i++) {
-        char* k1 = get_StringVec(a->fields, i);
-        char* k2 = get_StringVec(b->fields, i);
-        if (strcmp(k1, k2) != 0) {
+        const char* k1 = get_StringVec(a->fields, i);
+        const char* k2 = get_StringVec(b->fields, i);
+        if (k1 != k2) {
           return false;
         }
         Field* f1 = get_FieldMap(a->field_map, k1);
@@ -282,9 +251,9 @@ bool equal_to_Type(const Type* a, const Type* b) {
         return false;
       }
       for (unsigned i = 0; i < length_StringVec(a->enums); i++) {
-        char* k1 = get_StringVec(a->enums, i);
-        char* k2 = get_StringVec(b->enums, i);
-        if (strcmp(k1, k2) != 0) {
+        const char* k1 = get_StringVec(a->enums, i);
+        const char* k2 = get_StringVec(b->enums, i);
+        if (k1 != k2) {
           return false;
         }
         if (get_EnumMap(a->enum_map, k1) != get_EnumMap(b->enum_map, k2)) {
@@ -358,7 +327,7 @@ Type* bool_ty() {
   return new_Type(TY_BOOL);
 }
 
-Type* struct_ty(char* tag, StringVec* fields, FieldMap* field_map) {
+Type* struct_ty(const char* tag, StringVec* fields, FieldMap* field_map) {
   Type* t      = new_Type(TY_STRUCT);
   t->field_map = field_map;
   t->fields    = fields;
@@ -366,7 +335,7 @@ Type* struct_ty(char* tag, StringVec* fields, FieldMap* field_map) {
   return t;
 }
 
-Type* enum_ty(char* tag, StringVec* enums, EnumMap* enum_map) {
+Type* enum_ty(const char* tag, StringVec* enums, EnumMap* enum_map) {
   Type* t     = new_Type(TY_ENUM);
   t->enum_map = enum_map;
   t->enums    = enums;
@@ -430,15 +399,13 @@ Type* to_unsigned_ty(Type* t) {
 }
 
 Type* into_signed_ty(Type* t) {
-  Type* new = to_signed_ty(t);
-  release_Type(t);
-  return new;
+  make_signed_ty(t);
+  return t;
 }
 
 Type* into_unsigned_ty(Type* t) {
-  Type* new = to_unsigned_ty(t);
-  release_Type(t);
-  return new;
+  make_unsigned_ty(t);
+  return t;
 }
 
 bool is_arithmetic_ty(const Type* ty) {
@@ -461,11 +428,8 @@ bool is_compatible_ty(const Type* a, const Type* b) {
     return false;
   }
 
-  if ((bool)a->tag != (bool)b->tag) {
-    return false;
-  }
-  // if a->tag == NULL, b->tag would be NULL
-  if (a->tag != NULL && strcmp(a->tag, b->tag) != 0) {
+  // tags are interned
+  if (a->tag != b->tag) {
     return false;
   }
 
@@ -476,9 +440,9 @@ bool is_compatible_ty(const Type* a, const Type* b) {
           return false;
         }
         for (unsigned i = 0; i < length_StringVec(a->fields); i++) {
-          char* k1 = get_StringVec(a->fields, i);
-          char* k2 = get_StringVec(b->fields, i);
-          if (strcmp(k1, k2) != 0) {
+          const char* k1 = get_StringVec(a->fields, i);
+          const char* k2 = get_StringVec(b->fields, i);
+          if (k1 != k2) {
             return false;
           }
           Field* f1 = get_FieldMap(a->field_map, k1);
@@ -495,9 +459,9 @@ bool is_compatible_ty(const Type* a, const Type* b) {
           return false;
         }
         for (unsigned i = 0; i < length_StringVec(a->enums); i++) {
-          char* k1 = get_StringVec(a->enums, i);
-          char* k2 = get_StringVec(b->enums, i);
-          if (strcmp(k1, k2) != 0) {
+          const char* k1 = get_StringVec(a->enums, i);
+          const char* k2 = get_StringVec(b->enums, i);
+          if (k1 != k2) {
             return false;
           }
           if (get_EnumMap(a->enum_map, k1) != get_EnumMap(b->enum_map, k2)) {
@@ -592,8 +556,8 @@ unsigned sizeof_ty(const Type* t) {
     case TY_ARRAY:
       return length_of_ty(t) * sizeof_ty(t->element);
     case TY_STRUCT: {
-      char* last = get_StringVec(t->fields, length_StringVec(t->fields) - 1);
-      Field* f   = get_FieldMap(t->field_map, last);
+      const char* last = get_StringVec(t->fields, length_StringVec(t->fields) - 1);
+      Field* f         = get_FieldMap(t->field_map, last);
       return f->offset + sizeof_ty(f->type);
     }
     case TY_ENUM:
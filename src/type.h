@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include "arena.h"
 #include "map.h"
 #include "vector.h"
 
@@ -43,7 +44,7 @@ DECLARE_MAP(Field*, FieldMap)
 
 Field* new_Field(Type*, unsigned offset);
 
-DECLARE_VECTOR(char*, StringVec)
+DECLARE_VECTOR(const char*, StringVec)  // of interned strings
 
 struct Type {
   TypeKind kind;
@@ -66,7 +67,7 @@ struct Type {
   unsigned length;
 
   // for TY_STRUCT and TY_ENUM
-  char* tag;  // NULL if not tagged
+  const char* tag;  // interned, NULL if not tagged
 
   // for TY_STRUCT
   StringVec* fields;    // NULL if incomplete
@@ -77,9 +78,11 @@ struct Type {
   EnumMap* enum_map;  // NULL if incomplete
 };
 
+// types are allocated in `type_arena` and freed together with it; they are shared freely
+extern Arena* type_arena;
+
 Type* new_Type(TypeKind);
 Type* new_int_Type(DataSize size, bool is_signed);
-void release_Type(Type*);
 void print_Type(FILE*, Type*);
 bool equal_to_Type(const Type*, const Type*);
 Type* copy_Type(const Type*);
@@ -90,8 +93,8 @@ Type* long_ty();
 Type* short_ty();
 Type* void_ty();
 Type* bool_ty();
-Type* struct_ty(char*, StringVec*, FieldMap*);
-Type* enum_ty(char*, StringVec*, EnumMap*);
+Type* struct_ty(const char*, StringVec*, FieldMap*);
+Type* enum_ty(const char*, StringVec*, EnumMap*);
 Type* ptr_to_ty(Type*);
 Type* func_ty(Type*, TypeVec*, bool is_vararg);
 Type* array_ty(Type*, bool is_length_known);
@@ -1,6 +1,9 @@
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "error.h"
+#include "mem_stats.h"
 #include "util.h"
 
 size_t strnlen(const char* s, size_t n) {
@@ -24,3 +27,52 @@ char* strndup(const char* s, size_t n) {
 }
 
 void release_dummy(void* p) {}
+
+void* alloc_heap(size_t size) {
+  return alloc_tagged(MEM_CONTAINERS, size);
+}
+
+void* realloc_heap(void* p, size_t old_size, size_t new_size) {
+  return realloc_tagged(MEM_CONTAINERS, p, new_size);
+}
+
+void free_heap(void* p) {
+  free_tagged(MEM_CONTAINERS, p);
+}
+
+bool is_hyphen(const char* path) {
+  return path[0] == '-' && path[1] == '\0';
+}
+
+FILE* open_file(const char* path, const char* mode) {
+  if (mode[0] == 'w' && is_hyphen(path)) {
+    return stdout;
+  }
+  FILE* f = fopen(path, mode);
+  if (f == NULL) {
+    error("could not open \"%s\": %s", path, strerror(errno));
+  }
+  return f;
+}
+
+void close_file(FILE* f) {
+  if (f == stdout) {
+    return;
+  }
+  fclose(f);
+}
+
+char* read_file(const char* path) {
+  FILE* f = open_file(path, "rb");
+  fseek(f, 0, SEEK_END);
+  size_t size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  char* buf = malloc(size + 1);
+  fread(buf, 1, size, f);
+  fclose(f);
+
+  buf[size] = 0;
+
+  return buf;
+}
@@ -1,8 +1,27 @@
 #ifndef CCC_UTIL_H
 #define CCC_UTIL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
 char* strdup(const char* s);
 char* strndup(const char* s, size_t n);
 void release_dummy(void*);
 
+// the default allocator of containers (see `DEFINE_*_WITH` in list.h, vector.h and map.h)
+// counted as `MEM_CONTAINERS` (see mem_stats.h)
+void* alloc_heap(size_t size);  // zero-initialized
+void* realloc_heap(void*, size_t old_size, size_t new_size);
+void free_heap(void*);
+
+// "-" names the standard output
+bool is_hyphen(const char* path);
+// exits with an error if `path` cannot be opened
+FILE* open_file(const char* path, const char* mode);
+// leaves the standard output open
+void close_file(FILE*);
+// the whole content of `path`, null-terminated (to be freed)
+char* read_file(const char* path);
+
 #endif
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "util.h"
+
 #define DECLARE_VECTOR(T, Name)                                                                    \
   typedef struct Name Name;                                                                        \
   Name* new_##Name(unsigned capacity);                                                             \
@@ -21,15 +23,18 @@
   Name* copy_##Name(Name*);                                                                        \
   void release_##Name(Name*);
 
-#define DEFINE_VECTOR(release_data, T, Name)                                                       \
+#define DEFINE_VECTOR(release_data, T, Name) DEFINE_VECTOR_WITH(heap, release_data, T, Name)
+
+// allocated with `alloc_##A`, `realloc_##A` and `free_##A` (see util.h and arena.h)
+#define DEFINE_VECTOR_WITH(A, release_data, T, Name)                                               \
   struct Name {                                                                                    \
     T* data;                                                                                       \
     unsigned capacity;                                                                             \
     unsigned length;                                                                               \
   };                                                                                               \
   Name* new_##Name(unsigned c) {                                                                   \
-    Name* v     = calloc(1, sizeof(Name));                                                         \
-    v->data     = calloc(c, sizeof(T));                                                            \
+    Name* v     = alloc_##A(sizeof(Name));                                                         \
+    v->data     = alloc_##A(sizeof(T) * c);                                                        \
     v->capacity = c;                                                                               \
     v->length   = 0;                                                                               \
     return v;                                                                                      \
@@ -52,8 +57,8 @@
     }                                                                                              \
   }                                                                                                \
   void reserve_##Name(Name* v, unsigned size) {                                                    \
+    v->data     = realloc_##A(v->data, sizeof(T) * v->capacity, sizeof(T) * size);                 \
     v->capacity = size;                                                                            \
-    v->data     = realloc(v->data, sizeof(T) * size);                                              \
   }                                                                                                \
   void resize_##Name(Name* v, unsigned size) {                                                     \
     if (v->capacity < size) {                                                                      \
@@ -85,8 +90,8 @@
     for (unsigned i = 0; i < a->length; i++) {                                                     \
       release_data(a->data[i]);                                                                    \
     }                                                                                              \
-    free(a->data);                                                                                 \
-    free(a);                                                                                       \
+    free_##A(a->data);                                                                             \
+    free_##A(a);                                                                                   \
   }
 
 #define DECLARE_VECTOR_PRINTER(Name) void print_##Name(FILE* f, Name* v);
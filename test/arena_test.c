@@ -0,0 +1,58 @@
+// checks of the contracts in arena.h that compiled programs do not reach
+//
+// usage: arena_test
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "error.h"
+
+static bool is_zero(const char* p, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (p[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// an empty allocation is distinct from the next one, and growing either does not clobber the other
+static void empty_allocation() {
+  Arena* a = new_Arena("test", MEM_CONTAINERS);
+  char* p  = alloc_Arena(a, 0);
+  char* q  = alloc_Arena(a, 8);
+  if (p == q) {
+    error("an empty allocation shares its address with the next one");
+  }
+  memset(q, 'q', 8);
+  p = realloc_Arena(a, p, 0, 64);
+  memset(p, 'p', 64);
+  for (unsigned i = 0; i < 8; i++) {
+    if (q[i] != 'q') {
+      error("growing an empty allocation clobbered the next one");
+    }
+  }
+  release_Arena(a);
+}
+
+// memory reclaimed by shrinking the last allocation comes back zero-initialized
+static void shrink_then_alloc() {
+  Arena* a = new_Arena("test", MEM_CONTAINERS);
+  char* p  = alloc_Arena(a, 256);
+  memset(p, 'x', 256);
+  p       = realloc_Arena(a, p, 256, 16);
+  char* q = alloc_Arena(a, 240);
+  if (!is_zero(q, 240)) {
+    error("memory reclaimed by shrinking is not zero-initialized");
+  }
+  release_Arena(a);
+}
+
+int main() {
+  empty_allocation();
+  shrink_then_alloc();
+  puts("arena: OK");
+  return 0;
+}
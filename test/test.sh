@@ -4,6 +4,7 @@ set -u
 
 readonly BASE_DIR="$(dirname "$BASH_SOURCE")/.."
 readonly CCC="$BASE_DIR/build/$1"
+readonly CCC_OPT="$BASE_DIR/build/ccc-opt${1#ccc}"
 
 function try() {
     local expected="$1"
@@ -18,19 +19,58 @@ function try() {
     local tmp_ast2="$(mktemp)"
     local tmp_ir1="$(mktemp --suffix .gv)"
     local tmp_ir2="$(mktemp --suffix .gv)"
+    local tmp_saved="$(mktemp --suffix .ir)"
+    local tmp_opt_asm="$(mktemp --suffix .s)"
+    local tmp_stream_asm="$(mktemp --suffix .s)"
+    local tmp_stream_exe="$(mktemp)"
+    local tmp_color_asm="$(mktemp --suffix .s)"
+    local tmp_color_exe="$(mktemp)"
 
     echo "$input" > "$tmp_in"
-    "$CCC" "$tmp_in" -O3 \
+    "$CCC" "$tmp_in" -O3 -j 2 \
       -o "$tmp_asm" \
       --emit-tokens "$tmp_tks" \
       --emit-ast1 "$tmp_ast1" \
       --emit-ast2 "$tmp_ast2" \
       --emit-ir1 "$tmp_ir1" \
-      --emit-ir2 "$tmp_ir2"
+      --emit-ir2 "$tmp_ir2" \
+      --save-ir "$tmp_saved"
+    # the saved IR has to be optimized into the same output
+    "$CCC_OPT" "$tmp_saved" -O3 -o "$tmp_opt_asm" 2> /dev/null
+    if ! cmp -s "$tmp_asm" "$tmp_opt_asm"; then
+        echo "$input => ccc-opt output differs"
+        echo "saved ir: $tmp_saved"
+        echo "output: $tmp_asm"
+        echo "ccc-opt output: $tmp_opt_asm"
+        exit 1
+    fi
     gcc -o "$tmp_exe" "$tmp_asm"
     "$tmp_exe"
     local actual="$?"
 
+    # functions are output in another order when streamed, so only the behavior is compared
+    "$CCC" "$tmp_in" -O3 --stream -o "$tmp_stream_asm"
+    gcc -o "$tmp_stream_exe" "$tmp_stream_asm"
+    "$tmp_stream_exe"
+    local streamed="$?"
+    if [ "$streamed" != "$actual" ]; then
+        echo "$input => $actual, but got $streamed with --stream"
+        echo "output: $tmp_asm"
+        echo "streamed output: $tmp_stream_asm"
+        exit 1
+    fi
+
+    "$CCC" "$tmp_in" -O3 --regalloc=color -o "$tmp_color_asm"
+    gcc -o "$tmp_color_exe" "$tmp_color_asm"
+    "$tmp_color_exe"
+    local colored="$?"
+    if [ "$colored" != "$actual" ]; then
+        echo "$input => $actual, but got $colored with --regalloc=color"
+        echo "output: $tmp_asm"
+        echo "colored output: $tmp_color_asm"
+        exit 1
+    fi
+
     if [ "$actual" = "$expected" ]; then
         echo "$input => $actual"
     else
@@ -131,6 +171,7 @@ items 42 "return 2*21;";
 items 10 "int var; var = 10; return var;"
 items 42 "int va; int vb; va = 11; vb = 31; int vc; vc = va + vb; return vc;"
 items 50 "int v; v = 30; v = 50; return v;"
+items 3 "int yictiexy; int znlhayrh; yictiexy = 3; znlhayrh = 4; return yictiexy;" # same hash
 
 # if
 items 5 "if (1) return 5; else return 20;"
@@ -141,6 +182,9 @@ items 27 "int a; a = 15; int b; b = 2; if(a-15) b = 10; else if (b) return (a +
 # compound
 items 5 "{ return 5; }"
 items 10 "{ int a; a = 5; { a = 5 + a; } return a; }"
+items 1 "int a = 1; { int a = 2; a = a + 1; } return a;"
+items 6 "int s = 0; for (int i = 0; i < 3; i++) { int i = 2; s += i; } return s;"
+items 3 "int s = 0; { typedef char T; enum { E = 2 }; T c = E; s = s + c; } { enum { E = 1 }; s = s + E; } return s;"
 items 20 "int a; a = 10; if (1) { a = 20; } else { a = 10; } return a;"
 items 30 "int a; a = 10; if (a) { if (a - 10) { a = a + 1; } else { a = a + 20; } a = a - 10; } else { a = a + 5; } return a + 10;"
 
@@ -507,6 +551,7 @@ EOF
 
 # comments
 items 10 "int /* I am a comment */ a = /*hello!*/ 10; return /*wowo*/ a;"
+items 10 "int /***/ a = /* ** / * */ 10; return a;"
 try_ 42 <<EOF
 // OMG I AM A COMMENT
 
@@ -520,6 +565,11 @@ int main (/* no parameters. */) {
 // this is also a comment
 EOF
 
+# identifiers
+items 6 "int integer = 1; int format = 2; int done = 3; return integer + format + done;"
+items 7 "int constant_with_a_name_longer_than_sixteen_chars = 7; return constant_with_a_name_longer_than_sixteen_chars;"
+items 3 "int _Bool_ = 1, if_ = 2; return _Bool_ + if_;"
+
 # struct
 items 4 "struct {int a;} x; return sizeof(x);"
 items 12 "struct {char a; int b;} x; x.a=10; x.b = 2; return x.a + x.b;"
@@ -746,5 +796,175 @@ int main(int argc, char** argv) {
   return f(5, 2);
 }
 EOF
+try_ 39 <<EOF
+int g(int x) {
+  return x + 1;
+}
+
+int main() {
+  int a = 1; int b = 2; int c = 3; int d = 4; int e = 5; int f = 6; int h = 7; int i = 8;
+  int j = 9; int k = 10; int l = 11; int m = 12; int n = 13; int o = 14; int p = 15; int q = 16;
+  for (int t = 0; t < 3; t++) {
+    a = g(a) + q; q = p; p = o + b; o = n; n = m; m = l; l = k;
+    k = j; j = i; i = h; h = f; f = e; e = d; d = c; c = g(b); b = a - t;
+  }
+  return a + b + c + d + e + f + h + i + j + k + l + m + n + o + p + q - 256;
+}
+EOF
+try_ 37 <<EOF
+int set(int* p, int v) {
+  *p = v;
+  return 0;
+}
+
+int main() {
+  char c = 3;
+  int a[3];
+  char d = 4;
+  int* p = a;
+  int x;
+  set(&x, 5);
+  for (int i = 0; i < 3; i++) {
+    set(p + i, i * c + d);
+  }
+  char* q = &c;
+  *q = *q + d;
+  return a[0] + a[1] + a[2] + x + c + d;
+}
+EOF
+try_ 105 <<EOF
+int add(int* p, int v) {
+  *p = *p + v;
+  return 0;
+}
+
+int main() {
+  int a0 = 0; int a1 = 1; int a2 = 2; int a3 = 3; int a4 = 4; int a5 = 5; int a6 = 6; int a7 = 7;
+  int a8 = 8; int a9 = 9; int a10 = 10; int a11 = 11; int a12 = 12; int a13 = 13; int a14 = 14;
+  int a15 = 15;
+  int* p0 = &a0; int* p1 = &a1; int* p2 = &a2; int* p3 = &a3; int* p4 = &a4; int* p5 = &a5;
+  int* p6 = &a6; int* p7 = &a7; int* p8 = &a8; int* p9 = &a9; int* p10 = &a10; int* p11 = &a11;
+  int* p12 = &a12; int* p13 = &a13; int* p14 = &a14; int* p15 = &a15;
+  for (int i = 0; i < 10; i++) {
+    add(p0, i); add(p1, i); add(p2, i); add(p3, i); add(p4, i); add(p5, i); add(p6, i);
+    add(p7, i); add(p8, i); add(p9, i); add(p10, i); add(p11, i); add(p12, i); add(p13, i);
+    add(p14, i); add(p15, i);
+  }
+  return a0 + a15;
+}
+EOF
+try_ 99 <<EOF
+int g(int x) {
+  return x + 1;
+}
+
+int main() {
+  int a = g(1); int b = g(2); int c = g(3); int d = g(4); int e = g(5); int f = g(6);
+  int h = g(7); int i = g(8);
+  int s = 0;
+  for (int t = 0; t < 10; t++) {
+    s = g(s) + t;
+  }
+  return s + a + b + c + d + e + f + h + i;
+}
+EOF
+try_ 132 <<EOF
+int main() {
+  long seed = 7;
+  long acc  = 0;
+  for (int k = 0; k < 1000; k++) {
+    seed  = (seed * 1103515245 + 12345) & 2147483647;
+    int r = (int)(seed / 256);
+    acc   = (acc * 7 + r) & 1048575;
+  }
+  return acc & 255;
+}
+EOF
+try_ 246 <<EOF
+int main() {
+  long seed = 7;
+  long acc  = 0;
+  for (int k = 0; k < 1000; k++) {
+    seed  = (seed * 1103515245 + 12345) & 2147483647;
+    int r = (int)(seed / 256);
+    int m = (k & 7) + 1;
+    acc   = (acc * 7 + r + r % m + r / m) & 1048575;
+  }
+  return acc & 255;
+}
+EOF
+try_ 37 <<EOF
+int f(int x) {
+  return x / 3 + x % 5;
+}
+
+int main() {
+  return f(100) + f(7);
+}
+EOF
+try_ 16 <<EOF
+int f(int x) {
+  return x / 2 + x % 3;
+}
+
+int main() {
+  return f(0 - 7) + 20;
+}
+EOF
+try_ 95 <<EOF
+int f0(int a, int b, int c, int d, int e, int* p) {
+  p[a & 7] += b;
+  return (a * 3 + b * 5 + c * 7 + d * 11 + e * 13 + p[b & 7]) & 65535;
+}
+
+int f1(int a, int b, int c, int d) {
+  int arr[16];
+  for (int i = 0; i < 16; i++) {
+    arr[i] = i;
+  }
+  int l0 = 26 + a + b; int l1 = 7 + a + b; int l2 = 26 + a * 2 + b; int l3 = 29 + a * 3 + b;
+  int l4 = 17 + a * 3 + b; int l5 = 23 + a * 2 + b; int l6 = 18 + a * 2 + b;
+  int l7 = 12 + a * 2 + b; int l8 = 12 + b; int l9 = 27 + b; int l10 = a * 2 + b;
+  for (int i = 0; i < 7; i++) {
+    l7 = (f0(d ^ l6, l5, l3, d, c, arr) + l7) & 65535;
+    l3 = (l5 | (l3 > d)) & 65535;
+  }
+  int s = 0;
+  s = (s * 31 + l0) & 16777215; s = (s * 31 + l1) & 16777215; s = (s * 31 + l2) & 16777215;
+  s = (s * 31 + l3) & 16777215; s = (s * 31 + l4) & 16777215; s = (s * 31 + l5) & 16777215;
+  s = (s * 31 + l6) & 16777215; s = (s * 31 + l7) & 16777215; s = (s * 31 + l8) & 16777215;
+  s = (s * 31 + l9) & 16777215; s = (s * 31 + l10) & 16777215;
+  return s;
+}
+
+int main() {
+  return f1(3, 5, 7, 9) & 255;
+}
+EOF
+try_ 69 <<EOF
+long mix(char a, short b, int c, long d, char e, long f) {
+  return a + b + c + d % 5 + e + f;
+}
+
+long nested(long x, int n) {
+  long s = 0;
+  for (int i = 0; i < n; i++) {
+    s = s + mix(i, x % 9, mix(1, 2, i, s % 11, 3, x), x, i % 5, mix(i, i, i, i, i, i) % 13) % 101;
+  }
+  return s;
+}
+
+int main() {
+  char c0 = 3, c4 = 9;
+  short s0 = 7, s4 = 1;
+  long l0 = 11, l2 = 13, l4 = 0;
+  for (int i = 0; i < 50; i++) {
+    c0 = (c0 + 12345 % (i + 7)) & 63;
+    s4 = s4 ^ i;
+    l4 = l4 + mix(c0, s0, i, l0, c4, l2) % 1000 + c0;
+  }
+  return (c0 + s4 + l4 + nested(l4, 20)) & 255;
+}
+EOF
 
 echo OK
@@ -0,0 +1,203 @@
+// runs optimization passes over IR saved by `ccc --save-ir`, reporting the time spent in each
+//
+// usage: ccc-opt [-On|-Ofix] [--passes PASS,...] [-j N] [--time-report[=FORMAT]] [--mem-report]
+//                [--trace-out FILE] [--save-ir FILE] [--regalloc ALLOCATOR] [-o FILE] IR_FILE
+
+#include <argp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+#include "codegen.h"
+#include "intern.h"
+#include "ir_text.h"
+#include "mem_stats.h"
+#include "pass_manager.h"
+#include "time_report.h"
+#include "trace.h"
+#include "util.h"
+
+static char doc[] = "ccc-opt: run optimization passes over saved IR";
+
+static char args_doc[] =
+    "[-On|-Ofix] [--passes PASS,...] [-j N] [--time-report[=FORMAT]] [--mem-report] "
+    "[--trace-out FILE] [--save-ir FILE] [--regalloc ALLOCATOR] [-o FILE] IR_FILE";
+
+static struct argp_option options[] = {
+    {"optimize", 'O', "INTEGER", 0,
+     "Maximum number of optimization iterations, or 'fix' to iterate until nothing changes"},
+    {"passes", 'p', "PASS,...", 0, "Passes of the optimization pipeline"},
+    {"jobs", 'j', "N", 0, "Optimize and allocate registers of N functions in parallel"},
+    {"time-report", 'T', "FORMAT", OPTION_ARG_OPTIONAL,
+     "Print time and memory spent in each phase and pass to stderr as text (default) or json"},
+    {"mem-report", 'M', 0, 0,
+     "Print live bytes, peak bytes and allocations of each subsystem and phase to stderr"},
+    {"trace-out", 'P', "FILE", 0, "Write the timeline of phases and passes in trace event format"},
+    {"save-ir", 'I', "FILE", 0, "Save the optimized IR to the file"},
+    {"regalloc", 'A', "ALLOCATOR", 0,
+     "Register allocator for --output, 'linear' (default) or 'color', as in ccc"},
+    {"output", 'o', "FILE", 0, "Allocate registers and output assembly to FILE"},
+    {0}};
+
+// the safety cap of `-Ofix`, as in ccc
+#define FIXPOINT_ITERATIONS 16
+
+typedef struct {
+  unsigned iterations;
+  Pipeline* pipeline;
+  unsigned jobs;
+  bool time_report_json;
+
+  char* trace_out;
+  Trace* trace;  // NULL unless requested
+
+  char* save_ir;
+  RegAllocKind regalloc;
+  char* output;
+  char* source;
+} Options;
+
+static error_t parse_opt(int key, char* arg, struct argp_state* state) {
+  Options* opts = state->input;
+
+  switch (key) {
+    case 'O':
+      if (strcmp(arg, "fix") == 0) {
+        opts->iterations = FIXPOINT_ITERATIONS;
+      } else {
+        opts->iterations = atoi(arg) + 1;
+      }
+      break;
+    case 'p': {
+      char* unknown;
+      release_Pipeline(opts->pipeline);
+      opts->pipeline = parse_pipeline(arg, &unknown);
+      if (opts->pipeline == NULL) {
+        argp_error(state, "unknown pass: %s", unknown);
+      }
+      break;
+    }
+    case 'j':
+      opts->jobs = atoi(arg);
+      break;
+    case 'T':
+      if (arg != NULL && strcmp(arg, "json") == 0) {
+        opts->time_report_json = true;
+      } else if (arg != NULL && strcmp(arg, "text") != 0) {
+        argp_error(state, "unknown report format: %s", arg);
+      }
+      break;
+    case 'M':
+      // usually started already in `main`
+      start_mem_stats();
+      break;
+    case 'P':
+      opts->trace_out = arg;
+      opts->trace     = new_Trace();
+      break;
+    case 'I':
+      opts->save_ir = arg;
+      break;
+    case 'A':
+      if (strcmp(arg, "linear") == 0) {
+        opts->regalloc = RA_LINEAR;
+      } else if (strcmp(arg, "color") == 0) {
+        opts->regalloc = RA_COLOR;
+      } else {
+        argp_error(state, "unknown register allocator: %s", arg);
+      }
+      break;
+    case 'o':
+      opts->output = arg;
+      break;
+
+    case ARGP_KEY_ARG:
+      if (state->arg_num >= 1) {
+        argp_usage(state);
+      }
+      opts->source = arg;
+      break;
+    case ARGP_KEY_END:
+      if (state->arg_num < 1) {
+        argp_usage(state);
+      }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+  }
+  return 0;
+}
+
+static struct argp argp = {options, parse_opt, args_doc, doc};
+
+int main(int argc, char** argv) {
+  start_mem_stats_if_requested(argc, argv);
+
+  Options opts = {.iterations = 1, .pipeline = default_pipeline(), .jobs = 1};
+  argp_parse(&argp, argc, argv, 0, 0, &opts);
+
+  // the report is the point of this tool, so it is always printed
+  TimeReport* report = new_TimeReport();
+
+  Timer t     = start_Timer(false);
+  char* input = read_file(opts.source);
+  IR* ir      = read_IR(input);
+  free(input);
+  end_phase(report, opts.trace, "read_IR", &t);
+
+  BackendOptions backend = {
+      .iterations = opts.iterations,
+      .pipeline   = opts.pipeline,
+      .allocate   = false,
+      .regalloc   = opts.regalloc,
+      .jobs       = opts.jobs,
+      .report     = report,
+      .trace      = opts.trace,
+  };
+  t = start_Timer(false);
+  compile_functions(ir, &backend);
+  end_phase(report, opts.trace, "passes", &t);
+
+  if (opts.save_ir != NULL) {
+    FILE* f = open_file(opts.save_ir, "w");
+    write_IR(f, ir);
+    close_file(f);
+  }
+
+  if (opts.output != NULL) {
+    backend.iterations = 0;
+    backend.allocate   = true;
+    t                  = start_Timer(false);
+    compile_functions(ir, &backend);
+    end_phase(report, opts.trace, "reg_alloc", &t);
+
+    t       = start_Timer(false);
+    FILE* f = open_file(opts.output, "w");
+    codegen(f, ir);
+    close_file(f);
+    end_phase(report, opts.trace, "codegen", &t);
+  }
+
+  release_IR(ir);
+
+  if (opts.time_report_json) {
+    print_json_TimeReport(stderr, report);
+  } else {
+    print_TimeReport(stderr, report);
+  }
+  release_TimeReport(report);
+  if (opts.trace != NULL) {
+    FILE* f = open_file(opts.trace_out, "w");
+    print_Trace(f, opts.trace);
+    close_file(f);
+    release_Trace(opts.trace);
+  }
+  release_Pipeline(opts.pipeline);
+  release_interned_strings();
+
+  // what is still live here is leaked
+  print_mem_report(stderr);
+
+  return 0;
+}